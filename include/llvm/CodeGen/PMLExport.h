@@ -29,6 +29,7 @@
 namespace llvm {
 
   class MachineLoop;
+  class tool_output_file;
 
   /// Provides information about machine instructions, can be overloaded for
   /// specific targets.
@@ -83,7 +84,19 @@ namespace llvm {
 
     virtual void serialize(MachineFunction &MF) =0;
 
+    /// writeFunctionKey - write everything the export of MF depends on,
+    /// besides the bitcode and machine code of MF itself, to OS. This is
+    /// used to detect unchanged functions when caching exported functions.
+    virtual void writeFunctionKey(MachineFunction &MF, raw_ostream &OS) {}
+
     virtual void writeOutput(yaml::Output *Output) =0;
+
+    /// getPMLDoc - get the document containing the serialized information.
+    virtual yaml::PMLDoc& getPMLDoc() =0;
+
+    /// flush - write everything serialized so far (if anything) and release
+    /// it, so that the export can be streamed function by function.
+    virtual void flush(yaml::Output *Output) =0;
   };
 
 
@@ -121,6 +134,11 @@ namespace llvm {
       yaml::PMLDoc *DocPtr = &YDoc; *Output << DocPtr;
     }
 
+    virtual void flush(yaml::Output *Output) {
+      if (!YDoc.empty()) writeOutput(Output);
+      YDoc.clear();
+    }
+
     yaml::PMLDoc& getPMLDoc() { return YDoc; }
 
     virtual bool doExportInstruction(const Instruction* Instr) {
@@ -170,6 +188,11 @@ namespace llvm {
       yaml::PMLDoc *DocPtr = &YDoc; *Output << DocPtr;
     }
 
+    virtual void flush(yaml::Output *Output) {
+      if (!YDoc.empty()) writeOutput(Output);
+      YDoc.clear();
+    }
+
     yaml::PMLDoc& getPMLDoc() { return YDoc; }
 
     virtual bool doExportInstruction(const MachineInstr *Instr) {
@@ -225,6 +248,11 @@ namespace llvm {
       yaml::PMLDoc *DocPtr = &YDoc; *Output << DocPtr;
     }
 
+    virtual void flush(yaml::Output *Output) {
+      if (!YDoc.empty()) writeOutput(Output);
+      YDoc.clear();
+    }
+
     yaml::PMLDoc& getPMLDoc() { return YDoc; }
 
   private:
@@ -276,6 +304,13 @@ namespace llvm {
     StringList  Roots;
     bool        SerializeAll;
 
+    /// Directory containing the exports of previously serialized functions,
+    /// keyed by the hash of their contents. Empty if caching is disabled.
+    std::string CacheDir;
+
+    /// The output file while streaming the export, NULL otherwise.
+    tool_output_file *StreamFile;
+
     MFSet   FoundFunctions;
     MFQueue Queue;
 
@@ -335,6 +370,18 @@ namespace llvm {
 
     void addToQueue(MachineFunction *MF);
 
+    tool_output_file *openOutputFile();
+
+    /// getFunctionKey - get the hash of everything the export of MF
+    /// depends on, used as key into the cache directory.
+    std::string getFunctionKey(MachineFunction &MF);
+
+    /// streamFunction - serialize MF and write it to the output file
+    /// immediately, or reuse its export from the cache if it is unchanged.
+    void streamFunction(MachineFunction &MF);
+
+    void writeCacheFile(StringRef CacheFile, StringRef Fragment);
+
   };
 
 } // end namespace llvm
@@ -28,6 +28,7 @@ namespace llvm {
   class MachineInstr;
   class MachineBasicBlock;
   class MachineFunction;
+  class MemoryBuffer;
   class Module;
 
   class PMLQuery;
@@ -52,6 +53,9 @@ namespace llvm {
     /// Create an empty, unmapped function info.
     PMLFunctionInfo(bool bitcode) : IsBitcode(bitcode) {}
 
+    /// Build the block maps of the function, if not done yet.
+    virtual void loadBlockInfos() const = 0;
+
   private:
     PMLFunctionInfo(const PMLFunctionInfo &); // Not implemented
     PMLFunctionInfo& operator=(const PMLFunctionInfo &); // Not implemented
@@ -106,14 +110,22 @@ namespace llvm {
     /// Map of block ID -> (instr ID -> MemInstrLabel)
     MemInstrLabelMap MemInstrLabels;
 
-    PMLFunctionInfoT() : PMLFunctionInfo(bitcode), Function(0) {}
+    /// The block maps are only built when the function is first queried.
+    mutable bool BlockInfosLoaded;
+
+    PMLFunctionInfoT()
+    : PMLFunctionInfo(bitcode), Function(0), BlockInfosLoaded(true) {}
+
+  protected:
+    virtual void loadBlockInfos() const {
+      if (!BlockInfosLoaded)
+        const_cast<PMLFunctionInfoT*>(this)->reloadBlockInfos();
+    }
 
   public:
     PMLFunctionInfoT(yaml::Function<BlockT> &F)
-    : PMLFunctionInfo(bitcode), Function(&F)
-    {
-      reloadBlockInfos();
-    }
+    : PMLFunctionInfo(bitcode), Function(&F), BlockInfosLoaded(false)
+    {}
 
     void reloadBlockInfos();
 
@@ -146,6 +158,24 @@ namespace llvm {
 
   typedef StringMap<PMLFunctionInfo*> PMLFunctionInfoMap;
 
+  //===--------------------------------------------------------------------===//
+  /// PMLFunctionFacts - Imported analysis results referring to one function
+  ///
+  /// Timings are referenced by their scope, profile entries, value facts and
+  /// flow facts by their program point or scope.
+  ///
+  struct PMLFunctionFacts {
+    typedef std::pair<const yaml::Timing*, const yaml::ProfileEntry*>
+                                                                 ProfileRef;
+
+    std::vector<const yaml::Timing*>    Timings;
+    std::vector<ProfileRef>             Profiles;
+    std::vector<const yaml::ValueFact*> ValueFacts;
+    std::vector<const yaml::FlowFact*>  FlowFacts;
+  };
+
+  typedef StringMap<PMLFunctionFacts> PMLFunctionFactsMap;
+
 
   //===--------------------------------------------------------------------===//
   /// PMLLevelInfo - Provides PML information about machine code or bitcode
@@ -158,16 +188,27 @@ namespace llvm {
     yaml::ReprLevel Level;
     bool IsBitcode;
 
+    const yaml::PMLDoc &YDoc;
+
     /// Map of function label (mapsto) -> ID (name)
     PMLLabelMap  FunctionLabels;
 
     // Map of function ID (name) to function infos.
     PMLFunctionInfoMap FunctionInfos;
 
+    // Map of function ID (name) to the facts at this level referring to it,
+    // built on the first query.
+    mutable PMLFunctionFactsMap FunctionFacts;
+    mutable bool FactsIndexed;
+
     PMLLevelInfo(const PMLLevelInfo&); // Not implemented
     const PMLLevelInfo &operator=(const PMLLevelInfo&); // Not implemented
+
+    /// Sort all timings and facts at this level by the function they refer to.
+    void indexFacts() const;
   public:
-    PMLLevelInfo(yaml::ReprLevel lvl) : Level(lvl)
+    PMLLevelInfo(yaml::ReprLevel lvl, const yaml::PMLDoc &doc)
+    : Level(lvl), YDoc(doc), FactsIndexed(false)
     {
       IsBitcode = (lvl == yaml::level_bitcode);
     }
@@ -204,6 +245,9 @@ namespace llvm {
     PMLFunctionInfo &getFunctionInfo(const MachineFunction &F) const {
       return getFunctionInfo(getFunctionName(F));
     }
+
+    /// Get all timings and facts at this level referring to a function.
+    const PMLFunctionFacts &getFunctionFacts(const yaml::Name &Name) const;
   };
 
   class PMLImport : public ImmutablePass {
@@ -212,6 +256,10 @@ namespace llvm {
 
     yaml::PMLDoc YDoc;
 
+    /// The imported files. Strings of the imported documents may point into
+    /// the buffers, which are therefore kept until the pass is destroyed.
+    std::vector<MemoryBuffer*> Buffers;
+
     bool Initialized;
 
   public:
@@ -224,9 +272,7 @@ namespace llvm {
       initializePMLImportPass(Registry);
     }
 
-    ~PMLImport() {
-      deletePMLIndex();
-    }
+    ~PMLImport();
 
     void getAnalysisUsage(AnalysisUsage &AU) const {
       AU.setPreservesAll();
@@ -325,6 +371,10 @@ namespace llvm {
     /// mapping exists.
     bool getBlockCriticalityMap(BlockDoubleMap &Criticalities);
 
+    /// Get a map of all WCET frequencies for all MBBs for which a block
+    /// mapping exists.
+    bool getBlockFrequencyMap(BlockUIntMap &Frequencies);
+
     // Get a memory instruction label for a given program point.
     // Returns an empty label if the value fact is not a mem instruction.
     yaml::Name getMemInstrLabel(const yaml::ProgramPoint *PP) const {
@@ -332,6 +382,10 @@ namespace llvm {
     }
 
   protected:
+    const PMLFunctionFacts &getFunctionFacts() const {
+      return SrcLevel.getFunctionFacts(FI.getName());
+    }
+
     bool matches(const yaml::Name &Origin, yaml::ReprLevel Level) const;
 
     bool matches(const yaml::ProgramPoint *PP) const;
@@ -362,6 +416,10 @@ namespace llvm {
 
   public:
 
+    /// Get the WCET frequency of a single block, based on the pre-calculated
+    /// frequency map. Default is returned if the block is not in the map.
+    int64_t getWCETFrequency(BlockUIntMap &Frequencies,
+                             const BasicBlock &BB, int64_t Default = -1);
   };
 
   class PMLMCQuery : public PMLQuery {
@@ -385,6 +443,13 @@ namespace llvm {
     double getCriticality(BlockDoubleMap &Criticalities,
                           MachineBasicBlock &MBB, double Default = 1.0);
 
+    /// Get the WCET frequency of a single block, based on the pre-calculated
+    /// frequency map. In contrast to criticalities, frequencies are not
+    /// derived from dominators, Default is returned if the block is not in
+    /// the map.
+    int64_t getWCETFrequency(BlockUIntMap &Frequencies,
+                             MachineBasicBlock &MBB, int64_t Default = -1);
+
     /// return value facts referring to memory access information
     /// in a map BBName -> ValueFact
     bool getMemFacts(const MachineFunction &MF, ValueFactsMap &MemFacts) const;
@@ -1024,6 +1024,16 @@ struct PMLDoc {
     FlowFacts.push_back(FF);
   }
 
+  /// Delete all childs of the document.
+  void clear() {
+    DELETE_PTR_VEC(BitcodeFunctions);
+    DELETE_PTR_VEC(MachineFunctions);
+    DELETE_PTR_VEC(RelationGraphs);
+    DELETE_PTR_VEC(ValueFacts);
+    DELETE_PTR_VEC(FlowFacts);
+    DELETE_PTR_VEC(Timings);
+  }
+
   bool empty() {
     return BitcodeFunctions.empty() && MachineFunctions.empty() &&
            RelationGraphs.empty() && ValueFacts.empty() &&
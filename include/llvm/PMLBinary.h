@@ -0,0 +1,257 @@
+//===- llvm/PMLBinary.h - Binary encoding of PML documents ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Binary encoding of PML (and other YAML-mapped) documents.
+//
+// The encoding is driven by the same YAML traits as the text format, so every
+// structure that can be written as YAML can be written in binary form as well,
+// and both formats can be converted into each other without any loss.
+//
+// A binary PML file has the following layout:
+//
+//   magic       "PMLB"
+//   version     uint32, little endian
+//   #strings    uint32, little endian
+//   strings     #strings times (ULEB128 length, bytes)
+//   #documents  uint32, little endian
+//   documents   the encoded documents
+//
+// All names, keys and scalar values are interned in the string table and
+// referenced by their (ULEB128 encoded) index, starting at 1. A mapping is
+// encoded as the list of the keys that are present, each followed by its
+// value, in the order of the mapping traits, and terminated by index 0.
+// Sequences start with their uint32 element count. Enumeration values are
+// encoded by the name of their case, bit sets by the list of names of the set
+// bits terminated by index 0.
+//
+// Strings are not copied when reading a binary file: StringRef values point
+// directly into the (memory-mapped) input buffer, which has to outlive the
+// imported documents.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_PML_BINARY_H_
+#define LLVM_PML_BINARY_H_
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+namespace yaml {
+
+/// Version of the binary encoding. Must be incremented whenever the encoding
+/// itself changes. Changes to the mapping traits of the documents are
+/// detected when reading (unknown or missing required keys are errors).
+const uint32_t BinaryPMLVersion = 1;
+
+/// Check if a file name selects the binary encoding when exporting.
+bool isBinaryPMLFileName(StringRef FileName);
+
+/// Check if a buffer contains a binary encoded file (instead of YAML).
+bool isBinaryPML(StringRef Buffer);
+
+
+/// BinaryOutput - Writes documents in the binary encoding. The encoded
+/// documents are buffered and written to the stream when the BinaryOutput is
+/// destroyed.
+class BinaryOutput : public IO {
+public:
+  BinaryOutput(raw_ostream &os, void *Ctxt = NULL);
+  virtual ~BinaryOutput();
+
+  virtual bool outputting() const { return true; }
+
+  virtual unsigned beginSequence();
+  virtual bool preflightElement(unsigned, void *&);
+  virtual void postflightElement(void*) {}
+  virtual void endSequence();
+  virtual bool canElideEmptySequence() { return true; }
+
+  virtual unsigned beginFlowSequence() { return beginSequence(); }
+  virtual bool preflightFlowElement(unsigned i, void *&SaveInfo) {
+    return preflightElement(i, SaveInfo);
+  }
+  virtual void postflightFlowElement(void*) {}
+  virtual void endFlowSequence() { endSequence(); }
+
+  virtual bool mapTag(StringRef Tag, bool Default = false) { return Default; }
+  virtual void beginMapping() {}
+  virtual void endMapping();
+  virtual bool preflightKey(const char *Key, bool Required, bool SameAsDefault,
+                            bool &UseDefault, void *&SaveInfo);
+  virtual void postflightKey(void*) {}
+
+  virtual void beginEnumScalar();
+  virtual bool matchEnumScalar(const char *Str, bool Match);
+  virtual void endEnumScalar();
+
+  virtual bool beginBitSetScalar(bool &DoClear);
+  virtual bool bitSetMatch(const char *Str, bool Match);
+  virtual void endBitSetScalar();
+
+  virtual void scalarString(StringRef &S);
+
+  virtual void setError(const Twine &) {}
+
+  /// Start a new document, called for each document written.
+  void beginDocument() { NumDocuments++; }
+
+private:
+  raw_ostream &Out;
+
+  /// Encoded documents, written after the string table.
+  std::string Body;
+
+  /// Interned strings, indices start at 1.
+  StringMap<unsigned> StringIDs;
+  std::vector<StringRef> Strings;
+
+  /// Positions of the element counts of all open sequences, and the number
+  /// of elements written so far.
+  std::vector<std::pair<size_t, unsigned> > Sequences;
+
+  unsigned NumDocuments;
+
+  bool EnumerationMatchFound;
+
+  void writeString(StringRef S);
+  void writeULEB128(uint64_t Value);
+  void writeUInt32(std::string &Buffer, uint32_t Value);
+};
+
+
+/// BinaryInput - Reads documents in the binary encoding.
+class BinaryInput : public IO {
+public:
+  /// Create a reader for a binary encoded buffer. The buffer must outlive
+  /// all documents read from it.
+  BinaryInput(StringRef Buffer, void *Ctxt = NULL);
+  virtual ~BinaryInput() {}
+
+  /// Check if there was an error reading the buffer.
+  llvm::error_code error();
+
+  virtual bool outputting() const { return false; }
+
+  virtual unsigned beginSequence();
+  virtual bool preflightElement(unsigned, void *&);
+  virtual void postflightElement(void*) {}
+  virtual void endSequence() {}
+  virtual bool canElideEmptySequence() { return false; }
+
+  virtual unsigned beginFlowSequence() { return beginSequence(); }
+  virtual bool preflightFlowElement(unsigned i, void *&SaveInfo) {
+    return preflightElement(i, SaveInfo);
+  }
+  virtual void postflightFlowElement(void*) {}
+  virtual void endFlowSequence() {}
+
+  virtual bool mapTag(StringRef Tag, bool Default = false) { return Default; }
+  virtual void beginMapping() {}
+  virtual void endMapping();
+  virtual bool preflightKey(const char *Key, bool Required, bool SameAsDefault,
+                            bool &UseDefault, void *&SaveInfo);
+  virtual void postflightKey(void*) {}
+
+  virtual void beginEnumScalar();
+  virtual bool matchEnumScalar(const char *Str, bool);
+  virtual void endEnumScalar();
+
+  virtual bool beginBitSetScalar(bool &DoClear);
+  virtual bool bitSetMatch(const char *Str, bool);
+  virtual void endBitSetScalar() {}
+
+  virtual void scalarString(StringRef &S);
+
+  virtual void setError(const Twine &Message);
+
+  /// Get the number of documents in the buffer.
+  unsigned getNumDocuments() const { return NumDocuments; }
+
+private:
+  StringRef Buffer;
+  size_t Pos;
+
+  /// The string table, index 0 is unused.
+  std::vector<StringRef> Strings;
+
+  unsigned NumDocuments;
+
+  /// The current enumeration scalar or bit set.
+  StringRef EnumScalar;
+  bool EnumerationMatchFound;
+  std::vector<StringRef> BitSetValues;
+
+  bool Error;
+
+  uint64_t readULEB128();
+  uint32_t readUInt32();
+  StringRef readString();
+  unsigned peekStringID();
+};
+
+
+/// Write a single document.
+template <typename T>
+inline
+typename llvm::enable_if_c<has_MappingTraits<T>::value, BinaryOutput &>::type
+operator<<(BinaryOutput &Out, T &Doc) {
+  Out.beginDocument();
+  yamlize(Out, Doc, true);
+  return Out;
+}
+
+/// Write a list of documents.
+template <typename T>
+inline
+typename llvm::enable_if_c<has_DocumentListTraits<T>::value,
+                           BinaryOutput &>::type
+operator<<(BinaryOutput &Out, T &DocList) {
+  const size_t Count = DocumentListTraits<T>::size(Out, DocList);
+  for (size_t i = 0; i < Count; ++i) {
+    Out.beginDocument();
+    yamlize(Out, DocumentListTraits<T>::element(Out, DocList, i), true);
+  }
+  return Out;
+}
+
+/// Read all documents into a list of documents.
+template <typename T>
+inline
+typename llvm::enable_if_c<has_DocumentListTraits<T>::value,
+                           BinaryInput &>::type
+operator>>(BinaryInput &In, T &DocList) {
+  for (unsigned i = 0, e = In.getNumDocuments(); i != e && !In.error(); ++i) {
+    yamlize(In, DocumentListTraits<T>::element(In, DocList, i), true);
+  }
+  return In;
+}
+
+/// Read a single document.
+template <typename T>
+inline
+typename llvm::enable_if_c<has_MappingTraits<T>::value, BinaryInput &>::type
+operator>>(BinaryInput &In, T &Doc) {
+  if (In.getNumDocuments() != 1) {
+    In.setError("expected a single document");
+    return In;
+  }
+  yamlize(In, Doc, true);
+  return In;
+}
+
+} // end namespace yaml
+} // end namespace llvm
+
+#endif
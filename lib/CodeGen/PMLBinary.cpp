@@ -0,0 +1,325 @@
+//===-- PMLBinary.cpp - Binary encoding of PML documents ------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Reading and writing PML documents in the binary encoding, see PMLBinary.h.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/PMLBinary.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Path.h"
+
+using namespace llvm;
+using namespace yaml;
+
+static const char BinaryPMLMagic[] = { 'P', 'M', 'L', 'B' };
+
+bool yaml::isBinaryPMLFileName(StringRef FileName) {
+  return sys::path::extension(FileName) == ".bpml";
+}
+
+bool yaml::isBinaryPML(StringRef Buffer) {
+  return Buffer.startswith(StringRef(BinaryPMLMagic, sizeof(BinaryPMLMagic)));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+BinaryOutput::BinaryOutput(raw_ostream &os, void *Ctxt)
+  : IO(Ctxt), Out(os), NumDocuments(0), EnumerationMatchFound(false)
+{
+  // Index 0 terminates mappings and bit sets
+  Strings.push_back(StringRef());
+}
+
+BinaryOutput::~BinaryOutput() {
+  assert(Sequences.empty() && "Unterminated sequence");
+
+  std::string Header;
+  Header.append(BinaryPMLMagic, sizeof(BinaryPMLMagic));
+  writeUInt32(Header, BinaryPMLVersion);
+  writeUInt32(Header, Strings.size() - 1);
+  Out << Header;
+
+  for (unsigned i = 1, e = Strings.size(); i < e; i++) {
+    uint64_t Length = Strings[i].size();
+    do {
+      uint8_t Byte = Length & 0x7f;
+      Length >>= 7;
+      if (Length) Byte |= 0x80;
+      Out << (char)Byte;
+    } while (Length);
+    Out << Strings[i];
+  }
+
+  std::string Count;
+  writeUInt32(Count, NumDocuments);
+  Out << Count << Body;
+}
+
+void BinaryOutput::writeULEB128(uint64_t Value) {
+  do {
+    uint8_t Byte = Value & 0x7f;
+    Value >>= 7;
+    if (Value) Byte |= 0x80;
+    Body.push_back((char)Byte);
+  } while (Value);
+}
+
+void BinaryOutput::writeUInt32(std::string &Buffer, uint32_t Value) {
+  for (unsigned i = 0; i < 4; i++) {
+    Buffer.push_back((char)((Value >> (8 * i)) & 0xff));
+  }
+}
+
+void BinaryOutput::writeString(StringRef S) {
+  StringMapEntry<unsigned> &Entry = StringIDs.GetOrCreateValue(S, 0);
+  if (!Entry.getValue()) {
+    Entry.setValue(Strings.size());
+    Strings.push_back(Entry.getKey());
+  }
+  writeULEB128(Entry.getValue());
+}
+
+unsigned BinaryOutput::beginSequence() {
+  // The number of elements is not known yet, patched in endSequence
+  Sequences.push_back(std::make_pair(Body.size(), 0U));
+  writeUInt32(Body, 0);
+  return 0;
+}
+
+bool BinaryOutput::preflightElement(unsigned, void *&) {
+  Sequences.back().second++;
+  return true;
+}
+
+void BinaryOutput::endSequence() {
+  std::string Count;
+  writeUInt32(Count, Sequences.back().second);
+  Body.replace(Sequences.back().first, Count.size(), Count);
+  Sequences.pop_back();
+}
+
+void BinaryOutput::endMapping() {
+  writeULEB128(0);
+}
+
+bool BinaryOutput::preflightKey(const char *Key, bool Required,
+                                bool SameAsDefault, bool &UseDefault,
+                                void *&) {
+  UseDefault = false;
+  if (Required || !SameAsDefault) {
+    writeString(Key);
+    return true;
+  }
+  return false;
+}
+
+void BinaryOutput::beginEnumScalar() {
+  EnumerationMatchFound = false;
+}
+
+bool BinaryOutput::matchEnumScalar(const char *Str, bool Match) {
+  if (Match && !EnumerationMatchFound) {
+    writeString(Str);
+    EnumerationMatchFound = true;
+  }
+  return false;
+}
+
+void BinaryOutput::endEnumScalar() {
+  if (!EnumerationMatchFound)
+    llvm_unreachable("bad runtime enum value");
+}
+
+bool BinaryOutput::beginBitSetScalar(bool &DoClear) {
+  DoClear = false;
+  return true;
+}
+
+bool BinaryOutput::bitSetMatch(const char *Str, bool Match) {
+  if (Match)
+    writeString(Str);
+  return false;
+}
+
+void BinaryOutput::endBitSetScalar() {
+  writeULEB128(0);
+}
+
+void BinaryOutput::scalarString(StringRef &S) {
+  writeString(S);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+BinaryInput::BinaryInput(StringRef buffer, void *Ctxt)
+  : IO(Ctxt), Buffer(buffer), Pos(0), NumDocuments(0),
+    EnumerationMatchFound(false), Error(false)
+{
+  if (!isBinaryPML(Buffer)) {
+    setError("not a binary PML file");
+    return;
+  }
+  Pos = sizeof(BinaryPMLMagic);
+
+  if (readUInt32() != BinaryPMLVersion) {
+    setError("unsupported binary PML version");
+    return;
+  }
+
+  uint32_t NumStrings = readUInt32();
+  Strings.reserve(NumStrings + 1);
+  Strings.push_back(StringRef());
+  for (uint32_t i = 0; i < NumStrings && !Error; i++) {
+    uint64_t Length = readULEB128();
+    if (Length > Buffer.size() - Pos) {
+      setError("truncated string table");
+      return;
+    }
+    Strings.push_back(Buffer.substr(Pos, Length));
+    Pos += Length;
+  }
+
+  NumDocuments = readUInt32();
+}
+
+error_code BinaryInput::error() {
+  return Error ? make_error_code(errc::invalid_argument) : error_code();
+}
+
+void BinaryInput::setError(const Twine &Message) {
+  if (!Error) {
+    errs() << "error: binary PML: " << Message << "\n";
+  }
+  Error = true;
+  // Do not read any further
+  Pos = Buffer.size();
+  NumDocuments = 0;
+}
+
+uint64_t BinaryInput::readULEB128() {
+  uint64_t Value = 0;
+  unsigned Shift = 0;
+  while (Pos < Buffer.size()) {
+    uint8_t Byte = Buffer[Pos++];
+    Value |= uint64_t(Byte & 0x7f) << Shift;
+    if (!(Byte & 0x80)) return Value;
+    Shift += 7;
+  }
+  setError("unexpected end of file");
+  return 0;
+}
+
+uint32_t BinaryInput::readUInt32() {
+  if (Buffer.size() - Pos < 4) {
+    setError("unexpected end of file");
+    return 0;
+  }
+  uint32_t Value = 0;
+  for (unsigned i = 0; i < 4; i++) {
+    Value |= uint32_t((uint8_t)Buffer[Pos++]) << (8 * i);
+  }
+  return Value;
+}
+
+StringRef BinaryInput::readString() {
+  uint64_t ID = readULEB128();
+  if (ID == 0 || ID >= Strings.size()) {
+    setError("invalid string index");
+    return StringRef();
+  }
+  return Strings[ID];
+}
+
+unsigned BinaryInput::peekStringID() {
+  size_t Saved = Pos;
+  uint64_t ID = readULEB128();
+  Pos = Saved;
+  return ID;
+}
+
+unsigned BinaryInput::beginSequence() {
+  return Error ? 0 : readUInt32();
+}
+
+bool BinaryInput::preflightElement(unsigned, void *&) {
+  return !Error;
+}
+
+void BinaryInput::endMapping() {
+  if (Error) return;
+
+  uint64_t ID = readULEB128();
+  if (ID != 0) {
+    if (ID < Strings.size())
+      setError("unknown key '" + Strings[ID] + "'");
+    else
+      setError("invalid string index");
+  }
+}
+
+bool BinaryInput::preflightKey(const char *Key, bool Required, bool,
+                               bool &UseDefault, void *&) {
+  UseDefault = false;
+  if (Error) return false;
+
+  // Keys are stored in the order of the mapping, absent keys are skipped
+  unsigned ID = peekStringID();
+  if (ID != 0 && ID < Strings.size() && Strings[ID] == Key) {
+    readULEB128();
+    return true;
+  }
+  if (Required) {
+    setError(Twine("missing required key '") + Key + "'");
+    return false;
+  }
+  UseDefault = true;
+  return false;
+}
+
+void BinaryInput::beginEnumScalar() {
+  EnumScalar = readString();
+  EnumerationMatchFound = false;
+}
+
+bool BinaryInput::matchEnumScalar(const char *Str, bool) {
+  if (EnumerationMatchFound || EnumScalar != Str) return false;
+  EnumerationMatchFound = true;
+  return true;
+}
+
+void BinaryInput::endEnumScalar() {
+  if (!EnumerationMatchFound && !Error)
+    setError("unknown enumerated scalar '" + EnumScalar + "'");
+}
+
+bool BinaryInput::beginBitSetScalar(bool &DoClear) {
+  DoClear = true;
+  BitSetValues.clear();
+  while (!Error && peekStringID() != 0) {
+    BitSetValues.push_back(readString());
+  }
+  readULEB128();
+  return !Error;
+}
+
+bool BinaryInput::bitSetMatch(const char *Str, bool) {
+  for (std::vector<StringRef>::iterator i = BitSetValues.begin(),
+       ie = BitSetValues.end(); i != ie; i++)
+  {
+    if (*i == Str) return true;
+  }
+  return false;
+}
+
+void BinaryInput::scalarString(StringRef &S) {
+  S = readString();
+}
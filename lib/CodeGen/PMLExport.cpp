@@ -18,6 +18,7 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
@@ -31,8 +32,14 @@
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/PMLExport.h"
 #include "llvm/CodeGen/PseudoSourceValue.h"
+#include "llvm/PMLBinary.h"
 #include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Support/ToolOutputFile.h"
@@ -50,8 +57,27 @@ STATISTIC( NumAnnotatedBounds,
            "Number of user-annotated header bounds exported");
 
 STATISTIC( NumMemExp,   "Number of exported load from array infos");
+
+STATISTIC( NumCachedFunctions,
+           "Number of functions whose export was reused from the PML cache");
+STATISTIC( NumStreamedFunctions,
+           "Number of functions serialized by the streaming PML export");
 }
 
+static cl::opt<bool> SerializeStream("mserialize-stream",
+   cl::desc("Write the PML export of each function as soon as it is "
+            "serialized"),
+   cl::init(false));
+
+static cl::opt<std::string> SerializeCache("mserialize-cache",
+   cl::desc("Reuse the PML export of unchanged functions from directory DIR "
+            "(implies -mserialize-stream, not supported for binary PML)"),
+   cl::value_desc("DIR"), cl::init(""));
+
+/// Version of the format of the cached function exports, must be changed
+/// whenever the exported information changes.
+static const char *PMLCacheVersion = "pml-0.1-cache-1";
+
 /// Unfortunately, the interface for accessing successors differs
 /// between machine block and bitcode block, therefore we need this
 /// trait in order to avoid code duplication
@@ -1168,13 +1194,15 @@ PMLModuleExportPass::PMLModuleExportPass(char &id, TargetMachine &TM,
                                          StringRef filename,
                                          ArrayRef<std::string> roots,
                                          bool SerializeAll)
-  : MachineModulePass(id), PII(0), OutFileName(filename), Roots(roots), SerializeAll(SerializeAll)
+  : MachineModulePass(id), PII(0), OutFileName(filename), Roots(roots), SerializeAll(SerializeAll),
+    CacheDir(SerializeCache), StreamFile(0)
 {
 }
 
 PMLModuleExportPass::PMLModuleExportPass(TargetMachine &TM, StringRef filename,
                               ArrayRef<std::string> roots, PMLInstrInfo *pii, bool SerializeAll)
-  : MachineModulePass(ID), PII(pii), OutFileName(filename), Roots(roots), SerializeAll(SerializeAll)
+  : MachineModulePass(ID), PII(pii), OutFileName(filename), Roots(roots), SerializeAll(SerializeAll),
+    CacheDir(SerializeCache), StreamFile(0)
 {
 }
 
@@ -1196,6 +1224,20 @@ bool PMLModuleExportPass::runOnMachineModule(const Module &M)
 
   FoundFunctions.clear();
   Queue.clear();
+
+  // Write functions to the output file as soon as they are serialized.
+  // Functions cannot be streamed into the string table of binary files.
+  if ((SerializeStream || !CacheDir.empty()) &&
+      !yaml::isBinaryPMLFileName(OutFileName))
+  {
+    if (!CacheDir.empty() && sys::fs::create_directories(CacheDir)) {
+      errs() << "[mc2yml] Creating cache directory failed: " << CacheDir
+             << "\n";
+      CacheDir.clear();
+    }
+    StreamFile = openOutputFile();
+  }
+
   if (SerializeAll) {
     // Queue all functions
     for (Module::const_iterator it = M.begin(); it != M.end(); ++it) {
@@ -1214,8 +1256,12 @@ bool PMLModuleExportPass::runOnMachineModule(const Module &M)
     MachineFunction *MF = Queue.front();
     Queue.pop_front();
 
-    for (size_t i=0; i < Exporters.size(); i++) {
-      Exporters[i]->serialize(*MF);
+    if (StreamFile) {
+      streamFunction(*MF);
+    } else {
+      for (size_t i=0; i < Exporters.size(); i++) {
+        Exporters[i]->serialize(*MF);
+      }
     }
 
     addCalleesToQueue(M, MMI, *MF);
@@ -1245,35 +1291,63 @@ bool PMLModuleExportPass::doInitialization(Module &M) {
   return false;
 }
 
-bool PMLModuleExportPass::doFinalization(Module &M) {
-  tool_output_file *OutFile;
-  yaml::Output *Output;
+tool_output_file *PMLModuleExportPass::openOutputFile() {
   std::string ErrorInfo;
 
-  OutFile = new tool_output_file(OutFileName.str().c_str(), ErrorInfo);
+  tool_output_file *OutFile =
+    new tool_output_file(OutFileName.str().c_str(), ErrorInfo);
   if (!ErrorInfo.empty()) {
     delete OutFile;
     errs() << "[mc2yml] Opening Export File failed: " << OutFileName << "\n";
     errs() << "[mc2yml] Reason: " << ErrorInfo;
+    return 0;
+  }
+  return OutFile;
+}
+
+bool PMLModuleExportPass::doFinalization(Module &M) {
+  tool_output_file *OutFile;
+  yaml::Output *Output;
+
+  // When streaming, only module-level information is left to be written
+  bool Streamed = (StreamFile != 0);
+
+  OutFile = Streamed ? StreamFile : openOutputFile();
+  StreamFile = 0;
+  if (!OutFile) {
     return false;
   }
+
+  if (yaml::isBinaryPMLFileName(OutFileName)) {
+    yaml::BinaryOutput BinaryOut(OutFile->os());
+
+    for (ExportList::iterator it = Exporters.begin(), ie = Exporters.end();
+         it != ie; ++it)
+    {
+      (*it)->finalize(M);
+      yaml::PMLDoc *DocPtr = &(*it)->getPMLDoc();
+      BinaryOut << DocPtr;
+    }
+  }
   else {
     Output = new yaml::Output(OutFile->os());
-  }
 
-  for (ExportList::iterator it = Exporters.begin(), ie = Exporters.end();
-       it != ie; ++it)
-  {
-    (*it)->finalize(M);
-    (*it)->writeOutput(Output);
-  }
+    for (ExportList::iterator it = Exporters.begin(), ie = Exporters.end();
+         it != ie; ++it)
+    {
+      (*it)->finalize(M);
+      if (Streamed)
+        (*it)->flush(Output);
+      else
+        (*it)->writeOutput(Output);
+    }
 
-  if (OutFile) {
-    OutFile->keep();
     delete Output;
-    delete OutFile;
   }
 
+  OutFile->keep();
+  delete OutFile;
+
   if (!BitcodeFile.empty()) {
     std::string ErrorInfo;
     tool_output_file BitcodeStream(BitcodeFile.c_str(), ErrorInfo);
@@ -1314,6 +1388,91 @@ void PMLModuleExportPass::addToQueue(MachineFunction *MF) {
   }
 }
 
+std::string PMLModuleExportPass::getFunctionKey(MachineFunction &MF) {
+  std::string Buffer;
+  raw_string_ostream OS(Buffer);
+
+  // Machine functions are exported using their function number as name
+  OS << PMLCacheVersion << " " << MF.getTarget().getTargetTriple() << " "
+     << MF.getFunctionNumber() << "\n";
+
+  if (const Function *F = MF.getFunction())
+    F->print(OS);
+  MF.print(OS);
+
+  for (ExportList::iterator it = Exporters.begin(), ie = Exporters.end();
+       it != ie; ++it)
+  {
+    (*it)->writeFunctionKey(MF, OS);
+  }
+
+  MD5 Hash;
+  Hash.update(OS.str());
+  MD5::MD5Result Result;
+  Hash.final(Result);
+
+  SmallString<32> Key;
+  MD5::stringifyResult(Result, Key);
+  return Key.str();
+}
+
+void PMLModuleExportPass::streamFunction(MachineFunction &MF) {
+  SmallString<128> CacheFile;
+
+  if (!CacheDir.empty()) {
+    CacheFile = CacheDir;
+    sys::path::append(CacheFile, getFunctionKey(MF) + ".pml");
+
+    // Reuse the export of an unchanged function as it is
+    OwningPtr<MemoryBuffer> Cached;
+    if (!MemoryBuffer::getFile(CacheFile.str(), Cached)) {
+      StreamFile->os() << Cached->getBuffer();
+      NumCachedFunctions++;
+      return;
+    }
+  }
+
+  std::string Fragment;
+  {
+    raw_string_ostream OS(Fragment);
+    yaml::Output Output(OS);
+
+    for (ExportList::iterator it = Exporters.begin(), ie = Exporters.end();
+         it != ie; ++it)
+    {
+      (*it)->serialize(MF);
+      (*it)->flush(&Output);
+    }
+  }
+  NumStreamedFunctions++;
+
+  StreamFile->os() << Fragment;
+
+  if (!CacheFile.empty()) {
+    writeCacheFile(CacheFile.str(), Fragment);
+  }
+}
+
+void PMLModuleExportPass::writeCacheFile(StringRef CacheFile,
+                                         StringRef Fragment)
+{
+  // Write to a temporary file first, so that concurrent compilations
+  // sharing the cache never read a partially written file.
+  SmallString<128> TempFile;
+  int FD;
+  if (sys::fs::createUniqueFile(CacheFile + "-%%%%%%", FD, TempFile)) {
+    errs() << "[mc2yml] Writing cache file " << CacheFile << " failed\n";
+    return;
+  }
+  {
+    raw_fd_ostream OS(FD, true);
+    OS << Fragment;
+  }
+  if (sys::fs::rename(TempFile.str(), CacheFile)) {
+    sys::fs::remove(TempFile.str());
+  }
+}
+
 char PMLModuleExportPass::ID = 0;
 
 
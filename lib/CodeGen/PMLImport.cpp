@@ -21,6 +21,7 @@
 #include "llvm/CodeGen/MachinePostDominators.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/PMLBinary.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
@@ -41,6 +42,15 @@ char PMLImport::ID = 0;
 
 void PMLImport::anchor() {}
 
+PMLImport::~PMLImport() {
+  deletePMLIndex();
+  YDoc.clear();
+  while (!Buffers.empty()) {
+    delete Buffers.back();
+    Buffers.pop_back();
+  }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 static void printErrorMessages(const llvm::SMDiagnostic &Diag, void *) {
@@ -71,17 +81,29 @@ void PMLImport::initializePass()
       report_fatal_error("PMLImport: error reading PML file.");
     }
 
-    yaml::Input Input(Buf->getBuffer(), NULL, printErrorMessages);
-
     yaml::PMLDocList Docs;
 
-    Input >> Docs.YDocs;
+    // Binary files are detected by their header, independent of the name
+    if (yaml::isBinaryPML(Buf->getBuffer())) {
+      yaml::BinaryInput Input(Buf->getBuffer());
+
+      Input >> Docs.YDocs;
 
-    if (Input.error()) {
-      report_fatal_error("PMLImport: error parsing yaml.");
+      if (Input.error()) {
+        report_fatal_error("PMLImport: error reading binary PML.");
+      }
+    } else {
+      yaml::Input Input(Buf->getBuffer(), NULL, printErrorMessages);
+
+      Input >> Docs.YDocs;
+
+      if (Input.error()) {
+        report_fatal_error("PMLImport: error parsing yaml.");
+      }
     }
 
     Docs.mergeInto(YDoc);
+    Buffers.push_back(Buf.take());
   }
 
   rebuildPMLIndex();
@@ -100,8 +122,8 @@ void PMLImport::rebuildPMLIndex() {
   deletePMLIndex();
 
   // We could check if we actually have any documents with that level, but meh..
-  BitcodeLevel = new PMLLevelInfo(yaml::level_bitcode);
-  MachineLevel = new PMLLevelInfo(yaml::level_machinecode);
+  BitcodeLevel = new PMLLevelInfo(yaml::level_bitcode, YDoc);
+  MachineLevel = new PMLLevelInfo(yaml::level_machinecode, YDoc);
 
   for (std::vector<yaml::BitcodeFunction*>::iterator
        i = YDoc.BitcodeFunctions.begin(), ie = YDoc.BitcodeFunctions.end();
@@ -164,6 +186,8 @@ yaml::Name PMLFunctionInfo::getBlockName(StringRef Label) const
   // We never use the block number as name in this case, as this is not safe.
   if (!hasMapping()) return Label;
 
+  loadBlockInfos();
+
   PMLLabelMap::const_iterator it = BlockLabels.find(Label);
   if (it != BlockLabels.end()) {
     return yaml::Name(it->second);
@@ -201,6 +225,8 @@ StringRef PMLFunctionInfo::getBlockLabel(const MachineBasicBlock &MBB)
 template<typename BlockT, bool isBitcode>
 StringRef PMLFunctionInfoT<BlockT,isBitcode>::getBlockLabel(const yaml::Name& Name) const
 {
+  loadBlockInfos();
+
   typename BlockMap::const_iterator it = Blocks.find(Name.getName());
   if (it != Blocks.end()) {
     BlockT *BB = it->second;
@@ -222,6 +248,7 @@ void PMLFunctionInfoT<BlockT,bitcode>::reloadBlockInfos()
   BlockLabels.clear();
   Blocks.clear();
   MemInstrLabels.clear();
+  BlockInfosLoaded = true;
 
   if (!Function) return;
 
@@ -258,12 +285,14 @@ void PMLFunctionInfoT<BlockT,bitcode>::reloadBlockInfos()
 template<typename BlockT, bool bitcode>
 bool PMLFunctionInfoT<BlockT,bitcode>::hasBlock(const yaml::Name &N) const
 {
+  loadBlockInfos();
   return Blocks.find(N.getName()) != Blocks.end();
 }
 
 template<typename BlockT, bool bitcode>
 BlockT* PMLFunctionInfoT<BlockT,bitcode>::getBlock(const yaml::Name &N) const
 {
+  loadBlockInfos();
   return Blocks.lookup(N.getName());
 }
 
@@ -272,6 +301,8 @@ template<typename BlockT, bool bitcode>
 yaml::Name PMLFunctionInfoT<BlockT,bitcode>::getMemInstrLabel(
                                             const yaml::ProgramPoint *PP)
 {
+  loadBlockInfos();
+
   // lookup MemInstrLabels with PP->Block and PP->Instruction
   if (MemInstrLabels.count(PP->Block.getName())) {
     if (MemInstrLabels[PP->Block.getName()].count(PP->Instruction.getName())) {
@@ -362,6 +393,63 @@ PMLFunctionInfo &PMLLevelInfo::getFunctionInfo(const yaml::Name &Name) const
 }
 
 
+void PMLLevelInfo::indexFacts() const
+{
+  FactsIndexed = true;
+
+  for (std::vector<yaml::Timing*>::const_iterator i = YDoc.Timings.begin(),
+       ie = YDoc.Timings.end(); i != ie; i++)
+  {
+    const yaml::Timing *T = *i;
+    if (T->Level != Level) continue;
+
+    if (T->ScopeRef) {
+      FunctionFacts[T->ScopeRef->Function.getName()].Timings.push_back(T);
+    }
+
+    for (std::vector<yaml::ProfileEntry*>::const_iterator
+         pi = T->Profile.begin(), pie = T->Profile.end(); pi != pie; pi++)
+    {
+      const yaml::ProfileEntry *P = *pi;
+      if (!P->Reference) continue;
+
+      FunctionFacts[P->Reference->Function.getName()].Profiles.push_back(
+                                         PMLFunctionFacts::ProfileRef(T, P));
+    }
+  }
+
+  for (std::vector<yaml::ValueFact*>::const_iterator
+       i = YDoc.ValueFacts.begin(), ie = YDoc.ValueFacts.end(); i != ie; i++)
+  {
+    const yaml::ValueFact *VF = *i;
+    if (VF->Level != Level || !VF->PP) continue;
+
+    FunctionFacts[VF->PP->Function.getName()].ValueFacts.push_back(VF);
+  }
+
+  for (std::vector<yaml::FlowFact*>::const_iterator
+       i = YDoc.FlowFacts.begin(), ie = YDoc.FlowFacts.end(); i != ie; i++)
+  {
+    const yaml::FlowFact *FF = *i;
+    if (FF->Level != Level || !FF->ScopeRef) continue;
+
+    FunctionFacts[FF->ScopeRef->Function.getName()].FlowFacts.push_back(FF);
+  }
+}
+
+const PMLFunctionFacts &
+PMLLevelInfo::getFunctionFacts(const yaml::Name &Name) const
+{
+  if (!FactsIndexed) indexFacts();
+
+  PMLFunctionFactsMap::const_iterator it = FunctionFacts.find(Name.getName());
+  if (it != FunctionFacts.end()) {
+    return it->second;
+  }
+  static const PMLFunctionFacts EmptyFacts;
+  return EmptyFacts;
+}
+
 
 void PMLQuery::resetAnalyses()
 {
@@ -371,13 +459,22 @@ void PMLQuery::resetAnalyses()
 
 bool PMLQuery::hasValueFacts(bool CheckForFunction) const
 {
+  if (CheckForFunction) {
+    const PMLFunctionFacts &Facts = getFunctionFacts();
+    for (std::vector<const yaml::ValueFact*>::const_iterator
+         i = Facts.ValueFacts.begin(), ie = Facts.ValueFacts.end(); i != ie; i++)
+    {
+      if (matches((*i)->Origin, (*i)->Level)) return true;
+    }
+    return false;
+  }
+
   for (std::vector<yaml::ValueFact*>::iterator i = YDoc.ValueFacts.begin(),
        ie = YDoc.ValueFacts.end(); i != ie; i++)
   {
     yaml::ValueFact *VF = *i;
 
     if (!matches(VF->Origin, VF->Level)) continue;
-    if (CheckForFunction && !matches(VF->PP)) continue;
 
     return true;
   }
@@ -386,13 +483,22 @@ bool PMLQuery::hasValueFacts(bool CheckForFunction) const
 
 bool PMLQuery::hasFlowFacts(bool CheckForFunction) const
 {
+  if (CheckForFunction) {
+    const PMLFunctionFacts &Facts = getFunctionFacts();
+    for (std::vector<const yaml::FlowFact*>::const_iterator
+         i = Facts.FlowFacts.begin(), ie = Facts.FlowFacts.end(); i != ie; i++)
+    {
+      if (matches((*i)->Origin, (*i)->Level)) return true;
+    }
+    return false;
+  }
+
   for (std::vector<yaml::FlowFact*>::const_iterator i = YDoc.FlowFacts.begin(),
        ie = YDoc.FlowFacts.end(); i != ie; i++)
   {
     const yaml::FlowFact *FF = *i;
 
     if (!matches(FF->Origin, FF->Level)) continue;
-    if (CheckForFunction && !matches(FF->ScopeRef)) continue;
 
     return true;
   }
@@ -401,17 +507,24 @@ bool PMLQuery::hasFlowFacts(bool CheckForFunction) const
 
 bool PMLQuery::hasTimings(bool CheckForFunction) const
 {
+  if (CheckForFunction) {
+    // TODO also check for profiles referring to the function
+    const PMLFunctionFacts &Facts = getFunctionFacts();
+    for (std::vector<const yaml::Timing*>::const_iterator
+         i = Facts.Timings.begin(), ie = Facts.Timings.end(); i != ie; i++)
+    {
+      if (matches((*i)->Origin, (*i)->Level)) return true;
+    }
+    return false;
+  }
+
   for (std::vector<yaml::Timing*>::const_iterator i = YDoc.Timings.begin(),
        ie = YDoc.Timings.end(); i != ie; i++)
   {
     const yaml::Timing *T = *i;
 
     if (!matches(T->Origin, T->Level)) continue;
-    if (CheckForFunction) {
-      if (!matches(T->ScopeRef)) continue;
 
-      // TODO iterate over all profiles, check for references to the function
-    }
     return true;
   }
   return false;
@@ -521,32 +634,58 @@ T PMLQuery::getMaxDominatorValue(StringMap<T> &Map,
 
 bool PMLQuery::getBlockCriticalityMap(BlockDoubleMap &Criticalitites)
 {
-  // Search all timing infos for criticalities for all blocks of the function
+  // Search all timing profiles of the function for block criticalities
+  const PMLFunctionFacts &Facts = getFunctionFacts();
+
   bool found = false;
-  for (std::vector<yaml::Timing*>::const_iterator i = YDoc.Timings.begin(),
-       ie = YDoc.Timings.end(); i != ie; i++)
+  for (std::vector<PMLFunctionFacts::ProfileRef>::const_iterator
+       i = Facts.Profiles.begin(), ie = Facts.Profiles.end(); i != ie; i++)
   {
-    const yaml::Timing *T = *i;
+    const yaml::Timing *T = i->first;
     if (!matches(T->Origin, T->Level)) continue;
 
-    for (std::vector<yaml::ProfileEntry*>::const_iterator
-         pi = T->Profile.begin(), pie = T->Profile.end(); pi != pie; pi++)
-    {
-      const yaml::ProfileEntry *P = *pi;
-      if (!P->hasCriticality()) continue;
-      if (!matches(P->Reference)) continue;
+    const yaml::ProfileEntry *P = i->second;
+    if (!P->hasCriticality()) continue;
+    if (!matches(P->Reference)) continue;
 
-      // Get the name of either a block reference, or the source of an edge ref.
-      StringRef Block = P->Reference->Block.empty() ?
-                        P->Reference->EdgeSource.getName() :
-                        P->Reference->Block.getName();
-      if (Block.empty()) continue;
+    // Get the name of either a block reference, or the source of an edge ref.
+    StringRef Block = P->Reference->Block.empty() ?
+                      P->Reference->EdgeSource.getName() :
+                      P->Reference->Block.getName();
+    if (Block.empty()) continue;
 
-      double Crit = std::max(Criticalitites.lookup(Block), P->Criticality);
-      Criticalitites[Block] = Crit;
+    double Crit = std::max(Criticalitites.lookup(Block), P->Criticality);
+    Criticalitites[Block] = Crit;
 
-      found = true;
-    }
+    found = true;
+  }
+
+  return found;
+}
+
+bool PMLQuery::getBlockFrequencyMap(BlockUIntMap &Frequencies)
+{
+  // Search all timing profiles of the function for block WCET frequencies
+  const PMLFunctionFacts &Facts = getFunctionFacts();
+
+  bool found = false;
+  for (std::vector<PMLFunctionFacts::ProfileRef>::const_iterator
+       i = Facts.Profiles.begin(), ie = Facts.Profiles.end(); i != ie; i++)
+  {
+    const yaml::Timing *T = i->first;
+    if (!matches(T->Origin, T->Level)) continue;
+
+    const yaml::ProfileEntry *P = i->second;
+    if (!matches(P->Reference)) continue;
+
+    // Only block references, edge frequencies are not block frequencies.
+    StringRef Block = P->Reference->Block.getName();
+    if (Block.empty()) continue;
+
+    uint64_t Freq = std::max(Frequencies.lookup(Block), P->WCETFrequency);
+    Frequencies[Block] = Freq;
+
+    found = true;
   }
 
   return found;
@@ -555,11 +694,13 @@ bool PMLQuery::getBlockCriticalityMap(BlockDoubleMap &Criticalitites)
 bool PMLMCQuery::
 getMemFacts(const MachineFunction &MF, ValueFactsMap &MemFacts) const
 {
+  const PMLFunctionFacts &Facts = getFunctionFacts();
+
   bool inserted = false;
   // place all value facts with mem-address-read in a map, lookup by
   // program point
-  for (std::vector<yaml::ValueFact*>::const_iterator
-      i = YDoc.ValueFacts.begin(), ie = YDoc.ValueFacts.end(); i != ie; ++i) {
+  for (std::vector<const yaml::ValueFact*>::const_iterator
+      i = Facts.ValueFacts.begin(), ie = Facts.ValueFacts.end(); i != ie; ++i) {
 
     const yaml::ValueFact *VF = *i;
     if (!matches(VF->Origin, VF->Level)) continue;
@@ -592,6 +733,23 @@ double PMLMCQuery::getCriticality(BlockDoubleMap &Criticalities,
   return getMaxDominatorValue(Criticalities, MBB, Default);
 }
 
+int64_t PMLBitcodeQuery::getWCETFrequency(BlockUIntMap &Frequencies,
+                                          const BasicBlock &BB,
+                                          int64_t Default)
+{
+  BlockUIntMap::iterator it = Frequencies.find(FI.getBlockName(BB).getName());
+  if (it == Frequencies.end()) return Default;
+  return it->second;
+}
+
+int64_t PMLMCQuery::getWCETFrequency(BlockUIntMap &Frequencies,
+                                     MachineBasicBlock &MBB, int64_t Default)
+{
+  BlockUIntMap::iterator it = Frequencies.find(FI.getBlockName(MBB).getName());
+  if (it == Frequencies.end()) return Default;
+  return it->second;
+}
+
 
 
 INITIALIZE_PASS_BEGIN(PMLMachineFunctionImport, "pml-mf-import",
@@ -634,12 +792,18 @@ bool PMLMachineFunctionImport::runOnMachineFunction(MachineFunction &mf)
 
 void PMLMachineFunctionImport::loadCriticalityMap()
 {
+  if (!PQ) return;
 
+  Criticalities.clear();
+  PQ->getBlockCriticalityMap(Criticalities);
 }
 
 void PMLMachineFunctionImport::loadFrequencyMap()
 {
+  if (!PQ) return;
 
+  Frequencies.clear();
+  PQ->getBlockFrequencyMap(Frequencies);
 }
 
 double PMLMachineFunctionImport::getCriticalty(MachineBasicBlock *FromBB,
@@ -659,7 +823,10 @@ int64_t PMLMachineFunctionImport::getWCETFrequency(MachineBasicBlock *FromBB,
 {
   if (!PQ) return Default;
 
-  return Default;
+  // TODO we do not have edge frequencies at the moment.
+  if (ToBB) return Default;
+
+  return PQ->getWCETFrequency(Frequencies, *FromBB, Default);
 }
 
 
@@ -397,12 +397,16 @@ MatchAndEmitInstruction(SMLoc IDLoc, unsigned &Opcode,
         if (HasALUlVariant(Inst.getOpcode(), ALUlOpcode)){
           if (InBundle) {
             return Error(IDLoc, "long immediate instruction cannot be in the second slot of a bundle");
-          } else {
-            // If we have an expression and can use ALUl, do so
+          } else if (BundleCounter) {
+            // Bundled instructions are not relaxed, so if we have an
+            // expression and can use ALUl, do so
             Inst.setOpcode(ALUlOpcode);
             // ALUl counts as two operations
             BundleCounter++;
           }
+          // Otherwise, we keep the short form. The value of the expression
+          // is only known after layout, the asm backend relaxes the
+          // instruction to ALUl if the value does not fit.
         }
       } else {
         assert(MCO.isImm() && "expected immediate operand for ALUi format");
@@ -88,6 +88,8 @@ static const unsigned PRegsTable[] = {
 // Forward declarations for tablegen'd decoder
 static DecodeStatus DecodeRRegsRegisterClass(MCInst &Inst, unsigned RegNo, uint64_t Address,
                                              const void *Decoder);
+static DecodeStatus DecodeFRegsRegisterClass(MCInst &Inst, unsigned RegNo, uint64_t Address,
+                                             const void *Decoder);
 static DecodeStatus DecodeSRegsRegisterClass(MCInst &Inst, unsigned RegNo, uint64_t Address,
                                              const void *Decoder);
 static DecodeStatus DecodePRegsRegisterClass(MCInst &Inst, unsigned RegNo, uint64_t Address,
@@ -207,6 +209,13 @@ static DecodeStatus DecodeRRegsRegisterClass(MCInst &Inst, unsigned RegNo, uint6
   return MCDisassembler::Success;
 }
 
+static DecodeStatus DecodeFRegsRegisterClass(MCInst &Inst, unsigned RegNo, uint64_t Address,
+                                             const void *Decoder)
+{
+  // floats are held in the general purpose registers
+  return DecodeRRegsRegisterClass(Inst, RegNo, Address, Decoder);
+}
+
 static DecodeStatus DecodeSRegsRegisterClass(MCInst &Inst, unsigned RegNo, uint64_t Address,
                                              const void *Decoder)
 {
@@ -13,6 +13,7 @@
 //
 
 #include "PatmosFixupKinds.h"
+#include "PatmosInstrInfo.h"
 #include "MCTargetDesc/PatmosMCTargetDesc.h"
 #include "llvm/MC/MCAsmBackend.h"
 #include "llvm/MC/MCAssembler.h"
@@ -163,23 +164,46 @@ public:
   /// MayNeedRelaxation - Check whether the given instruction may need
   /// relaxation.
   ///
+  /// ALUi instructions with an expression as immediate are emitted in their
+  /// short form and relaxed to the ALUl variant if the value of the
+  /// expression does not fit into 12 bits, or is not known before linking.
+  ///
+  /// Branches are not relaxed, the PC relative immediate covers 16 MB of
+  /// code, calls use absolute addresses that are only known to the linker.
+  ///
   /// \param Inst - The instruction to test.
   bool mayNeedRelaxation(const MCInst &Inst) const {
-    // TODO return true for small immediates (?)
-    return false;
+    unsigned ALUlOpcode;
+    if (!HasALUlVariant(Inst.getOpcode(), ALUlOpcode))
+      return false;
+
+    // The last operand is the bundle marker, the immediate precedes it.
+    unsigned NumOps = Inst.getNumOperands();
+    assert(NumOps >= 2 && "Missing immediate operand");
+
+    // ALUl instructions cannot be bundled, keep bundled instructions as they
+    // are.
+    if (Inst.getOperand(NumOps - 1).getImm() > 0)
+      return false;
+
+    return Inst.getOperand(NumOps - 2).isExpr();
   }
 
   /// fixupNeedsRelaxation - Target specific predicate for whether a given
   /// fixup requires the associated instruction to be relaxed.
+  /// Only called for fixups that have been resolved, unresolved fixups always
+  /// need relaxation.
   bool fixupNeedsRelaxation(const MCFixup &Fixup,
                             uint64_t Value,
                             const MCRelaxableFragment *DF,
                             const MCAsmLayout &Layout) const
   {
-
-    // TODO check for branch/call immediate
-    assert(0 && "RelaxInstruction() unimplemented");
-    return false;
+    switch ((unsigned)Fixup.getKind()) {
+    case FK_Patmos_abs_ALUi:
+      return !isUInt<12>(Value);
+    default:
+      return false;
+    }
   }
 
   /// RelaxInstruction - Relax the instruction in the given fragment
@@ -189,7 +213,13 @@ public:
   /// as the output.
   /// \parm Res [output] - On return, the relaxed instruction.
   void relaxInstruction(const MCInst &Inst, MCInst &Res) const {
-    // TODO relax small immediates (?)
+    unsigned ALUlOpcode;
+    if (!HasALUlVariant(Inst.getOpcode(), ALUlOpcode))
+      llvm_unreachable("Relaxing an instruction without ALUl variant");
+
+    // The ALUl variants have the same operands as the ALUi instructions.
+    Res = Inst;
+    Res.setOpcode(ALUlOpcode);
   }
 
   /// @}
@@ -35,6 +35,7 @@ namespace llvm {
   FunctionPass *createPatmosISelDag(PatmosTargetMachine &TM);
   ModulePass   *createPatmosSPClonePass();
   ModulePass   *createPatmosSPMarkPass(PatmosTargetMachine &tm);
+  ModulePass   *createPatmosSPMergePass(const PatmosTargetMachine &tm);
   FunctionPass *createPatmosSinglePathInfoPass(const PatmosTargetMachine &tm);
   FunctionPass *createPatmosSPPreparePass(const PatmosTargetMachine &tm);
   FunctionPass *createPatmosSPBundlingPass(const PatmosTargetMachine &tm);
@@ -50,6 +51,8 @@ namespace llvm {
   FunctionPass *createPatmosBypassFromPMLPass(PatmosTargetMachine &tm);
   FunctionPass *createPatmosPMLProfileImport(const PatmosTargetMachine &tm);
   FunctionPass *createPatmosEnsureAlignmentPass(PatmosTargetMachine &tm);
+  FunctionPass *createPatmosSuperblockFormationPass(
+                                               const PatmosTargetMachine &tm);
 
   ModulePass *createPatmosModuleExportPass(PatmosTargetMachine &TM,
                                            std::string& Filename,
@@ -59,6 +62,12 @@ namespace llvm {
   ModulePass *createPatmosCallGraphBuilder();
   ModulePass *createPatmosStackCacheAnalysis(const PatmosTargetMachine &tm);
   ModulePass *createPatmosStackCacheAnalysisInfo(const PatmosTargetMachine &tm);
+  ModulePass *createPatmosMethodCachePlacement(const PatmosTargetMachine &tm);
+  ModulePass *createPatmosMethodCacheReport(const PatmosTargetMachine &tm);
+  ModulePass *createPatmosDataCacheBypass(const PatmosTargetMachine &tm);
+  ModulePass *createPatmosSPMAllocationPass(const PatmosTargetMachine &tm);
+  ModulePass *createPatmosWCETEstimatorPass(const PatmosTargetMachine &tm);
+  FunctionPass *createPatmosLoopBoundInferencePass();
 
   extern char &PatmosPostRASchedulerID;
 } // end namespace llvm;
@@ -0,0 +1,159 @@
+//===-- PatmosBlockDataFlow.h - Work-list solver over machine blocks. -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A generic work-list solver for data-flow problems over the basic blocks of a
+// machine function.
+//
+// Data-flow values are kept in a flat vector indexed by the basic blocks'
+// numbers. The work list is a bit vector over the blocks in reverse post-order
+// (forward problems) or post-order (backward problems), which is processed in
+// sweeps along this order until no block is pending anymore.
+//
+// The transfer function is supplied by the client. It reads and updates the
+// values of the blocks and pushes the blocks that need to be revisited.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _LLVM_TARGET_PATMOSBLOCKDATAFLOW_H_
+#define _LLVM_TARGET_PATMOSBLOCKDATAFLOW_H_
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/CodeGen/MachineBasicBlock.h"
+#include "llvm/CodeGen/MachineFunction.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+  /// Work-list based data-flow solver over the basic blocks of a machine
+  /// function, with values of type T.
+  template<typename T>
+  class PatmosBlockDataFlow
+  {
+  public:
+    /// The direction in which values are propagated, which determines the
+    /// order in which pending blocks are processed.
+    enum Direction { Forward, Backward };
+
+  private:
+    /// The basic blocks in processing order.
+    std::vector<MachineBasicBlock*> Order;
+
+    /// The position of each basic block in Order, indexed by block number.
+    std::vector<unsigned> Positions;
+
+    /// The data-flow values, indexed by block number.
+    std::vector<T> Values;
+
+    /// Blocks for which a value has been set, indexed by block number.
+    BitVector Defined;
+
+    /// Blocks pending for processing, indexed by position in Order.
+    BitVector Pending;
+
+  public:
+    /// Construct a solver for the given function, all values are initialized
+    /// to Init but remain undefined until they are set.
+    PatmosBlockDataFlow(MachineFunction &MF, Direction Dir,
+                        const T &Init = T()) :
+        Positions(MF.getNumBlockIDs()), Values(MF.getNumBlockIDs(), Init),
+        Defined(MF.getNumBlockIDs())
+    {
+      // compute a post-order of all blocks, starting from the entry, visiting
+      // blocks unreachable from the entry last.
+      typedef std::pair<MachineBasicBlock*, MachineBasicBlock::succ_iterator>
+                                                                    StackEntry;
+      std::vector<StackEntry> Stack;
+      BitVector Visited(MF.getNumBlockIDs());
+
+      Order.reserve(MF.size());
+      for(MachineFunction::iterator i(MF.begin()), ie(MF.end()); i != ie; i++)
+      {
+        if (Visited.test(i->getNumber()))
+          continue;
+
+        Visited.set(i->getNumber());
+        Stack.push_back(std::make_pair(&*i, i->succ_begin()));
+        while(!Stack.empty()) {
+          MachineBasicBlock *MBB = Stack.back().first;
+          if (Stack.back().second != MBB->succ_end()) {
+            MachineBasicBlock *succ = *Stack.back().second++;
+            if (!Visited.test(succ->getNumber())) {
+              Visited.set(succ->getNumber());
+              Stack.push_back(std::make_pair(succ, succ->succ_begin()));
+            }
+          }
+          else {
+            Order.push_back(MBB);
+            Stack.pop_back();
+          }
+        }
+      }
+
+      if (Dir == Forward)
+        std::reverse(Order.begin(), Order.end());
+
+      for(unsigned i = 0, ie = Order.size(); i != ie; i++)
+        Positions[Order[i]->getNumber()] = i;
+
+      Pending.resize(Order.size());
+    }
+
+    /// Get the basic blocks of the function in processing order.
+    const std::vector<MachineBasicBlock*> &getBlocks() const { return Order; }
+
+    /// Get the value of a basic block.
+    typename std::vector<T>::const_reference
+    get(const MachineBasicBlock *MBB) const {
+      return Values[MBB->getNumber()];
+    }
+
+    /// Set the value of a basic block.
+    void set(const MachineBasicBlock *MBB, const T &Value) {
+      Values[MBB->getNumber()] = Value;
+      Defined.set(MBB->getNumber());
+    }
+
+    /// Check whether a value has been set for a basic block.
+    bool isDefined(const MachineBasicBlock *MBB) const {
+      return Defined.test(MBB->getNumber());
+    }
+
+    /// Mark a basic block for (re-)processing.
+    void push(const MachineBasicBlock *MBB) {
+      Pending.set(Positions[MBB->getNumber()]);
+    }
+
+    /// Mark a range of basic blocks for (re-)processing.
+    template<typename IteratorT>
+    void push(IteratorT I, IteratorT E) {
+      for(; I != E; I++)
+        push(*I);
+    }
+
+    /// Mark all basic blocks for processing.
+    void pushAll() { Pending.set(); }
+
+    /// Process pending blocks until a fixpoint is reached. The transfer
+    /// function is invoked with the block to process and pushes all blocks
+    /// whose values need to be updated in turn.
+    template<typename TransferT>
+    void solve(TransferT Transfer) {
+      while(Pending.any()) {
+        for(int i = Pending.find_first(); i != -1; i = Pending.find_next(i)) {
+          Pending.reset(i);
+          Transfer(Order[i]);
+        }
+      }
+    }
+  };
+}
+
+#endif // _LLVM_TARGET_PATMOSBLOCKDATAFLOW_H_
@@ -136,14 +136,13 @@ bool PatmosBypassFromPML::hasLargeRange(const yaml::ValueFact *VF) const {
 
 
 bool PatmosBypassFromPML::rewriteInstruction(MachineInstr &MI) {
+  // only cached loads are rewritten
   unsigned opc = 0;
-  switch (MI.getOpcode()) {
-    case Patmos::LWC:  opc = Patmos::LWM;  break;
-    case Patmos::LHC:  opc = Patmos::LHM;  break;
-    case Patmos::LBC:  opc = Patmos::LBM;  break;
-    case Patmos::LHUC: opc = Patmos::LHUM; break;
-    case Patmos::LBUC: opc = Patmos::LBUM; break;
-    default: /*ignore*/;
+  if (MI.mayLoad() &&
+      TII->getMemTypeOpcode(MI.getOpcode(), PatmosII::MEM_C) ==
+                                                  (unsigned)MI.getOpcode())
+  {
+    opc = TII->getMemTypeOpcode(MI.getOpcode(), PatmosII::MEM_M);
   }
 
   if (opc) {
@@ -20,6 +20,7 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <set>
 
 using namespace llvm;
@@ -220,33 +221,42 @@ namespace llvm {
     MachineBasicBlock *MBB = MI->getParent();
     MachineFunction *MF = MBB->getParent();
 
-    for(scc_iterator<MachineFunction*> i(scc_begin(MF)), ie(scc_end(MF));
-        i != ie; i++)
-    {
-      if (i.hasLoop())
+    // collect the blocks within loops once per function
+    if (LoopsAnalyzed.insert(MF)) {
+      for(scc_iterator<MachineFunction*> i(scc_begin(MF)), ie(scc_end(MF));
+          i != ie; i++)
       {
-        if (std::find((*i).begin(), (*i).end(), MBB) != (*i).end())
-          return true;
+        if (i.hasLoop())
+        {
+          LoopBlocks.insert((*i).begin(), (*i).end());
+        }
       }
     }
 
-    return false;
+    return LoopBlocks.count(MBB);
+  }
+
+  MCGNode *MCallGraph::addNode(MCGNode *N)
+  {
+    N->Index = Nodes.size();
+    Nodes.push_back(N);
+    IsIndexed = false;
+
+    return N;
   }
 
   MCGNode *MCallGraph::makeMCGNode(MachineFunction *MF)
   {
     // does a call graph node for the machine function exist?
-    for(MCGNodes::const_iterator i(Nodes.begin()), ie(Nodes.end()); i != ie;
-        i++) {
-      if ((*i)->getMF() == MF)
-        return *i;
-    }
+    MCGNode *&MCGN = MFNodes[MF];
+    if (MCGN)
+      return MCGN;
 
     // construct a new call graph node for the MachineFunction
-    MCGNode *newMCGN = new MCGNode(MF);
-    Nodes.push_back(newMCGN);
+    MCGN = addNode(new MCGNode(MF));
+    NamedNodes[MF->getFunction()->getName()] = MCGN;
 
-    return newMCGN;
+    return MCGN;
   }
 
   MCGNode *MCallGraph::getUnknownNode(Type *T)
@@ -277,10 +287,7 @@ namespace llvm {
     }
 
     // construct a new call graph node for the Type
-    MCGNode *newMCGN = new MCGNode(T);
-    Nodes.push_back(newMCGN);
-
-    return newMCGN;
+    return addNode(new MCGNode(T));
   }
 
   MCGSite *MCallGraph::makeMCGSite(MCGNode *Caller, MachineInstr *MI,
@@ -294,7 +301,9 @@ namespace llvm {
     MCGSite *newSite = new MCGSite(Caller, MI, Callee, is_site_in_SCC);
 
     // store the site with the graph
+    newSite->Index = Sites.size();
     Sites.push_back(newSite);
+    IsIndexed = false;
 
     // append the site to the caller call graph node
     Caller->Sites.push_back(newSite);
@@ -305,24 +314,133 @@ namespace llvm {
     return newSite;
   }
 
+  /// collectAdjacency - Store the distinct neighbours of each node, given by
+  /// the callee or caller of the node's sites, in compact form.
+  static void collectAdjacency(const MCGNodes &Nodes, bool Callees,
+                               std::vector<unsigned> &Begin,
+                               std::vector<unsigned> &Adjacent)
+  {
+    Begin.clear();
+    Adjacent.clear();
+    Begin.reserve(Nodes.size() + 1);
+
+    for(MCGNodes::const_iterator i(Nodes.begin()), ie(Nodes.end()); i != ie;
+        i++) {
+      unsigned first = Adjacent.size();
+      Begin.push_back(first);
+
+      const MCGSites &sites(Callees ? (*i)->getSites() :
+                                      (*i)->getCallingSites());
+      for(MCGSites::const_iterator j(sites.begin()), je(sites.end()); j != je;
+          j++) {
+        Adjacent.push_back(Callees ? (*j)->getCallee()->getIndex() :
+                                     (*j)->getCaller()->getIndex());
+      }
+
+      // remove duplicates, e.g., from multiple calls to the same function
+      std::sort(Adjacent.begin() + first, Adjacent.end());
+      Adjacent.erase(std::unique(Adjacent.begin() + first, Adjacent.end()),
+                     Adjacent.end());
+    }
+    Begin.push_back(Adjacent.size());
+  }
+
+  void MCallGraph::buildIndex() const
+  {
+    unsigned numNodes = Nodes.size();
+
+    collectAdjacency(Nodes, true, CalleesBegin, Callees);
+    collectAdjacency(Nodes, false, CallersBegin, Callers);
+
+    // Tarjan's algorithm over all nodes, without recursion. Unlike the
+    // scc_iterator this also covers nodes not reachable from the entry node.
+    SCCs.clear();
+    NodeSCCs.assign(numNodes, 0);
+
+    std::vector<unsigned> number(numNodes, 0), low(numNodes, 0);
+    std::vector<bool> onStack(numNodes, false);
+    std::vector<unsigned> stack;
+    // DFS stack of nodes and the position of their next callee to visit
+    std::vector<std::pair<unsigned, unsigned> > dfs;
+    unsigned counter = 0;
+
+    for(unsigned root = 0; root < numNodes; root++) {
+      if (number[root])
+        continue;
+
+      number[root] = low[root] = ++counter;
+      stack.push_back(root);
+      onStack[root] = true;
+      dfs.push_back(std::make_pair(root, CalleesBegin[root]));
+
+      while (!dfs.empty()) {
+        unsigned v = dfs.back().first;
+
+        // visit the next callee
+        if (dfs.back().second < CalleesBegin[v + 1]) {
+          unsigned w = Callees[dfs.back().second++];
+          if (!number[w]) {
+            number[w] = low[w] = ++counter;
+            stack.push_back(w);
+            onStack[w] = true;
+            dfs.push_back(std::make_pair(w, CalleesBegin[w]));
+          }
+          else if (onStack[w]) {
+            low[v] = std::min(low[v], number[w]);
+          }
+          continue;
+        }
+
+        // all callees visited
+        dfs.pop_back();
+        if (!dfs.empty()) {
+          unsigned u = dfs.back().first;
+          low[u] = std::min(low[u], low[v]);
+        }
+
+        if (low[v] == number[v]) {
+          // v is the root of an SCC, pop its nodes from the stack
+          MCGNodes members;
+          unsigned w;
+          do {
+            w = stack.back();
+            stack.pop_back();
+            onStack[w] = false;
+            NodeSCCs[w] = SCCs.size();
+            members.push_back(Nodes[w]);
+          } while (w != v);
+
+          // single nodes are only in a loop when they call themselves
+          bool hasLoop = members.size() > 1 ||
+                         std::binary_search(Callees.begin() + CalleesBegin[v],
+                                            Callees.begin() + CalleesBegin[v+1],
+                                            v);
+          SCCs.push_back(MCGSCC(members, hasLoop));
+        }
+      }
+    }
+
+    IsIndexed = true;
+  }
+
   void MCallGraph::markNodesInSCC()
   {
     // Work list of nodes being
     typedef std::set<MCGNode*> MCGNodeSet;
     MCGNodeSet WL;
-    for(scc_iterator<MCallGraph> i(scc_begin(*this)), ie(scc_end(*this));
-        i != ie; i++)
+    const MCGSCCs &sccs(getSCCs());
+    for(MCGSCCs::const_iterator i(sccs.begin()), ie(sccs.end()); i != ie; i++)
     {
       // See if the node is in an SCC of the call graph --> mark it directly ...
-      if (i.hasLoop())
+      if (i->HasLoop)
       {
-        WL.insert((*i).begin(), (*i).end());
+        WL.insert(i->Nodes.begin(), i->Nodes.end());
       }
       else
       {
         // ok the node is not in an SCC of the call graph, but maybe one of
         // its call sites it in a loop
-        MCGNode *MCGN = *(*i).begin();
+        MCGNode *MCGN = i->Nodes.front();
         const MCGSites &calling(MCGN->getCallingSites());
         for(MCGSites::const_iterator j(calling.begin()), je(calling.end());
             j != je; j++)
@@ -19,8 +19,10 @@
 #include "llvm/IR/Function.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/Type.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/MachineModulePass.h"
@@ -52,6 +54,9 @@ namespace llvm {
     friend struct GraphTraits<MCallGraph>;
     friend struct GraphTraits<MCallSubGraph>;
   private:
+    /// The index of the node in the call graph's node list.
+    unsigned Index;
+
     /// The MachineFunction represented by this call graph node, or NULL.
     MachineFunction *MF;
 
@@ -74,12 +79,22 @@ namespace llvm {
   public:
     /// Construct a new call graph node.
     explicit MCGNode(MachineFunction *mf) :
-        MF(mf), T(NULL), IsDead(true), IsInSCC(false)
+        Index(0), MF(mf), T(NULL), IsDead(true), IsInSCC(false)
     {
     }
 
     /// Construct a new call graph node.
-    explicit MCGNode(Type *t) : MF(NULL), T(t), IsDead(true), IsInSCC(false) {}
+    explicit MCGNode(Type *t) :
+        Index(0), MF(NULL), T(t), IsDead(true), IsInSCC(false)
+    {
+    }
+
+    /// getIndex - Return the index of the node in the call graph, node indices
+    /// are dense, starting at 0.
+    unsigned getIndex() const
+    {
+      return Index;
+    }
 
     /// getMF - Return the node's MachineFunction.
     MachineFunction *getMF() const
@@ -154,7 +169,11 @@ namespace llvm {
   /// A machine-level call site
   class MCGSite
   {
+    friend class MCallGraph;
   private:
+    /// The index of the call site in the call graph's site list.
+    unsigned Index;
+
     /// The parent call graph node of this call site.
     MCGNode *Caller;
 
@@ -172,10 +191,17 @@ namespace llvm {
     /// Construct a new call site.
     MCGSite(MCGNode *caller, MachineInstr *mi, MCGNode *callee,
             bool is_in_scc) :
-        Caller(caller), MI(mi), Callee(callee), IsInSCC(is_in_scc)
+        Index(0), Caller(caller), MI(mi), Callee(callee), IsInSCC(is_in_scc)
     {
     }
 
+    /// getIndex - Return the index of the call site in the call graph, site
+    /// indices are dense, starting at 0.
+    unsigned getIndex() const
+    {
+      return Index;
+    }
+
     /// getCaller - Return the parent call graph node of the call site.
     MCGNode *getCaller() const
     {
@@ -208,7 +234,33 @@ namespace llvm {
     void print(raw_ostream &OS) const;
   };
 
+  /// A strongly connected component of the machine-level call graph.
+  struct MCGSCC
+  {
+    /// The call graph nodes of the SCC.
+    MCGNodes Nodes;
+
+    /// Flag indicating whether the SCC contains a cycle, i.e., recursion.
+    bool HasLoop;
+
+    MCGSCC(const MCGNodes &nodes, bool hasLoop) :
+        Nodes(nodes), HasLoop(hasLoop)
+    {
+    }
+  };
+
+  /// A list of SCCs.
+  typedef std::vector<MCGSCC> MCGSCCs;
+
   /// A machine-level call graph.
+  ///
+  /// Nodes and call sites are numbered densely in the order of their
+  /// construction, see MCGNode::getIndex and MCGSite::getIndex, so that
+  /// analyses can keep per-node information in vectors. Nodes of machine
+  /// functions are indexed by name and by MachineFunction.
+  ///
+  /// The compact caller/callee adjacency and the SCC condensation of the
+  /// graph are computed on demand and cached until the graph is modified.
   class MCallGraph
   {
     friend struct GraphTraits<MCallGraph>;
@@ -225,6 +277,46 @@ namespace llvm {
     /// The graph's call sites.
     MCGSites Sites;
 
+    /// The nodes of machine functions, indexed by function name.
+    StringMap<MCGNode*> NamedNodes;
+
+    /// The nodes of machine functions, indexed by MachineFunction.
+    DenseMap<const MachineFunction*, MCGNode*> MFNodes;
+
+    /// Basic blocks within loops of the functions in LoopsAnalyzed.
+    SmallPtrSet<const MachineBasicBlock*, 32> LoopBlocks;
+
+    /// Functions whose loops have been added to LoopBlocks.
+    SmallPtrSet<const MachineFunction*, 16> LoopsAnalyzed;
+
+    /// Flag indicating whether the adjacency and SCC information below is up
+    /// to date.
+    mutable bool IsIndexed;
+
+    /// Compact adjacency: the indices of the distinct callees of node i are
+    /// stored in Callees[CalleesBegin[i]] .. Callees[CalleesBegin[i+1] - 1],
+    /// sorted by index. Callers are stored accordingly.
+    mutable std::vector<unsigned> CalleesBegin;
+    mutable std::vector<unsigned> Callees;
+    mutable std::vector<unsigned> CallersBegin;
+    mutable std::vector<unsigned> Callers;
+
+    /// The SCCs of the graph, callees before callers.
+    mutable MCGSCCs SCCs;
+
+    /// The index of the SCC of each node.
+    mutable std::vector<unsigned> NodeSCCs;
+
+    /// buildIndex - Compute the adjacency and SCCs of the graph.
+    void buildIndex() const;
+
+    /// ensureIndex - Make sure the adjacency and SCCs are up to date.
+    void ensureIndex() const
+    {
+      if (!IsIndexed)
+        buildIndex();
+    }
+
     typedef std::map<std::pair<Type *, Type *>, int> equivalent_types_t;
     equivalent_types_t EQ;
 
@@ -235,7 +327,12 @@ namespace llvm {
     // check if a call site is in some form of an SCC (loop)
     bool isInSCC(MachineInstr *MI);
 
+    /// addNode - Number a new node and append it to the graph.
+    MCGNode *addNode(MCGNode *N);
+
   public:
+    MCallGraph() : IsIndexed(false) {}
+
     /// getNodes - Return the graph's nodes.
     const MCGNodes &getNodes() const
     {
@@ -260,22 +357,56 @@ namespace llvm {
       return Sites;
     }
 
-    /// getMCGNode - Return the call graph node of the function with the given
-    /// name.
+    /// getEntryNode - Return the call graph node of the program's entry
+    /// function.
     MCGNode *getEntryNode() const {
       return getNode(EntrySymbol);
     }
 
-     /// getMCGNode - Return the call graph node of the function with the given
-     /// name.
-    MCGNode *getNode(const char *name) const {
-      for(MCGNodes::const_iterator i(Nodes.begin()), ie(Nodes.end()); i != ie;
-          i++) {
-        if (!(*i)->isUnknown() &&
-            (*i)->getMF()->getFunction()->getName() == name)
-          return *i;
-      }
-      return NULL;
+    /// getNode - Return the call graph node of the function with the given
+    /// name.
+    MCGNode *getNode(StringRef name) const {
+      StringMap<MCGNode*>::const_iterator i(NamedNodes.find(name));
+      return i != NamedNodes.end() ? i->second : NULL;
+    }
+
+    /// getNode - Return the call graph node of the given function.
+    MCGNode *getNode(const MachineFunction *MF) const {
+      DenseMap<const MachineFunction*, MCGNode*>::const_iterator i(
+                                                              MFNodes.find(MF));
+      return i != MFNodes.end() ? i->second : NULL;
+    }
+
+    /// getCallees - Return the indices of the distinct callees of a node.
+    ArrayRef<unsigned> getCallees(const MCGNode *N) const {
+      ensureIndex();
+      return ArrayRef<unsigned>(Callees).slice(CalleesBegin[N->Index],
+                CalleesBegin[N->Index + 1] - CalleesBegin[N->Index]);
+    }
+
+    /// getCallers - Return the indices of the distinct callers of a node.
+    ArrayRef<unsigned> getCallers(const MCGNode *N) const {
+      ensureIndex();
+      return ArrayRef<unsigned>(Callers).slice(CallersBegin[N->Index],
+                CallersBegin[N->Index + 1] - CallersBegin[N->Index]);
+    }
+
+    /// getSCCs - Return the SCCs of the call graph. Callees are placed before
+    /// their callers, unless they are in the same SCC.
+    const MCGSCCs &getSCCs() const {
+      ensureIndex();
+      return SCCs;
+    }
+
+    /// getSCCIndex - Return the index of the SCC containing the node.
+    unsigned getSCCIndex(const MCGNode *N) const {
+      ensureIndex();
+      return NodeSCCs[N->Index];
+    }
+
+    /// getSCC - Return the SCC containing the node.
+    const MCGSCC &getSCC(const MCGNode *N) const {
+      return getSCCs()[getSCCIndex(N)];
     }
 
     /// makeMCGNode - Return a call graph node for the MachineFunction. The node
@@ -409,14 +540,9 @@ namespace llvm {
       return MCG.getEntryNode();
     }
 
-    /// getMCGNode - Return the call graph node of the given function.
+    /// getNode - Return the call graph node of the given function.
     MCGNode *getNode(const MachineFunction *MF) const {
-      for(MCGNodes::const_iterator i(MCG.getNodes().begin()),
-          ie(MCG.getNodes().end()); i != ie; i++) {
-        if ((*i)->getMF() == MF)
-          return *i;
-      }
-      return NULL;
+      return MCG.getNode(MF);
     }
 
     /// getMCGNode - Return the call graph node of the given function.
@@ -0,0 +1,610 @@
+//===-- PatmosDataCacheBypass.cpp - Whole-program bypass selection. -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Select the loads that bypass the data cache, based on a whole-program cost
+// model of the data cache.
+//
+// Loads are grouped by the object they access. The object and the size of the
+// accessed address range are taken from the value facts of an imported PML
+// file (aiT analysis results) if available, otherwise from the memory
+// operands of the loads (global variables and allocas of known size). Loads
+// without any information about their address range remain cached.
+//
+// The access frequency of a load is the WCET frequency of its block, if
+// imported by PatmosPMLProfileImport. Otherwise, it is estimated from the loop
+// bounds of the enclosing loops and the frequencies of the call sites of the
+// function, propagated over the call graph.
+//
+// An object that fits into the data cache is persistent, i.e., each of its
+// lines is loaded at most once. Accesses to other objects are assumed to miss
+// every time, as a cache analysis cannot classify them as hits without knowing
+// the exact addresses, and additionally evict lines of persistent objects
+// (pollution). A group of
+// loads is bypassed if single-word accesses to memory are cheaper than the
+// line fills and the pollution it causes when cached.
+//
+// Since the data cache is write-through and does not allocate on writes,
+// stores are never rewritten. This also ensures that bypassed loads never read
+// stale data from the cache. Placing data into the local scratchpad is left to
+// the scratchpad allocation.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "patmos-bypass-selection"
+
+#include "Patmos.h"
+#include "PatmosCallGraphBuilder.h"
+#include "PatmosInstrInfo.h"
+#include "PatmosMachineFunctionInfo.h"
+#include "PatmosSubtarget.h"
+#include "PatmosTargetMachine.h"
+#include "PatmosUtil.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineMemOperand.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/PMLImport.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<bool> EnableBypassSelection(
+  "mpatmos-enable-bypass-selection",
+  cl::init(false),
+  cl::desc("Select loads that bypass the data cache based on a whole-program "
+           "model of the data cache."),
+  cl::Hidden);
+
+static cl::opt<std::string> BypassReport(
+  "mpatmos-bypass-report",
+  cl::desc("Write the predicted data cache misses of all functions to the "
+           "given file."),
+  cl::Hidden);
+
+static cl::opt<unsigned> MemoryLatency(
+  "mpatmos-bypass-memory-latency",
+  cl::init(7),
+  cl::desc("Latency of a memory access in cycles, used to select bypassed "
+           "loads. (default: 7)"),
+  cl::Hidden);
+
+STATISTIC(BypassLoads,   "Number of loads rewritten to bypass the data cache");
+STATISTIC(BypassObjects, "Number of objects bypassing the data cache");
+STATISTIC(PersistentObjects, "Number of objects persistent in the data cache");
+
+/// DefaultLoopBound - Number of iterations assumed for loops without bounds
+/// and for recursion.
+static const unsigned DefaultLoopBound = 10;
+
+namespace {
+  /// A cached load, its access frequency and the object it accesses.
+  struct DCLoad {
+    MachineInstr *MI;
+
+    /// The function containing the load.
+    const MachineFunction *MF;
+
+    /// The number of executions of the load.
+    double Frequency;
+
+    DCLoad(MachineInstr *mi, const MachineFunction *mf, double freq)
+      : MI(mi), MF(mf), Frequency(freq) {}
+  };
+
+  /// A group of loads accessing the same object.
+  struct DCObject {
+    /// The size of the accessed address range in bytes, or -1 if it is
+    /// unbounded.
+    int64_t Range;
+
+    /// The loads accessing the object.
+    std::vector<DCLoad> Loads;
+
+    /// The number of accesses to the object.
+    double Frequency;
+
+    /// The object fits into the data cache.
+    bool Persistent;
+
+    /// The loads to the object are rewritten to bypass the data cache.
+    bool Bypass;
+
+    DCObject() : Range(0), Frequency(0), Persistent(false), Bypass(false) {}
+  };
+
+  /// Predicted data cache behaviour of a function.
+  struct DCFunctionStats {
+    unsigned Loads;
+    unsigned Bypassed;
+    double MissesBefore;
+    double MissesAfter;
+    double BypassedAccesses;
+
+    DCFunctionStats() : Loads(0), Bypassed(0), MissesBefore(0),
+                        MissesAfter(0), BypassedAccesses(0) {}
+  };
+
+  class PatmosDataCacheBypass : public MachineModulePass {
+  private:
+    const PatmosTargetMachine &TM;
+    const PatmosSubtarget &STC;
+    const PatmosInstrInfo &PII;
+
+    /// The objects accessed by cached loads, indexed by the underlying IR
+    /// value, or the load itself if the object is unknown.
+    std::map<const void*, DCObject> Objects;
+
+    /// The number of executions of each function.
+    std::map<const MCGNode*, double> FunctionFrequencies;
+
+    /// The number of executions of each basic block per execution of its
+    /// function, estimated from loop bounds.
+    std::map<const MachineBasicBlock*, double> LocalFrequencies;
+
+    /// Number of lines of persistent objects that are reused, i.e., that may
+    /// be evicted by non-persistent accesses.
+    double ReusedLines;
+
+    /// getLines - Get the number of cache lines an address range spans.
+    double getLines(int64_t Range) const {
+      unsigned Line = STC.getDataCacheBlockSize();
+      return (Range + Line - 1) / Line;
+    }
+
+    /// getWordCycles - Cycles for a single bypassed access.
+    double getWordCycles() const {
+      return MemoryLatency + 1;
+    }
+
+    /// getLineCycles - Cycles to fill a cache line.
+    double getLineCycles() const {
+      return MemoryLatency + STC.getDataCacheBlockSize() / 4;
+    }
+
+    /// getMisses - Get the predicted number of misses of loads to an object
+    /// with the given frequency, if it is cached.
+    double getMisses(const DCObject &O, double Frequency) const {
+      if (!O.Persistent) return Frequency;
+      // Scale the line fills of the object to the given loads.
+      double Misses = std::min(O.Frequency, getLines(O.Range));
+      return O.Frequency > 0 ? Misses * Frequency / O.Frequency : 0;
+    }
+
+    /// getPollution - Get the predicted number of misses caused by evicting
+    /// reused lines of persistent objects.
+    double getPollution(const DCObject &O, double Frequency) const {
+      if (O.Persistent) return 0;
+      return std::min(getMisses(O, Frequency), ReusedLines);
+    }
+
+    /// getLoopBound - Get the maximum number of iterations of a loop.
+    double getLoopBound(const MachineLoop *L) const {
+      // The bounds are read from the llvm.loop metadata of the terminator of
+      // the header (see getLoopBounds), but a latch may carry them as well.
+      for (MachineLoop::block_iterator i = L->block_begin(),
+           ie = L->block_end(); i != ie; i++)
+      {
+        int Max = getLoopBounds(*i).second;
+        if (Max >= 0) return Max + 1;
+      }
+      return DefaultLoopBound;
+    }
+
+    /// computeLocalFrequencies - Estimate the number of executions of the
+    /// basic blocks of a function per execution of the function.
+    void computeLocalFrequencies(MachineFunction &MF) {
+      DominatorTreeBase<MachineBasicBlock> DT(false);
+      DT.recalculate(MF);
+      LoopInfoBase<MachineBasicBlock, MachineLoop> LI;
+      LI.Analyze(DT);
+
+      for (MachineFunction::iterator i = MF.begin(), ie = MF.end();
+           i != ie; i++)
+      {
+        double Frequency = 1;
+        for (MachineLoop *L = LI.getLoopFor(i); L; L = L->getParentLoop()) {
+          Frequency *= getLoopBound(L);
+        }
+        LocalFrequencies[i] = Frequency;
+      }
+    }
+
+    /// computeFunctionFrequencies - Estimate the number of executions of all
+    /// functions, starting with one execution of every function that is not
+    /// called.
+    void computeFunctionFrequencies(const MCallGraph &MCG) {
+      const MCGSCCs &SCCs = MCG.getSCCs();
+
+      // Callers are placed after their callees.
+      for (MCGSCCs::const_reverse_iterator i = SCCs.rbegin(),
+           ie = SCCs.rend(); i != ie; i++)
+      {
+        for (MCGNodes::const_iterator n = i->Nodes.begin(),
+             ne = i->Nodes.end(); n != ne; n++)
+        {
+          const MCGSites &Calling = (*n)->getCallingSites();
+
+          double Frequency = 0;
+          bool HasCallers = false;
+          for (MCGSites::const_iterator s = Calling.begin(),
+               se = Calling.end(); s != se; s++)
+          {
+            // Recursive calls are covered by the loop bound of the SCC.
+            if (MCG.getSCCIndex((*s)->getCaller()) == MCG.getSCCIndex(*n))
+              continue;
+            HasCallers = true;
+
+            const MachineInstr *MI = (*s)->getMI();
+            double Local = MI ? LocalFrequencies[MI->getParent()] : 1;
+            Frequency += FunctionFrequencies[(*s)->getCaller()] * Local;
+          }
+          if (!HasCallers) Frequency = 1;
+          if (i->HasLoop) Frequency *= DefaultLoopBound;
+
+          FunctionFrequencies[*n] = Frequency;
+        }
+      }
+    }
+
+    /// getObject - Get the object accessed by a load from its memory
+    /// operands, and the size of the object.
+    const Value *getObject(const MachineInstr *MI, int64_t &Size) const {
+      if (!MI->hasOneMemOperand()) return NULL;
+
+      const MachineMemOperand *MMO = *MI->memoperands_begin();
+      if (!MMO->getValue()) return NULL;
+
+      const DataLayout *DL = TM.getDataLayout();
+      const Value *V = GetUnderlyingObject(MMO->getValue(), DL);
+
+      Type *Ty = NULL;
+      if (const GlobalVariable *GV = dyn_cast<GlobalVariable>(V)) {
+        Ty = GV->getType()->getElementType();
+      } else if (const AllocaInst *AI = dyn_cast<AllocaInst>(V)) {
+        if (!AI->isStaticAlloca()) return NULL;
+        Ty = AI->getAllocatedType();
+        if (const ConstantInt *C = dyn_cast<ConstantInt>(AI->getArraySize())) {
+          Size = DL->getTypeAllocSize(Ty) * C->getZExtValue();
+          return V;
+        }
+        return NULL;
+      } else {
+        return NULL;
+      }
+
+      Size = DL->getTypeAllocSize(Ty);
+      return V;
+    }
+
+    /// getAccessSize - Get the number of bytes read by a load.
+    unsigned getAccessSize(const MachineInstr *MI) const {
+      if (MI->hasOneMemOperand())
+        return (*MI->memoperands_begin())->getSize();
+      return 4;
+    }
+
+    /// getFactRange - Get the size of the address range of a load from its
+    /// value facts, or -1 if it is unbounded.
+    int64_t getFactRange(const PMLQuery::ValueFactList &Facts, unsigned Size)
+    {
+      int64_t Range = 0;
+      for (PMLQuery::ValueFactList::const_iterator i = Facts.begin(),
+           ie = Facts.end(); i != ie; i++)
+      {
+        for (unsigned v = 0; v < (*i)->Values.size(); v++) {
+          const yaml::Value &Val = (*i)->Values[v];
+          if (Val.Min == INT64_MIN || Val.Max == INT64_MAX) return -1;
+          Range = std::max(Range, Val.Max - Val.Min + Size);
+        }
+      }
+      return Range;
+    }
+
+    /// isSymbolic - Check if all values of the facts are relative to a
+    /// symbol.
+    bool isSymbolic(const PMLQuery::ValueFactList &Facts) const {
+      for (PMLQuery::ValueFactList::const_iterator i = Facts.begin(),
+           ie = Facts.end(); i != ie; i++)
+      {
+        for (unsigned v = 0; v < (*i)->Values.size(); v++) {
+          if ((*i)->Values[v].Symbol.empty()) return false;
+        }
+      }
+      return true;
+    }
+
+    /// collectLoads - Collect the cached loads of a function and group them by
+    /// the accessed object.
+    void collectLoads(MachineFunction &MF, double FunctionFrequency)
+    {
+      PatmosAnalysisInfo &PAI =
+                   MF.getInfo<PatmosMachineFunctionInfo>()->getAnalysisInfo();
+
+      // Use the WCET frequencies, if they have been imported for the
+      // function.
+      bool HasWCETFrequencies = false;
+      for (MachineFunction::iterator i = MF.begin(), ie = MF.end();
+           i != ie; i++)
+      {
+        if (PAI.getFrequency(i) >= 0) HasWCETFrequencies = true;
+      }
+
+      PMLImport &PI = getAnalysis<PMLImport>();
+      PMLMCQuery *Query = PI.createMCQuery(*this, MF);
+
+      PMLQuery::ValueFactsMap MemFacts;
+      bool HasFacts = Query && Query->getMemFacts(MF, MemFacts);
+
+      for (MachineFunction::iterator i = MF.begin(), ie = MF.end();
+           i != ie; i++)
+      {
+        double Frequency = HasWCETFrequencies ? PAI.getFrequency(i, 0) :
+                           FunctionFrequency * LocalFrequencies[i];
+
+        // Map the memory instruction labels to their value facts.
+        std::map<uint64_t, PMLQuery::ValueFactList> LabelFacts;
+        if (HasFacts) {
+          PMLQuery::ValueFactList &VFL = Query->getBBMemFacts(MemFacts, *i);
+          for (PMLQuery::ValueFactList::const_iterator f = VFL.begin(),
+               fe = VFL.end(); f != fe; f++)
+          {
+            yaml::Name L = Query->getMemInstrLabel((*f)->PP);
+            assert(L.isInteger() && "Mem instr label is not an integer!");
+            LabelFacts[L.getNameAsInteger()].push_back(*f);
+          }
+        }
+
+        // Memory instructions are labelled like in PatmosBypassFromPML.
+        uint64_t MemIdx = 0;
+        for (MachineBasicBlock::iterator mi = i->begin(), me = i->end();
+             mi != me; mi++)
+        {
+          if (!mi->mayLoad() && !mi->mayStore()) continue;
+
+          std::map<uint64_t, PMLQuery::ValueFactList>::iterator Facts =
+                                                   LabelFacts.find(MemIdx++);
+
+          MachineBasicBlock::instr_iterator I = mi.getInstrIterator();
+          MachineBasicBlock::instr_iterator E = llvm::next(I);
+          if (mi->isBundle()) {
+            ++I;
+            while (E != i->instr_end() && E->isInsideBundle()) ++E;
+          }
+
+          for (; I != E; ++I) {
+            if (!I->mayLoad() || I->isBundle() ||
+                PII.getMemTypeOpcode(I->getOpcode(), PatmosII::MEM_C) !=
+                                                    (unsigned)I->getOpcode())
+              continue;
+
+            int64_t Range = 0;
+            const void *Key = getObject(I, Range);
+
+            // Symbolic addresses are relative to the accessed object,
+            // otherwise the load is the only known access to its range.
+            if (Facts != LabelFacts.end()) {
+              Range = getFactRange(Facts->second, getAccessSize(I));
+              if (!Key || !isSymbolic(Facts->second))
+                Key = &*I;
+            }
+            if (!Key) continue;
+
+            DCObject &O = Objects[Key];
+            if (O.Range >= 0) {
+              O.Range = Range < 0 ? -1 : std::max(O.Range, Range);
+            }
+            O.Loads.push_back(DCLoad(&*I, &MF, Frequency));
+            O.Frequency += Frequency;
+          }
+        }
+      }
+
+      delete Query;
+    }
+
+    /// selectBypass - Decide which objects bypass the data cache.
+    void selectBypass() {
+      ReusedLines = 0;
+      for (std::map<const void*, DCObject>::iterator i = Objects.begin(),
+           ie = Objects.end(); i != ie; i++)
+      {
+        DCObject &O = i->second;
+        O.Persistent = O.Range >= 0 &&
+                       O.Range <= (int64_t)STC.getDataCacheSize();
+        if (O.Persistent) {
+          PersistentObjects++;
+          if (O.Frequency > getLines(O.Range))
+            ReusedLines += getLines(O.Range);
+        }
+      }
+      ReusedLines = std::min(ReusedLines, getLines(STC.getDataCacheSize()));
+
+      for (std::map<const void*, DCObject>::iterator i = Objects.begin(),
+           ie = Objects.end(); i != ie; i++)
+      {
+        DCObject &O = i->second;
+        if (O.Frequency <= 0) continue;
+
+        double Cached = (getMisses(O, O.Frequency) +
+                         getPollution(O, O.Frequency)) * getLineCycles();
+        double Bypassed = O.Frequency * getWordCycles();
+
+        O.Bypass = Bypassed < Cached;
+
+        DEBUG(dbgs() << "Bypass: object of " << O.Loads.size() << " loads, "
+                     << "range " << O.Range << ", frequency " << O.Frequency
+                     << (O.Persistent ? ", persistent" : "")
+                     << ": cached " << Cached << ", bypassed " << Bypassed
+                     << (O.Bypass ? " => bypass\n" : "\n"));
+      }
+    }
+
+    /// rewriteLoads - Rewrite the loads of the bypassed objects and collect
+    /// the predicted misses of each function.
+    bool rewriteLoads(std::map<const MachineFunction*,
+                               DCFunctionStats> &Stats)
+    {
+      bool Changed = false;
+      for (std::map<const void*, DCObject>::iterator i = Objects.begin(),
+           ie = Objects.end(); i != ie; i++)
+      {
+        DCObject &O = i->second;
+        if (O.Bypass) BypassObjects++;
+
+        for (std::vector<DCLoad>::iterator l = O.Loads.begin(),
+             le = O.Loads.end(); l != le; l++)
+        {
+          DCFunctionStats &S = Stats[l->MF];
+          double Misses = getMisses(O, l->Frequency) +
+                          getPollution(O, l->Frequency);
+          S.Loads++;
+          S.MissesBefore += Misses;
+
+          if (!O.Bypass) {
+            S.MissesAfter += Misses;
+            continue;
+          }
+
+          S.Bypassed++;
+          S.BypassedAccesses += l->Frequency;
+
+          unsigned Opc = PII.getMemTypeOpcode(l->MI->getOpcode(),
+                                              PatmosII::MEM_M);
+          assert(Opc && "Cached load without bypass variant");
+          DEBUG(dbgs() << "  - rewrite: " << *l->MI);
+          l->MI->setDesc(PII.get(Opc));
+          BypassLoads++;
+          Changed = true;
+        }
+      }
+      return Changed;
+    }
+
+    /// writeReport - Write one line per function with its predicted misses.
+    void writeReport(const Module &M,
+                     std::map<const MachineFunction*, DCFunctionStats> &Stats)
+    {
+      std::string err;
+      raw_fd_ostream f(BypassReport.c_str(), err, sys::fs::F_Append);
+      if (!err.empty()) {
+        errs() << "Error: Failed to open bypass report '"
+               << BypassReport << "': " << err << "\n";
+        return;
+      }
+
+      for (std::map<const MachineFunction*, DCFunctionStats>::iterator
+           i = Stats.begin(), ie = Stats.end(); i != ie; i++)
+      {
+        const DCFunctionStats &S = i->second;
+
+        // <module>, <function>, <#loads>, <#bypassed loads>,
+        f << "\"" << M.getModuleIdentifier() << "\", ";
+        f << "\"" << i->first->getName() << "\", ";
+        f << S.Loads << ", " << S.Bypassed << ", ";
+
+        // <misses before>, <misses after>, <miss delta>, <bypassed accesses>
+        f << format("%.0f", S.MissesBefore) << ", ";
+        f << format("%.0f", S.MissesAfter) << ", ";
+        f << format("%.0f", S.MissesAfter - S.MissesBefore) << ", ";
+        f << format("%.0f", S.BypassedAccesses) << "\n";
+      }
+    }
+
+  public:
+    static char ID;
+
+    PatmosDataCacheBypass(const PatmosTargetMachine &tm) :
+      MachineModulePass(ID), TM(tm), STC(tm.getSubtarget<PatmosSubtarget>()),
+      PII(*tm.getInstrInfo()), ReusedLines(0)
+    {
+      initializePatmosCallGraphBuilderPass(*PassRegistry::getPassRegistry());
+      initializePMLImportPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual const char *getPassName() const {
+      return "Patmos Data Cache Bypass Selection";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+      AU.addRequired<PatmosCallGraphBuilder>();
+      AU.addRequired<PMLImport>();
+
+      ModulePass::getAnalysisUsage(AU);
+    }
+
+    virtual bool doInitialization(Module &) {
+      if (!BypassReport.empty() && sys::fs::exists(BypassReport)) {
+        sys::fs::remove(BypassReport.c_str());
+      }
+      return false;
+    }
+
+    virtual bool runOnMachineModule(const Module &M) {
+      if (!EnableBypassSelection) return false;
+
+      PatmosCallGraphBuilder &PCGB = getAnalysis<PatmosCallGraphBuilder>();
+      const MCGNodes &Nodes = PCGB.getNodes();
+
+      Objects.clear();
+      FunctionFrequencies.clear();
+
+      LocalFrequencies.clear();
+
+      for (MCGNodes::const_iterator i = Nodes.begin(), ie = Nodes.end();
+           i != ie; i++)
+      {
+        if ((*i)->isUnknown()) continue;
+
+        computeLocalFrequencies(*(*i)->getMF());
+      }
+
+      computeFunctionFrequencies(*PCGB.getCallGraph());
+
+      for (MCGNodes::const_iterator i = Nodes.begin(), ie = Nodes.end();
+           i != ie; i++)
+      {
+        if ((*i)->isUnknown()) continue;
+
+        collectLoads(*(*i)->getMF(), FunctionFrequencies[*i]);
+      }
+
+      selectBypass();
+
+      std::map<const MachineFunction*, DCFunctionStats> Stats;
+      bool Changed = rewriteLoads(Stats);
+
+      if (!BypassReport.empty())
+        writeReport(M, Stats);
+
+      return Changed;
+    }
+  };
+
+  char PatmosDataCacheBypass::ID = 0;
+}
+
+/// createPatmosDataCacheBypass - Returns a new pass that selects the loads
+/// that bypass the data cache.
+ModulePass *llvm::createPatmosDataCacheBypass(const PatmosTargetMachine &tm) {
+  return new PatmosDataCacheBypass(tm);
+}
@@ -12,8 +12,14 @@
 // instructions. If no instructions can be moved into the delay slot, then a
 // NOP is inserted.
 //
-// At the current state, only instructions from the local basic are considered
-// (not the targets of branches).
+// Instructions are first taken from the local basic block. Delay slots of
+// branches at the end of a block that remain filled with NOPs are then filled
+// with instructions from the beginning of the branch target or the
+// fall-through successor, if that successor has no other predecessor. For
+// conditional branches, these instructions are guarded by the branch condition.
+// Unguarded speculation is not done, since the live-in lists of the blocks are
+// not precise enough at this point (e.g., for the registers saved by the
+// prologue).
 //
 // As a post-processing step, NOPs are inserted after loads again, where
 // necessary.
@@ -61,6 +67,8 @@ using namespace llvm;
 
 STATISTIC( FilledSlots, "Number of delay slots filled");
 STATISTIC( FilledNOPs,  "Number of delay slots filled with NOPs");
+STATISTIC( FilledFromSuccs, "Number of delay slots filled from successors");
+STATISTIC( PredicatedFillers, "Number of successor fillers predicated");
 
 STATISTIC( SkippedLoadNOPs, "Number of loads not requiring a NOP");
 STATISTIC( InsertedLoadNOPs, "Number of NOPs inserted after loads");
@@ -75,6 +83,13 @@ static cl::opt<bool> DisableDelaySlotFiller(
   cl::desc("Disable the Patmos delay slot filler."),
   cl::Hidden);
 
+static cl::opt<bool> DisableSuccessorFillers(
+  "mpatmos-disable-delay-filler-successors",
+  cl::init(false),
+  cl::desc("Do not fill delay slots of branches with instructions from the "
+           "successor blocks."),
+  cl::Hidden);
+
 namespace {
 
   class DelayHazardInfo;
@@ -83,6 +98,9 @@ namespace {
   private:
     bool ForceDisableFiller;
 
+    /// Branches at the end of a block with NOPs in their delay slots.
+    SmallVector<MachineInstr*, 16> NOPFilledBranches;
+
     static char ID;
   public:
     /// Target machine description which we query for reg. names, data
@@ -108,10 +126,25 @@ namespace {
 
       // FIXME: check if Post-RA scheduler is enabled (by option or Subtarget),
       //        skip this loop (delay slot filling) in this case.
+      NOPFilledBranches.clear();
       for (MachineFunction::iterator FI = F.begin(), FE = F.end();
            FI != FE; ++FI)
         Changed |= fillDelaySlots(*FI);
 
+      // replace remaining NOPs after branches by instructions from the
+      // successors. This is done only once all blocks are filled locally, so
+      // that we do not take instructions the successors need themselves.
+      if (!DisableSuccessorFillers) {
+        unsigned Removed = 0;
+        for (unsigned i = 0, e = NOPFilledBranches.size(); i < e; i++)
+          Removed += fillSlotsFromSuccessors(*NOPFilledBranches[i]);
+
+        DEBUG( if (Removed) dbgs() << "Removed " << Removed << " NOPs from "
+                                   << "delay slots in "
+                                   << F.getFunction()->getName() << "\n" );
+        Changed |= Removed > 0;
+      }
+
       // insert NOPs after other instructions, if necessary
       for (MachineFunction::iterator FI = F.begin(), FE = F.end();
            FI != FE; ++FI)
@@ -154,6 +187,25 @@ namespace {
     /// bundle I.
     void insertNOPAfter(MachineBasicBlock &MBB,
                         const MachineBasicBlock::iterator I);
+
+    /// fillSlotsFromSuccessors - Replace the NOPs in the delay slots of the
+    /// branch BR at the end of its block by instructions from the successors.
+    /// \return the number of NOPs removed.
+    unsigned fillSlotsFromSuccessors(MachineInstr &BR);
+
+    /// hoistFromSuccessor - Move instructions from the beginning of Succ to
+    /// the end of the block of BR, replacing up to NumNOPs NOPs.
+    /// \param Pred   The guard under which Succ is reached, or empty if Succ
+    ///               is always reached.
+    /// \return the number of NOPs removed.
+    unsigned hoistFromSuccessor(MachineInstr &BR, MachineBasicBlock &Succ,
+                                const SmallVectorImpl<MachineOperand> &Pred,
+                                unsigned NumNOPs);
+
+    /// canHoistFromSuccessor - Check if instructions can be moved from the
+    /// beginning of Succ into the delay slots of a branch in MBB.
+    bool canHoistFromSuccessor(const MachineBasicBlock &MBB,
+                               const MachineBasicBlock &Succ) const;
   };
 
   /// Information used throughout finding a delay filler for an instruction
@@ -306,6 +358,14 @@ fillSlotForCtrlFlow(MachineBasicBlock &MBB, const MachineBasicBlock::iterator I,
     }
   }
 
+  // remember branches ending the block, the NOPs might be replaced by
+  // instructions from the successors later on.
+  if (DI.getNumCandidates() < CFLDelaySlots && NI == MBB.end() &&
+      I->isBranch() && !I->isIndirectBranch() && !I->isBundle() &&
+      !DisableDelaySlotFiller && !ForceDisableFiller) {
+    NOPFilledBranches.push_back(I);
+  }
+
 }
 
 void PatmosDelaySlotFiller::insertNOPAfter(MachineBasicBlock &MBB,
@@ -318,6 +378,154 @@ void PatmosDelaySlotFiller::insertNOPAfter(MachineBasicBlock &MBB,
 }
 
 
+unsigned PatmosDelaySlotFiller::fillSlotsFromSuccessors(MachineInstr &BR) {
+  MachineBasicBlock &MBB = *BR.getParent();
+
+  // The NOPs are placed right after the branch, followed by the fillers from
+  // the local block. Bail out if the slots do not end the block.
+  unsigned NumSlots = TM.getSubtargetImpl()->getDelaySlotCycles(&BR);
+  unsigned NumNOPs = 0, NumInstrs = 0;
+  MachineBasicBlock::iterator Last = &BR;
+  for (MachineBasicBlock::iterator J = llvm::next(Last); J != MBB.end(); ++J) {
+    if (J->isDebugValue()) continue;
+    if (J->getOpcode() == Patmos::NOP && NumNOPs == NumInstrs) NumNOPs++;
+    NumInstrs++;
+    Last = J;
+  }
+  if (NumInstrs != NumSlots || NumNOPs == 0)
+    return 0;
+
+  // A load in the last slot would need a NOP before the hoisted instructions.
+  if (Last->mayLoad())
+    return 0;
+
+  const MachineOperand &Target = BR.getOperand(2);
+  if (!Target.isMBB())
+    return 0;
+  MachineBasicBlock *TBB = Target.getMBB();
+
+  DEBUG( dbgs() << "Filling " << NumNOPs << " slots from successors in BB#"
+                << MBB.getNumber() << " for: " << BR );
+
+  SmallVector<MachineOperand, 2> Pred;
+  if (!TII->isPredicated(&BR) || MBB.succ_size() == 1) {
+    // Unconditional branch: the target is always executed
+    if (MBB.succ_size() != 1 || *MBB.succ_begin() != TBB)
+      return 0;
+    return hoistFromSuccessor(BR, *TBB, Pred, NumNOPs);
+  }
+
+  if (MBB.succ_size() != 2)
+    return 0;
+  MachineBasicBlock *FBB = *MBB.succ_begin() == TBB ? *llvm::next(
+                                      MBB.succ_begin()) : *MBB.succ_begin();
+
+  TII->getPredicateOperands(&BR, Pred);
+
+  // Take the taken path first, then the fall-through path under the negated
+  // guard.
+  unsigned Removed = hoistFromSuccessor(BR, *TBB, Pred, NumNOPs);
+  if (Removed < NumNOPs) {
+    Pred[1].setImm(!Pred[1].getImm());
+    Removed += hoistFromSuccessor(BR, *FBB, Pred, NumNOPs - Removed);
+  }
+  return Removed;
+}
+
+unsigned PatmosDelaySlotFiller::
+hoistFromSuccessor(MachineInstr &BR, MachineBasicBlock &Succ,
+                   const SmallVectorImpl<MachineOperand> &Pred,
+                   unsigned NumNOPs) {
+  MachineBasicBlock &MBB = *BR.getParent();
+
+  if (!canHoistFromSuccessor(MBB, Succ))
+    return 0;
+
+  unsigned PredReg = Pred.empty() ? 0 : Pred[0].getReg();
+
+  unsigned Removed = 0;
+  MachineBasicBlock::iterator J = Succ.begin();
+  while (Removed < NumNOPs && J != Succ.end()) {
+    MachineInstr *MI = J++;
+
+    if (MI->isDebugValue()) continue;
+
+    // We only take a prefix of the successor, so we can stop at the first
+    // instruction that cannot be moved.
+    if (MI->isBundle() || MI->isInlineAsm() || MI->isLabel() ||
+        MI->hasDelaySlot() || MI->isTerminator() || MI->isCall() ||
+        MI->getOpcode() == Patmos::NOP || TII->isPseudo(MI))
+      break;
+
+    // Same restrictions as for fillers from the local block, loads are
+    // excluded since they would require a NOP after the delay slot.
+    if (MI->mayLoad() || TII->isStackControl(MI) ||
+        MI->getOpcode() == Patmos::MUL || MI->getOpcode() == Patmos::MULU ||
+        (MI->hasUnmodeledSideEffects() &&
+         !TII->isSideEffectFreeSRegAccess(MI)))
+      break;
+
+    if (PredReg) {
+      // The instruction must be guarded by the branch condition, which must
+      // remain valid for the following instructions. The cache analyses do
+      // not handle predicated stalls, see isProfitableToIfCvt.
+      if (!MI->isPredicable() || TII->isPredicated(MI) ||
+          MI->modifiesRegister(PredReg, TRI) || TII->mayStall(MI))
+        break;
+    }
+
+    // Move the instruction to the end of the delay slots, replacing a NOP.
+    Succ.remove(MI);
+    if (PredReg) {
+      TII->PredicateInstruction(MI, Pred);
+      ++PredicatedFillers;
+    }
+    MBB.insert(MBB.end(), MI);
+
+    MachineInstr *NOP = llvm::next(MachineBasicBlock::iterator(&BR));
+    assert(NOP->getOpcode() == Patmos::NOP && "Expected a NOP in delay slot");
+    NOP->eraseFromParent();
+
+    // The values defined by the instruction now flow into the successor.
+    for (MachineInstr::const_mop_iterator MO = MI->operands_begin(),
+         ME = MI->operands_end(); MO != ME; ++MO) {
+      if (MO->isReg() && MO->isDef() && MO->getReg() &&
+          !Succ.isLiveIn(MO->getReg()))
+        Succ.addLiveIn(MO->getReg());
+    }
+
+    Removed++;
+    ++FilledSlots;
+    ++FilledFromSuccs;
+    FilledNOPs--;
+    DEBUG( dbgs() << " -- filler from BB#" << Succ.getNumber() << ": "
+                  << *MI );
+  }
+
+  // The guard is now also read by the hoisted instructions.
+  if (Removed && PredReg) {
+    for (MachineBasicBlock::iterator J = &BR; J != MBB.end(); ++J) {
+      for (MachineInstr::mop_iterator MO = J->operands_begin(),
+           ME = J->operands_end(); MO != ME; ++MO) {
+        if (MO->isReg() && MO->isUse() && MO->getReg() == PredReg)
+          MO->setIsKill(false);
+      }
+    }
+  }
+
+  return Removed;
+}
+
+bool PatmosDelaySlotFiller::
+canHoistFromSuccessor(const MachineBasicBlock &MBB,
+                      const MachineBasicBlock &Succ) const {
+  // The instructions must be executed on all paths into the successor.
+  return &Succ != &MBB && &Succ != &MBB.getParent()->front() &&
+         Succ.pred_size() == 1 && *Succ.pred_begin() == &MBB &&
+         !Succ.isLandingPad() && !Succ.hasAddressTaken();
+}
+
+
 bool PatmosDelaySlotFiller::hasDefUseDep(const MachineInstr *D,
                                          const MachineInstr *U) const {
 
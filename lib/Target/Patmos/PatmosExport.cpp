@@ -307,6 +307,10 @@ namespace llvm {
     virtual void exportSubfunctions(MachineFunction &MF,
                                         yaml::MachineFunction *PMF);
 
+    /// writeFunctionKey - the export additionally depends on the method
+    /// cache regions and the stack cache analysis results.
+    virtual void writeFunctionKey(MachineFunction &MF, raw_ostream &OS);
+
     virtual void exportLoopInfo(MachineFunction &MF,
                                 yaml::PMLDoc &YDoc,
                                 MachineLoop *Loop);
@@ -602,12 +606,43 @@ namespace llvm {
       PMF->addSubfunction(S);
     }
 
+    void PatmosMachineExport::writeFunctionKey(MachineFunction &MF,
+                                               raw_ostream &OS)
+    {
+      const PatmosMachineFunctionInfo *PMFI =
+                                        MF.getInfo<PatmosMachineFunctionInfo>();
+      PatmosStackCacheAnalysisInfo *SCA =
+       &P.getAnalysis<PatmosStackCacheAnalysisInfo>();
+
+      OS << "long-serialize " << LongSerialize << "\n";
+
+      for (MachineFunction::iterator bb = MF.begin(), be = MF.end(); bb != be;
+           bb++)
+      {
+        if (PMFI->isMethodCacheRegionEntry(bb))
+          OS << "region " << bb->getNumber() << "\n";
+
+        if (!SCA->isValid())
+          continue;
+
+        for (MachineBasicBlock::instr_iterator i = bb->instr_begin(),
+             ie = bb->instr_end(); i != ie; i++)
+        {
+          if (i->getOpcode() == Patmos::SENSi)
+            OS << "fill " << SCA->Ensures[i] << "\n";
+          else if (i->getOpcode() == Patmos::SRESi)
+            OS << "spill " << SCA->Reserves[i] << "\n";
+        }
+      }
+    }
+
     void PatmosMachineExport::exportLoopInfo(MachineFunction &MF,
                                              yaml::PMLDoc &YDoc,
                                              MachineLoop *Loop)
     {
       // Export user loop bounds for single-path functions since we
-      // know that they are the exact loop bounds.
+      // know that they are the exact loop bounds. Bounds inferred by the
+      // compiler are exported as well, but not as user annotations.
       if (!isSinglepathFunction(MF)) return;
 
       // scan the header for loopbound info
@@ -626,7 +661,7 @@ namespace llvm {
         FF->addTermLHS(Block, 1LL);
         FF->RHS = LoopBound;
         FF->Comparison = yaml::cmp_less_equal;
-        FF->Origin = "user.bc";
+        FF->Origin = isInferredLoopBound(Header) ? "llvm.bc" : "user.bc";
         FF->Classification = "loop-local";
 
         YDoc.addFlowFact(FF);
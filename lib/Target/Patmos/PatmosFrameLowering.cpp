@@ -31,11 +31,15 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 
+#include <algorithm>
+
 using namespace llvm;
 
 namespace llvm {
   /// Count the number of FIs overflowing into the shadow stack
   STATISTIC(FIsNotFitSC, "FIs that did not fit in the stack cache");
+  /// Count the number of local objects assigned to the stack cache
+  STATISTIC(LocalFIsSC, "Local objects assigned to the stack cache");
 }
 
 /// DisableStackCache - Command line option to disable the usage of the stack 
@@ -50,6 +54,14 @@ static cl::opt<bool> EnableBlockAlignedStackCache
           ("mpatmos-enable-block-aligned-stack-cache", cl::init(false),
            cl::desc("Enable the use of Patmos' block-aligned stack cache"));
 
+/// StackCacheLocalsBudget - Command line option to limit the number of bytes
+/// per function occupied by local objects on the stack cache.
+static cl::opt<unsigned> StackCacheLocalsBudget
+          ("mpatmos-stack-cache-locals-budget", cl::init(256),
+           cl::desc("Maximum number of bytes of non-escaping local objects "
+                    "assigned to the stack cache per function, 0 disables "
+                    "(default: 256)"));
+
 
 PatmosFrameLowering::PatmosFrameLowering(const PatmosTargetMachine &tm)
 : TargetFrameLowering(TargetFrameLowering::StackGrowsDown, 4, 0), TM(tm),
@@ -146,6 +158,104 @@ void PatmosFrameLowering::assignFIsToStackCache(MachineFunction &MF,
     if (MFI.isSpillSlotObjectIndex(FI))
       SCFIs[FI] = true;
   }
+
+  // local objects, using the remaining space
+  assignLocalsToStackCache(MF, SCFIs);
+}
+
+/// isFrameLoadStore - Return true if the opcode is a load or store that
+/// accesses memory at its frame index operand.
+static bool isFrameLoadStore(unsigned opcode) {
+  switch (opcode) {
+    case Patmos::LWC: case Patmos::LWM:
+    case Patmos::LHC: case Patmos::LHM:
+    case Patmos::LHUC: case Patmos::LHUM:
+    case Patmos::LBC: case Patmos::LBM:
+    case Patmos::LBUC: case Patmos::LBUM:
+    case Patmos::SWC: case Patmos::SWM:
+    case Patmos::SHC: case Patmos::SHM:
+    case Patmos::SBC: case Patmos::SBM:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void PatmosFrameLowering::assignLocalsToStackCache(MachineFunction &MF,
+                                                   BitVector &SCFIs) const
+{
+  MachineFrameInfo &MFI = *MF.getFrameInfo();
+
+  if (StackCacheLocalsBudget == 0)
+    return;
+
+  // count the accesses to each FI, and find FIs whose address escapes, i.e.,
+  // is used other than by a load or store, e.g., for address arithmetic.
+  // Such objects may be accessed via pointers, which cannot refer to the
+  // stack cache.
+  std::vector<unsigned> Accesses(MFI.getObjectIndexEnd());
+  BitVector Escapes(MFI.getObjectIndexEnd());
+  for (MachineFunction::iterator i(MF.begin()), ie(MF.end()); i != ie; ++i) {
+    for (MachineBasicBlock::iterator j(i->begin()), je(i->end()); j != je;
+         j++) {
+      for (unsigned k = 0, ke = j->getNumOperands(); k != ke; k++) {
+        const MachineOperand &MO = j->getOperand(k);
+        if (!MO.isFI() || MO.getIndex() < 0)
+          continue;
+
+        if (isFrameLoadStore(j->getOpcode()))
+          Accesses[MO.getIndex()]++;
+        else if (!j->isDebugValue() &&
+                 j->getOpcode() != TargetOpcode::LIFETIME_START &&
+                 j->getOpcode() != TargetOpcode::LIFETIME_END)
+          Escapes[MO.getIndex()] = true;
+      }
+    }
+  }
+
+  // upper bound of the space used by FIs already on the stack cache,
+  // including padding for alignment
+  unsigned Used = 0;
+  for (int FI = SCFIs.find_first(); FI != -1; FI = SCFIs.find_next(FI)) {
+    if (MFI.isDeadObjectIndex(FI))
+      continue;
+    Used += MFI.getObjectSize(FI) + MFI.getObjectAlignment(FI) - 1;
+  }
+  if (Used >= getEffectiveStackCacheSize())
+    return;
+  unsigned Budget = std::min((unsigned)StackCacheLocalsBudget,
+                             getEffectiveStackCacheSize() - Used);
+
+  // collect the candidates, variable sized objects have size 0
+  std::vector<int> Candidates;
+  for(unsigned FI = 0, FIe = MFI.getObjectIndexEnd(); FI != FIe; FI++) {
+    if (SCFIs[FI] || Escapes[FI] || Accesses[FI] == 0 ||
+        MFI.isDeadObjectIndex(FI) ||
+        (int)FI == MFI.getStackProtectorIndex() ||
+        MFI.getObjectSize(FI) <= 0)
+      continue;
+    Candidates.push_back(FI);
+  }
+
+  // prefer objects with many accesses per byte
+  std::stable_sort(Candidates.begin(), Candidates.end(),
+                   [&](int a, int b) {
+    return (uint64_t)Accesses[a] * MFI.getObjectSize(b) >
+           (uint64_t)Accesses[b] * MFI.getObjectSize(a);
+  });
+
+  for (unsigned i = 0; i < Candidates.size(); i++) {
+    int FI = Candidates[i];
+    unsigned Size = MFI.getObjectSize(FI) + MFI.getObjectAlignment(FI) - 1;
+    if (Size > Budget)
+      continue;
+
+    DEBUG(dbgs() << "PatmosSC: local FI: " << FI << " assigned to SC ("
+                 << Accesses[FI] << " accesses)\n");
+    SCFIs[FI] = true;
+    Budget -= Size;
+    LocalFIsSC++;
+  }
 }
 
 
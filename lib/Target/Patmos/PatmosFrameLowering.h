@@ -44,11 +44,18 @@ protected:
   unsigned getAlignedStackCacheFrameSize(unsigned frameSize) const;
 
   /// assignFIsToStackCache - Assign some FIs to the stack cache.
-  /// Currently this is only done for spill slots.
+  /// This is done for spill slots and, within a budget, for local objects
+  /// whose address does not escape.
   /// @param SCFIs - should be set to true for all indices of frame objects
   ///                that should be assigned to the stack cache.
   void assignFIsToStackCache(MachineFunction &MF, BitVector &SCFIs) const;
 
+  /// assignLocalsToStackCache - Assign statically sized local objects that
+  /// are only accessed directly by loads and stores to the stack cache,
+  /// given that they fit into the space left by the FIs already in SCFIs.
+  /// \see assignFIsToStackCache
+  void assignLocalsToStackCache(MachineFunction &MF, BitVector &SCFIs) const;
+
   /// assignFrameObjects - Fix the layout of the stack frame, assign FIs to
   /// either stack cache or shadow stack, and update all stack offsets.
   /// Also reserves space for the call frame if no frame pointer is used.
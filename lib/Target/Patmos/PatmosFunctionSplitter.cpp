@@ -46,6 +46,14 @@
 // Jump tables require some special handling, since either all targets of the
 // table either have to be region entries or have to be in the same region as 
 // all indirect branches using that table.
+//
+// If WCET criticalities are available (from PML, see PatmosPMLProfileImport),
+// they guide the region growing: blocks on the worst-case path are kept in
+// the region of their (critical) predecessors up to the maximum region size,
+// cold blocks are not added to critical regions but moved into regions of
+// their own. This keeps the method cache footprint on the worst-case path
+// small. Without criticalities all blocks are considered critical, and only
+// the size limits are used.
 // 
 //===----------------------------------------------------------------------===//
 
@@ -138,6 +146,19 @@ static cl::opt<bool> SplitCallBlocks(
     cl::init(true),
     cl::desc("Split basic blocks containing calls into own subfunctions."));
 
+static cl::opt<double> CriticalThreshold(
+    "mpatmos-split-critical-threshold",
+    cl::init(0.9),
+    cl::desc("Minimum criticality of blocks that are kept in the region of "
+             "critical predecessors up to mpatmos-max-subfunction-size. "
+             "(default: 0.9)"));
+
+static cl::opt<double> ColdThreshold(
+    "mpatmos-split-cold-threshold",
+    cl::init(0.1),
+    cl::desc("Blocks with a lower criticality are not added to critical "
+             "regions, but split into own subfunctions. (default: 0.1)"));
+
 /// EnableShowCFGs - Option to enable the rendering of annotated CFGs.
 static cl::opt<bool> EnableShowCFGs(
   "mpatmos-function-splitter-cfgs",
@@ -170,6 +191,8 @@ namespace llvm {
   STATISTIC(NOPsInserted, "NOPs inserted by function splitter");
   STATISTIC(PostDomsFound, "Post dominators checked");
   STATISTIC(PostDomsAdded, "Post dominators added by increasing region size");
+  STATISTIC(CriticalAdded, "Critical blocks added by increasing region size");
+  STATISTIC(ColdSplit, "Cold blocks split from critical regions");
 
   class ablock;
   class agraph;
@@ -385,6 +408,14 @@ namespace llvm {
 
     PMLMCQuery *PML;
     PMLQuery::BlockDoubleMap Criticalities;
+    PMLQuery::BlockUIntMap Frequencies;
+
+    /// Analysis results imported from PML by PatmosPMLProfileImport.
+    PatmosAnalysisInfo &PAI;
+
+    /// Use criticalities to guide the region growing. Only true if WCET
+    /// criticalities are available for this function.
+    bool UseCriticalities;
 
     MachinePostDominatorTree &MPDT;
 
@@ -396,7 +427,9 @@ namespace llvm {
       PII(*tm.getInstrInfo()),
       PreferredRegionSize(preferredRegionSize),
       PreferredSCCSize(preferredSCCSize), MaxRegionSize(maxRegionSize),
-      PML(pml), MPDT(mpdt)
+      PML(pml),
+      PAI(mf->getInfo<PatmosMachineFunctionInfo>()->getAnalysisInfo()),
+      UseCriticalities(false), MPDT(mpdt)
     {
       Blocks.reserve(mf->size());
 
@@ -538,7 +571,8 @@ namespace llvm {
       }
 
       if (PML) {
-        PML->getBlockCriticalityMap(Criticalities);
+        UseCriticalities = PML->getBlockCriticalityMap(Criticalities);
+        PML->getBlockFrequencyMap(Frequencies);
       }
     }
 
@@ -927,25 +961,49 @@ namespace llvm {
       }
     }
 
+    /// getCriticality - Get the WCET criticality of a basic block. Prefer the
+    /// imported analysis results, blocks that were created after the import
+    /// are looked up in the PML file. Blocks without any information are
+    /// considered to be critical.
+    double getCriticality(MachineBasicBlock *MBB) {
+      double Crit = PAI.getCriticality(MBB);
+      if (Crit >= 0.0) return Crit;
+      if (PML) return PML->getCriticality(Criticalities, *MBB);
+      return 1.0;
+    }
+
+    /// getCriticality - Get the maximum criticality of a set of blocks.
+    double getCriticality(const ablocks &blocks) {
+      double maxCrit = 0.0;
+      for (ablocks::const_iterator i = blocks.begin(), ie = blocks.end();
+           i != ie; i++)
+      {
+        if (!(*i)->MBB) continue;
+        maxCrit = std::max(maxCrit, getCriticality((*i)->MBB));
+      }
+      return maxCrit;
+    }
+
+    /// getCriticality - Get the criticality of a block, or the maximum
+    /// criticality of the SCC of an artificial header.
+    double getCriticality(ablock *block) {
+      return block->MBB ? getCriticality(block->MBB)
+                        : getCriticality(block->SCC);
+    }
+
+    /// getWCETFrequency - Get the execution frequency of a basic block on the
+    /// worst-case path, or -1 if unknown.
+    int64_t getWCETFrequency(MachineBasicBlock *MBB) {
+      int64_t Freq = PAI.getFrequency(MBB);
+      if (Freq >= 0) return Freq;
+      if (PML) return PML->getWCETFrequency(Frequencies, *MBB);
+      return -1;
+    }
+
     void makeReady(ready_set &ready, ablock *block) {
       ready_block rb;
       rb.block = block;
-
-      if (PML && block->MBB) {
-        rb.criticality = PML->getCriticality(Criticalities, *block->MBB);
-      } else if (PML) {
-        double maxCrit = 0.0;
-        for (ablocks::iterator i = block->SCC.begin(), ie = block->SCC.end();
-             i != ie; i++)
-        {
-          if (!(*i)->MBB) continue;
-          maxCrit = std::max(maxCrit,
-                             PML->getCriticality(Criticalities, *(*i)->MBB));
-        }
-        rb.criticality = maxCrit;
-      } else {
-        rb.criticality = 1.0;
-      }
+      rb.criticality = getCriticality(block);
 
       // add the block to the sorted ready list
       ready.push_back(rb);
@@ -1155,6 +1213,10 @@ namespace llvm {
 
       unsigned int maxSize = preferred_size;
       bool isPostDom = false;
+      bool isCritical = false;
+
+      double region_crit = UseCriticalities ? getCriticality(region) : 0.0;
+      double scc_crit = UseCriticalities ? getCriticality(scc) : 0.0;
 
       // If the block post-dominates the header, add it in any case as long
       // as it fits into the cache
@@ -1165,6 +1227,22 @@ namespace llvm {
         isPostDom = true;
         PostDomsFound++;
       }
+      // Keep blocks on the worst-case path together, a region transfer on
+      // the worst-case path likely costs a method cache miss.
+      else if (UseCriticalities && region_crit >= CriticalThreshold &&
+               scc_crit >= CriticalThreshold)
+      {
+        maxSize = MaxRegionSize;
+        isCritical = true;
+      }
+      // Move cold blocks out of critical regions, they would only increase
+      // the size of the region loaded on the worst-case path.
+      else if (UseCriticalities && region_crit >= CriticalThreshold &&
+               scc_crit < ColdThreshold)
+      {
+        ColdSplit++;
+        return false;
+      }
 
       // Check for size only after we checked for headers to allow large
       // basic blocks.
@@ -1191,6 +1269,7 @@ namespace llvm {
 
       // update statistics
       if (isPostDom && region_size > PreferredRegionSize) PostDomsAdded++;
+      if (isCritical && region_size > preferred_size) CriticalAdded++;
 
       return true;
     }
@@ -2134,9 +2213,17 @@ namespace llvm {
           // <#BBs>, <calc size>, <region size>, <HasCall>,
           f << BBs << ", " << EstRegionSize << ", " << RegionSize << ", "
             << Header->HasCall << ", ";
-          // <isSCC>, <SCC size>, <CallInSCC>
+          // <isSCC>, <SCC size>, <CallInSCC>,
           f << Header->isSCCHeader() << ", " << Header->SCCSize << ", "
-            << Header->HasCallinSCC;
+            << Header->HasCallinSCC << ", ";
+
+          // <criticality>, <WCET frequency>, <WCET cost>
+          // The cost is the number of bytes loaded into the method cache on
+          // the worst-case path if every entry of the region misses, or -1 if
+          // the frequency of the region entry is unknown.
+          int64_t Freq = G.getWCETFrequency(Header->MBB);
+          f << G.getCriticality(Header) << ", " << Freq << ", "
+            << (Freq < 0 ? -1 : Freq * RegionSize);
 
           f << "\n";
 
@@ -2195,6 +2282,15 @@ namespace llvm {
       unsigned prefer_subfunc_size = PreferSubfunctionSize ?
                                                        PreferSubfunctionSize
                                                      : max_subfunc_size;
+
+      // The preferred size might have been set for this function by the
+      // method cache placement.
+      const PatmosMachineFunctionInfo &PMFI =
+                                        *MF.getInfo<PatmosMachineFunctionInfo>();
+      if (PMFI.getPreferredSubfunctionSize()) {
+        prefer_subfunc_size = std::max(prefer_subfunc_size,
+                                       PMFI.getPreferredSubfunctionSize());
+      }
       unsigned prefer_scc_size = PreferSCCSize ? PreferSCCSize
                                                : prefer_subfunc_size;
       prefer_subfunc_size = std::min(max_subfunc_size, prefer_subfunc_size);
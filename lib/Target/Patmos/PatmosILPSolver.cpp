@@ -0,0 +1,1193 @@
+//===-- PatmosILPSolver.cpp - ILP solvers for Patmos analyses -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A small ILP solver for problems given in the (CPLEX) LP text format, as
+// well as a wrapper around external solver programs.
+//
+// The built-in solver supports the subset of the LP format generated by the
+// Patmos analyses (and typically used in user-supplied bounds): objective,
+// constraints, bounds, general and binary sections, labels, and comments.
+// Relaxations are solved using a dense two-phase simplex (using Bland's rule
+// to avoid cycling), integrality is established using depth-first
+// branch-and-bound.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PatmosILPSolver.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+  /// Tolerance used to compare floating point values.
+  const double Eps = 1e-9;
+
+  /// Tolerance used to check integrality of variables.
+  const double IntEps = 1e-6;
+
+  /// Value representing infinite bounds.
+  const double Inf = std::numeric_limits<double>::infinity();
+
+  //===--------------------------------------------------------------------===//
+  // Problem representation
+  //===--------------------------------------------------------------------===//
+
+  /// A linear constraint: sum of Coeffs (relation) RHS.
+  struct LPRow {
+    enum Relation { LE, GE, EQ };
+
+    std::vector<std::pair<unsigned, double> > Coeffs;
+    Relation Rel;
+    double RHS;
+  };
+
+  /// An (integer) linear program.
+  struct LPProblem {
+    /// True if the objective function should be maximized.
+    bool Maximize;
+
+    /// Constant part of the objective function.
+    double ObjConst;
+
+    /// Coefficients of the objective function, indexed by variables.
+    std::vector<double> Obj;
+
+    /// Lower and upper bounds of variables.
+    std::vector<double> Lower, Upper;
+
+    /// Integrality of variables.
+    std::vector<bool> Integer;
+
+    /// Constraints.
+    std::vector<LPRow> Rows;
+
+    /// Map variable names to indices.
+    StringMap<unsigned> Vars;
+
+    LPProblem() : Maximize(true), ObjConst(0) {}
+
+    unsigned getNumVars() const { return Obj.size(); }
+
+    /// getVar - Return the index of a variable, creating it if needed.
+    unsigned getVar(StringRef Name) {
+      StringMap<unsigned>::iterator i(Vars.find(Name));
+      if (i != Vars.end())
+        return i->second;
+
+      unsigned idx = Obj.size();
+      Vars[Name] = idx;
+      Obj.push_back(0);
+      Lower.push_back(0);
+      Upper.push_back(Inf);
+      Integer.push_back(false);
+      return idx;
+    }
+  };
+
+  //===--------------------------------------------------------------------===//
+  // LP format parser
+  //===--------------------------------------------------------------------===//
+
+  struct LPToken {
+    enum Kind { Ident, Number, Plus, Minus, Colon, Rel, End };
+
+    Kind K;
+
+    /// Text of identifiers.
+    std::string Text;
+
+    /// Value of numbers.
+    double Value;
+
+    /// Relation of relational operators.
+    LPRow::Relation R;
+
+    /// True if the token is the first on its line.
+    bool StartsLine;
+  };
+
+  /// Sections of an LP file.
+  enum LPSection { SecNone, SecObjective, SecConstraints, SecBounds,
+                   SecGenerals, SecBinaries, SecEnd };
+
+  class LPParser {
+    std::vector<LPToken> Tokens;
+    unsigned Pos;
+    LPProblem &P;
+    std::string &ErrMsg;
+
+    static bool isIdentChar(char c) {
+      return isalnum(c) || (c != 0 && strchr("!\"#$%&()/,.;?@_`'{}|~", c));
+    }
+
+    bool error(const std::string &Msg) {
+      ErrMsg = "LP parser: " + Msg;
+      return false;
+    }
+
+    /// tokenize - Split the LP text into tokens, dropping comments.
+    bool tokenize(StringRef LP) {
+      bool startsLine = true;
+      size_t i = 0, e = LP.size();
+      while (i < e) {
+        char c = LP[i];
+
+        if (c == '\n') {
+          startsLine = true;
+          i++;
+          continue;
+        }
+        else if (isspace(c)) {
+          i++;
+          continue;
+        }
+        else if (c == '\\') {
+          // comment until end of line
+          while (i < e && LP[i] != '\n')
+            i++;
+          continue;
+        }
+
+        LPToken T;
+        T.StartsLine = startsLine;
+        T.Value = 0;
+        T.R = LPRow::EQ;
+        startsLine = false;
+
+        if (c == '+' || c == '-' || c == ':') {
+          T.K = c == '+' ? LPToken::Plus :
+                c == '-' ? LPToken::Minus : LPToken::Colon;
+          i++;
+        }
+        else if (c == '<' || c == '>' || c == '=') {
+          T.K = LPToken::Rel;
+          char n = i + 1 < e ? LP[i + 1] : 0;
+          if (c == '=') {
+            T.R = n == '<' ? LPRow::LE : n == '>' ? LPRow::GE : LPRow::EQ;
+            i += (n == '<' || n == '>') ? 2 : 1;
+          }
+          else {
+            T.R = c == '<' ? LPRow::LE : LPRow::GE;
+            i += n == '=' ? 2 : 1;
+          }
+        }
+        else if (isdigit(c) || c == '.') {
+          size_t start = i;
+          while (i < e && (isdigit(LP[i]) || LP[i] == '.'))
+            i++;
+          // exponent
+          if (i < e && (LP[i] == 'e' || LP[i] == 'E')) {
+            size_t j = i + 1;
+            if (j < e && (LP[j] == '+' || LP[j] == '-'))
+              j++;
+            if (j < e && isdigit(LP[j])) {
+              i = j;
+              while (i < e && isdigit(LP[i]))
+                i++;
+            }
+          }
+          std::string num(LP.substr(start, i - start).str());
+          char *end;
+          T.K = LPToken::Number;
+          T.Value = strtod(num.c_str(), &end);
+          if (*end != 0)
+            return error("invalid number '" + num + "'");
+        }
+        else if (isIdentChar(c)) {
+          size_t start = i;
+          while (i < e && isIdentChar(LP[i]))
+            i++;
+          T.K = LPToken::Ident;
+          T.Text = LP.substr(start, i - start).str();
+        }
+        else {
+          return error(std::string("unexpected character '") + c + "'");
+        }
+
+        Tokens.push_back(T);
+      }
+
+      LPToken T;
+      T.K = LPToken::End;
+      T.StartsLine = true;
+      T.Value = 0;
+      T.R = LPRow::EQ;
+      Tokens.push_back(T);
+      return true;
+    }
+
+    const LPToken &peek(unsigned Offset = 0) const {
+      return Tokens[std::min<size_t>(Pos + Offset, Tokens.size() - 1)];
+    }
+
+    bool isKeyword(unsigned Offset, const char *Keyword) const {
+      const LPToken &T = peek(Offset);
+      return T.K == LPToken::Ident && StringRef(T.Text).equals_lower(Keyword);
+    }
+
+    /// isSectionHeader - Check if a section header starts at the current
+    /// position. Returns the number of tokens of the header, or 0.
+    unsigned isSectionHeader(LPSection &S, bool &Maximize) const {
+      const LPToken &T = peek();
+      if (T.K == LPToken::End) {
+        S = SecEnd;
+        return 0;
+      }
+
+      if (!T.StartsLine || T.K != LPToken::Ident ||
+          peek(1).K == LPToken::Colon)
+        return 0;
+
+      StringRef W(T.Text);
+      std::string L(W.lower());
+      if (L == "maximize" || L == "maximise" || L == "maximum" || L == "max") {
+        S = SecObjective;
+        Maximize = true;
+        return 1;
+      }
+      else if (L == "minimize" || L == "minimise" || L == "minimum" ||
+               L == "min") {
+        S = SecObjective;
+        Maximize = false;
+        return 1;
+      }
+      else if ((L == "subject" && isKeyword(1, "to")) ||
+               (L == "such" && isKeyword(1, "that"))) {
+        S = SecConstraints;
+        return 2;
+      }
+      else if (L == "st" || L == "s.t.") {
+        S = SecConstraints;
+        return 1;
+      }
+      else if (L == "bounds" || L == "bound") {
+        S = SecBounds;
+        return 1;
+      }
+      else if (L == "generals" || L == "general" || L == "gen" ||
+               L == "integers" || L == "integer") {
+        S = SecGenerals;
+        return 1;
+      }
+      else if (L == "binaries" || L == "binary" || L == "bin") {
+        S = SecBinaries;
+        return 1;
+      }
+      else if (L == "end") {
+        S = SecEnd;
+        return 1;
+      }
+
+      return 0;
+    }
+
+    bool atSectionHeader() const {
+      LPSection S;
+      bool M;
+      return peek().K == LPToken::End || isSectionHeader(S, M) != 0;
+    }
+
+    /// atLabel - Check if a label (name followed by a colon) starts at the
+    /// current position.
+    bool atLabel() const {
+      return peek().K == LPToken::Ident && peek(1).K == LPToken::Colon;
+    }
+
+    /// skipLabel - Skip a label at the current position, if any.
+    void skipLabel() {
+      if (atLabel())
+        Pos += 2;
+    }
+
+    /// parseSign - Parse an optional sequence of signs.
+    double parseSign() {
+      double sign = 1;
+      while (peek().K == LPToken::Plus || peek().K == LPToken::Minus) {
+        if (peek().K == LPToken::Minus)
+          sign = -sign;
+        Pos++;
+      }
+      return sign;
+    }
+
+    /// parseExpression - Parse a linear expression, accumulating the
+    /// coefficients of variables in Coeffs and constants in Const.
+    bool parseExpression(std::vector<double> &Coeffs, double &Const) {
+      bool first = true;
+      while (!atSectionHeader() && !atLabel()) {
+        const LPToken &T = peek();
+        if (T.K != LPToken::Plus && T.K != LPToken::Minus &&
+            T.K != LPToken::Number && T.K != LPToken::Ident)
+          break;
+
+        // terms except the first need to be separated by a sign
+        if (!first && T.K != LPToken::Plus && T.K != LPToken::Minus)
+          break;
+        first = false;
+
+        double coeff = parseSign();
+        bool hasNumber = false;
+        if (peek().K == LPToken::Number) {
+          coeff *= peek().Value;
+          hasNumber = true;
+          Pos++;
+        }
+
+        if (peek().K == LPToken::Ident && !atLabel() && !atSectionHeader()) {
+          unsigned v = P.getVar(peek().Text);
+          if (Coeffs.size() <= v)
+            Coeffs.resize(v + 1, 0);
+          Coeffs[v] += coeff;
+          Pos++;
+        }
+        else if (hasNumber) {
+          Const += coeff;
+        }
+        else {
+          return error("expected term in linear expression");
+        }
+      }
+      return true;
+    }
+
+    /// parseValue - Parse a (signed) number or infinity.
+    bool parseValue(double &Value) {
+      double sign = parseSign();
+      if (peek().K == LPToken::Number) {
+        Value = sign * peek().Value;
+      }
+      else if (isKeyword(0, "inf") || isKeyword(0, "infinity")) {
+        Value = sign * Inf;
+      }
+      else {
+        return error("expected a numeric value");
+      }
+      Pos++;
+      return true;
+    }
+
+    bool parseObjective() {
+      skipLabel();
+
+      std::vector<double> coeffs;
+      if (!parseExpression(coeffs, P.ObjConst))
+        return false;
+
+      for(unsigned i = 0, ie = coeffs.size(); i < ie; i++)
+        P.Obj[i] += coeffs[i];
+
+      return true;
+    }
+
+    bool parseConstraint() {
+      skipLabel();
+
+      std::vector<double> coeffs;
+      double lhsConst = 0;
+      if (!parseExpression(coeffs, lhsConst))
+        return false;
+
+      if (peek().K != LPToken::Rel)
+        return error("expected relational operator in constraint");
+
+      LPRow R;
+      R.Rel = peek().R;
+      Pos++;
+
+      if (!parseValue(R.RHS))
+        return false;
+      R.RHS -= lhsConst;
+
+      for(unsigned i = 0, ie = coeffs.size(); i < ie; i++) {
+        if (coeffs[i] != 0)
+          R.Coeffs.push_back(std::make_pair(i, coeffs[i]));
+      }
+
+      P.Rows.push_back(R);
+      return true;
+    }
+
+    static void applyBound(LPProblem &P, unsigned V, LPRow::Relation R,
+                           double Value) {
+      if (R == LPRow::LE || R == LPRow::EQ)
+        P.Upper[V] = Value;
+      if (R == LPRow::GE || R == LPRow::EQ)
+        P.Lower[V] = Value;
+    }
+
+    static LPRow::Relation swapRelation(LPRow::Relation R) {
+      return R == LPRow::LE ? LPRow::GE : R == LPRow::GE ? LPRow::LE : R;
+    }
+
+    bool parseBound() {
+      skipLabel();
+
+      if (peek().K == LPToken::Ident && !isKeyword(0, "inf") &&
+          !isKeyword(0, "infinity")) {
+        // x free | x (relation) value
+        unsigned v = P.getVar(peek().Text);
+        Pos++;
+
+        if (isKeyword(0, "free")) {
+          Pos++;
+          P.Lower[v] = -Inf;
+          P.Upper[v] = Inf;
+          return true;
+        }
+
+        if (peek().K != LPToken::Rel)
+          return error("expected relational operator in bound");
+
+        LPRow::Relation R = peek().R;
+        Pos++;
+
+        double value;
+        if (!parseValue(value))
+          return false;
+
+        applyBound(P, v, R, value);
+        return true;
+      }
+
+      // value (relation) x [(relation) value]
+      double value;
+      if (!parseValue(value))
+        return false;
+
+      if (peek().K != LPToken::Rel)
+        return error("expected relational operator in bound");
+
+      LPRow::Relation R = peek().R;
+      Pos++;
+
+      if (peek().K != LPToken::Ident)
+        return error("expected variable in bound");
+
+      unsigned v = P.getVar(peek().Text);
+      Pos++;
+
+      applyBound(P, v, swapRelation(R), value);
+
+      if (peek().K == LPToken::Rel) {
+        R = peek().R;
+        Pos++;
+
+        if (!parseValue(value))
+          return false;
+
+        applyBound(P, v, R, value);
+      }
+
+      return true;
+    }
+
+  public:
+    LPParser(LPProblem &p, std::string &errMsg) : Pos(0), P(p),
+      ErrMsg(errMsg) {}
+
+    bool parse(StringRef LP) {
+      if (!tokenize(LP))
+        return false;
+
+      LPSection S = SecNone;
+      while (true) {
+        // check for a new section
+        LPSection NS;
+        bool M = P.Maximize;
+        if (unsigned n = isSectionHeader(NS, M)) {
+          S = NS;
+          P.Maximize = M;
+          Pos += n;
+          continue;
+        }
+        else if (peek().K == LPToken::End || S == SecEnd) {
+          break;
+        }
+
+        unsigned start = Pos;
+        switch (S) {
+          case SecNone:
+            return error("expected objective function");
+          case SecObjective:
+            if (!parseObjective())
+              return false;
+            break;
+          case SecConstraints:
+            if (!parseConstraint())
+              return false;
+            break;
+          case SecBounds:
+            if (!parseBound())
+              return false;
+            break;
+          case SecGenerals:
+          case SecBinaries:
+            if (peek().K != LPToken::Ident)
+              return error("expected variable name");
+            else {
+              unsigned v = P.getVar(peek().Text);
+              P.Integer[v] = true;
+              if (S == SecBinaries) {
+                P.Lower[v] = 0;
+                P.Upper[v] = 1;
+              }
+              Pos++;
+            }
+            break;
+          case SecEnd:
+            break;
+        }
+
+        // make sure the parser does not get stuck on unexpected tokens
+        if (Pos == start)
+          return error("unexpected token");
+      }
+
+      return true;
+    }
+  };
+
+  //===--------------------------------------------------------------------===//
+  // Simplex
+  //===--------------------------------------------------------------------===//
+
+  /// A dense simplex tableau, maximizing the objective function.
+  class SimplexTableau {
+    /// Number of rows (constraints) and columns (variables).
+    unsigned M, N;
+
+    /// Tableau, the last row contains the objective function, the last column
+    /// the right-hand sides.
+    std::vector<std::vector<double> > T;
+
+    /// Basic variables of each row.
+    std::vector<unsigned> Basis;
+
+    void pivot(unsigned r, unsigned c) {
+      std::vector<double> &R = T[r];
+      double p = R[c];
+      for(unsigned j = 0; j <= N; j++)
+        R[j] /= p;
+      R[c] = 1;
+
+      for(unsigned i = 0; i <= M; i++) {
+        if (i == r)
+          continue;
+
+        std::vector<double> &Ri = T[i];
+        double f = Ri[c];
+        if (f == 0)
+          continue;
+
+        for(unsigned j = 0; j <= N; j++) {
+          Ri[j] -= f * R[j];
+          if (std::fabs(Ri[j]) < Eps * Eps)
+            Ri[j] = 0;
+        }
+        Ri[c] = 0;
+      }
+
+      Basis[r] = c;
+    }
+
+  public:
+    enum Result { Optimal, Unbounded, IterationLimit };
+
+    SimplexTableau(unsigned m, unsigned n) : M(m), N(n),
+      T(m + 1, std::vector<double>(n + 1, 0)), Basis(m, 0) {}
+
+    double &at(unsigned r, unsigned c) { return T[r][c]; }
+    double &rhs(unsigned r) { return T[r][N]; }
+    double &obj(unsigned c) { return T[M][c]; }
+    double &value() { return T[M][N]; }
+    unsigned getBasic(unsigned r) const { return Basis[r]; }
+    void setBasic(unsigned r, unsigned c) { Basis[r] = c; }
+
+    /// eliminate - Make the objective row consistent with the basis, i.e.,
+    /// zero the reduced costs of basic variables.
+    void eliminate() {
+      for(unsigned i = 0; i < M; i++) {
+        double f = T[M][Basis[i]];
+        if (f == 0)
+          continue;
+
+        for(unsigned j = 0; j <= N; j++)
+          T[M][j] -= f * T[i][j];
+        T[M][Basis[i]] = 0;
+      }
+    }
+
+    /// optimize - Run simplex iterations, only columns below NumEntering may
+    /// enter the basis.
+    Result optimize(unsigned NumEntering) {
+      unsigned maxIterations = 50 * (M + N) + 1000;
+      for(unsigned iter = 0; iter < maxIterations; iter++) {
+        // Bland's rule: choose the entering column with the smallest index.
+        unsigned c = NumEntering;
+        for(unsigned j = 0; j < NumEntering; j++) {
+          if (T[M][j] < -Eps) {
+            c = j;
+            break;
+          }
+        }
+
+        if (c == NumEntering)
+          return Optimal;
+
+        // ratio test, ties are broken by the smallest basic variable
+        unsigned r = M;
+        double best = Inf;
+        for(unsigned i = 0; i < M; i++) {
+          if (T[i][c] > Eps) {
+            double ratio = T[i][N] / T[i][c];
+            if (r == M || ratio < best - Eps ||
+                (ratio <= best + Eps && Basis[i] < Basis[r])) {
+              r = i;
+              best = ratio;
+            }
+          }
+        }
+
+        if (r == M)
+          return Unbounded;
+
+        pivot(r, c);
+      }
+
+      return IterationLimit;
+    }
+
+    /// driveOut - Try to remove column c from the basis at row r by pivoting
+    /// on some column below NumCandidates.
+    void driveOut(unsigned r, unsigned NumCandidates) {
+      for(unsigned j = 0; j < NumCandidates; j++) {
+        if (std::fabs(T[r][j]) > Eps) {
+          pivot(r, j);
+          return;
+        }
+      }
+    }
+  };
+
+  /// Solve the LP relaxation of P, using the bounds Lo and Up instead of the
+  /// problem's original bounds. The objective function is always maximized
+  /// (C is expected to be adjusted accordingly by the caller).
+  PatmosILPSolver::Status solveRelaxation(const LPProblem &P,
+                                          const std::vector<double> &C,
+                                          const std::vector<double> &Lo,
+                                          const std::vector<double> &Up,
+                                          std::vector<double> &X,
+                                          double &Value)
+  {
+    unsigned n = P.getNumVars();
+
+    // substitute variables by non-negative columns:
+    //   x = Offset + Sign * y_Pos - y_Neg
+    std::vector<int> pos(n), neg(n, -1);
+    std::vector<double> offset(n, 0), sign(n, 1);
+    unsigned numCols = 0;
+
+    // additional rows due to upper bounds
+    std::vector<std::pair<unsigned, double> > upperRows;
+
+    for(unsigned j = 0; j < n; j++) {
+      if (Lo[j] > Up[j] + Eps)
+        return PatmosILPSolver::Infeasible;
+
+      pos[j] = numCols++;
+      if (Lo[j] != -Inf) {
+        offset[j] = Lo[j];
+        if (Up[j] != Inf)
+          upperRows.push_back(std::make_pair(j, Up[j] - Lo[j]));
+      }
+      else if (Up[j] != Inf) {
+        offset[j] = Up[j];
+        sign[j] = -1;
+      }
+      else {
+        neg[j] = numCols++;
+      }
+    }
+
+    // collect rows over the new columns
+    struct DenseRow {
+      std::vector<double> A;
+      LPRow::Relation Rel;
+      double B;
+    };
+    std::vector<DenseRow> rows;
+    rows.reserve(P.Rows.size() + upperRows.size());
+
+    for(unsigned i = 0, ie = P.Rows.size(); i < ie; i++) {
+      const LPRow &R = P.Rows[i];
+      DenseRow D;
+      D.A.assign(numCols, 0);
+      D.Rel = R.Rel;
+      D.B = R.RHS;
+      for(unsigned k = 0, ke = R.Coeffs.size(); k < ke; k++) {
+        unsigned j = R.Coeffs[k].first;
+        double a = R.Coeffs[k].second;
+        D.A[pos[j]] += a * sign[j];
+        if (neg[j] >= 0)
+          D.A[neg[j]] -= a;
+        D.B -= a * offset[j];
+      }
+      rows.push_back(D);
+    }
+
+    for(unsigned k = 0, ke = upperRows.size(); k < ke; k++) {
+      DenseRow D;
+      D.A.assign(numCols, 0);
+      D.A[pos[upperRows[k].first]] = 1;
+      D.Rel = LPRow::LE;
+      D.B = upperRows[k].second;
+      rows.push_back(D);
+    }
+
+    // normalize right-hand sides and count slack and artificial columns
+    unsigned m = rows.size();
+    unsigned numSlacks = 0, numArtificials = 0;
+    for(unsigned i = 0; i < m; i++) {
+      DenseRow &D = rows[i];
+      if (D.B < 0) {
+        for(unsigned j = 0; j < numCols; j++)
+          D.A[j] = -D.A[j];
+        D.B = -D.B;
+        D.Rel = D.Rel == LPRow::LE ? LPRow::GE :
+                D.Rel == LPRow::GE ? LPRow::LE : LPRow::EQ;
+      }
+
+      if (D.Rel != LPRow::EQ)
+        numSlacks++;
+      if (D.Rel != LPRow::LE)
+        numArtificials++;
+    }
+
+    unsigned firstSlack = numCols;
+    unsigned firstArtificial = firstSlack + numSlacks;
+    SimplexTableau S(m, firstArtificial + numArtificials);
+
+    unsigned slack = firstSlack, artificial = firstArtificial;
+    for(unsigned i = 0; i < m; i++) {
+      DenseRow &D = rows[i];
+      for(unsigned j = 0; j < numCols; j++)
+        S.at(i, j) = D.A[j];
+      S.rhs(i) = D.B;
+
+      switch (D.Rel) {
+        case LPRow::LE:
+          S.at(i, slack) = 1;
+          S.setBasic(i, slack++);
+          break;
+        case LPRow::GE:
+          S.at(i, slack++) = -1;
+          S.at(i, artificial) = 1;
+          S.setBasic(i, artificial++);
+          break;
+        case LPRow::EQ:
+          S.at(i, artificial) = 1;
+          S.setBasic(i, artificial++);
+          break;
+      }
+    }
+
+    // phase 1: minimize the sum of artificial variables
+    if (numArtificials) {
+      for(unsigned j = firstArtificial; j < artificial; j++)
+        S.obj(j) = 1;
+      S.eliminate();
+
+      if (S.optimize(artificial) != SimplexTableau::Optimal)
+        return PatmosILPSolver::Failed;
+
+      if (S.value() < -IntEps)
+        return PatmosILPSolver::Infeasible;
+
+      // remove artificial variables from the basis
+      for(unsigned i = 0; i < m; i++) {
+        if (S.getBasic(i) >= firstArtificial)
+          S.driveOut(i, firstArtificial);
+      }
+    }
+
+    // phase 2: optimize the actual objective function
+    double objConst = 0;
+    for(unsigned j = 0; j <= artificial; j++)
+      S.obj(j) = 0;
+    for(unsigned j = 0; j < n; j++) {
+      S.obj(pos[j]) -= C[j] * sign[j];
+      if (neg[j] >= 0)
+        S.obj(neg[j]) += C[j];
+      objConst += C[j] * offset[j];
+    }
+    S.eliminate();
+
+    switch (S.optimize(firstArtificial)) {
+      case SimplexTableau::Optimal:
+        break;
+      case SimplexTableau::Unbounded:
+        return PatmosILPSolver::Unbounded;
+      case SimplexTableau::IterationLimit:
+        return PatmosILPSolver::Failed;
+    }
+
+    // extract solution
+    std::vector<double> y(firstArtificial, 0);
+    for(unsigned i = 0; i < m; i++) {
+      if (S.getBasic(i) < firstArtificial)
+        y[S.getBasic(i)] = S.rhs(i);
+    }
+
+    X.resize(n);
+    for(unsigned j = 0; j < n; j++) {
+      X[j] = offset[j] + sign[j] * y[pos[j]];
+      if (neg[j] >= 0)
+        X[j] -= y[neg[j]];
+    }
+
+    Value = S.value() + objConst;
+    return PatmosILPSolver::Optimal;
+  }
+
+  //===--------------------------------------------------------------------===//
+  // Solvers
+  //===--------------------------------------------------------------------===//
+
+  /// In-process branch-and-bound solver.
+  class BuiltinILPSolver : public PatmosILPSolver {
+    unsigned MaxNodes;
+
+    /// A node in the branch-and-bound tree, given by variable bounds.
+    struct BBNode {
+      std::vector<double> Lower, Upper;
+    };
+
+  public:
+    BuiltinILPSolver(unsigned maxNodes) : MaxNodes(maxNodes) {}
+
+    virtual const char *getName() const { return "builtin"; }
+
+    virtual Status solve(StringRef LP, double &Result, std::string &ErrMsg)
+    {
+      std::map<std::string, double> Values;
+      return solve(LP, Result, Values, ErrMsg);
+    }
+
+    virtual Status solve(StringRef LP, double &Result,
+                         std::map<std::string, double> &Values,
+                         std::string &ErrMsg)
+    {
+      LPProblem P;
+      LPParser Parser(P, ErrMsg);
+      if (!Parser.parse(LP))
+        return Failed;
+
+      unsigned n = P.getNumVars();
+
+      // always maximize internally
+      std::vector<double> C(P.Obj);
+      if (!P.Maximize) {
+        for(unsigned j = 0; j < n; j++)
+          C[j] = -C[j];
+      }
+
+      // check whether the objective only takes integral values, which allows
+      // stronger pruning.
+      bool integralObjective = true;
+      for(unsigned j = 0; j < n; j++) {
+        if (C[j] != 0 && (!P.Integer[j] || C[j] != std::floor(C[j])))
+          integralObjective = false;
+      }
+
+      // integer variables have integral bounds
+      std::vector<double> lo(P.Lower), up(P.Upper);
+      for(unsigned j = 0; j < n; j++) {
+        if (P.Integer[j]) {
+          lo[j] = std::ceil(lo[j] - IntEps);
+          up[j] = std::floor(up[j] + IntEps);
+        }
+      }
+
+      std::vector<BBNode> WL(1);
+      WL.back().Lower.swap(lo);
+      WL.back().Upper.swap(up);
+
+      bool haveIncumbent = false;
+      double best = -Inf;
+      std::vector<double> incumbent;
+
+      unsigned nodes = 0;
+      while (!WL.empty()) {
+        if (++nodes > MaxNodes) {
+          ErrMsg = "node limit of branch-and-bound search exceeded";
+          return Failed;
+        }
+
+        BBNode N;
+        N.Lower.swap(WL.back().Lower);
+        N.Upper.swap(WL.back().Upper);
+        WL.pop_back();
+
+        std::vector<double> X;
+        double value;
+        switch (solveRelaxation(P, C, N.Lower, N.Upper, X, value)) {
+          case Optimal:
+            break;
+          case Infeasible:
+            continue;
+          case Unbounded:
+            return Unbounded;
+          case Failed:
+            ErrMsg = "simplex iteration limit exceeded";
+            return Failed;
+        }
+
+        // prune by bound
+        if (haveIncumbent) {
+          double bound = integralObjective ? std::floor(value + IntEps) : value;
+          if (bound <= best + IntEps)
+            continue;
+        }
+
+        // find the most fractional integer variable
+        unsigned branch = n;
+        double maxFrac = IntEps;
+        for(unsigned j = 0; j < n; j++) {
+          if (!P.Integer[j])
+            continue;
+
+          double frac = std::fabs(X[j] - std::floor(X[j] + 0.5));
+          if (frac > maxFrac) {
+            maxFrac = frac;
+            branch = j;
+          }
+        }
+
+        if (branch == n) {
+          // integer solution found
+          haveIncumbent = true;
+          best = value;
+          incumbent.swap(X);
+          continue;
+        }
+
+        // branch: x <= floor(v) and x >= ceil(v), the latter is explored
+        // first.
+        double v = X[branch];
+        WL.push_back(BBNode());
+        WL.back().Lower = N.Lower;
+        WL.back().Upper = N.Upper;
+        WL.back().Upper[branch] = std::floor(v);
+
+        WL.push_back(BBNode());
+        WL.back().Lower.swap(N.Lower);
+        WL.back().Upper.swap(N.Upper);
+        WL.back().Lower[branch] = std::ceil(v);
+      }
+
+      if (!haveIncumbent)
+        return Infeasible;
+
+      // recompute the objective value from the rounded solution
+      Result = P.ObjConst;
+      for(unsigned j = 0; j < n; j++) {
+        double x = P.Integer[j] ? std::floor(incumbent[j] + 0.5) : incumbent[j];
+        Result += P.Obj[j] * x;
+      }
+
+      for(StringMap<unsigned>::const_iterator i = P.Vars.begin(),
+          ie = P.Vars.end(); i != ie; i++) {
+        double x = incumbent[i->second];
+        Values[i->first()] = P.Integer[i->second] ? std::floor(x + 0.5) : x;
+      }
+
+      return Optimal;
+    }
+  };
+
+  /// Solver invoking an external program on a temporary LP file.
+  class ExternalILPSolver : public PatmosILPSolver {
+    std::string Program;
+
+  public:
+    ExternalILPSolver(StringRef program) : Program(program) {}
+
+    virtual const char *getName() const { return Program.c_str(); }
+
+    using PatmosILPSolver::solve;
+
+    virtual Status solve(StringRef LP, double &Result, std::string &ErrMsg)
+    {
+      // write LP file.
+      SmallString<1024> LPdir;
+      error_code err = sys::fs::createUniqueDirectory("stack", LPdir);
+      if (err) {
+        ErrMsg = "Error creating temp .lp file: " + err.message();
+        return Failed;
+      }
+
+      SmallString<1024> LPname(LPdir);
+      sys::path::append(LPname, "scc.lp");
+
+      {
+        raw_fd_ostream OS(LPname.c_str(), ErrMsg);
+        if (!ErrMsg.empty()) {
+          ErrMsg = "Failed to open file '" + LPname.str().str() +
+                   "' for writing: " + ErrMsg;
+          return Failed;
+        }
+
+        OS << LP;
+      }
+
+      // call the solver
+      std::vector<const char*> args;
+      args.push_back(Program.c_str());
+      args.push_back(LPname.c_str());
+      args.push_back(0);
+
+      Status status = Optimal;
+      if (sys::ExecuteAndWait(sys::FindProgramByName(Program),
+                              &args[0],0,0,0,0,&ErrMsg)) {
+        ErrMsg = "calling ILP solver (" + Program + "): " + ErrMsg;
+        status = Failed;
+      }
+      else {
+        // read solution
+        std::string SOLname(LPname.str().str());
+        SOLname += ".sol";
+
+        if (!sys::fs::exists(SOLname)) {
+          ErrMsg = "Failed to read ILP solution";
+          status = Failed;
+        }
+        else {
+          std::ifstream IS(SOLname.c_str());
+
+          // read the result value
+          double tmp = -1.;
+          IS >> tmp;
+          IS.close();
+
+          // the solver does not distinguish infeasible and unbounded problems
+          if (tmp == -1.)
+            status = Infeasible;
+          else
+            Result = tmp;
+
+          sys::fs::remove(SOLname);
+        }
+      }
+
+      sys::fs::remove(LPname.str());
+      sys::fs::remove(LPdir.str());
+
+      return status;
+    }
+  };
+}
+
+namespace llvm {
+  std::string getPatmosLPHash(StringRef LP) {
+    MD5 Hash;
+
+    LPProblem P;
+    std::string ErrMsg;
+    LPParser Parser(P, ErrMsg);
+    if (!Parser.parse(LP)) {
+      // fall back to the plain text
+      Hash.update(LP);
+    }
+    else {
+      // get variable names in sorted order
+      unsigned n = P.getNumVars();
+      std::vector<StringRef> names(n);
+      for(StringMap<unsigned>::const_iterator i(P.Vars.begin()),
+          ie(P.Vars.end()); i != ie; i++) {
+        names[i->second] = i->getKey();
+      }
+
+      std::vector<std::pair<StringRef, unsigned> > order;
+      for(unsigned j = 0; j < n; j++)
+        order.push_back(std::make_pair(names[j], j));
+      std::sort(order.begin(), order.end());
+
+      // print a canonical representation of the problem
+      std::string tmps;
+      raw_string_ostream tmp(tmps);
+
+      tmp << (P.Maximize ? "max " : "min ") << format("%.17g", P.ObjConst);
+      for(unsigned k = 0; k < n; k++) {
+        unsigned j = order[k].second;
+        tmp << "\n" << names[j] << " " << format("%.17g", P.Obj[j]) << " "
+            << format("%.17g", P.Lower[j]) << " "
+            << format("%.17g", P.Upper[j]) << " " << P.Integer[j];
+      }
+
+      std::vector<std::string> rows;
+      for(unsigned i = 0, ie = P.Rows.size(); i < ie; i++) {
+        const LPRow &R = P.Rows[i];
+
+        std::vector<std::pair<StringRef, double> > terms;
+        for(unsigned k = 0, ke = R.Coeffs.size(); k < ke; k++)
+          terms.push_back(std::make_pair(names[R.Coeffs[k].first],
+                                         R.Coeffs[k].second));
+        std::sort(terms.begin(), terms.end());
+
+        std::string rowstr;
+        raw_string_ostream row(rowstr);
+        for(unsigned k = 0, ke = terms.size(); k < ke; k++)
+          row << format("%.17g", terms[k].second) << " " << terms[k].first
+              << " ";
+        row << (R.Rel == LPRow::LE ? "<=" : R.Rel == LPRow::GE ? ">=" : "=")
+            << " " << format("%.17g", R.RHS);
+        rows.push_back(row.str());
+      }
+      std::sort(rows.begin(), rows.end());
+
+      for(unsigned i = 0, ie = rows.size(); i < ie; i++)
+        tmp << "\n" << rows[i];
+
+      Hash.update(tmp.str());
+    }
+
+    MD5::MD5Result Result;
+    Hash.final(Result);
+
+    SmallString<32> Str;
+    MD5::stringifyResult(Result, Str);
+    return Str.str();
+  }
+
+  PatmosILPSolver *createPatmosBuiltinILPSolver(unsigned MaxNodes) {
+    return new BuiltinILPSolver(MaxNodes);
+  }
+
+  PatmosILPSolver *createPatmosExternalILPSolver(StringRef Program) {
+    return new ExternalILPSolver(Program);
+  }
+}
@@ -0,0 +1,89 @@
+//===-- PatmosILPSolver.h - ILP solvers for Patmos analyses -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Interface to solvers for integer linear programs (ILPs) as used by the
+// Patmos analyses, e.g., the stack cache analysis.
+//
+// Problems are handed to a solver in the (CPLEX) LP text format. Two solvers
+// are available: a built-in branch-and-bound solver on top of a dense simplex,
+// which is intended for the small problems constructed per call graph SCC, and
+// a wrapper around an external solver program (see -mpatmos-ilp-solver).
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _PATMOS_ILPSOLVER_H_
+#define _PATMOS_ILPSOLVER_H_
+
+#include "llvm/ADT/StringRef.h"
+
+#include <map>
+#include <string>
+
+namespace llvm {
+
+  /// Abstract interface of an ILP solver.
+  class PatmosILPSolver {
+  public:
+    /// Outcome of solving an ILP.
+    enum Status {
+      /// An optimal solution was found.
+      Optimal,
+      /// The problem has no integer solution.
+      Infeasible,
+      /// The objective function is not bounded.
+      Unbounded,
+      /// The solver was not able to handle the problem, e.g., due to
+      /// unsupported input or resource limits.
+      Failed
+    };
+
+    virtual ~PatmosILPSolver() {}
+
+    /// getName - Return a name of the solver for diagnostics.
+    virtual const char *getName() const = 0;
+
+    /// solve - Solve the ILP given in LP format. On success, the optimal value
+    /// of the objective function is stored in Result. On failure, ErrMsg may
+    /// contain a description of the problem.
+    /// Solvers do not keep state between calls, i.e., solve may be called
+    /// concurrently from several threads.
+    virtual Status solve(StringRef LP, double &Result, std::string &ErrMsg) = 0;
+
+    /// solve - Solve the ILP as above, and additionally store the values of
+    /// the variables in the optimal solution in Values. Solvers that are not
+    /// able to report the solution leave Values empty.
+    virtual Status solve(StringRef LP, double &Result,
+                         std::map<std::string, double> &Values,
+                         std::string &ErrMsg)
+    {
+      return solve(LP, Result, ErrMsg);
+    }
+  };
+
+  /// getPatmosLPHash - Compute a content hash (as hex string) of an ILP given
+  /// in LP format. The hash does not depend on comments, constraint labels,
+  /// nor on the order of terms, constraints, and variable declarations, i.e.,
+  /// equivalent problems generated in different orders have the same hash.
+  std::string getPatmosLPHash(StringRef LP);
+
+  /// createPatmosBuiltinILPSolver - Create an in-process branch-and-bound
+  /// solver. The solver gives up (returning Failed) after exploring MaxNodes
+  /// nodes of the branch-and-bound tree.
+  PatmosILPSolver *createPatmosBuiltinILPSolver(unsigned MaxNodes = 100000);
+
+  /// createPatmosExternalILPSolver - Create a solver invoking an external
+  /// program. The program is expected to take the name of an LP file as its
+  /// only argument and to write the objective value of the integer solution to
+  /// a file with the same name and the suffix .sol appended (-1 if the problem
+  /// could not be solved).
+  PatmosILPSolver *createPatmosExternalILPSolver(StringRef Program);
+
+} // End llvm namespace
+
+#endif // _PATMOS_ILPSOLVER_H_
@@ -62,6 +62,9 @@ namespace {
     // NB: not used currently
     SDNode *SelectABSPattern(SDNode *N);
 
+    // Load a float immediate as integer immediate
+    SDNode *SelectConstantFP(SDNode *N);
+
     // These functions create a predicate operand from an i1 value
     bool SelectPred(SDValue N, SDValue &Reg, SDValue &Inv);
     bool SelectPredInv(SDValue N, SDValue &Reg, SDValue &Inv);
@@ -93,6 +96,7 @@ SDNode *PatmosDAGToDAGISel::Select(SDNode *Node) {
   }
   */
   //case ISD::BRCOND:   return SelectBRCOND(Node);
+  case ISD::ConstantFP: return SelectConstantFP(Node);
   default: break;
   }
   // autogenerated
@@ -153,6 +157,33 @@ SDNode *PatmosDAGToDAGISel::SelectABSPattern(SDNode *N){
 }
 
 
+/// Floats are kept in general purpose registers, a float immediate is thus
+/// loaded by loading its bit pattern like an integer immediate.
+SDNode *PatmosDAGToDAGISel::SelectConstantFP(SDNode *N) {
+  ConstantFPSDNode *CFP = cast<ConstantFPSDNode>(N);
+  assert(N->getValueType(0) == MVT::f32 && Subtarget.hasFPU());
+
+  uint64_t Bits = CFP->getValueAPF().bitcastToAPInt().getZExtValue();
+  SDLoc dl(N);
+
+  SDValue Val;
+  if (Bits == 0) {
+    Val = CurDAG->getCopyFromReg(CurDAG->getEntryNode(), dl, Patmos::R0,
+                                 MVT::i32);
+  } else {
+    SDValue Ops[] = { CurDAG->getRegister(Patmos::NoRegister, MVT::i1),
+                      CurDAG->getTargetConstant(0, MVT::i1),
+                      CurDAG->getTargetConstant(Bits, MVT::i32) };
+    unsigned Opc = isUInt<12>(Bits) ? Patmos::LIi : Patmos::LIl;
+    Val = SDValue(CurDAG->getMachineNode(Opc, dl, MVT::i32, Ops), 0);
+  }
+
+  SDValue RC = CurDAG->getTargetConstant(Patmos::FRegsRegClassID, MVT::i32);
+  return CurDAG->SelectNodeTo(N, TargetOpcode::COPY_TO_REGCLASS, MVT::f32,
+                              Val, RC);
+}
+
+
 // XXX is not used currently, as matching is done by an appropriate pattern
 SDNode *PatmosDAGToDAGISel::SelectBRCOND(SDNode *N) {
   assert(N->getNumOperands() >= 3);
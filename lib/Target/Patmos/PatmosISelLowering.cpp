@@ -48,6 +48,9 @@ PatmosTargetLowering::PatmosTargetLowering(PatmosTargetMachine &tm) :
   // SRegs are not used for computations.
   addRegisterClass(MVT::i32, &Patmos::RRegsRegClass);
   addRegisterClass(MVT::i1,  &Patmos::PRegsRegClass);
+  // Without an FPU, floats are handled by soft-float library calls.
+  if (Subtarget.hasFPU())
+    addRegisterClass(MVT::f32, &Patmos::FRegsRegClass);
 
   // Compute derived properties from the register classes
   computeRegisterProperties();
@@ -183,7 +186,38 @@ PatmosTargetLowering::PatmosTargetLowering(PatmosTargetMachine &tm) :
 
   setOperationAction(ISD::PCMARKER,  MVT::Other, Expand);
   setOperationAction(ISD::LOOPBOUND, MVT::Other, Legal);
-  // TODO expand floating point stuff?
+
+  if (Subtarget.hasFPU()) {
+    // floats are loaded, stored and moved as i32
+    setOperationAction(ISD::LOAD,  MVT::f32, Promote);
+    AddPromotedToType (ISD::LOAD,  MVT::f32, MVT::i32);
+    setOperationAction(ISD::STORE, MVT::f32, Promote);
+    AddPromotedToType (ISD::STORE, MVT::f32, MVT::i32);
+    // float immediates are loaded like integers, see
+    // PatmosDAGToDAGISel::SelectConstantFP
+    setOperationAction(ISD::ConstantFP, MVT::f32, Legal);
+
+    setOperationAction(ISD::SELECT_CC, MVT::f32, Expand);
+    setOperationAction(ISD::BR_CC,     MVT::f32, Expand);
+
+    // conversions from/to i1 go through i32
+    setOperationAction(ISD::SINT_TO_FP, MVT::i1, Promote);
+    setOperationAction(ISD::UINT_TO_FP, MVT::i1, Promote);
+    setOperationAction(ISD::FP_TO_SINT, MVT::i1, Promote);
+    setOperationAction(ISD::FP_TO_UINT, MVT::i1, Promote);
+
+    // the FPU only supports the basic arithmetic operations
+    setOperationAction(ISD::FCOPYSIGN, MVT::f32, Expand);
+    setOperationAction(ISD::FMA,       MVT::f32, Expand);
+    setOperationAction(ISD::FREM,      MVT::f32, Expand);
+    setOperationAction(ISD::FSIN,      MVT::f32, Expand);
+    setOperationAction(ISD::FCOS,      MVT::f32, Expand);
+    setOperationAction(ISD::FSINCOS,   MVT::f32, Expand);
+    setOperationAction(ISD::FPOW,      MVT::f32, Expand);
+    setOperationAction(ISD::FPOWI,     MVT::f32, Expand);
+    setOperationAction(ISD::FP16_TO_FP32, MVT::f32, Expand);
+    setOperationAction(ISD::FP32_TO_FP16, MVT::i16, Expand);
+  }
 }
 
 
@@ -203,6 +237,12 @@ SDValue PatmosTargetLowering::LowerOperation(SDValue Op,
   }
 }
 
+bool PatmosTargetLowering::isFPImmLegal(const APFloat &Imm, EVT VT) const
+{
+  // Any single precision immediate can be loaded as integer immediate.
+  return VT == MVT::f32 && Subtarget.hasFPU();
+}
+
 EVT PatmosTargetLowering::getSetCCResultType(LLVMContext &Context, EVT VT) const
 {
   // All our compare results should be i1
@@ -426,7 +466,9 @@ PatmosTargetLowering::LowerCCCArguments(SDValue Chain,
           ArgValue = DAG.getNode(ISD::AssertZext, dl, RegVT, ArgValue,
                                  DAG.getValueType(VA.getValVT()));
 
-        if (VA.getLocInfo() != CCValAssign::Full)
+        if (VA.getLocInfo() == CCValAssign::BCvt)
+          ArgValue = DAG.getNode(ISD::BITCAST, dl, VA.getValVT(), ArgValue);
+        else if (VA.getLocInfo() != CCValAssign::Full)
           ArgValue = DAG.getNode(ISD::TRUNCATE, dl, VA.getValVT(), ArgValue);
 
         InVals.push_back(ArgValue);
@@ -450,9 +492,12 @@ PatmosTargetLowering::LowerCCCArguments(SDValue Chain,
       // Create the SelectionDAG nodes corresponding to a load
       //from this parameter
       SDValue FIN = DAG.getFrameIndex(FI, MVT::i32);
-      InVals.push_back(DAG.getLoad(VA.getLocVT(), dl, Chain, FIN,
-                                   MachinePointerInfo::getFixedStack(FI),
-                                   false, false, 0, 0));
+      SDValue ArgValue = DAG.getLoad(VA.getLocVT(), dl, Chain, FIN,
+                                     MachinePointerInfo::getFixedStack(FI),
+                                     false, false, 0, 0);
+      if (VA.getLocInfo() == CCValAssign::BCvt)
+        ArgValue = DAG.getNode(ISD::BITCAST, dl, VA.getValVT(), ArgValue);
+      InVals.push_back(ArgValue);
     }
   }
 
@@ -495,8 +540,11 @@ PatmosTargetLowering::LowerReturn(SDValue Chain,
     CCValAssign &VA = RVLocs[i];
     assert(VA.isRegLoc() && "Can only return in registers!");
 
-    Chain = DAG.getCopyToReg(Chain, dl, VA.getLocReg(),
-                             OutVals[i], Flag);
+    SDValue Val = OutVals[i];
+    if (VA.getLocInfo() == CCValAssign::BCvt)
+      Val = DAG.getNode(ISD::BITCAST, dl, VA.getLocVT(), Val);
+
+    Chain = DAG.getCopyToReg(Chain, dl, VA.getLocReg(), Val, Flag);
 
     // Guarantee that all emitted copies are stuck together,
     // avoiding something bad.
@@ -571,6 +619,9 @@ PatmosTargetLowering::LowerCCCCallTo(CallLoweringInfo &CLI,
       case CCValAssign::AExt:
         Arg = DAG.getNode(ISD::ANY_EXTEND, dl, VA.getLocVT(), Arg);
         break;
+      case CCValAssign::BCvt:
+        Arg = DAG.getNode(ISD::BITCAST, dl, VA.getLocVT(), Arg);
+        break;
     }
 
     // Arguments that can be passed on register must be kept at RegsToPass
@@ -689,7 +740,11 @@ PatmosTargetLowering::LowerCallResult(SDValue Chain, SDValue InFlag,
     Chain = DAG.getCopyFromReg(Chain, dl, RVLocs[i].getLocReg(),
                                MVT::i32, InFlag).getValue(1);
     InFlag = Chain.getValue(2);
-    InVals.push_back(Chain.getValue(0));
+
+    SDValue Val = Chain.getValue(0);
+    if (RVLocs[i].getLocInfo() == CCValAssign::BCvt)
+      Val = DAG.getNode(ISD::BITCAST, dl, RVLocs[i].getValVT(), Val);
+    InVals.push_back(Val);
   }
 
   return Chain;
@@ -62,6 +62,9 @@ namespace llvm {
 
     virtual EVT getSetCCResultType(LLVMContext &Context, EVT VT) const;
 
+    /// isFPImmLegal - Float immediates are legal if there is an FPU.
+    virtual bool isFPImmLegal(const APFloat &Imm, EVT VT) const;
+
     virtual unsigned getByValTypeAlignment(Type *Ty) const LLVM_OVERRIDE {
       // Align any type passed by value on the stack to words
       return 4;
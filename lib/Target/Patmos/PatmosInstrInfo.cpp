@@ -50,6 +50,8 @@ bool PatmosInstrInfo::findCommutedOpIndices(MachineInstr *MI,
     case Patmos::ANDr: case Patmos::ANDr_ow:
     case Patmos::XORr: case Patmos::XORr_ow:
     case Patmos::NORr: case Patmos::NORr_ow:
+    case Patmos::FADDS:
+    case Patmos::FMULS:
       SrcOpIdx1 = 3;
       SrcOpIdx2 = 4;
       return true;
@@ -120,7 +122,8 @@ storeRegToStackSlot(MachineBasicBlock &MBB, MachineBasicBlock::iterator MI,
                           MFI.getObjectSize(FrameIdx),
                           MFI.getObjectAlignment(FrameIdx));
 
-  if (RC == &Patmos::RRegsRegClass) {
+  // Floats are kept in general purpose registers, spill them as words.
+  if (RC == &Patmos::RRegsRegClass || RC == &Patmos::FRegsRegClass) {
     AddDefaultPred(BuildMI(MBB, MI, DL, get(Patmos::SWC)))
       .addFrameIndex(FrameIdx).addImm(0) // address
       .addReg(SrcReg, getKillRegState(isKill)) // value to store
@@ -157,7 +160,7 @@ loadRegFromStackSlot(MachineBasicBlock &MBB, MachineBasicBlock::iterator MI,
   DebugLoc DL;
   if (MI != MBB.end()) DL = MI->getDebugLoc();
 
-  if (RC == &Patmos::RRegsRegClass) {
+  if (RC == &Patmos::RRegsRegClass || RC == &Patmos::FRegsRegClass) {
     AddDefaultPred(BuildMI(MBB, MI, DL, get(Patmos::LWC), DestReg))
       .addFrameIndex(FrameIdx).addImm(0); // address
   }
@@ -550,6 +553,32 @@ PatmosII::MemType PatmosInstrInfo::getMemType(const MachineInstr *MI) const {
 
 }
 
+unsigned PatmosInstrInfo::getMemTypeOpcode(unsigned Opcode,
+                                           PatmosII::MemType MT) const
+{
+  using namespace Patmos;
+  // Typed loads and stores, indexed by their memory type.
+  static const unsigned Opcodes[][4] = {
+    //  MEM_S  MEM_L  MEM_C  MEM_M
+    {   LWS,   LWL,   LWC,   LWM  },
+    {   LHS,   LHL,   LHC,   LHM  },
+    {   LBS,   LBL,   LBC,   LBM  },
+    {   LHUS,  LHUL,  LHUC,  LHUM },
+    {   LBUS,  LBUL,  LBUC,  LBUM },
+    {   SWS,   SWL,   SWC,   SWM  },
+    {   SHS,   SHL,   SHC,   SHM  },
+    {   SBS,   SBL,   SBC,   SBM  }
+  };
+
+  for (unsigned i = 0; i < array_lengthof(Opcodes); i++) {
+    for (unsigned j = 0; j < 4; j++) {
+      if (Opcodes[i][j] == Opcode)
+        return Opcodes[i][MT];
+    }
+  }
+  return 0;
+}
+
 bool PatmosInstrInfo::isPseudo(const MachineInstr *MI) const {
 
   if (MI->isBundle()) {
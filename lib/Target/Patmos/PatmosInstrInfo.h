@@ -299,6 +299,11 @@ public:
   /// MI must be either a load or a store instruction.
   PatmosII::MemType getMemType(const MachineInstr *MI) const;
 
+  /// getMemTypeOpcode - Return the opcode of the load or store that performs
+  /// the same access as the typed load or store Opcode, but to the given
+  /// memory type. Returns 0 if Opcode is not a typed load or store.
+  unsigned getMemTypeOpcode(unsigned Opcode, PatmosII::MemType MT) const;
+
   /// isPseudo - check if the given machine instruction is emitted, i.e.,
   /// if the instruction is either inline asm or has some FU assigned to it.
   bool isPseudo(const MachineInstr *MI) const;
@@ -0,0 +1,379 @@
+//===-- PatmosLoopBoundInference.cpp - Infer loop bounds from SCEV. -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass derives loop bounds from ScalarEvolution and attaches them as
+// llvm.loop.bound metadata to the terminator of the loop header, where
+// single-path code generation, the scratchpad allocation, the cache bypass
+// selection and the PML export look for them (see getLoopBounds).
+//
+// The bound is the maximum backedge-taken count of the loop. If ScalarEvolution
+// only finds a symbolic trip count, it is bounded by the ranges of its operands,
+// using the range metadata of loaded values and conditions on the values that
+// guard the entry of the loop. The minimum bound is only known if the trip
+// count is constant.
+//
+// Inferred bounds are marked with an llvm.loop.bound.inferred entry in the loop
+// metadata (see isInferredLoopBound).
+//
+// Existing bounds are only tightened, a user annotation that is smaller than
+// the inferred bound is kept. Bounds that exceed -mpatmos-max-inferred-loop-bound
+// are not attached, they usually only reflect the range of the type of the
+// induction variable.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "patmos-loop-bounds"
+
+#include "Patmos.h"
+#include "PatmosTargetMachine.h"
+#include "PatmosUtil.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ConstantRange.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <set>
+
+using namespace llvm;
+
+STATISTIC(NumInferredBounds,  "Number of loop bounds inferred from SCEV");
+STATISTIC(NumTightenedBounds, "Number of annotated loop bounds tightened");
+
+static cl::opt<bool> DisableLoopBoundInference(
+  "mpatmos-disable-loop-bound-inference",
+  cl::init(false),
+  cl::desc("Do not infer loop bounds from scalar evolution."),
+  cl::Hidden);
+
+static cl::opt<unsigned> MaxInferredLoopBound(
+  "mpatmos-max-inferred-loop-bound",
+  cl::init(65536),
+  cl::desc("Maximum loop bound that is attached to a loop by the loop bound "
+           "inference. (default: 65536)"),
+  cl::Hidden);
+
+/// MaxGuardCandidates - Maximum number of constants from conditions that are
+/// tried as bounds of a symbolic trip count per loop.
+static const unsigned MaxGuardCandidates = 32;
+
+namespace {
+  class PatmosLoopBoundInference : public FunctionPass {
+  private:
+    ScalarEvolution *SE;
+
+    DominatorTree *DT;
+
+    static char ID;
+  public:
+    PatmosLoopBoundInference() : FunctionPass(ID), SE(0), DT(0) {
+      initializeLoopInfoPass(*PassRegistry::getPassRegistry());
+      initializeScalarEvolutionPass(*PassRegistry::getPassRegistry());
+      initializeDominatorTreePass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual const char *getPassName() const {
+      return "Patmos Loop Bound Inference";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<ScalarEvolution>();
+      AU.addRequired<DominatorTree>();
+      AU.setPreservesAll();
+    }
+
+    virtual bool runOnFunction(Function &F);
+
+  private:
+    /// inferLoopBound - Infer the bound of a loop and its subloops and update
+    /// the metadata of the loop header.
+    bool inferLoopBound(Loop *L);
+
+    /// getMaxBackedgeTakenCount - Get an upper bound of the number of times
+    /// the backedges of the loop are taken, or false if there is none.
+    bool getMaxBackedgeTakenCount(Loop *L, uint64_t &Max);
+
+    /// getRange - Get the range of the values of a SCEV, intersecting the
+    /// ranges computed by ScalarEvolution with the range metadata of loaded
+    /// values.
+    ConstantRange getRange(const SCEV *S);
+
+    /// getGuardBound - Get the smallest constant C such that the entry of the
+    /// loop is guarded by Count <= C, trying the constants of the compares
+    /// that dominate the loop.
+    bool getGuardBound(Loop *L, const SCEV *Count, uint64_t &Max);
+
+    /// setLoopBound - Attach the bounds to the terminator of the loop header,
+    /// replacing an existing llvm.loop.bound entry, and mark them with an
+    /// llvm.loop.bound.inferred entry.
+    void setLoopBound(Loop *L, uint64_t Min, uint64_t Max);
+  };
+
+  char PatmosLoopBoundInference::ID = 0;
+}
+
+/// createPatmosLoopBoundInferencePass - Returns a new pass that attaches loop
+/// bounds derived from scalar evolution to the loops.
+FunctionPass *llvm::createPatmosLoopBoundInferencePass() {
+  return new PatmosLoopBoundInference();
+}
+
+bool PatmosLoopBoundInference::runOnFunction(Function &F) {
+  if (DisableLoopBoundInference) return false;
+
+  LoopInfo &LI = getAnalysis<LoopInfo>();
+  SE = &getAnalysis<ScalarEvolution>();
+  DT = &getAnalysis<DominatorTree>();
+
+  bool Changed = false;
+  for (LoopInfo::iterator i = LI.begin(), ie = LI.end(); i != ie; i++) {
+    Changed |= inferLoopBound(*i);
+  }
+  return Changed;
+}
+
+bool PatmosLoopBoundInference::inferLoopBound(Loop *L) {
+  bool Changed = false;
+  for (Loop::iterator i = L->begin(), ie = L->end(); i != ie; i++) {
+    Changed |= inferLoopBound(*i);
+  }
+
+  BasicBlock *Header = L->getHeader();
+  if (!Header->getTerminator())
+    return Changed;
+
+  uint64_t Max;
+  if (!getMaxBackedgeTakenCount(L, Max) || Max > MaxInferredLoopBound)
+    return Changed;
+
+  // The minimum is only known for loops with a constant trip count.
+  uint64_t Min = 0;
+  if (const SCEVConstant *Count =
+                     dyn_cast<SCEVConstant>(SE->getBackedgeTakenCount(L))) {
+    Min = Count->getValue()->getLimitedValue();
+  }
+
+  std::pair<int,int> Bounds = getLoopBounds(Header);
+  bool Annotated = Bounds.second != -1;
+  if (Annotated) {
+    if ((uint64_t)Bounds.second <= Max)
+      return Changed;
+
+    Min = std::max(Min, (uint64_t)std::max(Bounds.first, 0));
+    Min = std::min(Min, Max);
+  }
+
+  DEBUG(dbgs() << "Loop bound of " << Header->getParent()->getName() << ":"
+               << Header->getName() << ": [" << Min << ", " << Max << "]"
+               << (Annotated ? " (tightened)\n" : "\n"));
+
+  setLoopBound(L, Min, Max);
+
+  if (Annotated)
+    NumTightenedBounds++;
+  else
+    NumInferredBounds++;
+
+  return true;
+}
+
+bool PatmosLoopBoundInference::getMaxBackedgeTakenCount(Loop *L,
+                                                        uint64_t &Max)
+{
+  bool Found = false;
+
+  const SCEV *MaxCount = SE->getMaxBackedgeTakenCount(L);
+  if (const SCEVConstant *C = dyn_cast<SCEVConstant>(MaxCount)) {
+    Max = C->getValue()->getLimitedValue();
+    Found = true;
+  }
+
+  const SCEV *Count = SE->getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(Count) || isa<SCEVConstant>(Count))
+    return Found;
+
+  ConstantRange Range = getRange(Count);
+  if (!Range.isFullSet() && !Range.isEmptySet()) {
+    uint64_t RangeMax = Range.getUnsignedMax().getLimitedValue();
+    Max = Found ? std::min(Max, RangeMax) : RangeMax;
+    Found = true;
+  }
+
+  uint64_t GuardMax;
+  if (getGuardBound(L, Count, GuardMax) && (!Found || GuardMax < Max)) {
+    Max = GuardMax;
+    Found = true;
+  }
+
+  return Found;
+}
+
+ConstantRange PatmosLoopBoundInference::getRange(const SCEV *S) {
+  ConstantRange Range = SE->getUnsignedRange(S).intersectWith(
+                                                       SE->getSignedRange(S));
+  unsigned BitWidth = Range.getBitWidth();
+
+  if (const SCEVUnknown *U = dyn_cast<SCEVUnknown>(S)) {
+    const Instruction *I = dyn_cast<Instruction>(U->getValue());
+    MDNode *MD = I ? I->getMetadata(LLVMContext::MD_range) : 0;
+    if (MD) {
+      ConstantRange MDRange(BitWidth, false);
+      for (unsigned i = 0, e = MD->getNumOperands() / 2; i != e; i++) {
+        ConstantInt *Lo = cast<ConstantInt>(MD->getOperand(2 * i));
+        ConstantInt *Hi = cast<ConstantInt>(MD->getOperand(2 * i + 1));
+        MDRange = MDRange.unionWith(ConstantRange(Lo->getValue(),
+                                                  Hi->getValue()));
+      }
+      Range = Range.intersectWith(MDRange);
+    }
+  }
+  else if (const SCEVZeroExtendExpr *ZExt = dyn_cast<SCEVZeroExtendExpr>(S)) {
+    Range = Range.intersectWith(
+                        getRange(ZExt->getOperand()).zeroExtend(BitWidth));
+  }
+  else if (const SCEVSignExtendExpr *SExt = dyn_cast<SCEVSignExtendExpr>(S)) {
+    Range = Range.intersectWith(
+                        getRange(SExt->getOperand()).signExtend(BitWidth));
+  }
+  else if (const SCEVTruncateExpr *Trunc = dyn_cast<SCEVTruncateExpr>(S)) {
+    Range = Range.intersectWith(
+                        getRange(Trunc->getOperand()).truncate(BitWidth));
+  }
+  else if (const SCEVUDivExpr *UDiv = dyn_cast<SCEVUDivExpr>(S)) {
+    Range = Range.intersectWith(
+                        getRange(UDiv->getLHS()).udiv(getRange(UDiv->getRHS())));
+  }
+  else if (const SCEVNAryExpr *NAry = dyn_cast<SCEVNAryExpr>(S)) {
+    // Recurrences are not evaluated, their value depends on the iteration.
+    if (isa<SCEVAddRecExpr>(NAry))
+      return Range;
+
+    ConstantRange OpRange = getRange(NAry->getOperand(0));
+    for (unsigned i = 1, e = NAry->getNumOperands(); i != e; i++) {
+      ConstantRange R = getRange(NAry->getOperand(i));
+      switch (NAry->getSCEVType()) {
+      case scAddExpr:  OpRange = OpRange.add(R);      break;
+      case scMulExpr:  OpRange = OpRange.multiply(R); break;
+      case scSMaxExpr: OpRange = OpRange.smax(R);     break;
+      case scUMaxExpr: OpRange = OpRange.umax(R);     break;
+      default: llvm_unreachable("Unknown n-ary SCEV expression.");
+      }
+    }
+    Range = Range.intersectWith(OpRange);
+  }
+
+  return Range;
+}
+
+bool PatmosLoopBoundInference::getGuardBound(Loop *L, const SCEV *Count,
+                                             uint64_t &Max)
+{
+  Type *Ty = Count->getType();
+  if (!Ty->isIntegerTy())
+    return false;
+  unsigned BitWidth = Ty->getIntegerBitWidth();
+
+  // Collect the constants compared in the blocks that dominate the loop,
+  // plus-minus one for strict comparisons and off-by-one trip counts.
+  std::set<uint64_t> Candidates;
+  for (DomTreeNode *N = DT->getNode(L->getHeader())->getIDom(); N;
+       N = N->getIDom())
+  {
+    BranchInst *BI = dyn_cast<BranchInst>(N->getBlock()->getTerminator());
+    if (!BI || !BI->isConditional())
+      continue;
+
+    ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+    if (!Cmp)
+      continue;
+
+    for (unsigned i = 0; i < 2; i++) {
+      ConstantInt *C = dyn_cast<ConstantInt>(Cmp->getOperand(i));
+      if (!C || C->getValue().isNegative())
+        continue;
+
+      uint64_t V = C->getValue().getLimitedValue();
+      if (V > MaxInferredLoopBound + 1)
+        continue;
+
+      if (V > 0) Candidates.insert(V - 1);
+      Candidates.insert(V);
+      Candidates.insert(V + 1);
+    }
+  }
+
+  unsigned Tried = 0;
+  for (std::set<uint64_t>::iterator i = Candidates.begin(),
+       ie = Candidates.end(); i != ie && Tried < MaxGuardCandidates; i++)
+  {
+    if (!isUIntN(BitWidth, *i))
+      break;
+
+    Tried++;
+    if (SE->isLoopEntryGuardedByCond(L, ICmpInst::ICMP_ULE, Count,
+                                     SE->getConstant(Ty, *i)))
+    {
+      Max = *i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void PatmosLoopBoundInference::setLoopBound(Loop *L, uint64_t Min,
+                                            uint64_t Max)
+{
+  TerminatorInst *TI = L->getHeader()->getTerminator();
+  LLVMContext &Ctx = TI->getContext();
+  Type *Int32Ty = Type::getInt32Ty(Ctx);
+
+  Value *BoundOps[] = { MDString::get(Ctx, "llvm.loop.bound"),
+                        ConstantInt::get(Int32Ty, Min),
+                        ConstantInt::get(Int32Ty, Max) };
+  MDNode *Bound = MDNode::get(Ctx, BoundOps);
+
+  // Mark the bound as inferred, so it is not exported as a user annotation.
+  Value *InferredOps[] = { MDString::get(Ctx, "llvm.loop.bound.inferred") };
+  MDNode *Inferred = MDNode::get(Ctx, InferredOps);
+
+  // Keep all other entries of the loop metadata. The first operand is a
+  // self-reference, which is replaced once the node is created.
+  MDNode *Dummy = MDNode::getTemporary(Ctx, None);
+  SmallVector<Value*, 4> Ops;
+  Ops.push_back(Dummy);
+  if (MDNode *LoopID = TI->getMetadata("llvm.loop")) {
+    for (unsigned i = 1, e = LoopID->getNumOperands(); i < e; i++) {
+      MDNode *Op = dyn_cast_or_null<MDNode>(LoopID->getOperand(i));
+      MDString *Name = Op && Op->getNumOperands() > 0 ?
+                       dyn_cast_or_null<MDString>(Op->getOperand(0)) : 0;
+      if (!Name || (Name->getString() != "llvm.loop.bound" &&
+                    Name->getString() != "llvm.loop.bound.inferred"))
+        Ops.push_back(LoopID->getOperand(i));
+    }
+  }
+  Ops.push_back(Bound);
+  Ops.push_back(Inferred);
+
+  MDNode *NewLoopID = MDNode::get(Ctx, Ops);
+  NewLoopID->replaceOperandWith(0, NewLoopID);
+  MDNode::deleteTemporary(Dummy);
+
+  TI->setMetadata("llvm.loop", NewLoopID);
+}
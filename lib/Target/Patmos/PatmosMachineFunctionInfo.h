@@ -94,6 +94,10 @@ class PatmosMachineFunctionInfo : public MachineFunctionInfo {
   /// True if this function is to be single-path converted
   bool SinglePathConvert;
 
+  /// True if this single-path function is always called with an enabled
+  /// predicate, i.e., it does not need the predicate of its callers.
+  bool SinglePathUnconditional;
+
   /// FIs created for SinglePath conversion
   /// | LoopCnts | S0Spills | ExcessSpills |
   std::vector<int> SinglePathFIs;
@@ -111,6 +115,10 @@ class PatmosMachineFunctionInfo : public MachineFunctionInfo {
   /// method cache.
   std::set<const MachineBasicBlock*> MethodCacheRegionEntries;
 
+  /// Preferred maximum size of subfunctions for this function, overriding
+  /// the global option of the function splitter if not 0.
+  unsigned PreferredSubfunctionSize;
+
   /// Store analysis results per function.
   PatmosAnalysisInfo AnalysisInfo;
 
@@ -120,8 +128,9 @@ public:
   explicit PatmosMachineFunctionInfo(MachineFunction &MF) :
     StackCacheReservedBytes(0), StackReservedBytes(0), VarArgsFI(0),
     RegScavengingFI(0), S0SpillReg(0),
-    SinglePathConvert(false), SPS0SpillOffset(0), SPExcessSpillOffset(0),
-    SPCallSpillOffset(0)
+    SinglePathConvert(false), SinglePathUnconditional(false),
+    SPS0SpillOffset(0), SPExcessSpillOffset(0),
+    SPCallSpillOffset(0), PreferredSubfunctionSize(0)
     {}
 
   /// getStackCacheReservedBytes - Get the number of bytes reserved on the
@@ -200,6 +209,18 @@ public:
     return MethodCacheRegionEntries.find(MBB) != MethodCacheRegionEntries.end();
   }
 
+  /// getPreferredSubfunctionSize - Return the preferred maximum size of
+  /// subfunctions of this function, or 0 if not set.
+  unsigned getPreferredSubfunctionSize() const {
+    return PreferredSubfunctionSize;
+  }
+
+  /// setPreferredSubfunctionSize - Set the preferred maximum size of
+  /// subfunctions of this function.
+  void setPreferredSubfunctionSize(unsigned Size) {
+    PreferredSubfunctionSize = Size;
+  }
+
   void setSinglePath(bool convert=true) {
     SinglePathConvert = convert;
   }
@@ -208,6 +229,14 @@ public:
     return SinglePathConvert;
   }
 
+  void setSinglePathUnconditional(bool uncond=true) {
+    SinglePathUnconditional = uncond;
+  }
+
+  bool isSinglePathUnconditional(void) const {
+    return SinglePathUnconditional;
+  }
+
   void addSinglePathFI(int fi) {
     SinglePathFIs.push_back(fi);
   }
@@ -0,0 +1,457 @@
+//===-- PatmosMethodCacheAnalysis.cpp - Whole-program method cache model. -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Whole-program model of the method cache, based on the machine-level call
+// graph and the subfunctions (regions) of the function splitter.
+//
+// The footprint of a function is the total size of its code and of the code
+// of all functions reachable from it in the call graph. If the footprint of a
+// function fits into the method cache, every subfunction of the function and
+// its callees is loaded at most once per execution of the function, i.e., the
+// function is persistent in the method cache. This holds for FIFO and LRU
+// replacement, as nothing loaded during the execution of the function is
+// evicted by code loaded later during the same execution.
+//
+// The pass runs twice:
+//   - Before the function splitter (placement), functions that are called
+//     repeatedly (in loops or recursion) and that are persistent are kept in a
+//     single subfunction if they fit into the maximum subfunction size. This
+//     avoids region transfers in loops that cannot cause misses anyway.
+//   - After the function splitter (report), the subfunction transition graph
+//     is built and a per-function miss cost is written to a report file. Call
+//     sites in loops whose calling subfunction and callee footprint do not fit
+//     into the cache together are reported as conflicting.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "patmos-method-cache"
+
+#include "Patmos.h"
+#include "PatmosCallGraphBuilder.h"
+#include "PatmosInstrInfo.h"
+#include "PatmosMachineFunctionInfo.h"
+#include "PatmosSubtarget.h"
+#include "PatmosTargetMachine.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<bool> DisableMethodCachePlacement(
+  "mpatmos-disable-method-cache-placement",
+  cl::init(false),
+  cl::desc("Do not keep persistent functions that are called in loops in a "
+           "single subfunction."),
+  cl::Hidden);
+
+static cl::opt<std::string> MethodCacheReport(
+  "mpatmos-method-cache-report",
+  cl::desc("Write the method cache miss costs of all functions to the given "
+           "file."),
+  cl::Hidden);
+
+STATISTIC(PersistentFunctions, "Functions persistent in the method cache");
+STATISTIC(MergedFunctions,     "Functions kept in a single subfunction");
+STATISTIC(ConflictingSites,    "Call sites in loops conflicting in the "
+                               "method cache");
+
+namespace {
+  /// A subfunction, i.e., a region of a function that is loaded into the
+  /// method cache as a whole.
+  struct MCRegion {
+    /// The entry block of the region.
+    const MachineBasicBlock *Entry;
+
+    /// The size of the region in bytes.
+    unsigned Size;
+
+    /// Regions of the same function control may be transferred to.
+    std::set<const MCRegion*> Succs;
+
+    MCRegion(const MachineBasicBlock *entry) : Entry(entry), Size(0) {}
+  };
+
+  typedef std::vector<MCRegion> MCRegions;
+
+  class PatmosMethodCacheAnalysis : public MachineModulePass {
+  private:
+    const PatmosTargetMachine &TM;
+    const PatmosSubtarget &STC;
+    const PatmosInstrInfo &PII;
+
+    /// Run after the function splitter, i.e., report instead of placement.
+    bool AfterSplitting;
+
+    /// Size of all code of a function in bytes.
+    std::map<const MCGNode*, unsigned> Sizes;
+
+    /// Footprint of a function including all its callees, or -1 if the
+    /// function may call unknown functions.
+    std::map<const MCGNode*, int> Footprints;
+
+    /// Functions that are potentially executed multiple times, i.e., called
+    /// from a loop or recursively, or called by such functions.
+    std::set<const MCGNode*> Repeated;
+
+    /// The regions of each function, only computed after splitting.
+    std::map<const MachineFunction*, MCRegions> Regions;
+
+    /// The region of each basic block, only computed after splitting.
+    std::map<const MachineBasicBlock*, const MCRegion*> BlockRegions;
+
+    /// getBBSize - Size of the basic block in bytes.
+    unsigned getBBSize(const MachineBasicBlock *MBB) const {
+      unsigned Size = 0;
+      for (MachineBasicBlock::const_instr_iterator i = MBB->instr_begin(),
+           ie = MBB->instr_end(); i != ie; i++)
+      {
+        if (i->isBundle()) continue;
+        Size += PII.getInstrSize(&*i);
+      }
+      return Size;
+    }
+
+    /// computeFootprint - Compute the footprint of a function, i.e., the size
+    /// of the function and all functions reachable from it. Functions that
+    /// reach themselves are marked as repeated.
+    int computeFootprint(MCGNode *N) {
+      std::set<MCGNode*> Visited;
+      std::vector<MCGNode*> WL;
+
+      int Footprint = 0;
+      bool Unknown = false;
+      WL.push_back(N);
+      Visited.insert(N);
+      while (!WL.empty()) {
+        MCGNode *M = WL.back();
+        WL.pop_back();
+
+        if (M->isUnknown()) {
+          Unknown = true;
+          continue;
+        }
+
+        Footprint += Sizes[M];
+
+        const MCGSites &Sites = M->getSites();
+        for (MCGSites::const_iterator i = Sites.begin(), ie = Sites.end();
+             i != ie; i++)
+        {
+          MCGNode *Callee = (*i)->getCallee();
+          if (Callee == N) {
+            Repeated.insert(N);
+          }
+          if (Visited.insert(Callee).second) {
+            WL.push_back(Callee);
+          }
+        }
+      }
+      return Unknown ? -1 : Footprint;
+    }
+
+    /// computeRepeated - Find all functions that are potentially executed
+    /// multiple times. In contrast to MCGNode::isInSCC this does not depend on
+    /// the liveness of functions, which is unknown if the module does not
+    /// contain the program entry.
+    void computeRepeated(const MCGNodes &Nodes) {
+      std::vector<const MCGNode*> WL(Repeated.begin(), Repeated.end());
+
+      for (MCGNodes::const_iterator i = Nodes.begin(), ie = Nodes.end();
+           i != ie; i++)
+      {
+        const MCGSites &Calling = (*i)->getCallingSites();
+        for (MCGSites::const_iterator s = Calling.begin(), se = Calling.end();
+             s != se; s++)
+        {
+          if ((*s)->isInSCC() && Repeated.insert(*i).second) {
+            WL.push_back(*i);
+          }
+        }
+      }
+
+      // all callees of repeated functions are repeated as well
+      while (!WL.empty()) {
+        const MCGNode *N = WL.back();
+        WL.pop_back();
+
+        const MCGSites &Sites = N->getSites();
+        for (MCGSites::const_iterator s = Sites.begin(), se = Sites.end();
+             s != se; s++)
+        {
+          if (Repeated.insert((*s)->getCallee()).second) {
+            WL.push_back((*s)->getCallee());
+          }
+        }
+      }
+    }
+
+    /// isPersistent - Check if a function and its callees fit into the
+    /// method cache.
+    bool isPersistent(const MCGNode *N) const {
+      std::map<const MCGNode*, int>::const_iterator it = Footprints.find(N);
+      return it != Footprints.end() && it->second >= 0 &&
+             (unsigned)it->second <= STC.getMethodCacheSize();
+    }
+
+    /// computeRegions - Collect the regions of a function after splitting,
+    /// and the transitions between them.
+    void computeRegions(const MachineFunction &MF) {
+      const PatmosMachineFunctionInfo &PMFI =
+                                        *MF.getInfo<PatmosMachineFunctionInfo>();
+      MCRegions &FRegions = Regions[&MF];
+
+      // The regions are laid out consecutively, starting at their entry.
+      for (MachineFunction::const_iterator i = MF.begin(), ie = MF.end();
+           i != ie; i++)
+      {
+        if (FRegions.empty() || PMFI.isMethodCacheRegionEntry(i)) {
+          FRegions.push_back(MCRegion(i));
+        }
+        FRegions.back().Size += getBBSize(i);
+      }
+
+      // Do not take pointers before the vector is complete.
+      const MCRegion *Current = NULL;
+      for (MachineFunction::const_iterator i = MF.begin(), ie = MF.end();
+           i != ie; i++)
+      {
+        if (!Current || PMFI.isMethodCacheRegionEntry(i)) {
+          Current = Current ? Current + 1 : &FRegions.front();
+        }
+        BlockRegions[i] = Current;
+      }
+
+      for (MachineFunction::const_iterator i = MF.begin(), ie = MF.end();
+           i != ie; i++)
+      {
+        MCRegion *Src = const_cast<MCRegion*>(BlockRegions[i]);
+        for (MachineBasicBlock::const_succ_iterator s = i->succ_begin(),
+             se = i->succ_end(); s != se; s++)
+        {
+          const MCRegion *Dst = BlockRegions[*s];
+          if (Dst != Src) Src->Succs.insert(Dst);
+        }
+      }
+    }
+
+    /// isConflicting - Check if the subfunction containing the call and the
+    /// footprint of the callee do not fit into the method cache together, for
+    /// call sites executed repeatedly.
+    bool isConflicting(const MCGSite *Site) const {
+      if (!Site->isInSCC() || !Site->getMI()) return false;
+
+      std::map<const MCGNode*, int>::const_iterator it =
+                                         Footprints.find(Site->getCallee());
+      if (it == Footprints.end() || it->second < 0) return true;
+
+      std::map<const MachineBasicBlock*, const MCRegion*>::const_iterator R =
+                                BlockRegions.find(Site->getMI()->getParent());
+      unsigned CallerSize = R != BlockRegions.end() ? R->second->Size : 0;
+
+      return CallerSize + it->second > STC.getMethodCacheSize();
+    }
+
+    /// placeSubfunctions - Keep persistent functions that are called
+    /// repeatedly in a single subfunction.
+    void placeSubfunctions(const MCGNodes &Nodes) {
+      for (MCGNodes::const_iterator i = Nodes.begin(), ie = Nodes.end();
+           i != ie; i++)
+      {
+        MCGNode *N = *i;
+        if (N->isUnknown() || !Repeated.count(N) || !isPersistent(N)) continue;
+
+        MachineFunction *MF = N->getMF();
+        PatmosMachineFunctionInfo &PMFI =
+                                        *MF->getInfo<PatmosMachineFunctionInfo>();
+
+        // Let the function splitter decide whether the function fits into the
+        // maximum subfunction size.
+        PMFI.setPreferredSubfunctionSize(Sizes[N]);
+        MergedFunctions++;
+
+        DEBUG(dbgs() << "Method cache: keep " << MF->getName()
+                     << " in a single subfunction (" << Sizes[N] << ")\n");
+      }
+    }
+
+    /// writeReport - Write one line per function with its miss costs.
+    void writeReport(const Module &M, const MCGNodes &Nodes) {
+      std::string err;
+      raw_fd_ostream f(MethodCacheReport.c_str(), err, sys::fs::F_Append);
+      if (!err.empty()) {
+        errs() << "Error: Failed to open method cache report '"
+               << MethodCacheReport << "': " << err << "\n";
+        return;
+      }
+
+      for (MCGNodes::const_iterator i = Nodes.begin(), ie = Nodes.end();
+           i != ie; i++)
+      {
+        const MCGNode *N = *i;
+        if (N->isUnknown()) continue;
+
+        const MachineFunction *MF = N->getMF();
+        const MCRegions &FRegions = Regions[MF];
+
+        unsigned Transitions = 0;
+        for (MCRegions::const_iterator r = FRegions.begin(),
+             re = FRegions.end(); r != re; r++)
+        {
+          Transitions += r->Succs.size();
+        }
+
+        unsigned Conflicts = 0;
+        const MCGSites &Sites = N->getSites();
+        for (MCGSites::const_iterator s = Sites.begin(), se = Sites.end();
+             s != se; s++)
+        {
+          if (isConflicting(*s)) Conflicts++;
+        }
+        // Every call transfers control to the callee and back.
+        Transitions += 2 * Sites.size();
+
+        bool Persistent = isPersistent(N);
+        int Footprint = Footprints[N];
+
+        // <module>, <function>, <#regions>, <size>, <footprint>,
+        f << "\"" << M.getModuleIdentifier() << "\", ";
+        f << "\"" << MF->getName() << "\", ";
+        f << FRegions.size() << ", " << Sizes[N] << ", " << Footprint << ", ";
+
+        // <persistent>, <#transitions>, <#conflicting call sites>,
+        f << Persistent << ", " << Transitions << ", " << Conflicts << ", ";
+
+        // <miss cost>: bytes loaded into the method cache per execution of the
+        // function, only bounded without frequencies if it is persistent.
+        f << (Persistent ? Footprint : -1);
+        f << "\n";
+      }
+    }
+
+  public:
+    static char ID;
+
+    PatmosMethodCacheAnalysis(const PatmosTargetMachine &tm, bool after) :
+      MachineModulePass(ID), TM(tm), STC(tm.getSubtarget<PatmosSubtarget>()),
+      PII(*tm.getInstrInfo()), AfterSplitting(after)
+    {
+      initializePatmosCallGraphBuilderPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual const char *getPassName() const {
+      return AfterSplitting ? "Patmos Method Cache Report"
+                            : "Patmos Method Cache Placement";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+      AU.addRequired<PatmosCallGraphBuilder>();
+
+      ModulePass::getAnalysisUsage(AU);
+    }
+
+    virtual bool doInitialization(Module &) {
+      if (AfterSplitting && !MethodCacheReport.empty() &&
+          sys::fs::exists(MethodCacheReport))
+      {
+        sys::fs::remove(MethodCacheReport.c_str());
+      }
+      return false;
+    }
+
+    virtual bool runOnMachineModule(const Module &M) {
+      if (AfterSplitting ? MethodCacheReport.empty()
+                         : DisableMethodCachePlacement)
+        return false;
+
+      PatmosCallGraphBuilder &PCGB = getAnalysis<PatmosCallGraphBuilder>();
+      const MCGNodes &Nodes = PCGB.getNodes();
+
+      Sizes.clear();
+      Footprints.clear();
+      Repeated.clear();
+      Regions.clear();
+      BlockRegions.clear();
+
+      for (MCGNodes::const_iterator i = Nodes.begin(), ie = Nodes.end();
+           i != ie; i++)
+      {
+        if ((*i)->isUnknown()) continue;
+
+        const MachineFunction *MF = (*i)->getMF();
+        unsigned Size = 0;
+        for (MachineFunction::const_iterator b = MF->begin(), be = MF->end();
+             b != be; b++)
+        {
+          Size += getBBSize(b);
+        }
+        Sizes[*i] = Size;
+
+        if (AfterSplitting) computeRegions(*MF);
+      }
+
+      for (MCGNodes::const_iterator i = Nodes.begin(), ie = Nodes.end();
+           i != ie; i++)
+      {
+        if ((*i)->isUnknown()) continue;
+
+        Footprints[*i] = computeFootprint(*i);
+      }
+
+      computeRepeated(Nodes);
+
+      if (!AfterSplitting) {
+        placeSubfunctions(Nodes);
+        return true;
+      }
+
+      for (MCGNodes::const_iterator i = Nodes.begin(), ie = Nodes.end();
+           i != ie; i++)
+      {
+        if ((*i)->isUnknown()) continue;
+
+        if (isPersistent(*i)) PersistentFunctions++;
+
+        const MCGSites &Sites = (*i)->getSites();
+        for (MCGSites::const_iterator s = Sites.begin(), se = Sites.end();
+             s != se; s++)
+        {
+          if (isConflicting(*s)) ConflictingSites++;
+        }
+      }
+
+      writeReport(M, Nodes);
+
+      return false;
+    }
+  };
+
+  char PatmosMethodCacheAnalysis::ID = 0;
+}
+
+/// createPatmosMethodCachePlacement - Returns a new method cache analysis pass
+/// that runs before the function splitter.
+ModulePass *llvm::createPatmosMethodCachePlacement(
+                                                const PatmosTargetMachine &tm) {
+  return new PatmosMethodCacheAnalysis(tm, false);
+}
+
+/// createPatmosMethodCacheReport - Returns a new method cache analysis pass
+/// that runs after the function splitter.
+ModulePass *llvm::createPatmosMethodCacheReport(const PatmosTargetMachine &tm) {
+  return new PatmosMethodCacheAnalysis(tm, true);
+}
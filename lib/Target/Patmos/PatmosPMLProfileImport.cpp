@@ -27,6 +27,7 @@
 #include <map>
 #include <set>
 #include <cmath>
+#include <algorithm>
 
 using namespace llvm;
 
@@ -87,6 +88,7 @@ bool PatmosPMLProfileImport::runOnMachineFunction(MachineFunction &MF)
   if (!PI.isAvailable()) return false;
 
   PI.loadCriticalityMap();
+  PI.loadFrequencyMap();
 
   PatmosMachineFunctionInfo &PMFI = *MF.getInfo<PatmosMachineFunctionInfo>();
   PatmosAnalysisInfo &PAI = PMFI.getAnalysisInfo();
@@ -117,6 +119,10 @@ bool PatmosPMLProfileImport::runOnMachineFunction(MachineFunction &MF)
         Weight = PI.getWCETFrequency(MBB, ToMBB, 0);
       }
 
+      // Edge weights must not be zero, e.g. for edges of blocks that are not
+      // on the worst-case path.
+      Weight = std::max(Weight, 1u);
+
       MBPI.setEdgeWeight(MBB, succ, Weight);
     }
   }
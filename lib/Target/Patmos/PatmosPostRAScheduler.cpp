@@ -172,7 +172,7 @@ bool PatmosPostRAScheduler::runOnMachineFunction(MachineFunction &mf) {
   // TODO this should be created by some factory..
   const PatmosTargetMachine *PTM =
                       static_cast<const PatmosTargetMachine*>(&mf.getTarget());
-  PostRASchedStrategy *S = new PatmosPostRASchedStrategy(*PTM);
+  PatmosPostRASchedStrategy *S = new PatmosPostRASchedStrategy(*PTM);
 
   OwningPtr<ScheduleDAGPostRA> Scheduler(new ScheduleDAGPostRA(this, S));
 
@@ -259,6 +259,10 @@ bool PatmosPostRAScheduler::runOnMachineFunction(MachineFunction &mf) {
     Scheduler->finishBlock();
   }
   Scheduler->finalizeSchedule();
+
+  DEBUG(dbgs() << "Bundle fill rate of " << MF->getName() << ": "
+               << S->getNumFilledSlots() << " of " << S->getNumIssueSlots()
+               << " issue slots\n");
   return true;
 }
 
@@ -0,0 +1,549 @@
+//===-- PatmosSPMAllocation.cpp - Allocate data to the scratchpad. --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass allocates frequently accessed global variables and frame objects
+// to the local scratchpad memory (SPM), up to the size given by
+// -mpatmos-spm-size.
+//
+// Candidates are global variables defined in the module (either local to the
+// module, or any global if the module contains the whole program, i.e., after
+// linking), and aggregate allocas of functions that are not (potentially)
+// recursive, which are placed on the shadow stack otherwise. Functions that
+// may reach an indirect or external call are treated as recursive, since the
+// call graph does not tell which functions are called back. The address of a
+// candidate must not escape, i.e., it may only be used by loads and stores,
+// possibly through GEPs and bitcasts, so that all accesses can be rewritten.
+//
+// The access frequency of a candidate is the sum of the frequencies of its
+// loads and stores. Block frequencies are taken from bitcode-level WCET
+// frequencies of an imported PML file if available, otherwise they are
+// estimated from loop bounds and the call graph. Candidates are selected in
+// order of their frequency per byte.
+//
+// Selected objects are moved to the scratchpad address space, the instruction
+// selector then emits the local (MEM_L) variants of their loads and stores.
+// Frame objects become internal global variables. All selected objects are
+// emitted into the .spm section, which has to be placed into the scratchpad by
+// the linker. Initialized data has to be copied there by the startup code.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "patmos-spm-alloc"
+
+#include "Patmos.h"
+#include "PatmosSubtarget.h"
+#include "PatmosTargetMachine.h"
+#include "PatmosUtil.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/CodeGen/PMLImport.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<std::string> SPMReport(
+  "mpatmos-spm-report",
+  cl::desc("Write the objects allocated to the scratchpad to the given file."),
+  cl::Hidden);
+
+STATISTIC(NumSPMGlobals, "Number of global variables allocated to the SPM");
+STATISTIC(NumSPMFrameObjects, "Number of frame objects allocated to the SPM");
+STATISTIC(SPMBytes, "Number of bytes allocated to the SPM");
+
+/// DefaultLoopBound - Number of iterations assumed for loops without bounds
+/// and for recursion.
+static const unsigned DefaultLoopBound = 10;
+
+/// SPMSection - The section of the objects allocated to the scratchpad.
+static const char *SPMSection = ".spm";
+
+/// SPMAddressSpace - The address space of the scratchpad, see spmLoad in
+/// PatmosInstrPatterns.td.
+static const unsigned SPMAddressSpace = 1;
+
+namespace {
+  /// A candidate for the scratchpad allocation.
+  struct SPMObject {
+    /// The global variable or alloca.
+    Value *V;
+
+    /// The size of the object in bytes.
+    uint64_t Size;
+
+    /// The number of accesses to the object.
+    double Frequency;
+
+    SPMObject(Value *v, uint64_t size, double freq)
+      : V(v), Size(size), Frequency(freq) {}
+
+    bool operator<(const SPMObject &O) const {
+      return Frequency * O.Size > O.Frequency * Size;
+    }
+  };
+
+  class PatmosSPMAllocation : public ModulePass {
+  private:
+    const PatmosTargetMachine &TM;
+    const PatmosSubtarget &STC;
+
+    /// The number of executions of each basic block.
+    std::map<const BasicBlock*, double> BlockFrequencies;
+
+    /// Functions that may be executed recursively.
+    std::set<const Function*> Recursive;
+
+    /// getLoopBound - Get the maximum number of iterations of a loop.
+    double getLoopBound(const Loop *L) const {
+      // The bounds are read from the llvm.loop metadata of the terminator of
+      // the header (see getLoopBounds), but a latch may carry them as well.
+      for (Loop::block_iterator i = L->block_begin(), ie = L->block_end();
+           i != ie; i++)
+      {
+        int Max = getLoopBounds(*i).second;
+        if (Max >= 0) return Max + 1;
+      }
+      return DefaultLoopBound;
+    }
+
+    /// computeFrequencies - Compute the number of executions of all blocks,
+    /// using the imported WCET frequencies or the loop bounds and the call
+    /// graph.
+    void computeFrequencies(Module &M);
+
+    /// collectAccesses - Sum up the frequencies of all accesses to an object.
+    /// Returns false if the address of the object escapes.
+    bool collectAccesses(const Value *V, double &Frequency);
+
+    /// rewriteUses - Replace all uses of an object by a pointer to the
+    /// scratchpad address space.
+    void rewriteUses(Value *Old, Value *New);
+
+    /// moveToSPM - Replace an object by a global variable in the scratchpad.
+    void moveToSPM(Module &M, SPMObject &O);
+
+    /// writeReport - Write one line per allocated object.
+    void writeReport(const Module &M, const std::vector<SPMObject> &Objects);
+
+  public:
+    static char ID;
+
+    PatmosSPMAllocation(const PatmosTargetMachine &tm)
+      : ModulePass(ID), TM(tm), STC(tm.getSubtarget<PatmosSubtarget>())
+    {
+      initializeCallGraphPass(*PassRegistry::getPassRegistry());
+      initializeLoopInfoPass(*PassRegistry::getPassRegistry());
+      initializePMLImportPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual const char *getPassName() const {
+      return "Patmos Scratchpad Allocation";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<CallGraph>();
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<PMLImport>();
+    }
+
+    virtual bool doInitialization(Module &) {
+      if (!SPMReport.empty() && sys::fs::exists(SPMReport)) {
+        sys::fs::remove(SPMReport.c_str());
+      }
+      return false;
+    }
+
+    virtual bool runOnModule(Module &M);
+  };
+
+  char PatmosSPMAllocation::ID = 0;
+}
+
+/// createPatmosSPMAllocationPass - Returns a new pass that allocates data to
+/// the scratchpad memory.
+ModulePass *llvm::createPatmosSPMAllocationPass(const PatmosTargetMachine &tm) {
+  return new PatmosSPMAllocation(tm);
+}
+
+void PatmosSPMAllocation::computeFrequencies(Module &M)
+{
+  CallGraph &CG = getAnalysis<CallGraph>();
+  PMLImport &PI = getAnalysis<PMLImport>();
+
+  // Number of executions of the blocks per execution of their function.
+  std::map<const BasicBlock*, double> LocalFrequencies;
+  // Functions with imported WCET frequencies.
+  std::set<const Function*> HasWCETFrequencies;
+
+  for (Module::iterator F = M.begin(), FE = M.end(); F != FE; F++) {
+    if (F->isDeclaration()) continue;
+
+    PMLBitcodeQuery *Query = PI.createBitcodeQuery(*this, *F,
+                                                   yaml::level_bitcode);
+    PMLQuery::BlockUIntMap WCETFrequencies;
+    if (Query && Query->getBlockFrequencyMap(WCETFrequencies)) {
+      for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; BB++) {
+        BlockFrequencies[BB] = Query->getWCETFrequency(WCETFrequencies, *BB, 0);
+      }
+      HasWCETFrequencies.insert(F);
+    }
+    delete Query;
+
+    LoopInfo &LI = getAnalysis<LoopInfo>(*F);
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; BB++) {
+      double Frequency = 1;
+      for (Loop *L = LI.getLoopFor(BB); L; L = L->getParentLoop()) {
+        Frequency *= getLoopBound(L);
+      }
+      LocalFrequencies[BB] = Frequency;
+    }
+  }
+
+  // Propagate the function frequencies along the call graph, callers first.
+  std::vector<std::vector<CallGraphNode*> > SCCs;
+  std::vector<bool> HasLoop;
+  for (scc_iterator<CallGraph*> i = scc_begin(&CG), ie = scc_end(&CG);
+       i != ie; ++i)
+  {
+    SCCs.push_back(*i);
+    HasLoop.push_back(i.hasLoop());
+  }
+
+  // Find the functions that may call unknown functions, callees first. Such
+  // calls may lead back into the caller, e.g., through function pointers.
+  std::set<const CallGraphNode*> CallsExternal;
+  CallsExternal.insert(CG.getCallsExternalNode());
+  for (unsigned i = 0; i < SCCs.size(); i++) {
+    bool Calls = false;
+    for (unsigned n = 0; n < SCCs[i].size() && !Calls; n++) {
+      for (CallGraphNode::iterator c = SCCs[i][n]->begin(),
+           ce = SCCs[i][n]->end(); c != ce; c++)
+      {
+        if (CallsExternal.count(c->second)) {
+          Calls = true;
+          break;
+        }
+      }
+    }
+    if (!Calls) continue;
+
+    for (unsigned n = 0; n < SCCs[i].size(); n++) {
+      CallsExternal.insert(SCCs[i][n]);
+      if (Function *F = SCCs[i][n]->getFunction()) Recursive.insert(F);
+    }
+  }
+
+  std::map<const Function*, double> FunctionFrequencies;
+  std::set<const Function*> Visited;
+  for (unsigned i = SCCs.size(); i-- > 0; ) {
+    std::set<const Function*> SCCFunctions;
+    for (unsigned n = 0; n < SCCs[i].size(); n++) {
+      SCCFunctions.insert(SCCs[i][n]->getFunction());
+    }
+
+    for (unsigned n = 0; n < SCCs[i].size(); n++) {
+      CallGraphNode *CGN = SCCs[i][n];
+      Function *F = CGN->getFunction();
+      if (!F || F->isDeclaration()) continue;
+
+      Visited.insert(F);
+      if (HasLoop[i]) Recursive.insert(F);
+
+      double &Frequency = FunctionFrequencies[F];
+      // Functions without callers are executed once.
+      if (Frequency == 0) Frequency = 1;
+      if (HasLoop[i]) Frequency *= DefaultLoopBound;
+
+      for (CallGraphNode::iterator c = CGN->begin(), ce = CGN->end();
+           c != ce; c++)
+      {
+        Function *Callee = c->second->getFunction();
+        if (!Callee || SCCFunctions.count(Callee)) continue;
+
+        Value *CallV = c->first;
+        const Instruction *Call = dyn_cast_or_null<Instruction>(CallV);
+        double Local = Call ? LocalFrequencies[Call->getParent()] : 1;
+        FunctionFrequencies[Callee] += Frequency * Local;
+      }
+    }
+  }
+
+  for (Module::iterator F = M.begin(), FE = M.end(); F != FE; F++) {
+    if (F->isDeclaration()) continue;
+
+    // Functions not reachable in the call graph may be called from anywhere.
+    if (!Visited.count(F)) Recursive.insert(F);
+
+    if (HasWCETFrequencies.count(F)) continue;
+
+    double Frequency = Visited.count(F) ? FunctionFrequencies[F] : 1;
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; BB++) {
+      BlockFrequencies[BB] = Frequency * LocalFrequencies[BB];
+    }
+  }
+}
+
+bool PatmosSPMAllocation::collectAccesses(const Value *V, double &Frequency)
+{
+  for (Value::const_use_iterator u = V->use_begin(), ue = V->use_end();
+       u != ue; u++)
+  {
+    const User *U = *u;
+    if (const LoadInst *LI = dyn_cast<LoadInst>(U)) {
+      Frequency += BlockFrequencies[LI->getParent()];
+    } else if (const StoreInst *SI = dyn_cast<StoreInst>(U)) {
+      // Storing the address lets it escape.
+      if (SI->getValueOperand() == V) return false;
+      Frequency += BlockFrequencies[SI->getParent()];
+    } else if (isa<GetElementPtrInst>(U) || isa<BitCastInst>(U)) {
+      if (!collectAccesses(U, Frequency)) return false;
+    } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(U)) {
+      if (CE->getOpcode() != Instruction::GetElementPtr &&
+          CE->getOpcode() != Instruction::BitCast)
+        return false;
+      if (!collectAccesses(CE, Frequency)) return false;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+void PatmosSPMAllocation::rewriteUses(Value *Old, Value *New)
+{
+  SmallVector<User*, 16> Users;
+  for (Value::use_iterator u = Old->use_begin(), ue = Old->use_end(); u != ue;
+       u++)
+  {
+    Users.push_back(*u);
+  }
+
+  for (SmallVectorImpl<User*>::iterator u = Users.begin(), ue = Users.end();
+       u != ue; u++)
+  {
+    if (LoadInst *LI = dyn_cast<LoadInst>(*u)) {
+      LoadInst *NewLI = new LoadInst(New, "", LI->isVolatile(),
+                                     LI->getAlignment(), LI->getOrdering(),
+                                     LI->getSynchScope(), LI);
+      NewLI->takeName(LI);
+      NewLI->setDebugLoc(LI->getDebugLoc());
+      LI->replaceAllUsesWith(NewLI);
+      LI->eraseFromParent();
+    } else if (StoreInst *SI = dyn_cast<StoreInst>(*u)) {
+      StoreInst *NewSI = new StoreInst(SI->getValueOperand(), New,
+                                       SI->isVolatile(), SI->getAlignment(),
+                                       SI->getOrdering(), SI->getSynchScope(),
+                                       SI);
+      NewSI->setDebugLoc(SI->getDebugLoc());
+      SI->eraseFromParent();
+    } else if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(*u)) {
+      SmallVector<Value*, 4> Idx(GEP->idx_begin(), GEP->idx_end());
+      GetElementPtrInst *NewGEP = GetElementPtrInst::Create(New, Idx, "", GEP);
+      NewGEP->setIsInBounds(GEP->isInBounds());
+      NewGEP->takeName(GEP);
+      NewGEP->setDebugLoc(GEP->getDebugLoc());
+      rewriteUses(GEP, NewGEP);
+      GEP->eraseFromParent();
+    } else if (BitCastInst *BC = dyn_cast<BitCastInst>(*u)) {
+      Type *Ty = PointerType::get(BC->getType()->getPointerElementType(),
+                                  SPMAddressSpace);
+      BitCastInst *NewBC = new BitCastInst(New, Ty, "", BC);
+      NewBC->takeName(BC);
+      NewBC->setDebugLoc(BC->getDebugLoc());
+      rewriteUses(BC, NewBC);
+      BC->eraseFromParent();
+    } else {
+      ConstantExpr *CE = cast<ConstantExpr>(*u);
+      Constant *NewCE;
+      if (CE->getOpcode() == Instruction::GetElementPtr) {
+        SmallVector<Constant*, 4> Idx;
+        for (unsigned i = 1, e = CE->getNumOperands(); i != e; i++) {
+          Idx.push_back(CE->getOperand(i));
+        }
+        NewCE = ConstantExpr::getGetElementPtr(cast<Constant>(New), Idx,
+                                       cast<GEPOperator>(CE)->isInBounds());
+      } else {
+        Type *Ty = PointerType::get(CE->getType()->getPointerElementType(),
+                                    SPMAddressSpace);
+        NewCE = ConstantExpr::getBitCast(cast<Constant>(New), Ty);
+      }
+      rewriteUses(CE, NewCE);
+      CE->destroyConstant();
+    }
+  }
+}
+
+void PatmosSPMAllocation::moveToSPM(Module &M, SPMObject &O)
+{
+  GlobalVariable *SPMVar;
+
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(O.V)) {
+    SPMVar = new GlobalVariable(M, GV->getType()->getElementType(),
+                                GV->isConstant(), GV->getLinkage(),
+                                GV->getInitializer(), "", GV,
+                                GV->getThreadLocalMode(), SPMAddressSpace);
+    SPMVar->takeName(GV);
+    SPMVar->setAlignment(GV->getAlignment());
+    SPMVar->setVisibility(GV->getVisibility());
+    SPMVar->setSection(SPMSection);
+
+    rewriteUses(GV, SPMVar);
+    GV->eraseFromParent();
+    NumSPMGlobals++;
+  } else {
+    AllocaInst *AI = cast<AllocaInst>(O.V);
+    Function *F = AI->getParent()->getParent();
+
+    // Frame objects of non-recursive functions are allocated statically.
+    Type *Ty = AI->getAllocatedType();
+    uint64_t N = cast<ConstantInt>(AI->getArraySize())->getZExtValue();
+    Type *VarTy = N == 1 ? Ty : ArrayType::get(Ty, N);
+
+    SPMVar = new GlobalVariable(M, VarTy, false, GlobalValue::InternalLinkage,
+                                Constant::getNullValue(VarTy),
+                                F->getName() + "." + AI->getName(), 0,
+                                GlobalVariable::NotThreadLocal,
+                                SPMAddressSpace);
+    SPMVar->setAlignment(AI->getAlignment());
+    SPMVar->setSection(SPMSection);
+
+    Constant *Ptr = SPMVar;
+    if (N != 1) {
+      Ptr = ConstantExpr::getBitCast(SPMVar,
+                                     PointerType::get(Ty, SPMAddressSpace));
+    }
+    rewriteUses(AI, Ptr);
+    AI->eraseFromParent();
+    NumSPMFrameObjects++;
+  }
+
+  O.V = SPMVar;
+  SPMBytes += O.Size;
+}
+
+void PatmosSPMAllocation::writeReport(const Module &M,
+                                      const std::vector<SPMObject> &Objects)
+{
+  std::string err;
+  raw_fd_ostream f(SPMReport.c_str(), err, sys::fs::F_Append);
+  if (!err.empty()) {
+    errs() << "Error: Failed to open scratchpad report '"
+           << SPMReport << "': " << err << "\n";
+    return;
+  }
+
+  for (std::vector<SPMObject>::const_iterator i = Objects.begin(),
+       ie = Objects.end(); i != ie; i++)
+  {
+    // <module>, <object>, <size>, <accesses>
+    f << "\"" << M.getModuleIdentifier() << "\", ";
+    f << "\"" << i->V->getName() << "\", ";
+    f << i->Size << ", " << format("%.0f", i->Frequency) << "\n";
+  }
+}
+
+bool PatmosSPMAllocation::runOnModule(Module &M)
+{
+  unsigned Budget = STC.getSPMSize();
+  if (!Budget) return false;
+
+  const DataLayout &DL = *TM.getDataLayout();
+
+  BlockFrequencies.clear();
+  Recursive.clear();
+  computeFrequencies(M);
+
+  // Without a main function, other modules may access the globals.
+  Function *Main = M.getFunction("main");
+  bool WholeProgram = Main && !Main->isDeclaration();
+
+  std::vector<SPMObject> Candidates;
+
+  for (Module::global_iterator GV = M.global_begin(), GE = M.global_end();
+       GV != GE; GV++)
+  {
+    if (GV->isDeclaration() || GV->isThreadLocal() || GV->hasSection() ||
+        GV->getType()->getAddressSpace() != 0 ||
+        GV->getName().startswith("llvm."))
+      continue;
+    if (!GV->hasLocalLinkage() && (!WholeProgram || GV->isWeakForLinker()))
+      continue;
+
+    uint64_t Size = DL.getTypeAllocSize(GV->getType()->getElementType());
+    double Frequency = 0;
+    if (Size && collectAccesses(GV, Frequency) && Frequency > 0)
+      Candidates.push_back(SPMObject(GV, Size, Frequency));
+  }
+
+  for (Module::iterator F = M.begin(), FE = M.end(); F != FE; F++) {
+    if (F->isDeclaration() || Recursive.count(F) || F->hasAddressTaken())
+      continue;
+
+    BasicBlock &Entry = F->getEntryBlock();
+    for (BasicBlock::iterator I = Entry.begin(), IE = Entry.end(); I != IE;
+         I++)
+    {
+      AllocaInst *AI = dyn_cast<AllocaInst>(I);
+      if (!AI || !AI->isStaticAlloca() ||
+          !AI->getAllocatedType()->isAggregateType())
+        continue;
+
+      uint64_t N = cast<ConstantInt>(AI->getArraySize())->getZExtValue();
+      uint64_t Size = DL.getTypeAllocSize(AI->getAllocatedType()) * N;
+      double Frequency = 0;
+      if (Size && collectAccesses(AI, Frequency) && Frequency > 0)
+        Candidates.push_back(SPMObject(AI, Size, Frequency));
+    }
+  }
+
+  // Select the objects with the most accesses per byte.
+  std::stable_sort(Candidates.begin(), Candidates.end());
+
+  std::vector<SPMObject> Selected;
+  uint64_t Used = 0;
+  for (std::vector<SPMObject>::iterator i = Candidates.begin(),
+       ie = Candidates.end(); i != ie; i++)
+  {
+    uint64_t Size = RoundUpToAlignment(i->Size, 4);
+    if (Used + Size > Budget) continue;
+
+    DEBUG(dbgs() << "SPM: allocating " << i->V->getName() << " (" << i->Size
+                 << " bytes, " << i->Frequency << " accesses)\n");
+
+    Used += Size;
+    Selected.push_back(*i);
+  }
+
+  for (std::vector<SPMObject>::iterator i = Selected.begin(),
+       ie = Selected.end(); i != ie; i++)
+  {
+    moveToSPM(M, *i);
+  }
+
+  if (!SPMReport.empty())
+    writeReport(M, Selected);
+
+  return !Selected.empty();
+}
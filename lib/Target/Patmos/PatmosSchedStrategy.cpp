@@ -35,6 +35,18 @@
 
 using namespace llvm;
 
+STATISTIC(NumIssueSlots,  "Number of issue slots in all scheduled cycles");
+STATISTIC(NumFilledSlots, "Number of issue slots filled with instructions");
+STATISTIC(NumPacked,      "Number of bundles filled by critical path priority");
+STATISTIC(NumExclusiveDeps,
+          "Number of deps removed between mutually exclusive predicates");
+
+static cl::opt<bool> EnableBundlePacking("mpatmos-sched-bundle-packing",
+  cl::init(false),
+  cl::desc("Fill the issue slots of bundles by critical path priority, "
+           "issuing pairable instructions first."),
+  cl::Hidden);
+
 bool ILPOrder::operator()(const SUnit *A, const SUnit *B) const {
   // Always prefer instructions with ScheduleLow flag.
   if (A->isScheduleLow != B->isScheduleLow) {
@@ -127,12 +139,9 @@ bool PatmosLatencyQueue::selectBundle(std::vector<SUnit*> &Bundle)
   // scheduled only with a single other instruction in this queue, or if there
   // is any instruction in the queue that can only be scheduled with the highest
   // ones. Pick them in any case
-
-
-
-  // TODO magic goes here..
-
-
+  if (PackBundles && CurrWidth < IssueWidth) {
+    packBundle(Bundle, Selected, CurrWidth);
+  }
 
   // Try to fill up the bundle with instructions from the queue by best effort
   for (unsigned i = 0; i < AvailableQueue.size() && CurrWidth < IssueWidth; i++)
@@ -145,6 +154,9 @@ bool PatmosLatencyQueue::selectBundle(std::vector<SUnit*> &Bundle)
     unsigned width = PII.getIssueWidth(SU->getInstr());
     if (!Bundle.empty() && CurrWidth + width > IssueWidth) continue;
 
+    // the bundle must not use more functional units than available
+    if (!canAddToBundle(Bundle, SU, CurrWidth)) continue;
+
     addToBundle(Bundle, SU, CurrWidth);
   }
 
@@ -251,6 +263,127 @@ bool PatmosLatencyQueue::addToBundle(std::vector<SUnit *> &Bundle, SUnit *SU,
   return false;
 }
 
+bool PatmosLatencyQueue::canAddToBundle(const std::vector<SUnit *> &Bundle,
+                                        SUnit *SU, unsigned Width)
+{
+  std::vector<SUnit*> NewBundle(Bundle);
+  return addToBundle(NewBundle, SU, Width) && fitsResources(NewBundle);
+}
+
+/// Find an assignment of distinct units to all stages, each stage is given by
+/// the mask of units it can use.
+static bool assignUnits(const SmallVectorImpl<unsigned> &Stages, unsigned Idx,
+                        unsigned Used)
+{
+  if (Idx == Stages.size()) return true;
+
+  for (unsigned Units = Stages[Idx] & ~Used; Units; Units &= Units - 1) {
+    unsigned Unit = Units & -Units;
+    if (assignUnits(Stages, Idx + 1, Used | Unit))
+      return true;
+  }
+  return false;
+}
+
+bool PatmosLatencyQueue::fitsResources(const std::vector<SUnit *> &Bundle) const
+{
+  // Collect the stages of all instructions that occupy a unit in the issue
+  // cycle.
+  SmallVector<unsigned, 8> Stages;
+  for (unsigned i = 0; i < Bundle.size(); i++) {
+    MachineInstr *MI = Bundle[i]->getInstr();
+    if (!MI || MI->isPseudo()) continue;
+
+    unsigned SchedClass = MI->getDesc().getSchedClass();
+    unsigned Cycle = 0;
+    for (const InstrStage *IS = Itins.beginStage(SchedClass),
+         *E = Itins.endStage(SchedClass); IS != E; ++IS)
+    {
+      if (Cycle == 0 && IS->getCycles() > 0)
+        Stages.push_back(IS->getUnits());
+      Cycle += IS->getNextCycles();
+    }
+  }
+
+  return assignUnits(Stages, 0, 0);
+}
+
+int PatmosLatencyQueue::findPartner(const std::vector<SUnit *> &Bundle,
+                                    const std::vector<bool> &Selected,
+                                    unsigned Width)
+{
+  int Best = -1;
+  for (unsigned i = 0; i < AvailableQueue.size(); i++) {
+    if (Selected[i]) continue;
+    SUnit *SU = AvailableQueue[i];
+
+    // Ties are broken by the queue order
+    if (Best != -1 && SU->getDepth() <= AvailableQueue[Best]->getDepth())
+      continue;
+
+    if (canAddToBundle(Bundle, SU, Width))
+      Best = i;
+  }
+  return Best;
+}
+
+void PatmosLatencyQueue::packBundle(std::vector<SUnit *> &Bundle,
+                                    std::vector<bool> &Selected,
+                                    unsigned &Width)
+{
+  if (Bundle.empty()) {
+    // Take the most critical instruction, i.e., the one with the longest
+    // path from the top of the region, ties are broken by the queue order.
+    // If it cannot be paired, we look ahead for an equally critical
+    // instruction that has a partner, which does not delay the longest path.
+    // Register pressure is not affected by any order here, since all anti
+    // and output dependencies are in the DAG after register allocation.
+    int Crit = -1;
+    for (unsigned i = 0; i < AvailableQueue.size(); i++) {
+      if (Selected[i]) continue;
+      if (Crit == -1 ||
+          AvailableQueue[i]->getDepth() > AvailableQueue[Crit]->getDepth())
+        Crit = i;
+    }
+    if (Crit == -1) return;
+
+    int First = Crit;
+    for (unsigned i = Crit; i < AvailableQueue.size(); i++) {
+      SUnit *SU = AvailableQueue[i];
+      if (Selected[i] || SU->getDepth() < AvailableQueue[Crit]->getDepth() ||
+          SU->getInstr()->isPseudo() || SU->getInstr()->isInlineAsm())
+        continue;
+
+      std::vector<SUnit*> Single(1, SU);
+      unsigned SingleWidth = PII.getIssueWidth(SU->getInstr());
+      Selected[i] = true;
+      bool HasPartner = SingleWidth < IssueWidth &&
+                        findPartner(Single, Selected, SingleWidth) != -1;
+      Selected[i] = false;
+      if (HasPartner) {
+        First = i;
+        break;
+      }
+    }
+    if (First == -1) return;
+
+    addToBundle(Bundle, AvailableQueue[First], Width);
+    Selected[First] = true;
+  }
+
+  bool Packed = false;
+  while (Width < IssueWidth) {
+    int Partner = findPartner(Bundle, Selected, Width);
+    if (Partner == -1) break;
+
+    addToBundle(Bundle, AvailableQueue[Partner], Width);
+    Selected[Partner] = true;
+    Packed = true;
+  }
+
+  if (Packed) NumPacked++;
+}
+
 
 #ifndef NDEBUG
 void PatmosLatencyQueue::dump()
@@ -282,7 +415,8 @@ void PatmosLatencyQueue::dump()
 PatmosPostRASchedStrategy::PatmosPostRASchedStrategy(
                                             const PatmosTargetMachine &PTM)
 : PTM(PTM), PII(*PTM.getInstrInfo()), PRI(PII.getPatmosRegisterInfo()),
-  DAG(0), ReadyQ(PTM), CurrCycle(0)
+  DAG(0), ReadyQ(PTM, EnableBundlePacking), CurrCycle(0), NumCycles(0),
+  NumFilled(0)
 {
 }
 
@@ -499,11 +633,28 @@ bool PatmosPostRASchedStrategy::pickNode(SUnit *&SU, bool &IsTopNode,
 
       SU = NULL;
       CurrIsPseudo = false;
+      NumCycles++;
+      NumIssueSlots += ReadyQ.getIssueWidth();
       return true;
     } else {
       // Initialize IsPseudo to true when starting a bundle, will be cleared
       // on first non-pseudo instruction in the bundle.
       CurrIsPseudo = true;
+
+      // Update the fill rate, bundles of pseudos do not take a cycle.
+      unsigned Filled = 0;
+      for (unsigned i = 0; i < CurrBundle.size(); i++) {
+        MachineInstr *MI = CurrBundle[i]->getInstr();
+        if (!MI->isPseudo() || MI->isInlineAsm())
+          Filled += PII.getIssueWidth(MI);
+      }
+      if (Filled) {
+        Filled = std::min(Filled, ReadyQ.getIssueWidth());
+        NumCycles++;
+        NumFilled += Filled;
+        NumIssueSlots += ReadyQ.getIssueWidth();
+        NumFilledSlots += Filled;
+      }
     }
   } else {
     IsBundled = true;
@@ -669,7 +820,7 @@ void PatmosPostRASchedStrategy::removeTypedMemBarriers()
 }
 
 /// Remove all dependencies between instructions with mutually exclusive
-/// predicates.
+/// predicates, if the predicate is not redefined between them.
 void PatmosPostRASchedStrategy::removeExclusivePredDeps()
 {
   for (std::vector<SUnit>::iterator it = DAG->SUnits.begin(),
@@ -677,25 +828,117 @@ void PatmosPostRASchedStrategy::removeExclusivePredDeps()
   {
     MachineInstr *MI = it->getInstr();
 
+    SmallVector<SDep, 4> ExclusiveDeps;
+
     for (SUnit::pred_iterator pit = it->Preds.begin(),
            pie = it->Preds.end(); pit != pie; pit++)
     {
-      if (!pit->getSUnit()) continue;
+      if (!pit->getSUnit() || pit->isArtificial()) continue;
 
       MachineInstr *PI = pit->getSUnit()->getInstr();
+      if (!PI) continue;
 
       if (pit->getKind() != SDep::Order && PII.haveDisjointPredicates(MI, PI))
       {
         unsigned PredPos = MI->getDesc().getNumDefs();
-        if (pit->getReg() != MI->getOperand(PredPos).getReg())
+        unsigned Guard = MI->getOperand(PredPos).getReg();
+
+        // If the predicate is redefined in between, both instructions might
+        // be enabled. The dependency chain over the predicate definition
+        // would keep them ordered, but not the latency of the dependency.
+        if (pit->getReg() != Guard &&
+            !isRedefinedBetween(*pit->getSUnit(), *it, Guard))
         {
-          // TODO we must add new edges to the non-mutual-exclusive uses/defs
-          // Otherwise the scheduler might swap instructions around that have
-          // deps
-          //it->removePred(*pit);
+          ExclusiveDeps.push_back(*pit);
         }
       }
     }
+
+    // Other accesses to the register must still be ordered with respect to
+    // both instructions, so we move the deps of the register from the
+    // predecessor to this instruction and from this instruction to the
+    // predecessor.
+    for (SmallVectorImpl<SDep>::iterator dit = ExclusiveDeps.begin(),
+           die = ExclusiveDeps.end(); dit != die; dit++)
+    {
+      SUnit *PredSU = dit->getSUnit();
+      unsigned Reg = dit->getReg();
+
+      SmallVector<SUnit*, 4> Before, After;
+      for (SUnit::pred_iterator pit = PredSU->Preds.begin(),
+             pie = PredSU->Preds.end(); pit != pie; pit++)
+      {
+        if (isRegDep(*pit, Reg)) Before.push_back(pit->getSUnit());
+      }
+      for (SUnit::succ_iterator sit = it->Succs.begin(),
+             sie = it->Succs.end(); sit != sie; sit++)
+      {
+        if (isRegDep(*sit, Reg)) After.push_back(sit->getSUnit());
+      }
+
+      it->removePred(*dit);
+
+      for (SmallVectorImpl<SUnit*>::iterator bit = Before.begin(),
+             bie = Before.end(); bit != bie; bit++)
+      {
+        addRegDep(**bit, *it, Reg);
+      }
+      for (SmallVectorImpl<SUnit*>::iterator ait = After.begin(),
+             aie = After.end(); ait != aie; ait++)
+      {
+        addRegDep(*PredSU, **ait, Reg);
+      }
+
+      NumExclusiveDeps++;
+    }
+  }
+}
+
+bool PatmosPostRASchedStrategy::isRedefinedBetween(const SUnit &From,
+                                                   const SUnit &To,
+                                                   unsigned Reg)
+{
+  // The nodes are numbered in instruction order.
+  for (unsigned i = From.NodeNum; i < To.NodeNum; i++) {
+    const MachineInstr *MI = DAG->SUnits[i].getInstr();
+    if (MI && MI->modifiesRegister(Reg, &PRI)) return true;
+  }
+  return false;
+}
+
+bool PatmosPostRASchedStrategy::isRegDep(const SDep &Dep, unsigned Reg)
+{
+  if (!Dep.getSUnit() || !Dep.getSUnit()->getInstr()) return false;
+  if (Dep.getKind() == SDep::Order || Dep.isArtificial()) return false;
+
+  return PRI.regsOverlap(Dep.getReg(), Reg);
+}
+
+void PatmosPostRASchedStrategy::addRegDep(SUnit &From, SUnit &To, unsigned Reg)
+{
+  if (&From == &To) return;
+
+  MachineInstr *FromMI = From.getInstr();
+  MachineInstr *ToMI = To.getInstr();
+
+  if (FromMI->modifiesRegister(Reg, &PRI)) {
+    if (ToMI->readsRegister(Reg, &PRI)) {
+      SDep Dep(&From, SDep::Data, Reg);
+      Dep.setLatency( computeExitLatency(From) );
+      To.addPred(Dep);
+    }
+    else if (ToMI->modifiesRegister(Reg, &PRI)) {
+      SDep Dep(&From, SDep::Output, Reg);
+      Dep.setLatency(1);
+      To.addPred(Dep);
+    }
+  }
+  else if (FromMI->readsRegister(Reg, &PRI) &&
+           ToMI->modifiesRegister(Reg, &PRI))
+  {
+    SDep Dep(&From, SDep::Anti, Reg);
+    Dep.setLatency(0);
+    To.addPred(Dep);
   }
 }
 
@@ -104,9 +104,15 @@ namespace llvm {
   private:
     const PatmosInstrInfo &PII;
 
+    /// The resource model used to check if instructions can be bundled.
+    const InstrItineraryData &Itins;
+
     /// Max number of slots to fill when selecting a bundle.
     unsigned IssueWidth;
 
+    /// Fill the bundle by critical path priority instead of queue order.
+    bool PackBundles;
+
     ILPOrder Cmp;
 
     /// PendingQueue - This contains all of the instructions whose operands have
@@ -119,8 +125,10 @@ namespace llvm {
     std::vector<SUnit*> AvailableQueue;
 
   public:
-    PatmosLatencyQueue(const PatmosTargetMachine &PTM)
-    : PII(*PTM.getInstrInfo()), Cmp(false)
+    PatmosLatencyQueue(const PatmosTargetMachine &PTM, bool pack)
+    : PII(*PTM.getInstrInfo()),
+      Itins(PTM.getSubtargetImpl()->getInstrItineraryData()),
+      PackBundles(pack), Cmp(false)
     {
       const PatmosSubtarget &PST = *PTM.getSubtargetImpl();
 
@@ -168,6 +176,27 @@ namespace llvm {
     /// Try to add an instruction to the bundle, return true if succeeded.
     /// \param Width the current width of the bundle, will be updated.
     bool addToBundle(std::vector<SUnit *> &Bundle, SUnit *SU, unsigned &Width);
+
+    /// Check if an instruction can be added to the bundle, without modifying
+    /// the bundle. Also checks the functional units required in the issue
+    /// cycle by all instructions of the bundle.
+    bool canAddToBundle(const std::vector<SUnit *> &Bundle, SUnit *SU,
+                        unsigned Width);
+
+    /// Check if the functional units required in the issue cycle by the
+    /// instructions of the bundle can all be reserved at the same time.
+    bool fitsResources(const std::vector<SUnit *> &Bundle) const;
+
+    /// Find the unselected instruction with the longest path from the top of
+    /// the region that can be added to the bundle, or -1 if there is none.
+    int findPartner(const std::vector<SUnit *> &Bundle,
+                    const std::vector<bool> &Selected, unsigned Width);
+
+    /// Fill the bundle by critical path priority. If the first instruction in
+    /// the queue cannot be paired with any other instruction, an instruction
+    /// on an equally long path that can be paired is issued first instead.
+    void packBundle(std::vector<SUnit *> &Bundle, std::vector<bool> &Selected,
+                    unsigned &Width);
   };
 
   class  PatmosTargetMachine;
@@ -221,10 +250,24 @@ namespace llvm {
     /// The current bundle that we are emitting
     std::vector<SUnit*> CurrBundle;
 
+    /// Number of issued cycles in the current function, including NOOPs.
+    unsigned NumCycles;
+
+    /// Number of issue slots filled in the current function.
+    unsigned NumFilled;
+
   public:
     PatmosPostRASchedStrategy(const PatmosTargetMachine &PTM);
     virtual ~PatmosPostRASchedStrategy() {}
 
+    /// Get the number of issue slots of all cycles scheduled so far.
+    unsigned getNumIssueSlots() const {
+      return NumCycles * ReadyQ.getIssueWidth();
+    }
+
+    /// Get the number of issue slots filled with instructions so far.
+    unsigned getNumFilledSlots() const { return NumFilled; }
+
     /// isSchedulingBoundary - Test if the given instruction should be
     /// considered a scheduling boundary.
     virtual bool isSchedulingBoundary(const MachineInstr *MI,
@@ -286,6 +329,18 @@ namespace llvm {
     /// predicates.
     void removeExclusivePredDeps();
 
+    /// Check if Reg is defined by From or by any instruction between From
+    /// and To.
+    bool isRedefinedBetween(const SUnit &From, const SUnit &To, unsigned Reg);
+
+    /// Check if a dependency is a register dependency on a register that
+    /// overlaps with Reg.
+    bool isRegDep(const SDep &Dep, unsigned Reg);
+
+    /// Add a dependency on Reg from From to To, depending on how the
+    /// instructions access the register.
+    void addRegDep(SUnit &From, SUnit &To, unsigned Reg);
+
     /// Check if the operand of an instruction is actually used by
     /// the instruction or if it is just return info, arguments or caller saved
     /// registers.
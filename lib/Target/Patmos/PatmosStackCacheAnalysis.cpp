@@ -27,23 +27,30 @@
 #undef PATMOS_TRACE_PATH_OCCUPANCY
 #undef PATMOS_TRACE_DETAILED_RESULTS
 
+#include "PatmosBlockDataFlow.h"
 #include "PatmosCallGraphBuilder.h"
+#include "PatmosILPSolver.h"
 #include "PatmosMachineFunctionInfo.h"
 #include "PatmosStackCacheAnalysis.h"
 #include "PatmosSubtarget.h"
 #include "PatmosTargetMachine.h"
-#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/PMLExport.h"
+#include "llvm/PMLBinary.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
-#include "llvm/Support/Program.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <fstream>
+#include <thread>
 
 /// Utility for deleting owned members of an object
 #define DELETE_MEMBERS(vec) \
@@ -76,6 +83,50 @@ static cl::opt<std::string> Solve_ilp(
   cl::desc("Path to an ILP solver."),
   cl::Hidden);
 
+/// Kinds of ILP solvers available to the stack cache analysis.
+enum ILPSolverKind {
+  ILP_Builtin,
+  ILP_External
+};
+
+/// Option to select the ILP solver used by the stack cache analysis.
+static cl::opt<ILPSolverKind> ILPEngine(
+  "mpatmos-ilp-engine",
+  cl::init(ILP_Builtin),
+  cl::desc("ILP solver used by the stack cache analysis."),
+  cl::values(
+    clEnumValN(ILP_Builtin, "builtin",
+               "In-process solver, falling back to -mpatmos-ilp-solver "
+               "(default)"),
+    clEnumValN(ILP_External, "external",
+               "External solver given by -mpatmos-ilp-solver"),
+    clEnumValEnd),
+  cl::Hidden);
+
+/// Option to specify a file caching the solutions of ILPs across compiler
+/// runs, e.g., for incremental rebuilds.
+static cl::opt<std::string> ILPCacheFile(
+  "mpatmos-ilp-cache",
+  cl::desc("File caching solutions of ILPs solved during stack cache "
+           "analysis."),
+  cl::Hidden);
+
+/// Option to specify the number of threads solving independent ILPs.
+static cl::opt<unsigned> ILPThreads(
+  "mpatmos-ilp-threads",
+  cl::init(0),
+  cl::desc("Number of threads solving ILPs concurrently (default: number of "
+           "hardware threads)."),
+  cl::Hidden);
+
+/// Option to specify the number of threads analyzing functions concurrently.
+static cl::opt<unsigned> SCAThreads(
+  "mpatmos-sca-threads",
+  cl::init(1),
+  cl::desc("Number of threads analyzing functions concurrently during Stack "
+           "Cache Analysis, 0 uses all hardware threads (default: 1)."),
+  cl::Hidden);
+
 /// Option to specify a file containing user-supplied bounds when solving ILP
 /// problems (for regions of the call graph with recursion).
 static cl::opt<std::string> BoundsFile(
@@ -168,9 +219,20 @@ namespace llvm {
   /// Count the total number of nodes in the pruned SCA graph.
   STATISTIC(PrunedSCAGraphSize, "Pruned SCA graph size.");
 
+  /// Count the number of calling contexts not expanded in the SCA graph, since
+  /// they are dominated by a spill-free context.
+  STATISTIC(DominatedSCAContexts,
+            "Calling contexts merged into dominating spill-free contexts.");
+
   /// Count the total number of ILPs solved.
   STATISTIC(ILPs, "Number of ILPs solved.");
 
+  /// Accumulate the time spent solving ILPs.
+  STATISTIC(ILPSolveTime, "Time spent solving ILPs (in microseconds).");
+
+  /// Count the number of ILPs whose solution was known already.
+  STATISTIC(ILPCacheHits, "Number of ILPs reused from earlier solutions.");
+
   /// Count the total number of functions (excluding dead functions).
   STATISTIC(Functions, "Number of machine functions.");
 
@@ -206,6 +268,39 @@ namespace llvm {
   STATISTIC(GlobalEnsureFillingFree,
    "Number of omitted SENS instructions - global restore analysis.");
 
+  /// Marks call sites without a value, e.g., sites in unreachable code.
+  static const unsigned int UndefinedSiteValue =
+                                          std::numeric_limits<unsigned>::max();
+
+  /// parallelFor - Invoke Fn for the indices 0 to NumJobs-1 using up to
+  /// NumThreads threads (0 = number of hardware threads). Fn has to be safe to
+  /// run concurrently for different indices.
+  template<typename FnT>
+  static void parallelFor(unsigned NumJobs, unsigned NumThreads, FnT Fn)
+  {
+    if (NumThreads == 0)
+      NumThreads = std::thread::hardware_concurrency();
+    NumThreads = std::min(NumThreads, NumJobs);
+
+    if (NumThreads <= 1) {
+      for(unsigned i = 0; i < NumJobs; i++)
+        Fn(i);
+    }
+    else {
+      std::atomic<unsigned> next(0);
+      std::vector<std::thread> workers;
+      for(unsigned t = 0; t < NumThreads; t++) {
+        workers.push_back(std::thread([&]() {
+          for(unsigned i = next++; i < NumJobs; i = next++)
+            Fn(i);
+        }));
+      }
+
+      for(unsigned t = 0; t < NumThreads; t++)
+        workers[t].join();
+    }
+  }
+
   /// Prefixes for ILP variable names
   enum ilp_prefix {
     T,
@@ -235,6 +330,9 @@ namespace llvm {
   /// Set of SCANodes.
   typedef std::set<SCANode*> SCANodeSet;
 
+  /// List of SCANodes.
+  typedef std::vector<SCANode*> SCANodes;
+
   /// Set of SCAEdges.
   typedef std::set<SCAEdge> SCAEdgeSet;
 
@@ -509,6 +607,16 @@ namespace llvm {
       return Root;
     }
 
+    /// findNode - Return the SCA node of a call graph node for the given
+    /// occupancy, or NULL if no such node exists (yet).
+    SCANode *findNode(MCGNode *node, const CostPair &occupancy) const
+    {
+      MCGSCANodeMap::const_iterator tmp(Nodes.find(
+          std::make_pair(node, occupancy)));
+
+      return tmp == Nodes.end() ? NULL : tmp->second;
+    }
+
     /// makeNode - Construct a new SCA node or return an already existing one.
     /// Returns true when the node was newly created, false otherwise. The node
     /// itself is returned using the argument result.
@@ -822,33 +930,32 @@ namespace llvm {
   /// Pass to analyze the occupancy and displacement of Patmos' stack cache.
   class PatmosStackCacheAnalysis : public MachineModulePass {
   private:
-    /// Work list of basic blocks.
-    typedef std::set<MachineBasicBlock*> MBBs;
-
     /// Set of call graph nodes.
     typedef std::set<MCGNode*> MCGNodeSet;
 
     /// Set of call graph sites.
     typedef std::set<MCGSite*> MCGSiteSet;
 
-    /// List of call graph SCCs and a flag indicating whether the SCC actually
-    /// contains loops.
-    typedef std::vector<std::pair<MCGNodes, bool> > MCGNSCCs;
+    /// Data-flow solver over the basic blocks of a function, with unsigned
+    /// integer values.
+    typedef PatmosBlockDataFlow<unsigned int> MBBDataFlow;
 
-    /// Map basic blocks to an unsigned integer.
-    typedef std::map<MachineBasicBlock*, unsigned int> MBBUInt;
+    /// Data-flow solver over the basic blocks of a function, with boolean
+    /// values.
+    typedef PatmosBlockDataFlow<bool> MBBBoolDataFlow;
 
-    /// Map basic blocks to a boolean.
-    typedef std::map<MachineBasicBlock*, bool> MBBBool;
+    /// Unsigned integers for the basic blocks of all functions, indexed by
+    /// getBlockIndex.
+    typedef std::vector<unsigned int> MBBUInts;
 
     /// Map call graph nodes to booleans.
-    typedef std::map<MCGNode*, bool> MCGNodeBool;
-
-    /// Map call graph nodes to their (potentially trivial SCC).
-    typedef std::map<MCGNode*, std::pair<MCGNodes, bool>*> MCGNodeSCC;
+    typedef DenseMap<MCGNode*, bool> MCGNodeBool;
 
     /// Map call graph nodes to an unsigned integer.
-    typedef std::map<MCGNode*, unsigned int> MCGNodeUInt;
+    typedef DenseMap<MCGNode*, unsigned int> MCGNodeUInt;
+
+    /// Counters for all call graph nodes, indexed by MCGNode::getIndex.
+    typedef std::vector<unsigned int> MCGNodeCounts;
 
     struct MCGSiteCompare {
       bool operator()(const MCGSite *lhs, const MCGSite *rhs) const {
@@ -867,16 +974,71 @@ namespace llvm {
       }
     };
 
-    /// Map call sites to an unsigned integer.
-    typedef std::map<MCGSite*, unsigned int> MCGSiteUInt;
-    typedef std::map<MCGSite*, unsigned int, MCGSiteCompare> MCGSiteUIntSort;
+    /// Set of call sites, sorted by caller and instruction.
+    typedef std::set<MCGSite*, MCGSiteCompare> MCGSiteSort;
+
+    /// Unsigned integers for all call sites, indexed by MCGSite::getIndex.
+    /// Sites without a value are set to UndefinedSiteValue.
+    typedef std::vector<unsigned int> MCGSiteUInts;
 
     /// List of ensures and their effective sizes.
     typedef std::map<MachineInstr*, unsigned int> SIZEs;
 
+    /// Lists of ensures for all call graph nodes, indexed by
+    /// MCGNode::getIndex.
+    typedef std::vector<SIZEs> MCGNodeSIZEs;
+
     typedef std::map<const MachineInstr*, std::pair<MachineBasicBlock*,
                                                     unsigned> > MInstrIndex;
 
+    /// An ILP problem along with its solution.
+    struct ILPJob {
+      /// The problem in LP format.
+      std::string LP;
+
+      /// Content hash of the problem, see getPatmosLPHash.
+      std::string Hash;
+
+      /// Flag indicating whether the objective function is maximized.
+      bool Maximize;
+
+      /// Outcome of solving the problem.
+      PatmosILPSolver::Status Status;
+
+      /// Value of the objective function.
+      double Value;
+
+      /// Name of the solver that solved the problem.
+      const char *Solver;
+
+      /// Error message of the solver.
+      std::string ErrMsg;
+
+      /// Time spent solving the problem (in seconds).
+      double Time;
+
+      /// Index of the job actually solving the problem, e.g., when problems
+      /// are equivalent.
+      unsigned Representative;
+
+      /// Flag indicating whether the solution was taken from the ILP cache.
+      bool Cached;
+
+      ILPJob(const std::string &lp, bool maximize) : LP(lp),
+        Maximize(maximize), Status(PatmosILPSolver::Failed), Value(-1.),
+        Solver(""), Time(0), Representative(0), Cached(false) {}
+    };
+
+    /// List of ILP problems.
+    typedef std::vector<ILPJob> ILPJobs;
+
+    /// Map content hashes of ILP problems to their solution.
+    typedef std::map<std::string, unsigned int> ILPSolutions;
+
+    /// Index of the first basic block of each function in MBBUInts, indexed
+    /// by MCGNode::getIndex.
+    MCGNodeCounts BlockIndexBase;
+
     /// Track for each call graph node the maximum stack displacement.
     MCGNodeUInt MaxDisplacement;
 
@@ -897,11 +1059,11 @@ namespace llvm {
 
     /// Track the worst-case stack occupancy before every call site, assuming
     /// a full stack cache on function entry.
-    MCGSiteUInt WorstCaseSiteOccupancy;
+    MCGSiteUInts WorstCaseSiteOccupancy;
 
     /// Track the worst-case stack occupancy before every call site, assuming
     /// a full stack cache on function entry.
-    MCGSiteUInt WorstCaseSpillDirty;
+    MCGSiteUInts WorstCaseSpillDirty;
 
     /// Track functions with call-free paths in them.
     MCGNodeBool IsCallFree;
@@ -912,42 +1074,42 @@ namespace llvm {
 
     /// Track the minimal area of dead data at the bottom of the stack frame for
     /// each basic block.
-    MBBUInt WorstCaseBlockDP;
+    MBBUInts WorstCaseBlockDP;
 
     // Track the maximal area of potentially live data at the bottom of the
     // stack frame at basic blocks.
-    MBBUInt WorstCaseBlockRP;
+    MBBUInts WorstCaseBlockRP;
 
     // Track the lowest possible position of the LP
-    MBBUInt WorstCaseBlockLP;
+    MBBUInts WorstCaseBlockLP;
 
     // Track worst-case number of blocks that are not ensured by subsequent
     // sens instructions, i.e., that have to be filled in case of a preemption
-    MBBUInt WorstCaseLocalEnsureFilling;
+    MBBUInts WorstCaseLocalEnsureFilling;
 
     // Track number of blocks that have to be restored by ensure instructions
     // of other functions in case of a preemption.
     MCGNodeUInt WorstCaseGlobalEnsureFilling;
 
     // Minimum filling bound associated with next ensure following a call site.
-    MCGSiteUInt WorstCaseSiteEnsureBound;
+    MCGSiteUInts WorstCaseSiteEnsureBound;
 
     // Filling bounds associated with ensure instructions.
     SIZEs WorstCaseEnsureBound;
 
     // Track minimal reduction in spilling due to preemption.
-    MBBUInt ReserveGain;
+    MBBUInts ReserveGain;
 
     // Track worst-case stack occupancy for each basic block.
-    MBBUInt WorstCaseBlockOccupancy;
+    MBBUInts WorstCaseBlockOccupancy;
 
     // Worst-case number of blocks that need to be saved when a task i
     // preempted.
-    MBBUInt WorstCaseBlockSaving;
+    MBBUInts WorstCaseBlockSaving;
 
     // Worst-case number of blocks that need to be restored when a task was
     // preempted and is reactivated.
-    MBBUInt WorstCaseBlockRestoring;
+    MBBUInts WorstCaseBlockRestoring;
 
     ////////////////////////////////////////////////////////////////////////////
 
@@ -964,6 +1126,18 @@ namespace llvm {
     /// Bounds to solve ILPs during stack cache analysis.
     const BoundsInformation BI;
 
+    /// In-process solver for the ILPs of SCCs in the call graph.
+    OwningPtr<PatmosILPSolver> BuiltinILPSolver;
+
+    /// External solver, used as a fallback for the built-in solver.
+    OwningPtr<PatmosILPSolver> ExternalILPSolver;
+
+    /// Solutions of ILPs solved so far, or read from the ILP cache file.
+    ILPSolutions ILPCache;
+
+    /// Flag indicating whether solutions were added to the ILP cache.
+    bool ILPCacheModified;
+
     MInstrIndex MiMap;
   public:
     /// Pass ID
@@ -971,7 +1145,10 @@ namespace llvm {
 
     PatmosStackCacheAnalysis(const PatmosTargetMachine &tm) :
         MachineModulePass(ID), STC(tm.getSubtarget<PatmosSubtarget>()),
-        TII(*tm.getInstrInfo()), SCAGraph(STC), BI(BoundsFile)
+        TII(*tm.getInstrInfo()), SCAGraph(STC), BI(BoundsFile),
+        BuiltinILPSolver(createPatmosBuiltinILPSolver()),
+        ExternalILPSolver(createPatmosExternalILPSolver(Solve_ilp)),
+        ILPCacheModified(false)
     {
       initializePatmosCallGraphBuilderPass(*PassRegistry::getPassRegistry());
     }
@@ -996,6 +1173,65 @@ namespace llvm {
         return a - b;
     }
 
+    /// getBlockIndex - Get the index of a basic block of a call graph node's
+    /// function in MBBUInts.
+    unsigned int getBlockIndex(const MCGNode *Node,
+                               const MachineBasicBlock *MBB) const
+    {
+      assert(Node->getMF() == MBB->getParent());
+      return BlockIndexBase[Node->getIndex()] + MBB->getNumber();
+    }
+
+    /// indexBlocks - Number the basic blocks of all functions and allocate
+    /// the per-block and per-site analysis results.
+    void indexBlocks(const MCallGraph &G)
+    {
+      const MCGNodes &nodes(G.getNodes());
+      unsigned int numBlocks = 0;
+
+      BlockIndexBase.assign(nodes.size(), 0);
+      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
+          i++) {
+        if (!(*i)->isUnknown()) {
+          BlockIndexBase[(*i)->getIndex()] = numBlocks;
+          numBlocks += (*i)->getMF()->getNumBlockIDs();
+        }
+      }
+
+      WorstCaseBlockDP.assign(numBlocks, 0);
+      WorstCaseBlockRP.assign(numBlocks, 0);
+      WorstCaseBlockLP.assign(numBlocks, 0);
+      WorstCaseLocalEnsureFilling.assign(numBlocks, 0);
+      ReserveGain.assign(numBlocks, 0);
+      WorstCaseBlockOccupancy.assign(numBlocks, 0);
+      WorstCaseBlockSaving.assign(numBlocks, 0);
+      WorstCaseBlockRestoring.assign(numBlocks, 0);
+
+      unsigned int numSites = G.getSites().size();
+      WorstCaseSiteOccupancy.assign(numSites, UndefinedSiteValue);
+      WorstCaseSpillDirty.assign(numSites, UndefinedSiteValue);
+      WorstCaseSiteEnsureBound.assign(numSites, UndefinedSiteValue);
+    }
+
+    /// forEachFunction - Invoke Fn for the call graph nodes of all live
+    /// functions, possibly concurrently. Fn may only modify data associated
+    /// with the function it is invoked for, while results computed for the
+    /// call graph as a whole can be read.
+    template<typename FnT>
+    void forEachFunction(const MCallGraph &G, FnT Fn)
+    {
+      MCGNodes functions;
+      for(MCGNodes::const_iterator i(G.getNodes().begin()),
+          ie(G.getNodes().end()); i != ie; i++) {
+        if (!(*i)->isUnknown() && !(*i)->isDead())
+          functions.push_back(*i);
+      }
+
+      parallelFor(functions.size(), SCAThreads, [&](unsigned i) {
+        Fn(functions[i]);
+      });
+    }
+
     // getMaxOccupancy - The maximum occupancy at the entry of a function, i.e.,
     // after its sres.
     unsigned int getMaxOccupancy(MCGNode *node) const
@@ -1122,22 +1358,21 @@ namespace llvm {
       }
       else {
         unsigned int k = getBytesReserved(node);
+        unsigned int siteBound = WorstCaseSiteEnsureBound[site->getIndex()];
 
-        MCGSiteUInt::const_iterator siteBound(
-                                            WorstCaseSiteEnsureBound.find(site));
-
-        assert(siteBound != WorstCaseSiteEnsureBound.end() && !node->isDead());
+        assert(siteBound != UndefinedSiteValue && !node->isDead());
 
-        return k - siteBound->second;
+        return k - siteBound;
       }
     }
 
     /// computeMinMaxDisplacement - Visit a call graph node and determine its
     /// minimum/maximum displacement, including all its children in the call
     /// graph.
-    void computeMinMaxDisplacement(MCGNodeSCC &SCCMap, MCGNode *Node,
-                                   MCGNodeUInt &succCount, MCGNodes &WL,
-                                   bool Maximize)
+    void computeMinMaxDisplacement(const MCallGraph &G, MCGNode *Node,
+                                   MCGNodeCounts &succCount, MCGNodes &WL,
+                                   bool Maximize,
+                                   const MCGNodeUInt &ILPResults)
     {
       // keep track of the total displacement of the node and its children
       unsigned int totalDisplacment;
@@ -1151,12 +1386,12 @@ namespace llvm {
         // ok, dead nodes don't do anything
         return;
       }
-      else if (SCCMap[Node]->second) {
-        // the node is in an SCC! -> make an ILP
-        // note: we know here that all successors of the entire SCC have been
-        // handled
-        totalDisplacment = computeMinMaxDisplacementILP(SCCMap[Node]->first,
-                                                        Node, Maximize);
+      else if (G.getSCC(Node).HasLoop) {
+        // the node is in an SCC! -> the ILP has been solved already
+        // see solveMinMaxDisplacementILPs
+        MCGNodeUInt::const_iterator result(ILPResults.find(Node));
+        assert(result != ILPResults.end());
+        totalDisplacment = result->second;
         assert(totalDisplacment >= nodeDisplacement);
       }
       else {
@@ -1198,14 +1433,14 @@ namespace llvm {
       // get unique predecessors in the call graph, excluding dead functions and
       // predecessors within the same SCC
       MCGNodeSet preds;
-      const MCGSites &callingSites(Node->getCallingSites());
-      for(MCGSites::const_iterator i(callingSites.begin()),
-          ie(callingSites.end()); i != ie; i++) {
-        MCGNode *caller = (*i)->getCaller();
-        assert(caller->isDead() || SCCMap.count(caller));
+      unsigned int nodeSCC = G.getSCCIndex(Node);
+      ArrayRef<unsigned> callers(G.getCallers(Node));
+      for(ArrayRef<unsigned>::iterator i(callers.begin()), ie(callers.end());
+          i != ie; i++) {
+        MCGNode *caller = G.getNodes()[*i];
         // do not consider dead functions and functions in the same SCC here
-        if (!caller->isDead() && SCCMap[caller] != SCCMap[Node]) {
-          const MCGNodes &predSCC(SCCMap[caller]->first);
+        if (!caller->isDead() && G.getSCCIndex(caller) != nodeSCC) {
+          const MCGNodes &predSCC(G.getSCC(caller).Nodes);
           preds.insert(predSCC.begin(), predSCC.end());
         }
       }
@@ -1213,8 +1448,8 @@ namespace llvm {
       // update the work list by checking the predecessor list
       for(MCGNodeSet::const_iterator i(preds.begin()), ie(preds.end()); i != ie;
           i++) {
-        assert(succCount[*i] > 0);
-        if (--succCount[*i] == 0)
+        assert(succCount[(*i)->getIndex()] > 0);
+        if (--succCount[(*i)->getIndex()] == 0)
           WL.push_back(*i);
       }
     }
@@ -1230,76 +1465,66 @@ namespace llvm {
     ///
     /// Note that SCCs are considered as if they were collapsed into a single
     /// node. Within SCCs an ILP formulation is used to bound the displacement.
+    /// All nodes on the work list are independent of each other, their ILPs
+    /// are thus solved together (and concurrently).
     ///
-    /// \see computeMinMaxDisplacementILP
+    /// \see makeMinMaxDisplacementILP
     void computeMinMaxDisplacement(const MCallGraph &G, bool Maximize)
     {
-      // list of SCCs in the call graph and mapping to/from call graph nodes
-      MCGNSCCs SCCs;
-      MCGNodeSCC SCCMap;
-
-      // get all call graph nodes
+      // get all call graph nodes and the SCCs of the call graph
       const MCGNodes &nodes(G.getNodes());
-
-      // make sure we have enough space for all SCCs without re-allocation
-      SCCs.reserve(nodes.size());
-
-      // get SCCs
-      typedef scc_iterator<MCallGraph> PCGSCC_iterator;
-      for(PCGSCC_iterator s(scc_begin(G)); !s.isAtEnd(); s++) {
-
-        // keep track of call graph nodes and their SCCs.
-        SCCs.push_back(std::make_pair(*s, s.hasLoop()));
-        for(MCGNodes::iterator n((*s).begin()), ne((*s).end()); n != ne; n++) {
-          SCCMap[*n] = &SCCs.back();
-        }
-
-      }
-      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
-            i++) {
-        if (!(*i)->isDead() && !SCCMap.count(*i))
-          dbgs() << "missing: " << **i << "\n";
-      }
+      const MCGSCCs &SCCs(G.getSCCs());
 
       // initialize the work list and successor counters
-      MCGNodeUInt succCount;
+      MCGNodeCounts succCount(nodes.size(), 0);
       MCGNodes WL;
-      for(MCGNSCCs::const_iterator i(SCCs.begin()), ie(SCCs.end()); i != ie;
-          i++) {
+      for(unsigned int i = 0, ie = SCCs.size(); i != ie; i++) {
         // get info of the current SCC
-        const MCGNodes *SCC = &i->first;
+        const MCGNodes &SCC(SCCs[i].Nodes);
 
         // get the number of successors of the SCC that are not in that SCC.
         MCGNodeSet succs;
-        for(MCGNodes::const_iterator j(SCC->begin()), je(SCC->end()); j != je;
+        for(MCGNodes::const_iterator j(SCC.begin()), je(SCC.end()); j != je;
             j++) {
-          for(MCGSites::const_iterator k((*j)->getSites().begin()),
-              ke((*j)->getSites().end()); k != ke; k++) {
+          ArrayRef<unsigned> callees(G.getCallees(*j));
+          for(ArrayRef<unsigned>::iterator k(callees.begin()),
+              ke(callees.end()); k != ke; k++) {
             // check if the two are in the same SCC
-            if (&SCCMap[(*k)->getCallee()]->first != SCC) {
-              succs.insert((*k)->getCallee());
+            if (G.getSCCIndex(nodes[*k]) != i) {
+              succs.insert(nodes[*k]);
             }
           }
         }
 
         // be sure to keep all nodes within an SCC off the WL for now
-        for(MCGNodes::const_iterator j(SCC->begin()), je(SCC->end()); j != je;
+        for(MCGNodes::const_iterator j(SCC.begin()), je(SCC.end()); j != je;
             j++) {
           if (succs.size() == 0)
             WL.push_back(*j);
           else
-            succCount[*j] = succs.size();
+            succCount[(*j)->getIndex()] = succs.size();
         }
       }
 
       // process nodes in topological order
       while(!WL.empty()) {
-        // pop some node from the work list
-        MCGNode *tmp = WL.back();
-        WL.pop_back();
-
-        // compute its displacement
-        computeMinMaxDisplacement(SCCMap, tmp, succCount, WL, Maximize);
+        // take all nodes from the work list
+        MCGNodes batch;
+        batch.swap(WL);
+
+        // solve the ILPs of nodes in SCCs
+        MCGNodeUInt ILPResults;
+        solveMinMaxDisplacementILPs(G, batch, Maximize, ILPResults);
+
+        while(!batch.empty()) {
+          // pop some node from the batch
+          MCGNode *tmp = batch.back();
+          batch.pop_back();
+
+          // compute its displacement
+          computeMinMaxDisplacement(G, tmp, succCount, WL, Maximize,
+                                    ILPResults);
+        }
       }
 
 #ifdef PATMOS_TRACE_CG_DISPLACMENT
@@ -1361,11 +1586,11 @@ namespace llvm {
     /// to ensure instructions. This information can be used to downsize or
     /// remove ensures.
     // TODO: check for STCr
-    void propagateLiveArea(MBBs &WL, MBBUInt &INs, MCGNode *Node,
+    void propagateLiveArea(MBBDataFlow &DF, MCGNode *Node,
                            SIZEs &ENSs, MachineBasicBlock *MBB)
     {
       // get the size of the live stack area from the CFG successors
-      unsigned int liveAreaSize = INs[MBB];
+      unsigned int liveAreaSize = DF.get(MBB);
 
       // propagate within the basic block
       for(MachineBasicBlock::reverse_instr_iterator i(MBB->instr_rbegin()),
@@ -1396,17 +1621,17 @@ namespace llvm {
       /// current basic block assuming a preemption in a preceding basic block.
       /// Since the analysis goes upward, the result is set at the output of
       /// the analyzed basic block.
-      WorstCaseBlockRP[MBB] = liveAreaSize;
+      WorstCaseBlockRP[getBlockIndex(Node, MBB)] = liveAreaSize;
 
       // propagate to CFG predecessors
       for(MachineBasicBlock::pred_iterator i(MBB->pred_begin()),
           ie(MBB->pred_end()); i != ie; i++) {
         // check if the new live area size is larger than what was known
         // previously for this predecessor
-        if (INs[*i] < liveAreaSize) {
+        if (DF.get(*i) < liveAreaSize) {
           // update the predecessor's live area size and put it on the work list
-          INs[*i] = liveAreaSize;
-          WL.insert(*i);
+          DF.set(*i, liveAreaSize);
+          DF.push(*i);
         }
       }
 
@@ -1418,70 +1643,53 @@ namespace llvm {
     /// remove ensures.
     void propagateLiveArea(const MCallGraph &G)
     {
-      const MCGNodes &nodes(G.getNodes());
-
       // visit all functions
-      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
-          i++) {
-        if (!(*i)->isUnknown() && !(*i)->isDead()) {
-          MBBs WL;
-          SIZEs ENSs;
-          MBBUInt INs;
-          MachineFunction *MF = (*i)->getMF();
-
-          MCGNodes::const_iterator j = i;
-
-          // initialize work list (yeah, reverse-reverse post order would be
-          // optimal, but this works too).
-          for(MachineFunction::iterator i(MF->begin()), ie(MF->end()); i != ie;
-              i++) {
-            WL.insert(i);
-          }
-
-          // process until the work list becomes empty
-          while (!WL.empty()) {
-            // get some basic block
-            MachineBasicBlock *MBB = *WL.begin();
-            WL.erase(WL.begin());
+      forEachFunction(G, [&](MCGNode *Node) {
+        SIZEs ENSs;
+        MachineFunction *MF = Node->getMF();
+        MBBDataFlow DF(*MF, MBBDataFlow::Backward);
 
-            // update the basic block's information, potentially putting any of
-            // its predecessors on the work list.
-            propagateLiveArea(WL, INs, *j, ENSs, MBB);
-          }
+        // initialize work list with all basic blocks.
+        DF.pushAll();
 
+        // process until the work list becomes empty, the basic block's
+        // information is updated, potentially putting any of its predecessors
+        // on the work list.
+        DF.solve([&](MachineBasicBlock *MBB) {
+          propagateLiveArea(DF, Node, ENSs, MBB);
+        });
 
-          // actually update the sizes of the ensure instructions.
-          if (EnableEnsureDwn) {
-            for(SIZEs::const_iterator i(ENSs.begin()), ie(ENSs.end()); i != ie;
-                i++) {
-              i->first->getOperand(2).setImm(i->second);
-            }
+        // actually update the sizes of the ensure instructions.
+        if (EnableEnsureDwn) {
+          for(SIZEs::const_iterator i(ENSs.begin()), ie(ENSs.end()); i != ie;
+              i++) {
+            i->first->getOperand(2).setImm(i->second);
           }
+        }
 
 #ifdef PATMOS_TRACE_BB_LIVEAREA
-          DEBUG(
-            dbgs() << "*************************** "
-                   << MF->getFunction()->getName() << "\n";
-            for(MBBUInt::const_iterator i(INs.begin()), ie(INs.end()); i != ie;
-                i++) {
-              dbgs() << "  " << i->first->getName()
-                    << "(" << i->first->getNumber() << ")"
-                    << ": " << i->second << "\n";
-            }
-          );
+        DEBUG(
+          dbgs() << "*************************** "
+                 << MF->getFunction()->getName() << "\n";
+          for(MachineFunction::iterator i(MF->begin()), ie(MF->end()); i != ie;
+              i++) {
+            dbgs() << "  " << i->getName()
+                  << "(" << i->getNumber() << ")"
+                  << ": " << DF.get(i) << "\n";
+          }
+        );
 #endif // PATMOS_TRACE_BB_LIVEAREA
-        }
-      }
+      });
     }
 
     /// propagateReserveGain - Propagate the minimum reduction in spilling at
     /// the reserve instructions of subsequent call sites upwards through the
     /// CFG.
-    void propagateReserveGain(MBBs &WL, MBBUInt &INs,
+    void propagateReserveGain(MBBDataFlow &DF,
                               MCGNode *Node, MachineBasicBlock *MBB)
     {
       // get the reserve gain from the CFG successors
-      unsigned int siteGain = INs[MBB];
+      unsigned int siteGain = DF.get(MBB);
       unsigned int k = getBytesReserved(Node);
 
       // propagate within the basic block
@@ -1492,8 +1700,9 @@ namespace llvm {
         if (i->isCall()) {
           MCGSite *site = Node->findSite(&*i);
           unsigned int minDisp = getMinDisplacement(site->getCallee());
-          unsigned int minOccupancy = std::min(WorstCaseBlockOccupancy[MBB],
-                                               getMinOccupancy(Node));
+          unsigned int minOccupancy = std::min(
+                          WorstCaseBlockOccupancy[getBlockIndex(Node, MBB)],
+                          getMinOccupancy(Node));
 
           unsigned int minSpill = safeUIntDiff(minOccupancy + minDisp,
                                                STC.getStackCacheSize());
@@ -1509,7 +1718,7 @@ namespace llvm {
       /// assuming a preemption in a preceding basic block. Since the analysis
       /// goes upward, the result is set at the output of the analyzed
       /// basic block.
-      ReserveGain[MBB] = siteGain;
+      ReserveGain[getBlockIndex(Node, MBB)] = siteGain;
 
       // propagate to CFG predecessors
       for(MachineBasicBlock::pred_iterator i(MBB->pred_begin()),
@@ -1517,10 +1726,10 @@ namespace llvm {
         /// check if the new gain is less than what was known previously for
         /// this predecessor. Also, insert predecessors that have not been
         /// already visited.
-        if ((INs.find(*i) == INs.end()) || (INs[*i] > siteGain)) {
+        if (!DF.isDefined(*i) || (DF.get(*i) > siteGain)) {
           // update the predecessor's gain and put it on the work list
-          INs[*i] = siteGain;
-          WL.insert(*i);
+          DF.set(*i, siteGain);
+          DF.push(*i);
         }
       }
     }
@@ -1530,46 +1739,31 @@ namespace llvm {
     /// CFG.
     void propagateReserveGain(const MCallGraph &G)
     {
-      const MCGNodes &nodes(G.getNodes());
-
       // visit all functions
-      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
-          i++) {
-        if (!(*i)->isUnknown() && !(*i)->isDead()) {
-          MBBs WL;
-          MBBUInt INs;
-          MachineFunction *MF = (*i)->getMF();
-
-          // initialize work list (yeah, reverse-reverse post order would be
-          // optimal, but this works too).
-          for(MachineFunction::iterator j(MF->begin()), je(MF->end()); j != je;
-              j++) {
-            WL.insert(j);
-          }
-
-          // process until the work list becomes empty
-          while (!WL.empty()) {
-            // get some basic block
-            MachineBasicBlock *MBB = *WL.begin();
-            WL.erase(WL.begin());
-
-            // update the basic block's information, potentially putting any of
-            // its predecessors on the work list.
-            propagateReserveGain(WL, INs, *i, MBB);
-          }
-        }
-      }
+      forEachFunction(G, [&](MCGNode *Node) {
+        MBBDataFlow DF(*Node->getMF(), MBBDataFlow::Backward);
+
+        // initialize work list with all basic blocks.
+        DF.pushAll();
+
+        // process until the work list becomes empty, the basic block's
+        // information is updated, potentially putting any of its predecessors
+        // on the work list.
+        DF.solve([&](MachineBasicBlock *MBB) {
+          propagateReserveGain(DF, Node, MBB);
+        });
+      });
     }
 
     /// propagateLocalEnsureFilling - Propagate the maximum number of blocks
     /// that are filled by the next ensure instruction after a preemption
     /// upwards through the CFG. Also associate call sites with worst-case
     /// filling.
-    void propagateLocalEnsureFilling(MBBs &WL, MBBUInt &INs,
+    void propagateLocalEnsureFilling(MBBDataFlow &DF,
                                      MCGNode *Node, MachineBasicBlock *MBB)
     {
       // get the number of filled blocks from the CFG successors
-      unsigned int ensureBound = INs[MBB];
+      unsigned int ensureBound = DF.get(MBB);
 
       // propagate within the basic block
       for(MachineBasicBlock::reverse_instr_iterator i(MBB->instr_rbegin()),
@@ -1578,14 +1772,16 @@ namespace llvm {
         // check for ensures
         if (i->getOpcode() == Patmos::SENSi) {
           assert(i->getOperand(2).isImm());
-          assert(WorstCaseEnsureBound.find(&*i) != WorstCaseEnsureBound.end());
 
-          ensureBound = WorstCaseEnsureBound[&*i];
+          SIZEs::const_iterator bound(WorstCaseEnsureBound.find(&*i));
+          assert(bound != WorstCaseEnsureBound.end());
+
+          ensureBound = bound->second;
         }
         // check for calls
         else if (i->isCall()) {
           MCGSite *site = Node->findSite(&*i);
-          WorstCaseSiteEnsureBound[site] = ensureBound;
+          WorstCaseSiteEnsureBound[site->getIndex()] = ensureBound;
         }
       }
 
@@ -1593,17 +1789,18 @@ namespace llvm {
       /// next ensure in the current basic block assuming a preemption in a
       /// preceding basic block. Since the analysis goes upward, the result
       /// is set at the output of the analyzed basic block.
-      WorstCaseLocalEnsureFilling[MBB] = getBytesReserved(Node) - ensureBound;
+      WorstCaseLocalEnsureFilling[getBlockIndex(Node, MBB)] =
+                                          getBytesReserved(Node) - ensureBound;
 
       // propagate to CFG predecessors
       for(MachineBasicBlock::pred_iterator i(MBB->pred_begin()),
           ie(MBB->pred_end()); i != ie; i++) {
         // check if the new filling size is less than what was known
         // previously for this predecessor
-        if ((INs.find(*i) == INs.end()) || (INs[*i] > ensureBound)) {
+        if (!DF.isDefined(*i) || (DF.get(*i) > ensureBound)) {
           // update the predecessor's filling size and put it on the work list
-          INs[*i] = ensureBound;
-          WL.insert(*i);
+          DF.set(*i, ensureBound);
+          DF.push(*i);
         }
       }
     }
@@ -1614,43 +1811,33 @@ namespace llvm {
     /// filling.
     void propagateLocalEnsureFilling(const MCallGraph &G)
     {
-      const MCGNodes &nodes(G.getNodes());
-
       // visit all functions
-      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
-          i++) {
-        if (!(*i)->isUnknown() && !(*i)->isDead()) {
-          MBBs WL;
-          MBBUInt INs;
-          MachineFunction *MF = (*i)->getMF();
-
-          // initialize work list (yeah, reverse-reverse post order would be
-          // optimal, but this works too).
-          for(MachineFunction::iterator j(MF->begin()), je(MF->end()); j != je;
-              j++) {
-            WL.insert(j);
-            INs[j] = getBytesReserved(*i);
-          }
-
-          // process until the work list becomes empty
-          while (!WL.empty()) {
-            // get some basic block
-            MachineBasicBlock *MBB = *WL.begin();
-            WL.erase(WL.begin());
+      forEachFunction(G, [&](MCGNode *Node) {
+        MachineFunction *MF = Node->getMF();
+        MBBDataFlow DF(*MF, MBBDataFlow::Backward);
 
-            // update the basic block's information, potentially putting any of
-            // its predecessors on the work list.
-            propagateLocalEnsureFilling(WL, INs, *i, MBB);
-          }
+        // initialize work list with all basic blocks.
+        for(MachineFunction::iterator j(MF->begin()), je(MF->end()); j != je;
+            j++) {
+          DF.set(j, getBytesReserved(Node));
         }
-      }
+        DF.pushAll();
+
+        // process until the work list becomes empty, the basic block's
+        // information is updated, potentially putting any of its predecessors
+        // on the work list.
+        DF.solve([&](MachineBasicBlock *MBB) {
+          propagateLocalEnsureFilling(DF, Node, MBB);
+        });
+      });
     }
 
     /// propagateGlobalEnsureFilling - Propagate the worst-case filling caused
     /// at the ensure instruction of all the callers of a call graph node
     /// downwards through the call graph.
-    void propagateGlobalEnsureFilling(MCGNodeSCC &SCCMap, MCGNode *Node,
-                                      MCGNodeUInt &succCount, MCGNodes &WL)
+    void propagateGlobalEnsureFilling(const MCallGraph &G, MCGNode *Node,
+                                      MCGNodeCounts &succCount, MCGNodes &WL,
+                                      const MCGNodeUInt &ILPResults)
     {
       // keep track of the total ensure cost of the node and its parent
       unsigned int totalCost = 0;
@@ -1662,16 +1849,16 @@ namespace llvm {
 
       GlobalEnsureFillingTotal++;
 
-      if (SCCMap[Node]->second) {
+      if (G.getSCC(Node).HasLoop) {
         if (getMinDisplacement(Node) >= STC.getStackCacheSize()) {
           GlobalEnsureFillingILPFree++;
         }
         else {
-          // the node is in an SCC! -> make an ILP
-          // note: we know here that all predecessors of the entire SCC have been
-          // handled
-          totalCost = propagateGlobalEnsureFillingILP(SCCMap[Node]->first,
-                                                      Node);
+          // the node is in an SCC! -> the ILP has been solved already
+          // see solveGlobalEnsureFillingILPs
+          MCGNodeUInt::const_iterator result(ILPResults.find(Node));
+          assert(result != ILPResults.end());
+          totalCost = result->second;
           GlobalEnsureFillingILP++;
         }
       }
@@ -1707,16 +1894,14 @@ namespace llvm {
       // get unique successors in the call graph, excluding dead functions and
       // nodes within the same SCC
       MCGNodeSet succs;
-
-      const MCGSites &sites(Node->getSites());
-
-      for(MCGSites::const_iterator i(sites.begin()),
-          ie(sites.end()); i != ie; i++) {
-        MCGNode *callee = (*i)->getCallee();
-        assert(callee->isDead() || SCCMap.count(callee));
+      unsigned int nodeSCC = G.getSCCIndex(Node);
+      ArrayRef<unsigned> callees(G.getCallees(Node));
+      for(ArrayRef<unsigned>::iterator i(callees.begin()), ie(callees.end());
+          i != ie; i++) {
+        MCGNode *callee = G.getNodes()[*i];
         // do not consider dead functions and functions in the same SCC here
-        if (!callee->isDead() && SCCMap[callee] != SCCMap[Node]) {
-          const MCGNodes &succSCC(SCCMap[callee]->first);
+        if (!callee->isDead() && G.getSCCIndex(callee) != nodeSCC) {
+          const MCGNodes &succSCC(G.getSCC(callee).Nodes);
           succs.insert(succSCC.begin(), succSCC.end());
         }
       }
@@ -1724,39 +1909,55 @@ namespace llvm {
       // update the work list by checking the successor list
       for(MCGNodeSet::const_iterator i(succs.begin()), ie(succs.end()); i != ie;
           i++) {
-          if (--succCount[*i] == 0)
+          if (--succCount[(*i)->getIndex()] == 0)
             WL.push_back(*i);
       }
     }
 
-    /// propagateGlobalEnsureFillingILP - Propagate the worst-case filling
-    /// caused at the ensure instruction of all the callers of a call graph node
-    /// downwards through the call graph.
-    unsigned int propagateGlobalEnsureFillingILP(const MCGNodes &SCC,
-                                                 MCGNode *N)
+    /// solveGlobalEnsureFillingILPs - Construct and solve the ILPs of all
+    /// nodes of the batch that are within SCCs of the call graph. The nodes
+    /// of the batch have to be independent of each other.
+    void solveGlobalEnsureFillingILPs(const MCallGraph &G, const MCGNodes &Batch,
+                                      MCGNodeUInt &ILPResults)
     {
-      assert(std::find(SCC.begin(), SCC.end(), N) != SCC.end());
+      ILPJobs Jobs;
+      MCGNodes JobNodes;
+      for(MCGNodes::const_iterator i(Batch.begin()), ie(Batch.end()); i != ie;
+          i++) {
+        MCGNode *N = *i;
+        if (!N->isDead() && G.getSCC(N).HasLoop &&
+            getMinDisplacement(N) < STC.getStackCacheSize()) {
+          Jobs.push_back(ILPJob(makeGlobalEnsureFillingILP(G.getSCC(N).Nodes, N),
+                                true));
+          JobNodes.push_back(N);
+        }
+      }
 
-      // get user-supplied bounds to solve the ILP.
-      const SCCInfo &BInfo(BI.getInfo(SCC));
+      solve_ilps(Jobs);
 
-      // open LP file.
-      SmallString<1024> LPname;
-      error_code err = sys::fs::createUniqueDirectory("stack", LPname);
-      if (err) {
-        errs() << "Error creating temp .lp file: " << err.message() << "\n";
-        return std::numeric_limits<unsigned int>::max();
+      for(unsigned i = 0, ie = Jobs.size(); i < ie; i++) {
+        unsigned int result = Jobs[i].Value;
+        ILPResults[JobNodes[i]] = result;
+
+#ifdef PATMOS_TRACE_CG_ENS_COST_ILP
+        dbgs() << "ILP: " << *JobNodes[i] << ": " << result << "\n";
+#endif // PATMOS_TRACE_CG_ENS_COST_ILP
       }
+    }
+
+    /// makeGlobalEnsureFillingILP - Construct an ILP modeling the worst-case
+    /// filling caused at the ensure instruction of all the callers of a call
+    /// graph node within an SCC of the call graph.
+    std::string makeGlobalEnsureFillingILP(const MCGNodes &SCC, MCGNode *N)
+    {
+      assert(std::find(SCC.begin(), SCC.end(), N) != SCC.end());
 
-      sys::path::append(LPname, "scc.lp");
+      // get user-supplied bounds to solve the ILP.
+      const SCCInfo &BInfo(BI.getInfo(SCC));
 
-      std::string ErrMsg;
-      raw_fd_ostream OS(LPname.c_str(), ErrMsg);
-      if (!ErrMsg.empty()) {
-        errs() << "Error: Failed to open file '" << LPname.str()
-               << "' for writing!\n";
-        return std::numeric_limits<unsigned int>::max();
-      }
+      // construct the LP problem in memory.
+      std::string LP;
+      raw_string_ostream OS(LP);
 
       // find entry and exit call sites
       typedef std::set<MCGSite*> MCGSiteSet;
@@ -1996,20 +2197,7 @@ namespace llvm {
 
       OS << "End\n";
 
-      OS.close();
-
-      // solve the ILP
-      unsigned int result = solve_ilp(LPname.c_str(), true);
-
-#ifdef PATMOS_TRACE_CG_ENS_COST_ILP
-      dbgs() << "ILP: " << *N << ": " << result << "\n";
-#endif // PATMOS_TRACE_CG_ENS_COST_ILP
-
-      // remove LP file
-      // TODO do we need to remove the temp dir??
-      sys::fs::remove(LPname.str());
-
-      return result;
+      return OS.str();
     }
 
     /// propagateGlobalEnsureFilling - Propagate the worst-case filling caused
@@ -2017,74 +2205,67 @@ namespace llvm {
     /// downwards through the call graph.
     void propagateGlobalEnsureFilling(const MCallGraph &G)
     {
-      // list of SCCs in the call graph and mapping to/from call graph nodes
-      MCGNSCCs SCCs;
-      MCGNodeSCC SCCMap;
-
-      // get all call graph nodes
+      // get all call graph nodes and the SCCs of the call graph
       const MCGNodes &nodes(G.getNodes());
-
-      // make sure we have enough space for all SCCs without re-allocation
-      SCCs.reserve(nodes.size());
-
-      // get SCCs
-      typedef scc_iterator<MCallGraph> PCGSCC_iterator;
-      for(PCGSCC_iterator s(scc_begin(G)); !s.isAtEnd(); s++) {
-
-        // keep track of call graph nodes and their SCCs.
-        SCCs.push_back(std::make_pair(*s, s.hasLoop()));
-        for(MCGNodes::iterator n((*s).begin()), ne((*s).end()); n != ne; n++) {
-          SCCMap[*n] = &SCCs.back();
-        }
-      }
+      const MCGSCCs &SCCs(G.getSCCs());
 
       // initialize the work list and predecessor counters
-      MCGNodeUInt predCount;
+      MCGNodeCounts predCount(nodes.size(), 0);
       MCGNodes WL;
-      for(MCGNSCCs::const_iterator i(SCCs.begin()), ie(SCCs.end()); i != ie;
-          i++) {
+      for(unsigned int i = 0, ie = SCCs.size(); i != ie; i++) {
         // get info of the current SCC
-        const MCGNodes *SCC = &i->first;
+        const MCGNodes &SCC(SCCs[i].Nodes);
 
         // get the number of predecessors of the SCC that are not in that SCC.
         MCGNodeSet preds;
-        for(MCGNodes::const_iterator j(SCC->begin()), je(SCC->end()); j != je;
+        for(MCGNodes::const_iterator j(SCC.begin()), je(SCC.end()); j != je;
             j++) {
-          for(MCGSites::const_iterator k((*j)->getCallingSites().begin()),
-              ke((*j)->getCallingSites().end()); k != ke; k++) {
+          ArrayRef<unsigned> callers(G.getCallers(*j));
+          for(ArrayRef<unsigned>::iterator k(callers.begin()),
+              ke(callers.end()); k != ke; k++) {
             // check if the two are in the same SCC
-            if (&SCCMap[(*k)->getCaller()]->first != SCC) {
-              preds.insert((*k)->getCaller());
+            if (G.getSCCIndex(nodes[*k]) != i) {
+              preds.insert(nodes[*k]);
             }
           }
         }
 
         // be sure to keep all nodes within an SCC off the WL for now
-        for(MCGNodes::const_iterator j(SCC->begin()), je(SCC->end()); j != je;
+        for(MCGNodes::const_iterator j(SCC.begin()), je(SCC.end()); j != je;
             j++) {
           if (preds.size() == 0)
             WL.push_back(*j);
           else
-            predCount[*j] = preds.size();
+            predCount[(*j)->getIndex()] = preds.size();
         }
       }
 
       while(!WL.empty()) {
-          MCGNode *tmp = WL.back();
-          WL.pop_back();
+        // take all nodes from the work list, they are independent
+        MCGNodes batch;
+        batch.swap(WL);
+
+        // solve the ILPs of nodes in SCCs
+        MCGNodeUInt ILPResults;
+        solveGlobalEnsureFillingILPs(G, batch, ILPResults);
+
+        while(!batch.empty()) {
+          MCGNode *tmp = batch.back();
+          batch.pop_back();
 
-          propagateGlobalEnsureFilling(SCCMap, tmp, predCount, WL);
+          propagateGlobalEnsureFilling(G, tmp, predCount, WL, ILPResults);
+        }
       }
     }
 
     /// propagateDeadArea - Propagate information on the dead data within the
     /// stack cache, e.g., accessed by loads and stores, upwards trough the CFG.
     // TODO: check for STCr
-    void propagateDeadArea(MBBs &WL, MBBUInt &INs,
+    void propagateDeadArea(MBBDataFlow &DF,
                            MCGNode *Node, MachineBasicBlock *MBB)
     {
       // get the size of the dead stack area from the CFG successors
-      unsigned int deadAreaSize = INs[MBB];
+      unsigned int deadAreaSize = DF.get(MBB);
 
       // propagate within the basic block
       for(MachineBasicBlock::reverse_instr_iterator i(MBB->instr_rbegin()),
@@ -2144,17 +2325,17 @@ namespace llvm {
       /// assuming a preemption in a preceding basic block.
       /// Since the analysis goes upward, the result is set at the output of
       /// the analyzed basic block.
-      WorstCaseBlockDP[MBB] = deadAreaSize;
+      WorstCaseBlockDP[getBlockIndex(Node, MBB)] = deadAreaSize;
 
       // propagate to CFG predecessors
       for(MachineBasicBlock::pred_iterator i(MBB->pred_begin()),
           ie(MBB->pred_end()); i != ie; i++) {
         // check if the new dead area size is less than what was known
         // previously for this predecessor
-        if (INs[*i] > deadAreaSize) {
+        if (DF.get(*i) > deadAreaSize) {
           // update the predecessor's dead area size and put it on the work list
-          INs[*i] = deadAreaSize;
-          WL.insert(*i);
+          DF.set(*i, deadAreaSize);
+          DF.push(*i);
         }
       }
 
@@ -2164,58 +2345,48 @@ namespace llvm {
     /// stack cache, e.g., accessed by loads and stores, upwards trough the CFG.
     void propagateDeadArea(const MCallGraph &G)
     {
-      const MCGNodes &nodes(G.getNodes());
-
       // visit all functions
-      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
-          i++) {
-        if (!(*i)->isUnknown() && !(*i)->isDead()) {
-          MBBs WL;
-          MBBUInt INs;
-          MachineFunction *MF = (*i)->getMF();
-
-          // initialize work list (yeah, reverse-reverse post order would be
-          // optimal, but this works too).
-          for(MachineFunction::iterator j(MF->begin()), je(MF->end()); j != je;
-              j++) {
-            WL.insert(j);
-            INs[j] = getBytesReserved(*i);
-          }
-
-          // process until the work list becomes empty
-          while (!WL.empty()) {
-            // get some basic block
-            MachineBasicBlock *MBB = *WL.begin();
-            WL.erase(WL.begin());
+      forEachFunction(G, [&](MCGNode *Node) {
+        MachineFunction *MF = Node->getMF();
+        MBBDataFlow DF(*MF, MBBDataFlow::Backward);
 
-            // update the basic block's information, potentially putting any of
-            // its predecessors on the work list.
-            propagateDeadArea(WL, INs, *i, MBB);
-          }
+        // initialize work list with all basic blocks.
+        for(MachineFunction::iterator j(MF->begin()), je(MF->end()); j != je;
+            j++) {
+          DF.set(j, getBytesReserved(Node));
+        }
+        DF.pushAll();
+
+        // process until the work list becomes empty, the basic block's
+        // information is updated, potentially putting any of its predecessors
+        // on the work list.
+        DF.solve([&](MachineBasicBlock *MBB) {
+          propagateDeadArea(DF, Node, MBB);
+        });
 #ifdef PATMOS_TRACE_BB_DEADAREA
-          DEBUG(
-            dbgs() << "*************************** "
-                   << MF->getFunction()->getName() << "\n";);
+        DEBUG(
+          dbgs() << "*************************** "
+                 << MF->getFunction()->getName() << "\n";);
 #endif // PATMOS_TRACE_BB_DEADAREA
 
-          for(MBBUInt::const_iterator j(INs.begin()), je(INs.end()); j != je;
-              j++) {
+        for(MachineFunction::iterator j(MF->begin()), je(MF->end()); j != je;
+            j++) {
+          unsigned int deadAreaSize = DF.get(j);
 #ifdef PATMOS_TRACE_BB_DEADAREA
-            DEBUG(
-              dbgs() << "  " << j->first->getName()
-                    << "(" << j->first->getNumber() << ")"
-                    << ": " << j->second << "\n";);
+          DEBUG(
+            dbgs() << "  " << j->getName()
+                  << "(" << j->getNumber() << ")"
+                  << ": " << deadAreaSize << "\n";);
 #endif // PATMOS_TRACE_BB_DEADAREA
 
-            TotalBlocks++;
-            if (j->second == getBytesReserved(*i))
-              TotallyDeadBlocks++;
-            else if ((j->second != 0) && (j->second != std::numeric_limits<unsigned int>::max())) {
-              PartiallyDeadBlocks++;
-            }
+          TotalBlocks++;
+          if (deadAreaSize == getBytesReserved(Node))
+            TotallyDeadBlocks++;
+          else if ((deadAreaSize != 0) && (deadAreaSize != std::numeric_limits<unsigned int>::max())) {
+            PartiallyDeadBlocks++;
           }
         }
-      }
+      });
     }
 
     /// analyzeEnsures - Does what it says. SENS instructions can be removed if
@@ -2224,12 +2395,12 @@ namespace llvm {
     // TODO: take care of predication, i.e., predicated SENS/CALL instructions
     // might be mangled and they might not match one to one.
     // TODO: check for STCr
-    void analyzeEnsures(MBBs &WL, MBBUInt &INs, SIZEs &ENSs, MCGNode *Node,
+    void analyzeEnsures(MBBDataFlow &DF, SIZEs &ENSs, MCGNode *Node,
                         MachineBasicBlock *MBB)
     {
       // track maximum displacement of children in the call graph -- initialize
       // from predecessors in the CFG.
-      unsigned int childDisplacement = INs[MBB];
+      unsigned int childDisplacement = DF.get(MBB);
 
       // propagate maximum displacement through the basic block
       for(MachineBasicBlock::instr_iterator i(MBB->instr_begin()),
@@ -2256,9 +2427,6 @@ namespace llvm {
                                                STC.getStackCacheSize();
           ENSs[i] = filling;
 
-          // store worst-case filling at call sites and basic block entry
-          WorstCaseEnsureBound[i] = filling;
-
           assert(filling != 0 || remove);
 
           if (!remove && !TII.isPredicated(i)) {
@@ -2273,10 +2441,10 @@ namespace llvm {
           ie(MBB->succ_end()); i != ie; i++) {
         // check if the new displacement is larger than what was known
         // previously for this successor
-        if (INs[*i] < childDisplacement) {
+        if (DF.get(*i) < childDisplacement) {
           // update the successor’s displacement and put it on the work list
-          INs[*i] = childDisplacement;
-          WL.insert(*i);
+          DF.set(*i, childDisplacement);
+          DF.push(*i);
         }
       }
     }
@@ -2294,36 +2462,52 @@ namespace llvm {
        &getAnalysis<PatmosStackCacheAnalysisInfo>();
       info->setValid();
 
+      // analyze all functions
+      MCGNodeSIZEs NodeENSs(nodes.size());
+      forEachFunction(G, [&](MCGNode *Node) {
+        SIZEs &ENSs(NodeENSs[Node->getIndex()]);
+        MachineFunction *MF = Node->getMF();
+        MBBDataFlow DF(*MF, MBBDataFlow::Forward);
+
+        // initialize work list with all basic blocks.
+        DF.pushAll();
+
+        // process until the work list becomes empty, the basic block's
+        // information is updated, potentially putting any of its successors
+        // on the work list.
+        DF.solve([&](MachineBasicBlock *MBB) {
+          analyzeEnsures(DF, ENSs, Node, MBB);
+        });
+
+#ifdef PATMOS_TRACE_SENS_REMOVAL
+        DEBUG(
+          dbgs() << "########################### "
+                 << MF->getFunction()->getName() << "\n";
+          for(MachineFunction::iterator i(MF->begin()), ie(MF->end()); i != ie;
+              i++) {
+            dbgs() << "  " << i->getName()
+                  << "(" << i->getNumber() << ")"
+                  << ": " << DF.get(i) << "\n";
+          }
+        );
+#endif // PATMOS_TRACE_SENS_REMOVAL
+      });
+
       // visit all functions
       for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
           i++) {
         if (!(*i)->isUnknown() && !(*i)->isDead()) {
-          MBBs WL;
-          SIZEs ENSs;
-          MBBUInt INs;
+          const SIZEs &ENSs(NodeENSs[(*i)->getIndex()]);
+#ifdef PATMOS_TRACE_DETAILED_RESULTS
           MachineFunction *MF = (*i)->getMF();
-
-          // initialize work list (yeah, reverse post order would be optimal,
-          // but this works too).
-          for(MachineFunction::iterator j(MF->begin()), je(MF->end()); j != je;
-              j++) {
-            WL.insert(j);
-          }
-
-          // process until the work list becomes empty
-          while (!WL.empty()) {
-            // get some basic block
-            MachineBasicBlock *MBB = *WL.begin();
-            WL.erase(WL.begin());
-
-            // update the basic block's information, potentially putting any of
-            // its successors on the work list.
-            analyzeEnsures(WL, INs, ENSs, *i, MBB);
-          }
+#endif // PATMOS_TRACE_DETAILED_RESULTS
 
           // actually remove ensure instructions (if requested)
           for(SIZEs::const_iterator i(ENSs.begin()), ie(ENSs.end()); i != ie;
               i++) {
+            // store worst-case filling at call sites and basic block entry
+            WorstCaseEnsureBound[i->first] = i->second;
+
             unsigned int ensure = i->first->getOperand(2).getImm() * 4;
 #ifdef PATMOS_TRACE_DETAILED_RESULTS
             MachineBasicBlock *MBB = i->first->getParent();
@@ -2354,19 +2538,6 @@ namespace llvm {
             assert(i->second % STC.getStackCacheBlockSize() == 0);
             info->Ensures[i->first] = i->second; // export in bytes
           }
-
-#ifdef PATMOS_TRACE_SENS_REMOVAL
-          DEBUG(
-            dbgs() << "########################### "
-                   << MF->getFunction()->getName() << "\n";
-            for(MBBUInt::const_iterator i(INs.begin()), ie(INs.end()); i != ie;
-                i++) {
-              dbgs() << "  " << i->first->getName()
-                    << "(" << i->first->getNumber() << ")"
-                    << ": " << i->second << "\n";
-            }
-          );
-#endif // PATMOS_TRACE_SENS_REMOVAL
         }
       }
     }
@@ -2386,90 +2557,226 @@ namespace llvm {
     }
 
     /// ilp_name - make a name for a call site suitable for the LP file.
+    /// Sites are named after their caller and their position within the
+    /// caller, which keeps the LP (and its hash) stable across compiler runs.
     static std::string ilp_name(ilp_prefix Prefix, const MCGSite *S)
     {
       std::string tmps;
       raw_string_ostream tmp(tmps);
-      tmp << Prefix << "S" << (void*)S;
+      tmp << Prefix << "S";
+
+      const MCGNode *C = S->getCaller();
+      if (C->isUnknown()) {
+        tmp << (void*)S;
+      }
+      else {
+        const MCGSites &CS(C->getSites());
+        tmp << "X" << C->getMF()->getFunction()->getName() << "_"
+            << (std::find(CS.begin(), CS.end(), S) - CS.begin());
+      }
       return tmp.str();
     }
 
-    /// solve_ilp - solve the ILP problem.
-    static unsigned int solve_ilp(const char *LPname, bool Maximize)
+    /// solveILP - solve an ILP problem.
+    /// The built-in solver is tried first (unless the external solver is
+    /// requested explicitly), the external solver serves as a fallback for
+    /// problems the built-in solver cannot handle.
+    /// This may run concurrently for several jobs, it thus must not modify the
+    /// state of the analysis.
+    void solveILP(ILPJob &Job) const
     {
-      unsigned int result = Maximize ? std::numeric_limits<unsigned int>::max():
-                                       std::numeric_limits<unsigned int>::min();
+      TimeRecord start(TimeRecord::getCurrentTime(true));
 
-      std::vector<const char*> args;
-      args.push_back(Solve_ilp.c_str());
-      args.push_back(LPname);
-      args.push_back(0);
+      Job.Status = PatmosILPSolver::Failed;
 
-      std::string ErrMsg;
-      if (sys::ExecuteAndWait(sys::FindProgramByName(Solve_ilp),
-                                       &args[0],0,0,0,0,&ErrMsg)) {
-        report_fatal_error("calling ILP solver (" + Solve_ilp + "): " + ErrMsg);
+      if (ILPEngine == ILP_Builtin) {
+        Job.Solver = BuiltinILPSolver->getName();
+        Job.Status = BuiltinILPSolver->solve(Job.LP, Job.Value, Job.ErrMsg);
       }
-      else {
-        // read solution
-        // construct name of solution
-        std::string SOLname(LPname);
-        SOLname += ".sol";
 
-        //SmallString<1024> SOLname(LPname);
-        //sys::path::replace_extension(SOLname, ".sol");
+      if (Job.Status == PatmosILPSolver::Failed) {
+        Job.ErrMsg.clear();
+        Job.Solver = ExternalILPSolver->getName();
+        Job.Status = ExternalILPSolver->solve(Job.LP, Job.Value, Job.ErrMsg);
+      }
 
-        if (!sys::fs::exists(SOLname))
-          report_fatal_error("Failed to read ILP solution");
+      TimeRecord end(TimeRecord::getCurrentTime(false));
+      Job.Time = end.getWallTime() - start.getWallTime();
+    }
 
-        std::ifstream IS(SOLname.c_str());
-        assert(IS.good());
+    /// solve_ilps - solve a list of independent ILP problems.
+    /// Problems with known solutions, i.e., from the ILP cache or from an
+    /// equivalent problem in the same list, are not solved again. The
+    /// remaining problems are distributed over a pool of threads.
+    void solve_ilps(ILPJobs &Jobs)
+    {
+      // look for known solutions
+      std::vector<unsigned> pending;
+      std::map<std::string, unsigned> hashes;
+      for(unsigned i = 0, ie = Jobs.size(); i < ie; i++) {
+        ILPJob &Job = Jobs[i];
+        Job.Hash = getPatmosLPHash(Job.LP);
+        Job.Representative = i;
+
+        ILPSolutions::const_iterator known(ILPCache.find(Job.Hash));
+        if (known != ILPCache.end()) {
+          Job.Status = PatmosILPSolver::Optimal;
+          Job.Value = known->second;
+          Job.Solver = "cache";
+          Job.Cached = true;
+          ILPCacheHits++;
+        }
+        else if (hashes.count(Job.Hash)) {
+          Job.Representative = hashes[Job.Hash];
+          ILPCacheHits++;
+        }
+        else {
+          hashes[Job.Hash] = i;
+          pending.push_back(i);
+        }
+      }
 
-        // read the result value
-        double tmp;
-        IS >> tmp;
-        result = tmp;
+      // solve the remaining problems
+      parallelFor(pending.size(), ILPThreads, [&](unsigned i) {
+        solveILP(Jobs[pending[i]]);
+      });
+
+      // check the results
+      for(unsigned i = 0, ie = Jobs.size(); i < ie; i++) {
+        ILPJob &Job = Jobs[i];
+
+        if (Job.Representative != i) {
+          const ILPJob &R = Jobs[Job.Representative];
+          Job.Status = R.Status;
+          Job.Value = R.Value;
+          Job.Solver = R.Solver;
+          Job.ErrMsg = R.ErrMsg;
+        }
+        else if (!Job.Cached) {
+          ILPs++;
+          ILPSolveTime += (unsigned)(Job.Time * 1e6);
+        }
+
+        switch (Job.Status) {
+          case PatmosILPSolver::Optimal:
+            break;
+          case PatmosILPSolver::Failed:
+            report_fatal_error("ILP solver (" + Twine(Job.Solver) + "): " +
+                               Job.ErrMsg);
+          case PatmosILPSolver::Infeasible:
+          case PatmosILPSolver::Unbounded:
+            // don't go ahead when solving has failed
+            assert(0 && "unbounded/infeasible ILP");
+            Job.Value = Job.Maximize ?
+                                    std::numeric_limits<unsigned int>::max() :
+                                    std::numeric_limits<unsigned int>::min();
+            break;
+        }
 
-        // don't go ahead when solving has failed
-        if (tmp == -1.)
-          assert(0 && "unbounded/infeasible ILP");
+        unsigned int result = Job.Value;
+        if (Job.Status == PatmosILPSolver::Optimal &&
+            !ILPCache.count(Job.Hash)) {
+          ILPCache[Job.Hash] = result;
+          ILPCacheModified = true;
+        }
 
-        sys::fs::remove(SOLname);
+        DEBUG(dbgs() << "ILP " << Job.Hash << " solved by " << Job.Solver
+                     << " in " << format("%.6f", Job.Time) << "s: " << result
+                     << "\n");
       }
+    }
 
-      ILPs++;
+    /// loadILPCache - Read solutions of ILPs from the ILP cache file.
+    void loadILPCache()
+    {
+      if (ILPCacheFile.empty() || !sys::fs::exists(ILPCacheFile))
+        return;
 
-      return result;
+      std::ifstream IS(ILPCacheFile.c_str());
+      std::string hash;
+      unsigned int value;
+      while (IS >> hash >> value)
+        ILPCache[hash] = value;
     }
 
-    /// computeMinMaxDisplacementILP - Construct an ILP modeling the
-    /// displacement of an SCC within the call graph, write it to an LP file,
-    /// and solve it.
-    unsigned int computeMinMaxDisplacementILP(const MCGNodes &SCC,
-                                              const MCGNode *N, bool Maximize)
+    /// storeILPCache - Write solutions of ILPs to the ILP cache file.
+    void storeILPCache()
     {
-      assert(std::find(SCC.begin(), SCC.end(), N) != SCC.end());
+      if (ILPCacheFile.empty() || !ILPCacheModified)
+        return;
 
-      // get user-supplied bounds to solve the ILP.
-      const SCCInfo &BInfo(BI.getInfo(SCC));
+      // write to a temporary file first, other compiler instances might
+      // access the cache file concurrently.
+      int FD;
+      SmallString<1024> TmpName;
+      error_code err = sys::fs::createUniqueFile(ILPCacheFile + "-%%%%%%", FD,
+                                                 TmpName);
+      if (err) {
+        errs() << "Error: Failed to write ILP cache '" << ILPCacheFile
+               << "': " << err.message() << "\n";
+        return;
+      }
+
+      {
+        raw_fd_ostream OS(FD, true);
+        for(ILPSolutions::const_iterator i(ILPCache.begin()),
+            ie(ILPCache.end()); i != ie; i++) {
+          OS << i->first << " " << i->second << "\n";
+        }
+      }
 
-      // open LP file.
-      SmallString<1024> LPname;
-      error_code err = sys::fs::createUniqueDirectory("stack", LPname);
+      err = sys::fs::rename(TmpName.str(), ILPCacheFile);
       if (err) {
-        errs() << "Error creating temp .lp file: " << err.message() << "\n";
-        return std::numeric_limits<unsigned int>::max();
+        errs() << "Error: Failed to write ILP cache '" << ILPCacheFile
+               << "': " << err.message() << "\n";
+        sys::fs::remove(TmpName.str());
       }
+    }
 
-      sys::path::append(LPname, "scc.lp");
+    /// solveMinMaxDisplacementILPs - Construct and solve the ILPs of all
+    /// nodes of the batch that are within SCCs of the call graph. The nodes
+    /// of the batch have to be independent of each other.
+    void solveMinMaxDisplacementILPs(const MCallGraph &G, const MCGNodes &Batch,
+                                     bool Maximize, MCGNodeUInt &ILPResults)
+    {
+      ILPJobs Jobs;
+      MCGNodes JobNodes;
+      for(MCGNodes::const_iterator i(Batch.begin()), ie(Batch.end()); i != ie;
+          i++) {
+        MCGNode *N = *i;
+        if (!N->isDead() && G.getSCC(N).HasLoop) {
+          Jobs.push_back(ILPJob(makeMinMaxDisplacementILP(G.getSCC(N).Nodes, N,
+                                                          Maximize),
+                                Maximize));
+          JobNodes.push_back(N);
+        }
+      }
 
-      std::string ErrMsg;
-      raw_fd_ostream OS(LPname.c_str(), ErrMsg);
-      if (!ErrMsg.empty()) {
-        errs() << "Error: Failed to open file '" << LPname.str()
-               << "' for writing!\n";
-        return std::numeric_limits<unsigned int>::max();
+      solve_ilps(Jobs);
+
+      for(unsigned i = 0, ie = Jobs.size(); i < ie; i++) {
+        unsigned int result = Jobs[i].Value;
+        ILPResults[JobNodes[i]] = result;
+
+#ifdef PATMOS_TRACE_CG_DISPLACMENT_ILP
+        dbgs() << "ILP: " << *JobNodes[i] << ": " << result << "\n";
+#endif // PATMOS_TRACE_CG_DISPLACMENT_ILP
       }
+    }
+
+    /// makeMinMaxDisplacementILP - Construct an ILP modeling the displacement
+    /// of an SCC within the call graph.
+    std::string makeMinMaxDisplacementILP(const MCGNodes &SCC, const MCGNode *N,
+                                          bool Maximize)
+    {
+      assert(std::find(SCC.begin(), SCC.end(), N) != SCC.end());
+
+      // get user-supplied bounds to solve the ILP.
+      const SCCInfo &BInfo(BI.getInfo(SCC));
+
+      // construct the LP problem in memory.
+      std::string LP;
+      raw_string_ostream OS(LP);
 
       // find entry and exit call sites
       typedef std::set<MCGSite*> MCGSiteSet;
@@ -2688,32 +2995,19 @@ namespace llvm {
 
       OS << "End\n";
 
-      OS.close();
-
-      // solve the ILP
-      unsigned int result = solve_ilp(LPname.c_str(), Maximize);
-
-#ifdef PATMOS_TRACE_CG_DISPLACMENT_ILP
-      dbgs() << "ILP: " << *N << ": " << result << "\n";
-#endif // PATMOS_TRACE_CG_DISPLACMENT_ILP
-
-      // remove LP file
-      // TODO do we need to remove the temp dir??
-      sys::fs::remove(LPname.str());
-
-      return result;
+      return OS.str();
     }
 
     /// checkCallFreePaths - Check whether functions have call free paths.
     /// see below.
-    void checkCallFreePaths(MBBs &WL, MBBBool &OUTs, MachineBasicBlock *MBB)
+    void checkCallFreePaths(MBBBoolDataFlow &DF, MachineBasicBlock *MBB)
     {
       // see if a successor contains a call-free path to a sink
-      bool is_call_free = OUTs[MBB];
+      bool is_call_free = DF.get(MBB);
 
       for(MachineBasicBlock::succ_iterator i(MBB->succ_begin()),
           ie(MBB->succ_end()); i != ie && is_call_free; i++) {
-        is_call_free |= OUTs[*i];
+        is_call_free |= DF.get(*i);
       }
 
       // see if the block contains a call
@@ -2725,11 +3019,11 @@ namespace llvm {
 
       // simply put all predecessors on the work list -- this may happen only
       // once.
-      if (is_call_free != OUTs[MBB]) {
-        WL.insert(MBB->pred_begin(), MBB->pred_end());
+      if (is_call_free != DF.get(MBB)) {
+        DF.push(MBB->pred_begin(), MBB->pred_end());
       }
 
-      OUTs[MBB] = is_call_free;
+      DF.set(MBB, is_call_free);
     }
 
     /// checkCallFreePaths - Check whether functions have call free paths. In
@@ -2738,45 +3032,34 @@ namespace llvm {
     void checkCallFreePaths(const MCallGraph &G)
     {
       const MCGNodes &nodes(G.getNodes());
+      // (not a vector<bool>, the functions are visited concurrently)
+      std::vector<char> NodeCallFree(nodes.size(), false);
 
-      // visit all functions
-      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
-          i++) {
-
-        bool is_call_free = false;
-
-        // ignore unknown functions here
-        if (!(*i)->isUnknown() && !(*i)->isDead()) {
-          MBBs WL;
-          MBBBool OUTs;
-          MachineFunction *MF = (*i)->getMF();
-
-          // initialize work list -- initially we assume
-          for(MachineFunction::iterator i(MF->begin()), ie(MF->end()); i != ie;
-              i++) {
-            WL.insert(i);
+      // visit all functions, ignoring unknown functions here
+      forEachFunction(G, [&](MCGNode *Node) {
+        MachineFunction *MF = Node->getMF();
 
-            // initially assume the basic block does not contain a call and a
-            // path to a sink exists without any calls.
-            OUTs[i] = true;
-          }
+        // initially assume the basic blocks do not contain a call and a path
+        // to a sink exists without any calls.
+        MBBBoolDataFlow DF(*MF, MBBBoolDataFlow::Backward, true);
 
-          // process until the work list becomes empty
-          while (!WL.empty()) {
-            // get some basic block
-            MachineBasicBlock *MBB = *WL.begin();
-            WL.erase(WL.begin());
+        // initialize work list with all basic blocks.
+        DF.pushAll();
 
-            // update the basic block's information, potentially putting any of
-            // its predecessors on the work list.
-            checkCallFreePaths(WL, OUTs, MBB);
-          }
+        // process until the work list becomes empty, the basic block's
+        // information is updated, potentially putting any of its predecessors
+        // on the work list.
+        DF.solve([&](MachineBasicBlock *MBB) {
+          checkCallFreePaths(DF, MBB);
+        });
 
-          // see if the entry node contains a call-free path
-          is_call_free = OUTs[MF->begin()];
-        }
+        // see if the entry node contains a call-free path
+        NodeCallFree[Node->getIndex()] = DF.get(MF->begin());
+      });
 
-        IsCallFree[*i] = is_call_free;
+      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
+          i++) {
+        IsCallFree[*i] = NodeCallFree[(*i)->getIndex()];
       }
     }
 
@@ -2787,7 +3070,7 @@ namespace llvm {
     /// propagate the worst-case occupancy at call sites through the function.
     /// We use the minimum displacement caused by the functions called along
     /// a path to get the worst-case occupancy.
-    void propagateWorstCaseOccupancyAtSite(MBBs &WL, MBBUInt &INs,
+    void propagateWorstCaseOccupancyAtSite(MBBDataFlow &DF,
                                            MCGNode *Node,
                                            MachineBasicBlock *MBB)
     {
@@ -2795,9 +3078,9 @@ namespace llvm {
       // children in the call graph and fills due to ensures, assuming a full
       // stack cache at function entry -- initialize from predecessors in the
       // CFG.
-      unsigned int worstOccupancy = INs[MBB];
+      unsigned int worstOccupancy = DF.get(MBB);
 
-      WorstCaseBlockOccupancy[MBB] = worstOccupancy;
+      WorstCaseBlockOccupancy[getBlockIndex(Node, MBB)] = worstOccupancy;
 
       // propagate the worst-case stack occupancy through the basic block
       for(MachineBasicBlock::instr_iterator i(MBB->instr_begin()),
@@ -2809,7 +3092,7 @@ namespace llvm {
 
           // store the worst-case occupancy before the call site, i.e., for the
           // functions potentially entered through calls from this site
-          WorstCaseSiteOccupancy[site] = worstOccupancy;
+          WorstCaseSiteOccupancy[site->getIndex()] = worstOccupancy;
 
           if (!TII.isPredicated(i)) {
             // get the worst-case occupancy after the call
@@ -2831,18 +3114,18 @@ namespace llvm {
           ie(MBB->succ_end()); i != ie; i++) {
         // propagate the worst-case occupancy to the successors and put them on
         // the work list
-        if (INs[*i] < worstOccupancy) {
-          INs[*i] = worstOccupancy;
-          WL.insert(*i);
+        if (DF.get(*i) < worstOccupancy) {
+          DF.set(*i, worstOccupancy);
+          DF.push(*i);
         }
       }
     }
 
-    void propagateLPSaving(MBBs &WL, MBBUInt &INs,
+    void propagateLPSaving(MBBDataFlow &DF,
                            MCGNode *Node,
                            MachineBasicBlock *MBB)
     {
-      unsigned int worstSpillDirty = INs[MBB];
+      unsigned int worstSpillDirty = DF.get(MBB);
       unsigned int SCSize = STC.getStackCacheSize();
       unsigned int Reserved = getBytesReserved(Node);
 
@@ -2850,7 +3133,7 @@ namespace llvm {
       /// preemption in a preceding basic block.
       /// Since the analysis goes downward, the result is set at the entry of
       /// the analyzed basic block.
-      WorstCaseBlockLP[MBB] = worstSpillDirty;
+      WorstCaseBlockLP[getBlockIndex(Node, MBB)] = worstSpillDirty;
 
       // propagate the lowest position of the LP through the basic block
       for(MachineBasicBlock::instr_iterator i(MBB->instr_begin()),
@@ -2862,7 +3145,7 @@ namespace llvm {
 
           // store the worst-case occupancy before the call site, i.e., for the
           // functions potentially entered through calls from this site
-          WorstCaseSpillDirty[site] = worstSpillDirty;
+          WorstCaseSpillDirty[site->getIndex()] = worstSpillDirty;
 
           if (!TII.isPredicated(i)) {
             unsigned int minDisplacement= getMinDisplacement(site->getCallee());
@@ -2915,12 +3198,12 @@ namespace llvm {
       for(MachineBasicBlock::succ_iterator i(MBB->succ_begin()),
           ie(MBB->succ_end()); i != ie; i++) {
         // propagate worst-case value and put successors on the work list
-        if (INs.find(*i) == INs.end()) {
-          INs[*i] = worstSpillDirty;
-          WL.insert(*i);
-        } else if (INs[*i] < worstSpillDirty) {
-          INs[*i] = worstSpillDirty;
-          WL.insert(*i);
+        if (!DF.isDefined(*i)) {
+          DF.set(*i, worstSpillDirty);
+          DF.push(*i);
+        } else if (DF.get(*i) < worstSpillDirty) {
+          DF.set(*i, worstSpillDirty);
+          DF.push(*i);
         }
       }
 
@@ -2933,24 +3216,25 @@ namespace llvm {
     {
       // worst-case amount of dirty data (lowest position of the LP) -- coherent
       // data can be excluded from context saving anyways.
-      unsigned int lp = std::min(WorstCaseBlockLP[MBB],
+      unsigned int index = getBlockIndex(Node, MBB);
+      unsigned int lp = std::min(WorstCaseBlockLP[index],
                                  getMaxEffectiveOccupancy(Node));
 
       // minimal amount of dead data -- can be excluded from contexts saving as
       // well
-      unsigned int dp = WorstCaseBlockDP[MBB];
+      unsigned int dp = WorstCaseBlockDP[index];
 
       // At most all dirty data minus the dead data needs to be saved ...
       unsigned int toSave = safeUIntDiff(lp, dp);
 
       // save information for later use
-      WorstCaseBlockSaving[MBB] = toSave;
+      WorstCaseBlockSaving[index] = toSave;
 
 #ifdef PATMOS_TRACE_WORST_SAVING_REGION
       unsigned int reserved = getBytesReserved(Node);
-      unsigned int naive_saving = std::min(WorstCaseBlockOccupancy[MBB],
+      unsigned int naive_saving = std::min(WorstCaseBlockOccupancy[index],
                                            getMaxOccupancy(Node));
-      unsigned int optimized_saving = WorstCaseBlockSaving[MBB];
+      unsigned int optimized_saving = WorstCaseBlockSaving[index];
 
           DEBUG(
             dbgs() << "Saving \\\\\\\\\\\\\\\\\\\\\\ "
@@ -2993,27 +3277,29 @@ namespace llvm {
     void computeWorstCaseRestoringOccupancy(MCGNode *Node,
                                             MachineBasicBlock *MBB)
     {
+      unsigned int index = getBlockIndex(Node, MBB);
+
       // Minimum amount of dead data in the stack cache
-      unsigned int dp = WorstCaseBlockDP[MBB];
+      unsigned int dp = WorstCaseBlockDP[index];
 
       // Minimum amount of data that needs to be restored before the next sens.
       // Note: rp might be smaller then dp, and vice verse.
-      unsigned int rp = WorstCaseBlockRP[MBB];
+      unsigned int rp = WorstCaseBlockRP[index];
 
       // at most rp blocks need to be restored explicitly, dead data can be
       // ignored.
       unsigned int toRestore = safeUIntDiff(rp, dp);
 
       // keep result for later use
-      WorstCaseBlockRestoring[MBB] = toRestore;
+      WorstCaseBlockRestoring[index] = toRestore;
 
 #ifdef PATMOS_TRACE_WORST_RESTORING_REGION
       unsigned int reserved = getBytesReserved(Node);
-      unsigned int naive_restoring = std::min(WorstCaseBlockOccupancy[MBB],
+      unsigned int naive_restoring = std::min(WorstCaseBlockOccupancy[index],
                                               getMaxOccupancy(Node));
-      int reserveGain = ReserveGain[MBB];
-      unsigned int localEnsure = safeUIntDiff(WorstCaseLocalEnsureFilling[MBB],
-                                              rp);
+      int reserveGain = ReserveGain[index];
+      unsigned int localEnsure = safeUIntDiff(
+                                   WorstCaseLocalEnsureFilling[index], rp);
       unsigned int globalEnsure = WorstCaseGlobalEnsureFilling[Node];
 
       // attention: the costs here might become negative
@@ -3091,80 +3377,68 @@ namespace llvm {
           // globally, are simply propagated onward through UNKNOWN nodes
           for(MCGSites::const_iterator j((*i)->getSites().begin()),
               je((*i)->getSites().end()); j != je; j++) {
-            WorstCaseSiteOccupancy[*j] = STC.getStackCacheSize();
-            WorstCaseSpillDirty[*j] = STC.getStackCacheSize();
+            WorstCaseSiteOccupancy[(*j)->getIndex()] = STC.getStackCacheSize();
+            WorstCaseSpillDirty[(*j)->getIndex()] = STC.getStackCacheSize();
           }
         }
-        else if (!(*i)->isDead()) {
-          MBBs WL;
-          MBBUInt INs;
-          MachineFunction *MF = (*i)->getMF();
+      }
 
-          // initialize work list.
-          INs[MF->begin()] = STC.getStackCacheSize();
-          WL.insert(MF->begin());
+      // visit all other functions
+      forEachFunction(G, [&](MCGNode *Node) {
+        MachineFunction *MF = Node->getMF();
+        MBBDataFlow DF(*MF, MBBDataFlow::Forward);
 
-          // process until the work list becomes empty
-          while (!WL.empty()) {
-            // get some basic block
-            MachineBasicBlock *MBB = *WL.begin();
-            WL.erase(WL.begin());
+        // initialize work list.
+        DF.set(MF->begin(), STC.getStackCacheSize());
+        DF.push(MF->begin());
 
-            // update the basic block's information, potentially putting any of
-            // its successors on the work list.
-            propagateWorstCaseOccupancyAtSite(WL, INs, *i, MBB);
-          }
+        // process until the work list becomes empty, the basic block's
+        // information is updated, potentially putting any of its successors
+        // on the work list.
+        DF.solve([&](MachineBasicBlock *MBB) {
+          propagateWorstCaseOccupancyAtSite(DF, Node, MBB);
+        });
 
 #ifdef PATMOS_TRACE_WORST_SITE_OCCUPANCY
-          DEBUG(
-            dbgs() << "\\\\\\\\\\\\\\\\\\\\\\\\\\\\ "
-                   << MF->getFunction()->getName()
-                   << " (" << getBytesReserved(*i) << ")\n";
-            for(MCGSiteUInt::const_iterator j(WorstCaseSiteOccupancy.begin()),
-                je(WorstCaseSiteOccupancy.end()); j != je; j++) {
-              dbgs() << "  " << *j->first << ": " << j->second
-                     << " (" << getMinDisplacement(j->first->getCallee()) << ")\n";
-            }
-          );
+        DEBUG(
+          dbgs() << "\\\\\\\\\\\\\\\\\\\\\\\\\\\\ "
+                 << MF->getFunction()->getName()
+                 << " (" << getBytesReserved(Node) << ")\n";
+          for(MCGSites::const_iterator j(Node->getSites().begin()),
+              je(Node->getSites().end()); j != je; j++) {
+            dbgs() << "  " << **j << ": "
+                   << WorstCaseSiteOccupancy[(*j)->getIndex()]
+                   << " (" << getMinDisplacement((*j)->getCallee()) << ")\n";
+          }
+        );
 #endif // PATMOS_TRACE_WORST_SITE_OCCUPANCY
-        }
-      }
+      });
 
       // lazy pointer analysis: visit all functions again
-      for(MCGNodes::const_iterator i(nodes.begin()), ie(nodes.end()); i != ie;
-          i++) {
-        if ((*i)->isDead() || (*i)->isUnknown())
-          continue;
-
-        MBBs WL;
-        MBBUInt INs;
-        MachineFunction *MF = (*i)->getMF();
+      forEachFunction(G, [&](MCGNode *Node) {
+        MachineFunction *MF = Node->getMF();
+        MBBDataFlow DF(*MF, MBBDataFlow::Forward);
 
         // initialize work list.
-        INs[MF->begin()] = STC.getStackCacheSize();
-        WL.insert(MF->begin());
+        DF.set(MF->begin(), STC.getStackCacheSize());
+        DF.push(MF->begin());
 
 #ifdef PATMOS_TRACE_WORST_SITE_OCCUPANCY
         dbgs() << "\\\\\\\\\\\\\\\\\\\\\\\\\\\\ "
                << MF->getFunction()->getName()
-               << " (" << getBytesReserved(*i) << ")\n";
+               << " (" << getBytesReserved(Node) << ")\n";
 #endif // PATMOS_TRACE_WORST_SITE_OCCUPANCY
 
-
-        // process until the work list becomes empty
-        while (!WL.empty()) {
-          // get some basic block
-          MachineBasicBlock *MBB = *WL.begin();
-          WL.erase(WL.begin());
-
-          // update the basic block's information, potentially putting any of
-          // its successors on the work list.
-          propagateLPSaving(WL, INs, *i, MBB);
-        }
-      }
+        // process until the work list becomes empty, the basic block's
+        // information is updated, potentially putting any of its successors
+        // on the work list.
+        DF.solve([&](MachineBasicBlock *MBB) {
+          propagateLPSaving(DF, Node, MBB);
+        });
+      });
 
 #ifdef PATMOS_DUMP_WORST_SITE_OCCUPANCY
-      dumpOccupancy();
+      dumpOccupancy(G);
       if (EnableLazyPointer) {
         dbgs() << "sca-anastores:"
           << StoresAnalyzed << "," << StoresIgnored << "\n";
@@ -3172,27 +3446,35 @@ namespace llvm {
 #endif // PATMOS_DUMP_WORST_SITE_OCCUPANCY
     }
 
-    void dumpOccupancy() const {
-      MCGSiteUIntSort Sorted(WorstCaseSiteOccupancy.begin(), WorstCaseSiteOccupancy.end());
-      for(MCGSiteUInt::const_iterator j(Sorted.begin()),
+    void dumpOccupancy(const MCallGraph &G) const {
+      MCGSiteSort Sorted;
+      for(MCGSites::const_iterator j(G.getSites().begin()),
+          je(G.getSites().end()); j != je; j++) {
+        if (WorstCaseSiteOccupancy[(*j)->getIndex()] != UndefinedSiteValue)
+          Sorted.insert(*j);
+      }
+
+      for(MCGSiteSort::const_iterator j(Sorted.begin()),
           je(Sorted.end()); j != je; j++) {
-        unsigned int Displacement = getMinDisplacement(j->first->getCallee());
+        MCGSite *site = *j;
+        unsigned int Occupancy = WorstCaseSiteOccupancy[site->getIndex()];
+        unsigned int Displacement = getMinDisplacement(site->getCallee());
         std::stringstream SpillDirty; // worst-case lazy-pointer saving
-        MCGSiteUInt::const_iterator it = WorstCaseSpillDirty.find(j->first);
-        assert(it != WorstCaseSpillDirty.end());
-        if (it == WorstCaseSpillDirty.end())
+        unsigned int spillDirty = WorstCaseSpillDirty[site->getIndex()];
+        assert(spillDirty != UndefinedSiteValue);
+        if (spillDirty == UndefinedSiteValue)
           SpillDirty << "*";
         else
-          SpillDirty << it->second;
-        MachineFunction *MF = j->first->getCaller()->getMF();
+          SpillDirty << spillDirty;
+        MachineFunction *MF = site->getCaller()->getMF();
 
-        dbgs() << *j->first << ": " << j->second  // worst-case max occupancy
+        dbgs() << *site << ": " << Occupancy  // worst-case max occupancy
           << "/" << SpillDirty.str()
           << " (" << Displacement
           << "); sca-occ:"
           << (MF ? MF->getName() : "unknown") << ","
-          << getBytesReserved(j->first->getCaller()) << ","
-          << j->second << "," << Displacement << "," << SpillDirty.str()
+          << getBytesReserved(site->getCaller()) << ","
+          << Occupancy << "," << Displacement << "," << SpillDirty.str()
           << "\n";
       }
     }
@@ -3308,8 +3590,14 @@ namespace llvm {
     ///
     /// We only need to propagate the minimum of the two.
     ///
+    /// The calling contexts of the callees are returned in Children, in the
+    /// order of the call sites. Contexts dominated by a context in SpillFree
+    /// are linked to the dominating context instead.
+    ///
     /// \see propagateWorstCaseOccupancyAtSite
-    void propagateMaxOccupancy(SCANode *Node, SCANodeSet &WL)
+    void propagateMaxOccupancy(SCANode *Node,
+                               const std::vector<SCANodes> &SpillFree,
+                               SCANodes &Children)
     {
       // get the call graph node and occupancy
       MCGNode *mcgNode = Node->getMCGNode();
@@ -3332,9 +3620,9 @@ namespace llvm {
         // get the site's stack worst-case occupancy
         MCGSite *site = *j;
         MCGNode *callee = site->getCallee();
+        // TODO the worst-case occupancy computed for the site is not taken
+        //      into account here (yet).
         unsigned int worstSiteOccupancy = STC.getStackCacheSize();
-        if (WorstCaseSiteOccupancy.count(site))
-          WorstCaseSiteOccupancy[site];
 
         // compute the occupancy and the call site
         unsigned int siteOccupancy = std::min(nodeOccupancy,
@@ -3352,8 +3640,8 @@ namespace llvm {
         // compute again only considering dirty spill region below lazy pointer
         //assert(WorstCaseSpillDirty.count(site));
         unsigned int lpWorstSiteOccupancy = STC.getStackCacheSize();
-        if (WorstCaseSpillDirty.count(site))
-          lpWorstSiteOccupancy = WorstCaseSpillDirty[site];
+        if (WorstCaseSpillDirty[site->getIndex()] != UndefinedSiteValue)
+          lpWorstSiteOccupancy = WorstCaseSpillDirty[site->getIndex()];
 
 
         unsigned int lpSiteOccupancy = std::min(lpNodeOccupancy,
@@ -3374,20 +3662,42 @@ namespace llvm {
         assert(lpChildOccupancy <= childOccupancy);
         assert(lpSpillCost <= spillCost);
 
-        // the occupancy before child's reserve (and spill cost) is propagated
-        SCANode *calleeSCANode;
-        bool isNewNode = SCAGraph.makeNode(callee, OccP, SCP,
-                                           getMaxDisplacement(callee),
-                                           IsCallFree[callee], calleeSCANode);
+        // the occupancy before child's reserve (and spill cost) is propagated,
+        // unless a spill-free context with larger occupancies exists already.
+        SCANode *calleeSCANode = SCAGraph.findNode(callee, OccP);
+        if (!calleeSCANode)
+          calleeSCANode = findDominatingContext(SpillFree[callee->getIndex()],
+                                                OccP);
+
+        if (calleeSCANode) {
+          if (calleeSCANode->getOccupancyCosts() != OccP)
+            DominatedSCAContexts++;
+        }
+        else {
+          SCAGraph.makeNode(callee, OccP, SCP, getMaxDisplacement(callee),
+                            IsCallFree[callee], calleeSCANode);
+        }
 
         // make a link to the parent context
         calleeSCANode->addParent(Node, site);
 
-        // if the node did not exist before, append it to the work list
-        if (isNewNode) {
-          WL.insert(calleeSCANode);
-        }
+        Children.push_back(calleeSCANode);
+      }
+    }
+
+    /// findDominatingContext - Find a context whose occupancies are at least
+    /// as large as the given ones in a list of contexts of a function.
+    static SCANode *findDominatingContext(const SCANodes &Contexts,
+                                          const CostPair &Occupancy)
+    {
+      for(SCANodes::const_iterator i(Contexts.begin()), ie(Contexts.end());
+          i != ie; i++) {
+        if ((*i)->getOccupancy() >= Occupancy.first &&
+            (*i)->getEffectiveOccupancy() >= Occupancy.second)
+          return *i;
       }
+
+      return NULL;
     }
 
     /// propagateMaxOccupancy - propagate the maximum stack occupancy on the
@@ -3406,23 +3716,78 @@ namespace llvm {
     ///
     /// We only need to propagate the minimum of the two.
     ///
+    /// The graph is constructed by a depth-first traversal over the calling
+    /// contexts. Once all descendants of a context are explored and none of
+    /// them spills, smaller contexts of the same function cannot spill either:
+    /// occupancies and spill costs only grow with the occupancy on entry. Such
+    /// dominated contexts are thus not expanded, but linked to the spill-free
+    /// context. They would not be visible anyway, see markSCAGraphVisible.
+    /// This is skipped for the preemption analysis, which needs the minimum
+    /// occupancy of all contexts.
+    ///
     /// \see propagateWorstCaseOccupancyAtSite
     void propagateMaxOccupancy(const MCallGraph &G, MCGNode *main)
     {
-      // initialize the work list and calling context information
-      SCANodeSet WL;
-      WL.insert(SCAGraph.makeRoot(main, getMaxDisplacement(main),
-                                  IsCallFree[main]));
+      /// A calling context on the DFS stack, with its children in the graph.
+      struct SCAFrame {
+        SCANode *Node;
+        SCANodes Children;
+        unsigned int Next;
+        bool IsSpillFree;
+      };
+
+      /// State of a calling context during the traversal.
+      enum SCAState { OnStack, Explored, ExploredSpillFree };
+
+      // spill-free contexts with all their descendants, for each function
+      std::vector<SCANodes> SpillFree(G.getNodes().size());
+      DenseMap<SCANode*, SCAState> States;
+      std::vector<SCAFrame> Stack;
+
+      // enter a new calling context: propagate to callees through call sites
+      // and push the context on the stack
+      auto enter = [&](SCANode *Node) {
+        SCAFrame Frame = { Node, SCANodes(), 0, true };
+        States[Node] = OnStack;
+
+        if (!Node->getMCGNode()->isDead())
+          propagateMaxOccupancy(Node, SpillFree, Frame.Children);
+
+        Stack.push_back(Frame);
+      };
 
-      while (!WL.empty()) {
-        // pop current call graph node
-        SCANode *Node =  *WL.begin();
-        WL.erase(Node);
+      // initialize the stack and calling context information
+      enter(SCAGraph.makeRoot(main, getMaxDisplacement(main),
+                              IsCallFree[main]));
 
-        // propagate to callees through call sites
-        if (!Node->getMCGNode()->isDead()) {
-          propagateMaxOccupancy(Node, WL);
+      while (!Stack.empty()) {
+        SCAFrame &F = Stack.back();
+
+        // visit the next child context
+        if (F.Next < F.Children.size()) {
+          SCANode *Child = F.Children[F.Next++];
+          DenseMap<SCANode*, SCAState>::iterator state(States.find(Child));
+
+          if (state == States.end()) {
+            enter(Child);
+          }
+          else if (state->second != ExploredSpillFree) {
+            // spilling or not completely explored yet (recursion)
+            F.IsSpillFree = false;
+          }
+          continue;
         }
+
+        // all descendants are explored
+        SCANode *Node = F.Node;
+        bool isSpillFree = F.IsSpillFree && Node->getSpillCost() == 0;
+        States[Node] = isSpillFree ? ExploredSpillFree : Explored;
+        if (isSpillFree && !EnablePreemptionSCA)
+          SpillFree[Node->getMCGNode()->getIndex()].push_back(Node);
+
+        Stack.pop_back();
+        if (!isSpillFree && !Stack.empty())
+          Stack.back().IsSpillFree = false;
       }
 
       // mark cost-relevant nodes; nodes not relevant for analysis remain hidden
@@ -3510,6 +3875,12 @@ namespace llvm {
       const MCallGraph &G(*PCGB.getCallGraph());
       MCGNode *main = G.getEntryNode();
 
+      // get solutions of ILPs from earlier runs
+      loadILPCache();
+
+      // allocate the analysis results of basic blocks and call sites
+      indexBlocks(G);
+
       // find out whether a call free path exists in each function
       checkCallFreePaths(G);
 
@@ -3555,6 +3926,9 @@ namespace llvm {
       if (!SCAPMLExport.empty())
         exportPML(G, SCAGraph);
 
+      // keep solutions of ILPs for later runs
+      storeILPCache();
+
       return false;
     }
 
@@ -3620,10 +3994,15 @@ namespace llvm {
         errs() << "[mc2yml] Reason: " << ErrorInfo;
         report_fatal_error("Exporting stack analysis results to PML failed!");
       }
+      else if (yaml::isBinaryPMLFileName(OutFileName)) {
+        yaml::BinaryOutput BinaryOut(OutFile->os());
+        BinaryOut << YDoc;
+        Output = 0;
+      }
       else {
         Output = new yaml::Output(OutFile->os());
+        *Output << YDoc;
       }
-      *Output << YDoc;
       if (OutFile) {
         OutFile->keep();
         delete Output;
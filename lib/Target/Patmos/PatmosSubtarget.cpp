@@ -43,6 +43,25 @@ static cl::opt<unsigned> MethodCacheSize("mpatmos-method-cache-size",
                      cl::desc("Total size of the instruction cache in bytes "
                               "(default 4096)"));
 
+/// DataCacheSize - Total size of the data cache in bytes.
+static cl::opt<unsigned> DataCacheSize("mpatmos-data-cache-size",
+                     cl::init(2048),
+                     cl::desc("Total size of the data cache in bytes "
+                              "(default 2048)"));
+
+/// DataCacheBlockSize - Size of a line of the data cache in bytes.
+static cl::opt<unsigned> DataCacheBlockSize("mpatmos-data-cache-block-size",
+                     cl::init(32),
+                     cl::desc("Line size of the data cache in bytes "
+                              "(default 32)"));
+
+/// SPMSize - Size of the local scratchpad memory available for data.
+static cl::opt<unsigned> SPMSize("mpatmos-spm-size",
+                     cl::init(0),
+                     cl::desc("Size of the local scratchpad memory in bytes "
+                              "used to allocate data automatically "
+                              "(default 0, disabled)"));
+
 static cl::opt<unsigned> MinSubfunctionAlign("mpatmos-subfunction-align",
                    cl::init(16),
                    cl::desc("Alignment for functions and subfunctions (including "
@@ -97,7 +116,7 @@ static cl::opt<PatmosSubtarget::CFLType> PatmosCFLType("mpatmos-cfl",
 PatmosSubtarget::PatmosSubtarget(const std::string &TT,
                                  const std::string &CPU,
                                  const std::string &FS) :
-  PatmosGenSubtargetInfo(TT, CPU, FS)
+  PatmosGenSubtargetInfo(TT, CPU, FS), HasFPU(false), HasMethodCache(false)
 {
   std::string CPUName = CPU;
   if (CPUName.empty()) CPUName = "generic";
@@ -222,6 +241,18 @@ unsigned PatmosSubtarget::getMethodCacheSize() const {
   return MethodCacheSize;
 }
 
+unsigned PatmosSubtarget::getDataCacheSize() const {
+  return DataCacheSize;
+}
+
+unsigned PatmosSubtarget::getDataCacheBlockSize() const {
+  return DataCacheBlockSize;
+}
+
+unsigned PatmosSubtarget::getSPMSize() const {
+  return SPMSize;
+}
+
 unsigned PatmosSubtarget::getAlignedStackFrameSize(unsigned frameSize) const {
   if (frameSize == 0) return 0;
   return ((frameSize - 1) / getStackCacheBlockSize() + 1) *
@@ -117,6 +117,13 @@ public:
 
   unsigned getMethodCacheSize() const;
 
+  unsigned getDataCacheSize() const;
+
+  unsigned getDataCacheBlockSize() const;
+
+  /// Return the size of the scratchpad memory used for data allocation.
+  unsigned getSPMSize() const;
+
   /// Return the actual size of a stack cache frame in bytes.
   /// @param frameSize the required frame size in bytes.
   unsigned getAlignedStackFrameSize(unsigned frameSize) const;
@@ -0,0 +1,307 @@
+//===-- PatmosSuperblockFormation.cpp - Form superblocks for scheduling. --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass forms superblocks along the WCET-critical path before the post-RA
+// scheduler, which schedules each basic block separately.
+//
+// A block that has a single successor is merged with its successor, so that
+// the code of both blocks (including predicated code created by the if
+// converter) is scheduled as one region and the branch between them is
+// removed. If the successor has other predecessors, i.e., it is a side entry
+// into the trace, the successor is tail-duplicated into the block and the
+// original block remains as compensation code for the other predecessors.
+//
+// Tail duplication is only done along edges where both blocks are critical,
+// according to the criticalities imported by PatmosPMLProfileImport, and only
+// up to a maximum number of duplicated instructions per superblock. Without
+// criticalities, only blocks that have no other predecessors are merged.
+//
+// Side exits (conditional branches) still end a scheduling region, the
+// scheduler does not move code across them.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "patmos-superblocks"
+
+#include "Patmos.h"
+#include "PatmosInstrInfo.h"
+#include "PatmosMachineFunctionInfo.h"
+#include "PatmosTargetMachine.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineBranchProbabilityInfo.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+STATISTIC(NumMerged,     "Number of blocks merged into their predecessor");
+STATISTIC(NumDuplicated, "Number of blocks tail-duplicated into superblocks");
+STATISTIC(NumDupInstrs,  "Number of instructions duplicated for superblocks");
+
+static cl::opt<bool> DisableSuperblocks(
+    "mpatmos-disable-superblocks",
+    cl::init(false),
+    cl::desc("Disable the formation of superblocks before post-RA "
+             "scheduling."),
+    cl::Hidden);
+
+static cl::opt<unsigned> MaxDuplicateSize(
+    "mpatmos-superblock-max-duplicate",
+    cl::init(16),
+    cl::desc("Maximum number of instructions tail-duplicated into a "
+             "superblock. (default: 16)"),
+    cl::Hidden);
+
+static cl::opt<double> CriticalThreshold(
+    "mpatmos-superblock-critical-threshold",
+    cl::init(0.9),
+    cl::desc("Minimum criticality of blocks that are tail-duplicated into "
+             "superblocks. (default: 0.9)"),
+    cl::Hidden);
+
+namespace {
+
+  class PatmosSuperblockFormation : public MachineFunctionPass {
+  private:
+    const PatmosInstrInfo &PII;
+
+    MachineLoopInfo *MLI;
+
+    MachineBranchProbabilityInfo *MBPI;
+
+    static char ID;
+  public:
+    PatmosSuperblockFormation(const PatmosTargetMachine &tm)
+      : MachineFunctionPass(ID), PII(*tm.getInstrInfo()), MLI(0), MBPI(0)
+    {
+    }
+
+    virtual const char *getPassName() const {
+      return "Patmos Superblock Formation";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<MachineLoopInfo>();
+      AU.addRequired<MachineBranchProbabilityInfo>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
+    bool runOnMachineFunction(MachineFunction &MF);
+
+  private:
+    /// getSuperblockSuccessor - Get the successor that can be appended to a
+    /// block, or NULL if the block does not end with an unconditional
+    /// transfer to a single successor.
+    MachineBasicBlock *getSuperblockSuccessor(MachineBasicBlock &MBB);
+
+    /// canAppend - Check if the successor block can be appended to MBB, either
+    /// by merging the blocks or by duplicating Succ.
+    bool canAppend(MachineBasicBlock &MBB, MachineBasicBlock &Succ,
+                   PatmosAnalysisInfo &PAI, unsigned Budget);
+
+    /// append - Append the code of Succ to MBB, replacing the branch to Succ.
+    /// If Succ has no other predecessors, its instructions are moved and the
+    /// block is removed, otherwise they are copied.
+    void append(MachineBasicBlock &MBB, MachineBasicBlock &Succ);
+
+    /// getSize - Get the number of non-pseudo instructions in a block.
+    unsigned getSize(const MachineBasicBlock &MBB) const;
+  };
+
+  char PatmosSuperblockFormation::ID = 0;
+}
+
+FunctionPass *
+llvm::createPatmosSuperblockFormationPass(const PatmosTargetMachine &tm) {
+  return new PatmosSuperblockFormation(tm);
+}
+
+bool PatmosSuperblockFormation::runOnMachineFunction(MachineFunction &MF)
+{
+  if (DisableSuperblocks) return false;
+
+  MLI = &getAnalysis<MachineLoopInfo>();
+  MBPI = &getAnalysis<MachineBranchProbabilityInfo>();
+
+  PatmosMachineFunctionInfo &PMFI = *MF.getInfo<PatmosMachineFunctionInfo>();
+  PatmosAnalysisInfo &PAI = PMFI.getAnalysisInfo();
+
+  bool Changed = false;
+
+  for (MachineFunction::iterator i = MF.begin(); i != MF.end(); i++) {
+    MachineBasicBlock *MBB = &*i;
+
+    // Grow the superblock as long as it ends in a single successor.
+    unsigned Budget = MaxDuplicateSize;
+    while (MachineBasicBlock *Succ = getSuperblockSuccessor(*MBB)) {
+      if (!canAppend(*MBB, *Succ, PAI, Budget))
+        break;
+
+      if (Succ->pred_size() > 1)
+        Budget -= getSize(*Succ);
+
+      append(*MBB, *Succ);
+      Changed = true;
+    }
+  }
+
+  return Changed;
+}
+
+MachineBasicBlock *
+PatmosSuperblockFormation::getSuperblockSuccessor(MachineBasicBlock &MBB)
+{
+  if (MBB.succ_size() != 1)
+    return NULL;
+
+  MachineBasicBlock *TBB = NULL, *FBB = NULL;
+  SmallVector<MachineOperand, 2> Cond;
+  if (PII.AnalyzeBranch(MBB, TBB, FBB, Cond, false) || !Cond.empty())
+    return NULL;
+
+  MachineBasicBlock *Succ = *MBB.succ_begin();
+
+  // Without a branch, the successor must be the fall-through block.
+  if (TBB != Succ && (TBB || !MBB.isLayoutSuccessor(Succ)))
+    return NULL;
+
+  return Succ;
+}
+
+bool PatmosSuperblockFormation::canAppend(MachineBasicBlock &MBB,
+                                          MachineBasicBlock &Succ,
+                                          PatmosAnalysisInfo &PAI,
+                                          unsigned Budget)
+{
+  if (&Succ == &MBB || Succ.isLandingPad() || Succ.hasAddressTaken() ||
+      &Succ == &MBB.getParent()->front())
+    return false;
+
+  // Do not change the structure of loops, loop bounds are attached to the
+  // headers.
+  if (MLI->isLoopHeader(&Succ))
+    return false;
+
+  // The branch of the successor is rewritten if it is copied, so it must be
+  // analyzable, or the successor must end the function.
+  MachineBasicBlock *TBB = NULL, *FBB = NULL;
+  SmallVector<MachineOperand, 2> Cond;
+  if (PII.AnalyzeBranch(Succ, TBB, FBB, Cond, false) && !Succ.succ_empty())
+    return false;
+
+  for (MachineBasicBlock::const_succ_iterator si = Succ.succ_begin(),
+       se = Succ.succ_end(); si != se; si++)
+  {
+    if ((*si)->isLandingPad())
+      return false;
+  }
+
+  // Merging the blocks does not increase the code size.
+  if (Succ.pred_size() == 1)
+    return true;
+
+  if (PAI.getCriticality(&MBB) < CriticalThreshold ||
+      PAI.getCriticality(&Succ) < CriticalThreshold)
+    return false;
+
+  if (getSize(Succ) > Budget)
+    return false;
+
+  for (MachineBasicBlock::const_iterator mi = Succ.begin(), me = Succ.end();
+       mi != me; mi++)
+  {
+    if (mi->isNotDuplicable() || mi->isInlineAsm() || mi->isBundle())
+      return false;
+  }
+
+  return true;
+}
+
+void PatmosSuperblockFormation::append(MachineBasicBlock &MBB,
+                                       MachineBasicBlock &Succ)
+{
+  MachineFunction &MF = *MBB.getParent();
+
+  DEBUG(dbgs() << "Superblock: appending BB#" << Succ.getNumber()
+               << " to BB#" << MBB.getNumber() << " in " << MF.getName()
+               << (Succ.pred_size() > 1 ? " (duplicated)\n" : "\n"));
+
+  // Get the targets of the successor before moving any code around.
+  MachineBasicBlock *TBB = NULL, *FBB = NULL;
+  SmallVector<MachineOperand, 2> Cond;
+  bool IsExit = PII.AnalyzeBranch(Succ, TBB, FBB, Cond, false);
+
+  MachineFunction::iterator Next = &Succ;
+  ++Next;
+  MachineBasicBlock *FallThrough = Next != MF.end() ? &*Next : NULL;
+
+  DebugLoc DL;
+  if (MBB.getFirstTerminator() != MBB.end())
+    DL = MBB.getFirstTerminator()->getDebugLoc();
+
+  PII.RemoveBranch(MBB);
+
+  // Copy or move the code, except for the branches which are re-created
+  // below.
+  MachineBasicBlock::iterator End = IsExit ? Succ.end()
+                                           : Succ.getFirstTerminator();
+  if (Succ.pred_size() == 1) {
+    MBB.splice(MBB.end(), &Succ, Succ.begin(), End);
+    NumMerged++;
+  } else {
+    for (MachineBasicBlock::iterator mi = Succ.begin(); mi != End; mi++) {
+      MBB.push_back(MF.CloneMachineInstr(mi));
+      if (!mi->isDebugValue())
+        NumDupInstrs++;
+    }
+    NumDuplicated++;
+  }
+
+  if (!IsExit && !Succ.succ_empty()) {
+    if (!TBB) {
+      TBB = FallThrough;
+    } else if (!Cond.empty() && !FBB) {
+      FBB = FallThrough;
+    }
+    PII.InsertBranch(MBB, TBB, FBB, Cond, DL);
+  }
+
+  // Update the CFG, keep the edge weights of the successor.
+  MBB.removeSuccessor(&Succ);
+  for (MachineBasicBlock::succ_iterator si = Succ.succ_begin(),
+       se = Succ.succ_end(); si != se; si++)
+  {
+    MBB.addSuccessor(*si, MBPI->getEdgeWeight(&Succ, si));
+  }
+
+  if (Succ.pred_empty()) {
+    while (!Succ.succ_empty())
+      Succ.removeSuccessor(Succ.succ_end() - 1);
+    Succ.eraseFromParent();
+  }
+
+  // Remove branches to the layout successor.
+  MBB.updateTerminator();
+}
+
+unsigned PatmosSuperblockFormation::getSize(const MachineBasicBlock &MBB) const
+{
+  unsigned Size = 0;
+  for (MachineBasicBlock::const_iterator mi = MBB.begin(), me = MBB.end();
+       mi != me; mi++)
+  {
+    if (!mi->isPseudo() && !mi->isDebugValue())
+      Size++;
+  }
+  return Size;
+}
@@ -105,6 +105,16 @@ namespace {
     /// addPreISelPasses - This method should add any "last minute" LLVM->LLVM
     /// passes (which are run just before instruction selector).
     virtual bool addPreISel() {
+      // Attach loop bounds derived from scalar evolution before they are
+      // used by the passes below and by single-path code generation.
+      addPass(createPatmosLoopBoundInferencePass());
+
+      // Move data to the scratchpad address space, the instruction selector
+      // emits the local loads and stores for it.
+      if (getPatmosSubtarget().getSPMSize()) {
+        addPass(createPatmosSPMAllocationPass(getPatmosTargetMachine()));
+      }
+
       if (PatmosSinglePathInfo::isEnabled()) {
         // Single-path transformation requires a single exit node
         addPass(createUnifyFunctionExitNodesPass());
@@ -156,6 +166,8 @@ namespace {
         addPass(createPatmosSPBundlingPass(getPatmosTargetMachine()));
         addPass(createPatmosSPReducePass(getPatmosTargetMachine()));
         addPass(createSPSchedulerPass(getPatmosTargetMachine()));
+        // Merge single-path clones that became identical
+        addPass(createPatmosSPMergePass(getPatmosTargetMachine()));
       } else {
         if (getOptLevel() != CodeGenOpt::None && !DisableIfConverter) {
           addPass(&IfConverterID);
@@ -167,6 +179,11 @@ namespace {
           // Add the standard basic block placement before the post-RA scheduler
           // as it creates and removes branches.
           TargetPassConfig::addBlockPlacement();
+
+          // Merge blocks along the critical path, so that the post-RA
+          // scheduler can schedule them as one region.
+          addPass(createPatmosSuperblockFormationPass(
+                                                  getPatmosTargetMachine()));
         }
       }
 
@@ -206,17 +223,23 @@ namespace {
       // correctly.
 
       if (getPatmosSubtarget().hasMethodCache()) {
+        addPass(createPatmosMethodCachePlacement(getPatmosTargetMachine()));
         addPass(createPatmosFunctionSplitterPass(getPatmosTargetMachine()));
+        addPass(createPatmosMethodCacheReport(getPatmosTargetMachine()));
       }
 
       addPass(createPatmosDelaySlotKillerPass(getPatmosTargetMachine()));
 
       addPass(createPatmosEnsureAlignmentPass(getPatmosTargetMachine()));
 
-      // following pass is a peephole pass that does neither modify
-      // the control structure nor the size of basic blocks.
+      // following passes do neither modify the control structure nor the
+      // size of basic blocks.
+      addPass(createPatmosDataCacheBypass(getPatmosTargetMachine()));
       addPass(createPatmosBypassFromPMLPass(getPatmosTargetMachine()));
 
+      // Estimate the WCET of the final code.
+      addPass(createPatmosWCETEstimatorPass(getPatmosTargetMachine()));
+
       return true;
     }
 
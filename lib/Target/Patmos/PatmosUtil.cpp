@@ -28,8 +28,16 @@ void getMBBIRName(const MachineBasicBlock *MBB,
 }
 
 std::pair<int,int> getLoopBounds(const MachineBasicBlock * MBB) {
-  if(MBB && MBB->getBasicBlock()) {
-    if (auto loop_bound_meta = MBB->getBasicBlock()->getTerminator()->getMetadata("llvm.loop")) {
+  if(MBB) {
+    return getLoopBounds(MBB->getBasicBlock());
+  }
+
+  return std::make_pair(-1, -1);
+}
+
+std::pair<int,int> getLoopBounds(const BasicBlock * BB) {
+  if(BB && BB->getTerminator()) {
+    if (auto loop_bound_meta = BB->getTerminator()->getMetadata("llvm.loop")) {
 
       // We ignore the first metadata operand, as it is always a self-reference
       // in "llvm.loop".
@@ -57,8 +65,8 @@ std::pair<int,int> getLoopBounds(const MachineBasicBlock * MBB) {
                 return std::make_pair(min, max);
               } else {
                 report_fatal_error(
-                          "Invalid loop bound in MBB: '" +
-                          MBB->getName() + "'!");
+                          "Invalid loop bound in block: '" +
+                          BB->getName() + "'!");
               }
             }
           }
@@ -70,5 +78,29 @@ std::pair<int,int> getLoopBounds(const MachineBasicBlock * MBB) {
   return std::make_pair(-1, -1);
 }
 
+bool isInferredLoopBound(const MachineBasicBlock * MBB) {
+  return MBB && isInferredLoopBound(MBB->getBasicBlock());
+}
+
+bool isInferredLoopBound(const BasicBlock * BB) {
+  if(BB && BB->getTerminator()) {
+    if (auto loop_meta = BB->getTerminator()->getMetadata("llvm.loop")) {
+      for(int i = 1, end = loop_meta->getNumOperands(); i < end; i++) {
+        auto meta_op = dyn_cast_or_null<MDNode>(loop_meta->getOperand(i));
+
+        if (meta_op && meta_op->getNumOperands() == 1) {
+          auto name = dyn_cast_or_null<MDString>(meta_op->getOperand(0));
+
+          if (name && name->getString() == "llvm.loop.bound.inferred") {
+            return true;
+          }
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
 } // End llvm namespace
 
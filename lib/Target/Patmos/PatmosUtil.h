@@ -36,6 +36,12 @@ void getMBBIRName(const MachineBasicBlock *MBB,
 /// The second element is the maximum iteration count.
 /// If a bound is not available, -1 is returned.
 std::pair<int,int> getLoopBounds(const MachineBasicBlock * MBB);
+std::pair<int,int> getLoopBounds(const BasicBlock * BB);
+
+/// Returns true if the loop bound in the metadata of the block terminator
+/// was inferred by the compiler and not annotated by the user.
+bool isInferredLoopBound(const MachineBasicBlock * MBB);
+bool isInferredLoopBound(const BasicBlock * BB);
 
 } // End llvm namespace
 
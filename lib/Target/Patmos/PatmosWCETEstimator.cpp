@@ -0,0 +1,448 @@
+//===-- PatmosWCETEstimator.cpp - Estimate the WCET of functions. ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Compute a WCET estimate of all functions using the implicit path enumeration
+// technique (IPET), to give fast feedback on the effect of transformations
+// without exporting PML and running platin.
+//
+// The execution time of a basic block is its number of cycles, assuming that
+// all cache accesses hit: every bundle (or single instruction) takes a cycle,
+// pseudo instructions without functional units in the itineraries are free,
+// and non-delayed control flow instructions stall for their delay slots. The
+// latencies of the itineraries are already covered by the schedule. Calls add
+// the WCET estimate of their callees, which are processed bottom-up over the
+// call graph.
+//
+// The IPET problem of a function is an ILP over the execution counts of the
+// CFG edges: the entry is executed once, the flow into each block equals the
+// flow out of it, and the backedges of each loop are taken at most as often
+// as given by the loop bound (see getLoopBounds) per entry of the loop. The
+// problem is solved using the built-in ILP solver, the counts of the optimal
+// solution give the worst-case path.
+//
+// Functions containing loops without bounds, recursion, or calls to unknown
+// (external or indirect) functions have no estimate. Estimates are printed to
+// the error stream if -mpatmos-wcet-estimate is given.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "patmos-wcet-estimate"
+
+#include "Patmos.h"
+#include "PatmosCallGraphBuilder.h"
+#include "PatmosILPSolver.h"
+#include "PatmosInstrInfo.h"
+#include "PatmosSubtarget.h"
+#include "PatmosTargetMachine.h"
+#include "PatmosUtil.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/CodeGen/MachineDominators.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <string>
+
+using namespace llvm;
+
+STATISTIC(NumEstimated, "Number of functions with a WCET estimate");
+STATISTIC(NumUnknown,   "Number of functions without a WCET estimate");
+
+static cl::opt<bool> EnableWCETEstimate(
+  "mpatmos-wcet-estimate",
+  cl::init(false),
+  cl::desc("Print an IPET-based WCET estimate and the worst-case path of all "
+           "functions, assuming that all cache accesses hit."),
+  cl::Hidden);
+
+namespace {
+  /// The WCET estimate of a function.
+  struct WCETEstimate {
+    /// True if the function has an estimate.
+    bool Known;
+
+    /// The WCET estimate in cycles.
+    double Cycles;
+
+    /// The reason why there is no estimate.
+    std::string Reason;
+
+    WCETEstimate() : Known(false), Cycles(0) {}
+  };
+
+  class PatmosWCETEstimator : public MachineModulePass {
+  private:
+    const PatmosTargetMachine &TM;
+    const PatmosSubtarget &STC;
+    const PatmosInstrInfo &PII;
+
+    /// The estimates of the functions processed so far.
+    std::map<const MCGNode*, WCETEstimate> Estimates;
+
+    /// getCycles - Get the cycles of an instruction or bundle.
+    unsigned getCycles(const MachineInstr *MI) const {
+      if (PII.isPseudo(MI))
+        return 0;
+
+      unsigned Cycles = 1;
+
+      MachineBasicBlock::const_instr_iterator I = MI,
+                                      E = MI->getParent()->instr_end();
+      if (MI->isBundle()) I++;
+      do {
+        // Non-delayed branches stall the pipeline instead of executing the
+        // delay slots.
+        if ((I->isBranch() || I->isCall() || I->isReturn()) &&
+            !I->hasDelaySlot())
+        {
+          Cycles += STC.getCFLDelaySlotCycles(I->isBranch() &&
+                                              !PII.mayStall(I));
+        }
+        I++;
+      } while (I != E && I->isBundledWithPred());
+
+      return Cycles;
+    }
+
+    /// getBlockCycles - Get the cycles of a basic block, including the WCET
+    /// of the called functions. Returns false if a callee has no estimate.
+    bool getBlockCycles(PatmosCallGraphBuilder &PCGB,
+                        const MachineBasicBlock &MBB, double &Cycles,
+                        std::string &Reason)
+    {
+      Cycles = 0;
+      for (MachineBasicBlock::const_iterator i = MBB.begin(), ie = MBB.end();
+           i != ie; i++)
+      {
+        Cycles += getCycles(i);
+      }
+
+      for (MachineBasicBlock::const_instr_iterator i = MBB.instr_begin(),
+           ie = MBB.instr_end(); i != ie; i++)
+      {
+        if (!i->isCall())
+          continue;
+
+        MCGSites Sites = PCGB.getSites(i);
+        if (Sites.empty()) {
+          Reason = "unknown call in BB#" + utostr(MBB.getNumber());
+          return false;
+        }
+
+        // Take the most expensive of all potential callees.
+        double CallCycles = 0;
+        for (MCGSites::iterator s = Sites.begin(), se = Sites.end();
+             s != se; s++)
+        {
+          MCGNode *Callee = (*s)->getCallee();
+          if (Callee->isUnknown()) {
+            Reason = "call to an unknown function in BB#" +
+                     utostr(MBB.getNumber());
+            return false;
+          }
+
+          const WCETEstimate &E = Estimates[Callee];
+          if (!E.Known) {
+            Reason = "call to " + Callee->getMF()->getName().str() +
+                     " without estimate in BB#" + utostr(MBB.getNumber());
+            return false;
+          }
+          CallCycles = std::max(CallCycles, E.Cycles);
+        }
+        Cycles += CallCycles;
+      }
+
+      return true;
+    }
+
+    /// getEdgeName - Get the name of the ILP variable of a CFG edge.
+    static std::string getEdgeName(const MachineBasicBlock *From,
+                                   const MachineBasicBlock *To) {
+      return "e" + utostr(From->getNumber()) + "_" + utostr(To->getNumber());
+    }
+
+    /// getEntryName - Get the name of the ILP variable of the function entry.
+    static std::string getEntryName() { return "entry"; }
+
+    /// getExitName - Get the name of the ILP variable of the edge leaving the
+    /// function from a block.
+    static std::string getExitName(const MachineBasicBlock *MBB) {
+      return "x" + utostr(MBB->getNumber());
+    }
+
+    /// getLoopBound - Get the maximum number of times the backedges of a loop
+    /// are taken per entry of the loop, or -1 if it has no bound.
+    int getLoopBound(const LoopInfoBase<MachineBasicBlock, MachineLoop> &LI,
+                     const MachineLoop *L) const {
+      // The bound is attached to the block of the loop header in the bitcode,
+      // which is not necessarily the header of the machine loop. Skip the
+      // blocks of subloops, which carry their own bounds.
+      for (MachineLoop::block_iterator i = L->block_begin(),
+           ie = L->block_end(); i != ie; i++)
+      {
+        if (LI.getLoopFor(*i) != L) continue;
+
+        int Max = getLoopBounds(*i).second;
+        if (Max >= 0) return Max;
+      }
+      return -1;
+    }
+
+    /// estimate - Compute the WCET estimate of a function, and print the
+    /// estimate and the worst-case path to OS.
+    WCETEstimate estimate(PatmosCallGraphBuilder &PCGB, PatmosILPSolver &S,
+                          MachineFunction &MF, raw_ostream &OS);
+
+  public:
+    static char ID;
+
+    PatmosWCETEstimator(const PatmosTargetMachine &tm) :
+      MachineModulePass(ID), TM(tm), STC(tm.getSubtarget<PatmosSubtarget>()),
+      PII(*tm.getInstrInfo())
+    {
+      initializePatmosCallGraphBuilderPass(*PassRegistry::getPassRegistry());
+    }
+
+    virtual const char *getPassName() const {
+      return "Patmos WCET Estimator";
+    }
+
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesAll();
+      AU.addRequired<PatmosCallGraphBuilder>();
+
+      ModulePass::getAnalysisUsage(AU);
+    }
+
+    virtual bool runOnMachineModule(const Module &M) {
+      if (!EnableWCETEstimate) return false;
+
+      PatmosCallGraphBuilder &PCGB = getAnalysis<PatmosCallGraphBuilder>();
+      const MCallGraph &MCG = *PCGB.getCallGraph();
+      OwningPtr<PatmosILPSolver> Solver(createPatmosBuiltinILPSolver());
+
+      Estimates.clear();
+
+      // Callees are placed before their callers, the reports are printed in
+      // the order of the call graph nodes.
+      std::map<const MCGNode*, std::string> Reports;
+
+      const MCGSCCs &SCCs = MCG.getSCCs();
+      for (MCGSCCs::const_iterator i = SCCs.begin(), ie = SCCs.end();
+           i != ie; i++)
+      {
+        for (MCGNodes::const_iterator n = i->Nodes.begin(),
+             ne = i->Nodes.end(); n != ne; n++)
+        {
+          if ((*n)->isUnknown()) continue;
+
+          raw_string_ostream OS(Reports[*n]);
+          if (i->HasLoop) {
+            Estimates[*n].Reason = "recursion";
+            OS << "WCET estimate of " << (*n)->getMF()->getName()
+               << ": unknown (recursion)\n";
+          } else {
+            Estimates[*n] = estimate(PCGB, *Solver, *(*n)->getMF(), OS);
+          }
+
+          if (Estimates[*n].Known)
+            NumEstimated++;
+          else
+            NumUnknown++;
+        }
+      }
+
+      const MCGNodes &Nodes = MCG.getNodes();
+      for (MCGNodes::const_iterator n = Nodes.begin(), ne = Nodes.end();
+           n != ne; n++)
+      {
+        errs() << Reports[*n];
+      }
+
+      return false;
+    }
+  };
+
+  char PatmosWCETEstimator::ID = 0;
+}
+
+WCETEstimate PatmosWCETEstimator::estimate(PatmosCallGraphBuilder &PCGB,
+                                           PatmosILPSolver &S,
+                                           MachineFunction &MF,
+                                           raw_ostream &OS)
+{
+  WCETEstimate Result;
+
+  OS << "WCET estimate of " << MF.getName() << ": ";
+
+  DominatorTreeBase<MachineBasicBlock> DT(false);
+  DT.recalculate(MF);
+  LoopInfoBase<MachineBasicBlock, MachineLoop> MLI;
+  MLI.Analyze(DT);
+
+  // Build the objective function, weighting the edges by the cycles of their
+  // targets.
+  std::map<const MachineBasicBlock*, double> BlockCycles;
+  std::string Objective;
+  raw_string_ostream Obj(Objective);
+  for (MachineFunction::iterator i = MF.begin(), ie = MF.end(); i != ie; i++) {
+    double Cycles;
+    if (!getBlockCycles(PCGB, *i, Cycles, Result.Reason)) {
+      OS << "unknown (" << Result.Reason << ")\n";
+      return Result;
+    }
+    BlockCycles[i] = Cycles;
+
+    if (&*i == &MF.front())
+      Obj << " + " << format("%.0f", Cycles) << " " << getEntryName();
+
+    for (MachineBasicBlock::pred_iterator p = i->pred_begin(),
+         pe = i->pred_end(); p != pe; p++)
+    {
+      Obj << " + " << format("%.0f", Cycles) << " " << getEdgeName(*p, i);
+    }
+  }
+
+  std::string LP;
+  raw_string_ostream ILP(LP);
+  ILP << "Maximize\n" << Obj.str() << "\nSubject To\n";
+  ILP << "start:\t" << getEntryName() << " = 1\n";
+
+  // Flow conservation, collect the variables of all edges.
+  std::vector<std::string> Vars;
+  Vars.push_back(getEntryName());
+  for (MachineFunction::iterator i = MF.begin(), ie = MF.end(); i != ie; i++) {
+    ILP << "flow" << i->getNumber() << ":\t";
+    if (&*i == &MF.front())
+      ILP << " + " << getEntryName();
+
+    for (MachineBasicBlock::pred_iterator p = i->pred_begin(),
+         pe = i->pred_end(); p != pe; p++)
+    {
+      ILP << " + " << getEdgeName(*p, i);
+    }
+
+    if (i->succ_empty()) {
+      ILP << " - " << getExitName(i);
+      Vars.push_back(getExitName(i));
+    }
+
+    for (MachineBasicBlock::succ_iterator s = i->succ_begin(),
+         se = i->succ_end(); s != se; s++)
+    {
+      ILP << " - " << getEdgeName(i, *s);
+      Vars.push_back(getEdgeName(i, *s));
+    }
+    ILP << " = 0\n";
+  }
+
+  // Loop bounds: backedges <= bound * entry edges.
+  for (MachineFunction::iterator i = MF.begin(), ie = MF.end(); i != ie; i++) {
+    MachineLoop *L = MLI.getLoopFor(i);
+    if (!L || L->getHeader() != &*i)
+      continue;
+
+    int Bound = getLoopBound(MLI, L);
+    if (Bound < 0) {
+      Result.Reason = "loop without bound in BB#" + utostr(i->getNumber());
+      OS << "unknown (" << Result.Reason << ")\n";
+      return Result;
+    }
+
+    ILP << "loop" << i->getNumber() << ":\t";
+    if (&*i == &MF.front())
+      ILP << " - " << Bound << " " << getEntryName();
+
+    for (MachineBasicBlock::pred_iterator p = i->pred_begin(),
+         pe = i->pred_end(); p != pe; p++)
+    {
+      if (L->contains(*p))
+        ILP << " + " << getEdgeName(*p, i);
+      else
+        ILP << " - " << Bound << " " << getEdgeName(*p, i);
+    }
+    ILP << " <= 0\n";
+  }
+
+  ILP << "Generals\n";
+  for (unsigned i = 0; i < Vars.size(); i++)
+    ILP << Vars[i] << "\n";
+  ILP << "End\n";
+
+  DEBUG(dbgs() << "IPET problem of " << MF.getName() << ":\n" << ILP.str());
+
+  std::map<std::string, double> Values;
+  std::string ErrMsg;
+  switch (S.solve(ILP.str(), Result.Cycles, Values, ErrMsg)) {
+  case PatmosILPSolver::Optimal:
+    break;
+  case PatmosILPSolver::Unbounded:
+    Result.Reason = "unbounded, irreducible loop";
+    OS << "unknown (" << Result.Reason << ")\n";
+    return Result;
+  default:
+    Result.Reason = ErrMsg.empty() ? "no solution" : ErrMsg;
+    OS << "unknown (" << Result.Reason << ")\n";
+    return Result;
+  }
+
+  Result.Known = true;
+  OS << format("%.0f", Result.Cycles) << " cycles\n";
+
+  // Print the worst-case path, i.e., the blocks executed in the solution.
+  for (MachineFunction::iterator i = MF.begin(), ie = MF.end(); i != ie; i++) {
+    double Count = &*i == &MF.front() ? Values[getEntryName()] : 0;
+    for (MachineBasicBlock::pred_iterator p = i->pred_begin(),
+         pe = i->pred_end(); p != pe; p++)
+    {
+      Count += Values[getEdgeName(*p, i)];
+    }
+    if (Count < 0.5)
+      continue;
+
+    OS << "  BB#" << i->getNumber();
+    if (const BasicBlock *BB = i->getBasicBlock())
+      OS << " (" << BB->getName() << ")";
+    OS << ": " << format("%.0f", Count) << " x "
+       << format("%.0f", BlockCycles[i]) << " cycles";
+
+    for (MachineBasicBlock::const_instr_iterator mi = i->instr_begin(),
+         me = i->instr_end(); mi != me; mi++)
+    {
+      if (!mi->isCall())
+        continue;
+
+      MCGSites Sites = PCGB.getSites(mi);
+      for (MCGSites::iterator s = Sites.begin(), se = Sites.end(); s != se;
+           s++)
+      {
+        MCGNode *Callee = (*s)->getCallee();
+        OS << ", calls " << Callee->getMF()->getName() << " ("
+           << format("%.0f", Estimates[Callee].Cycles) << " cycles)";
+      }
+    }
+    OS << "\n";
+  }
+
+  return Result;
+}
+
+/// createPatmosWCETEstimatorPass - Returns a new pass that computes and prints
+/// a WCET estimate of all functions.
+ModulePass *llvm::createPatmosWCETEstimatorPass(const PatmosTargetMachine &tm) {
+  return new PatmosWCETEstimator(tm);
+}
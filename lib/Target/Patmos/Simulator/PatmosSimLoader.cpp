@@ -0,0 +1,349 @@
+//===-- PatmosSimLoader.cpp - Load and link programs for the simulator ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Loading of ELF files into the memory of the Patmos simulator.
+//
+// Executables are loaded as they are. Relocatable objects are linked with a
+// simple static layout: all code sections are placed at the text base address,
+// followed by all data and all zero-initialized sections. Sections named .spm
+// are placed into the local memory, starting at address zero. Relocations are
+// applied as described by the relocation types of PatmosELFObjectWriter.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PatmosSimulator.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Object/ELF.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+using namespace llvm;
+using namespace object;
+
+typedef ELF32BEFile PatmosELFFile;
+typedef PatmosELFFile::Elf_Shdr Elf_Shdr;
+typedef PatmosELFFile::Elf_Sym Elf_Sym;
+
+/// isLocalMemorySection - Check if a section is placed into the scratchpad.
+static bool isLocalMemorySection(StringRef Name) {
+  return Name == ".spm" || Name.startswith(".spm.");
+}
+
+/// getSectionName - Get the name of a section, or an empty name on errors.
+static StringRef getSectionName(const PatmosELFFile &ELF,
+                                const Elf_Shdr *Sec) {
+  ErrorOr<StringRef> Name = ELF.getSectionName(Sec);
+  return Name ? *Name : StringRef();
+}
+
+bool PatmosSimulator::addObject(MemoryBuffer *Buffer, std::string &ErrMsg) {
+  error_code ec;
+  PatmosELFFile ELF(Buffer, ec);
+  if (ec) {
+    ErrMsg = std::string(Buffer->getBufferIdentifier()) + ": " + ec.message();
+    delete Buffer;
+    return false;
+  }
+  if (ELF.getHeader()->e_machine != ELF::EM_PATMOS) {
+    ErrMsg = std::string(Buffer->getBufferIdentifier()) +
+             ": not a Patmos ELF file";
+    delete Buffer;
+    return false;
+  }
+  Objects.push_back(Buffer);
+  return true;
+}
+
+bool PatmosSimulator::lookupSymbol(StringRef Name, uint32_t &Value) const {
+  StringMap<uint32_t>::const_iterator it = Symbols.find(Name);
+  if (it == Symbols.end())
+    return false;
+  Value = it->second;
+  return true;
+}
+
+bool PatmosSimulator::link(std::string &ErrMsg) {
+  if (Objects.empty()) {
+    ErrMsg = "no input files";
+    return false;
+  }
+
+  for (unsigned i = 0, e = Objects.size(); i != e; ++i) {
+    error_code ec;
+    PatmosELFFile ELF(Objects[i], ec);
+    if (ELF.getHeader()->e_type != ELF::ET_EXEC)
+      continue;
+    if (e != 1) {
+      ErrMsg = "executables cannot be linked with other files";
+      return false;
+    }
+    return loadExecutable(Objects[i], ErrMsg);
+  }
+
+  return linkObjects(ErrMsg);
+}
+
+bool PatmosSimulator::loadExecutable(MemoryBuffer *Buffer,
+                                     std::string &ErrMsg) {
+  error_code ec;
+  PatmosELFFile ELF(Buffer, ec);
+
+  for (PatmosELFFile::Elf_Shdr_Iter i = ELF.begin_sections(),
+       ie = ELF.end_sections(); i != ie; ++i) {
+    if (!(i->sh_flags & ELF::SHF_ALLOC) || i->sh_type == ELF::SHT_NOBITS)
+      continue;
+
+    bool Local = isLocalMemorySection(getSectionName(ELF, &*i));
+    std::vector<uint8_t> &Mem = Local ? LocalMemory : Memory;
+    ErrorOr<ArrayRef<uint8_t> > Contents = ELF.getSectionContents(&*i);
+    if (!Contents || (uint64_t)i->sh_addr + i->sh_size > Mem.size()) {
+      ErrMsg = "cannot load section " + getSectionName(ELF, &*i).str();
+      return false;
+    }
+    std::copy(Contents->begin(), Contents->end(), Mem.begin() + i->sh_addr);
+  }
+
+  for (PatmosELFFile::Elf_Sym_Iter i = ELF.begin_symbols(),
+       ie = ELF.end_symbols(); i != ie; ++i) {
+    ErrorOr<StringRef> Name = ELF.getSymbolName(i);
+    if (Name && !Name->empty() && i->getBinding() != ELF::STB_LOCAL)
+      Symbols[*Name] = i->st_value;
+  }
+  if (!Symbols.count("_start"))
+    Symbols["_start"] = ELF.getHeader()->e_entry;
+
+  return true;
+}
+
+namespace {
+  /// Placement of the sections of a relocatable object.
+  struct SectionLayout {
+    DenseMap<const Elf_Shdr*, uint32_t> Address;
+    DenseMap<const Elf_Shdr*, bool> Local;
+  };
+}
+
+/// place - Allocate space for a section at the end of the given region.
+static uint32_t place(uint32_t &End, const Elf_Shdr *Sec) {
+  uint32_t Align = std::max((uint32_t)Sec->sh_addralign, 1u);
+  uint32_t Addr = RoundUpToAlignment(End, Align);
+  End = Addr + Sec->sh_size;
+  return Addr;
+}
+
+bool PatmosSimulator::linkObjects(std::string &ErrMsg) {
+  std::vector<PatmosELFFile*> ELFs;
+  std::vector<SectionLayout> Layouts(Objects.size());
+  for (unsigned i = 0, e = Objects.size(); i != e; ++i) {
+    error_code ec;
+    ELFs.push_back(new PatmosELFFile(Objects[i], ec));
+  }
+
+  bool Success = true;
+
+  // Place code, then data, then zero-initialized data; the scratchpad data
+  // of all objects is placed into the local memory.
+  uint32_t End = Config.TextBase, LocalEnd = 0;
+  for (unsigned Kind = 0; Kind < 3; Kind++) {
+    for (unsigned o = 0, oe = ELFs.size(); o != oe; ++o) {
+      PatmosELFFile &ELF = *ELFs[o];
+      for (PatmosELFFile::Elf_Shdr_Iter i = ELF.begin_sections(),
+           ie = ELF.end_sections(); i != ie; ++i) {
+        if (!(i->sh_flags & ELF::SHF_ALLOC))
+          continue;
+        bool Local = isLocalMemorySection(getSectionName(ELF, &*i));
+        unsigned SecKind = Local ? 0 :
+                           (i->sh_flags & ELF::SHF_EXECINSTR) ? 0 :
+                           i->sh_type == ELF::SHT_NOBITS ? 2 : 1;
+        if (SecKind != Kind)
+          continue;
+        Layouts[o].Local[&*i] = Local;
+        Layouts[o].Address[&*i] = place(Local ? LocalEnd : End, &*i);
+      }
+    }
+  }
+
+  // Common symbols are allocated after all other data.
+  for (unsigned o = 0, oe = ELFs.size(); o != oe; ++o) {
+    PatmosELFFile &ELF = *ELFs[o];
+    for (PatmosELFFile::Elf_Sym_Iter i = ELF.begin_symbols(),
+         ie = ELF.end_symbols(); i != ie; ++i) {
+      ErrorOr<StringRef> Name = ELF.getSymbolName(i);
+      if (i->st_shndx != ELF::SHN_COMMON || !Name || Symbols.count(*Name))
+        continue;
+      End = RoundUpToAlignment(End, std::max((uint32_t)i->st_value, 1u));
+      Symbols[*Name] = End;
+      End += i->st_size;
+    }
+  }
+
+  if (End > Memory.size() || LocalEnd > LocalMemory.size()) {
+    ErrMsg = "program does not fit into memory";
+    Success = false;
+  }
+
+  // Copy the section contents.
+  for (unsigned o = 0, oe = ELFs.size(); Success && o != oe; ++o) {
+    PatmosELFFile &ELF = *ELFs[o];
+    for (DenseMap<const Elf_Shdr*, uint32_t>::iterator
+         i = Layouts[o].Address.begin(), ie = Layouts[o].Address.end();
+         i != ie; ++i) {
+      std::vector<uint8_t> &Mem = Layouts[o].Local[i->first] ? LocalMemory
+                                                             : Memory;
+      if (i->first->sh_type == ELF::SHT_NOBITS) {
+        std::fill(Mem.begin() + i->second,
+                  Mem.begin() + i->second + i->first->sh_size, 0);
+        continue;
+      }
+      ErrorOr<ArrayRef<uint8_t> > Contents = ELF.getSectionContents(i->first);
+      if (!Contents) {
+        ErrMsg = "cannot read section " + getSectionName(ELF, i->first).str();
+        Success = false;
+        break;
+      }
+      std::copy(Contents->begin(), Contents->end(), Mem.begin() + i->second);
+    }
+  }
+
+  // Collect the global symbols, symbols defined from the outside take
+  // precedence.
+  for (unsigned o = 0, oe = ELFs.size(); Success && o != oe; ++o) {
+    PatmosELFFile &ELF = *ELFs[o];
+    for (PatmosELFFile::Elf_Sym_Iter i = ELF.begin_symbols(),
+         ie = ELF.end_symbols(); i != ie; ++i) {
+      ErrorOr<StringRef> Name = ELF.getSymbolName(i);
+      if (!Name || Name->empty() || i->getBinding() == ELF::STB_LOCAL ||
+          i->st_shndx == ELF::SHN_UNDEF || i->st_shndx == ELF::SHN_COMMON)
+        continue;
+
+      uint32_t Value = i->st_value;
+      if (i->st_shndx != ELF::SHN_ABS)
+        Value += Layouts[o].Address.lookup(ELF.getSection(&*i));
+
+      if (Symbols.count(*Name) && i->getBinding() != ELF::STB_WEAK) {
+        ErrMsg = "duplicate symbol '" + Name->str() + "'";
+        Success = false;
+        break;
+      }
+      Symbols[*Name] = Value;
+    }
+  }
+  for (StringMap<uint32_t>::iterator i = DefinedSymbols.begin(),
+       ie = DefinedSymbols.end(); i != ie; ++i)
+    Symbols[i->getKey()] = i->getValue();
+
+  // Apply the relocations.
+  for (unsigned o = 0, oe = ELFs.size(); Success && o != oe; ++o) {
+    PatmosELFFile &ELF = *ELFs[o];
+    for (PatmosELFFile::Elf_Shdr_Iter s = ELF.begin_sections(),
+         se = ELF.end_sections(); Success && s != se; ++s) {
+      if (s->sh_type == ELF::SHT_RELA) {
+        ErrMsg = "unsupported relocation section " +
+                 getSectionName(ELF, &*s).str();
+        Success = false;
+        break;
+      }
+      if (s->sh_type != ELF::SHT_REL)
+        continue;
+
+      const Elf_Shdr *Target = ELF.getSection(s->sh_info);
+      if (!Layouts[o].Address.count(Target))
+        continue;
+      std::vector<uint8_t> &Mem = Layouts[o].Local[Target] ? LocalMemory
+                                                           : Memory;
+
+      for (PatmosELFFile::Elf_Rel_Iter r = ELF.begin_rel(&*s),
+           re = ELF.end_rel(&*s); r != re; ++r) {
+        std::pair<const Elf_Shdr*, const Elf_Sym*> Sym =
+          ELF.getRelocationSymbol(&*s, &*r);
+
+        // Compute the value of the symbol.
+        uint32_t S = 0;
+        if (Sym.second) {
+          const Elf_Sym *ES = Sym.second;
+          if (ES->st_shndx == ELF::SHN_UNDEF ||
+              ES->st_shndx == ELF::SHN_COMMON ||
+              (ES->getBinding() != ELF::STB_LOCAL &&
+               ES->getType() != ELF::STT_SECTION)) {
+            ErrorOr<StringRef> Name = ELF.getSymbolName(Sym.first, ES);
+            if (!Name || !lookupSymbol(*Name, S)) {
+              ErrMsg = "undefined symbol '" +
+                       (Name ? Name->str() : std::string("?")) + "'";
+              Success = false;
+              break;
+            }
+          } else {
+            S = ES->st_value;
+            if (ES->st_shndx != ELF::SHN_ABS)
+              S += Layouts[o].Address.lookup(ELF.getSection(ES));
+          }
+        }
+
+        uint32_t P = Layouts[o].Address[Target] + r->r_offset;
+        unsigned Type = r->getType(false);
+        uint32_t Word = P + (Type == ELF::R_PATMOS_ALUL_ABS ? 4 : 0);
+        if ((uint64_t)Word + 4 > Mem.size()) {
+          ErrMsg = "relocation outside of memory";
+          Success = false;
+          break;
+        }
+
+        uint8_t *Data = &Mem[Word];
+        uint32_t Value = (uint32_t)Data[0] << 24 | (uint32_t)Data[1] << 16 |
+                         (uint32_t)Data[2] << 8 | (uint32_t)Data[3];
+
+        // The addend is stored in place, in the (shifted) immediate field.
+        switch (Type) {
+        case ELF::R_PATMOS_NONE:
+          break;
+        case ELF::R_PATMOS_ABS_32:
+        case ELF::R_PATMOS_ALUL_ABS:
+          Value += S;
+          break;
+        case ELF::R_PATMOS_CFLI_ABS:
+          Value = (Value & ~0x3fffffu) |
+                  ((((Value & 0x3fffff) << 2) + S) >> 2 & 0x3fffff);
+          break;
+        case ELF::R_PATMOS_CFLI_PCREL:
+          Value = (Value & ~0x3fffffu) |
+                  ((((uint32_t)SignExtend32<22>(Value & 0x3fffff) << 2) +
+                    S - P) >> 2 & 0x3fffff);
+          break;
+        case ELF::R_PATMOS_ALUI_ABS:
+          Value = (Value & ~0xfffu) | ((Value + S) & 0xfff);
+          break;
+        case ELF::R_PATMOS_MEMB_ABS:
+        case ELF::R_PATMOS_MEMH_ABS:
+        case ELF::R_PATMOS_MEMW_ABS: {
+          unsigned Shift = Type - ELF::R_PATMOS_MEMB_ABS;
+          Value = (Value & ~0x7fu) |
+                  ((((Value & 0x7f) << Shift) + S) >> Shift & 0x7f);
+          break;
+        }
+        default:
+          ErrMsg = "unsupported relocation type " + Twine(Type).str();
+          Success = false;
+          break;
+        }
+
+        Data[0] = Value >> 24;
+        Data[1] = Value >> 16;
+        Data[2] = Value >> 8;
+        Data[3] = Value;
+      }
+    }
+  }
+
+  for (unsigned i = 0, e = ELFs.size(); i != e; ++i)
+    delete ELFs[i];
+
+  return Success;
+}
@@ -0,0 +1,733 @@
+//===-- PatmosSimulator.cpp - Cycle-level Patmos simulator ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Instruction execution and the timing model of the Patmos simulator.
+//
+// Instructions are decoded directly from their encoding as defined in
+// PatmosInstrFormats.td, which keeps the simulator independent of the code
+// generator and the MC layer.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PatmosSimulator.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+/// Special registers with a dedicated meaning.
+enum {
+  SReg_Pred = 0,
+  SReg_SL   = 2,
+  SReg_SH   = 3,
+  SReg_SS   = 5,
+  SReg_ST   = 6,
+  SReg_SRB  = 7,
+  SReg_SRO  = 8,
+  SReg_SXB  = 9,
+  SReg_SXO  = 10
+};
+
+/// Number of delay slots of local branches and of control flow instructions
+/// that may fill the method cache, see PatmosSubtarget::getCFLDelaySlotCycles.
+static const unsigned LocalBranchDelaySlots = 2;
+static const unsigned NonLocalDelaySlots = 3;
+
+/// Number of pipeline slots until the results of loads and multiplications
+/// can be used, see IIC_LD and IIC_ALUm in PatmosSchedule.td.
+static const unsigned LoadLatency = 2;
+static const unsigned MulLatency = 2;
+
+struct PatmosSimulator::Writes {
+  SmallVector<std::pair<unsigned, uint32_t>, 2> R;
+  SmallVector<std::pair<unsigned, uint32_t>, 2> S;
+  SmallVector<std::pair<unsigned, bool>, 2> P;
+  SmallVector<DelayedWrite, 2> Delayed;
+};
+
+void PatmosSimStats::clear() {
+  Cycles = Bundles = Instructions = Disabled = 0;
+  MethodCacheStalls = DataCacheStalls = StackCacheStalls = MemoryStalls =
+    BranchStalls = 0;
+  MethodCacheHits = MethodCacheMisses = MethodCacheBytes = 0;
+  DataCacheHits = DataCacheMisses = 0;
+  StackCacheSpilled = StackCacheFilled = 0;
+}
+
+void PatmosSimStats::print(raw_ostream &OS) const {
+  OS << "Cycles: " << Cycles << "\n"
+     << "Bundles: " << Bundles << "\n"
+     << "Instructions: " << Instructions << " (" << Disabled
+     << " disabled)\n"
+     << "Stall cycles: " << getStallCycles() << "\n"
+     << "  method cache: " << MethodCacheStalls << "\n"
+     << "  data cache: " << DataCacheStalls << "\n"
+     << "  stack cache: " << StackCacheStalls << "\n"
+     << "  main memory: " << MemoryStalls << "\n"
+     << "  branches: " << BranchStalls << "\n"
+     << "Method cache: " << MethodCacheHits << " hits, " << MethodCacheMisses
+     << " misses, " << MethodCacheBytes << " bytes loaded\n"
+     << "Data cache: " << DataCacheHits << " hits, " << DataCacheMisses
+     << " misses\n"
+     << "Stack cache: " << StackCacheSpilled << " bytes spilled, "
+     << StackCacheFilled << " bytes filled\n";
+}
+
+PatmosSimulator::PatmosSimulator(const PatmosSimConfig &config)
+  : Config(config), Memory(config.MemorySize),
+    LocalMemory(config.LocalMemorySize)
+{
+  reset(0);
+}
+
+PatmosSimulator::~PatmosSimulator() {
+  for (unsigned i = 0, e = Objects.size(); i != e; ++i)
+    delete Objects[i];
+}
+
+void PatmosSimulator::reset(uint32_t Entry) {
+  Stats.clear();
+
+  for (unsigned i = 0; i < 32; i++) R[i] = 0;
+  for (unsigned i = 0; i < 16; i++) S[i] = 0;
+  for (unsigned i = 0; i < 8; i++) P[i] = i == 0;
+
+  // Start with an empty stack cache at the end of the memory, the startup
+  // code usually sets up its own stack.
+  S[SReg_SS] = S[SReg_ST] = Config.MemorySize;
+
+  Pending = PendingNonLocal = false;
+  DelaySlots = PendingTarget = PendingBase = 0;
+  DelayedWrites.clear();
+  Halt = false;
+  ErrMsg.clear();
+
+  MethodCache.clear();
+  MethodCacheUsed = 0;
+
+  DataCache.clear();
+  if (Config.DataCacheSize && Config.DataCacheBlockSize &&
+      Config.DataCacheAssoc) {
+    unsigned Sets = Config.DataCacheSize /
+                    (Config.DataCacheBlockSize * Config.DataCacheAssoc);
+    DataCache.resize(std::max(Sets, 1u));
+  }
+
+  PC = Base = Entry;
+  if (Entry)
+    enterFunction(Entry);
+}
+
+void PatmosSimulator::fail(const Twine &Msg) {
+  if (ErrMsg.empty())
+    ErrMsg = Msg.str();
+}
+
+bool PatmosSimulator::checkAccess(bool Local, uint32_t Addr, unsigned Size) {
+  uint64_t Limit = Local ? LocalMemory.size() : Memory.size();
+  if ((uint64_t)Addr + Size > Limit) {
+    fail(Twine("invalid ") + (Local ? "local " : "") + "memory access at 0x" +
+         Twine::utohexstr(Addr) + " (pc 0x" + Twine::utohexstr(PC) + ")");
+    return false;
+  }
+  if (Addr % Size) {
+    fail("unaligned memory access at 0x" + Twine::utohexstr(Addr) +
+         " (pc 0x" + Twine::utohexstr(PC) + ")");
+    return false;
+  }
+  return true;
+}
+
+uint32_t PatmosSimulator::read(bool Local, uint32_t Addr, unsigned Size) {
+  if (!checkAccess(Local, Addr, Size))
+    return 0;
+  const uint8_t *Data = Local ? &LocalMemory[Addr] : &Memory[Addr];
+  uint32_t Value = 0;
+  for (unsigned i = 0; i < Size; i++)
+    Value = (Value << 8) | Data[i];
+  return Value;
+}
+
+void PatmosSimulator::write(bool Local, uint32_t Addr, unsigned Size,
+                            uint32_t Value) {
+  if (!checkAccess(Local, Addr, Size))
+    return;
+  uint8_t *Data = Local ? &LocalMemory[Addr] : &Memory[Addr];
+  for (unsigned i = Size; i > 0; i--) {
+    Data[i - 1] = Value & 0xff;
+    Value >>= 8;
+  }
+}
+
+void PatmosSimulator::checkDelayed(bool Special, unsigned Reg, uint32_t Addr) {
+  for (std::vector<DelayedWrite>::iterator i = DelayedWrites.begin(),
+       ie = DelayedWrites.end(); i != ie; ++i) {
+    if (i->Special == Special && i->Reg == Reg) {
+      fail(Twine("access to ") + (Special ? "s" : "r") + Twine(Reg) +
+           " at 0x" + Twine::utohexstr(Addr) + " before the result of 0x" +
+           Twine::utohexstr(i->Addr) + " is available");
+      return;
+    }
+  }
+}
+
+void PatmosSimulator::commitDelayedWrites(uint64_t Slot) {
+  std::vector<DelayedWrite>::iterator i = DelayedWrites.begin();
+  for (std::vector<DelayedWrite>::iterator ie = DelayedWrites.end();
+       i != ie && i->Ready <= Slot; ++i) {
+    if (i->Special)
+      S[i->Reg] = i->Value;
+    else if (i->Reg != 0)
+      R[i->Reg] = i->Value;
+  }
+  DelayedWrites.erase(DelayedWrites.begin(), i);
+}
+
+unsigned PatmosSimulator::getTransferCycles(unsigned Bytes) const {
+  return Config.MemoryLatency + (Bytes + 3) / 4;
+}
+
+void PatmosSimulator::enterFunction(uint32_t NewBase) {
+  for (std::deque<std::pair<uint32_t, uint32_t> >::iterator
+       i = MethodCache.begin(), ie = MethodCache.end(); i != ie; ++i) {
+    if (i->first == NewBase) {
+      Stats.MethodCacheHits++;
+      return;
+    }
+  }
+
+  // The size of a function is stored in the word preceding it (.fstart).
+  if (NewBase < 4) {
+    fail("invalid function address 0x" + Twine::utohexstr(NewBase));
+    return;
+  }
+  uint32_t Size = read(false, NewBase - 4, 4);
+  if (!ErrMsg.empty())
+    return;
+
+  Stats.MethodCacheMisses++;
+  Stats.MethodCacheBytes += Size;
+  Stats.MethodCacheStalls += getTransferCycles(Size);
+  Stats.Cycles += getTransferCycles(Size);
+
+  // Functions that do not fit are executed without being cached.
+  if (Size > Config.MethodCacheSize)
+    return;
+
+  while (!MethodCache.empty() &&
+         (MethodCache.size() >= Config.MethodCacheBlocks ||
+          MethodCacheUsed + Size > Config.MethodCacheSize)) {
+    MethodCacheUsed -= MethodCache.front().second;
+    MethodCache.pop_front();
+  }
+  MethodCache.push_back(std::make_pair(NewBase, Size));
+  MethodCacheUsed += Size;
+}
+
+bool PatmosSimulator::accessDataCache(uint32_t Addr) {
+  uint32_t Tag = Addr / Config.DataCacheBlockSize;
+  std::vector<uint32_t> &Set = DataCache[Tag % DataCache.size()];
+
+  for (unsigned i = 0, e = Set.size(); i != e; ++i) {
+    if (Set[i] == Tag) {
+      Set.erase(Set.begin() + i);
+      Set.insert(Set.begin(), Tag);
+      return true;
+    }
+  }
+
+  if (Set.size() >= Config.DataCacheAssoc)
+    Set.pop_back();
+  Set.insert(Set.begin(), Tag);
+  return false;
+}
+
+unsigned PatmosSimulator::getBundleSize(uint32_t Addr) {
+  return (read(false, Addr, 4) >> 31) ? 8 : 4;
+}
+
+void PatmosSimulator::setPredicates(uint32_t Value) {
+  for (unsigned i = 1; i < 8; i++)
+    P[i] = (Value >> i) & 1;
+}
+
+uint32_t PatmosSimulator::getPredicates() const {
+  uint32_t Value = 0;
+  for (unsigned i = 0; i < 8; i++)
+    Value |= (uint32_t)P[i] << i;
+  return Value;
+}
+
+/// computeALU - Compute the result of an ALU operation with the given function
+/// code, as shared by the ALUi, ALUl and ALUr formats.
+static bool computeALU(unsigned Func, uint32_t A, uint32_t B, uint32_t &Res) {
+  switch (Func) {
+  case 0x0: Res = A + B; break;
+  case 0x1: Res = A - B; break;
+  case 0x2: Res = A ^ B; break;
+  case 0x3: Res = A << (B & 31); break;
+  case 0x4: Res = A >> (B & 31); break;
+  case 0x5: Res = (uint32_t)((int32_t)A >> (B & 31)); break;
+  case 0x6: Res = A | B; break;
+  case 0x7: Res = A & B; break;
+  case 0xb: Res = ~(A | B); break;
+  case 0xc: Res = (A << 1) + B; break;
+  case 0xd: Res = (A << 2) + B; break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+/// compare - Evaluate a compare of the ALUc and ALUci formats.
+static bool compare(unsigned Func, uint32_t A, uint32_t B, bool &Res) {
+  switch (Func) {
+  case 0x0: Res = A == B; break;
+  case 0x1: Res = A != B; break;
+  case 0x2: Res = (int32_t)A < (int32_t)B; break;
+  case 0x3: Res = (int32_t)A <= (int32_t)B; break;
+  case 0x4: Res = A < B; break;
+  case 0x5: Res = A <= B; break;
+  case 0x6: Res = (A >> (B & 31)) & 1; break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+bool PatmosSimulator::execute(uint32_t Addr, uint32_t Insn, uint32_t LongImm,
+                              bool IsLong, Writes &W) {
+  unsigned Rd  = (Insn >> 17) & 0x1f;
+  unsigned Rs1 = (Insn >> 12) & 0x1f;
+  unsigned Rs2 = (Insn >> 7) & 0x1f;
+  unsigned Pd  = (Insn >> 17) & 0x7;
+  unsigned Opc = (Insn >> 22) & 0x1f;
+
+  // ALUl - the immediate is in the second word
+  if (IsLong) {
+    uint32_t Res;
+    if (!computeALU(Insn & 0xf, readGPR(Rs1, Addr), LongImm, Res))
+      return false;
+    W.R.push_back(std::make_pair(Rd, Res));
+    return true;
+  }
+
+  // ALUi
+  if ((Opc >> 3) == 0x0) {
+    uint32_t Res;
+    computeALU((Insn >> 22) & 0x7, readGPR(Rs1, Addr), Insn & 0xfff, Res);
+    W.R.push_back(std::make_pair(Rd, Res));
+    return true;
+  }
+
+  // Control flow inside the delay slots of other control flow is not
+  // supported (see -mpatmos-nested-branches).
+  if (((Opc >> 3) == 0x2 || (Opc >> 1) == 0xc) && Pending) {
+    fail("control flow instruction in delay slot at 0x" +
+         Twine::utohexstr(Addr));
+    return true;
+  }
+
+  // CFLi
+  if ((Opc >> 3) == 0x2) {
+    unsigned Op = (Opc >> 1) & 0x3;
+    bool Delayed = Opc & 0x1;
+    uint32_t Imm = Insn & 0x3fffff;
+    uint32_t Target;
+    bool NonLocal = true;
+    switch (Op) {
+    case 0: // call
+    case 2: // brcf
+      Target = Imm << 2;
+      break;
+    case 1: // br
+      Target = Addr + (SignExtend32<22>(Imm) << 2);
+      NonLocal = false;
+      break;
+    default:
+      fail("trap " + Twine(Imm) + " at 0x" + Twine::utohexstr(Addr));
+      return true;
+    }
+    Pending = true;
+    PendingNonLocal = NonLocal;
+    PendingTarget = PendingBase = Target;
+    DelaySlots = Delayed ? (NonLocal ? NonLocalDelaySlots
+                                     : LocalBranchDelaySlots) : 0;
+    if (Op == 0) {
+      uint32_t Ret = Addr + getBundleSize(Addr);
+      for (unsigned i = 0; i < DelaySlots; i++)
+        Ret += getBundleSize(Ret);
+      W.S.push_back(std::make_pair((unsigned)SReg_SRB, Base));
+      W.S.push_back(std::make_pair((unsigned)SReg_SRO, Ret - Base));
+    }
+    return true;
+  }
+
+  // CFLr
+  if ((Opc >> 1) == 0xc) {
+    bool Delayed = Opc & 0x1;
+    unsigned Op = ((Insn >> 2) & 0x3) << 2 | (Insn & 0x3);
+    bool NonLocal = true;
+    switch (Op) {
+    case 0x0: // ret
+      PendingBase = S[SReg_SRB];
+      PendingTarget = S[SReg_SRB] + S[SReg_SRO];
+      break;
+    case 0x1: // xret
+      PendingBase = S[SReg_SXB];
+      PendingTarget = S[SReg_SXB] + S[SReg_SXO];
+      break;
+    case 0x4: // callr
+      PendingBase = PendingTarget = readGPR(Rs1, Addr);
+      break;
+    case 0x5: // brr
+      PendingTarget = readGPR(Rs1, Addr);
+      NonLocal = false;
+      break;
+    case 0xa: // brcfr
+      PendingBase = readGPR(Rs1, Addr);
+      PendingTarget = readGPR(Rs1, Addr) + readGPR(Rs2, Addr);
+      break;
+    default:
+      return false;
+    }
+    Pending = true;
+    PendingNonLocal = NonLocal;
+    DelaySlots = Delayed ? (NonLocal ? NonLocalDelaySlots
+                                     : LocalBranchDelaySlots) : 0;
+    if (Op == 0x4) {
+      uint32_t Ret = Addr + getBundleSize(Addr);
+      for (unsigned i = 0; i < DelaySlots; i++)
+        Ret += getBundleSize(Ret);
+      W.S.push_back(std::make_pair((unsigned)SReg_SRB, Base));
+      W.S.push_back(std::make_pair((unsigned)SReg_SRO, Ret - Base));
+    }
+    return true;
+  }
+
+  switch (Opc) {
+  case 0x08: { // ALU
+    unsigned Func = Insn & 0xf;
+    switch ((Insn >> 4) & 0x7) {
+    case 0x0: { // ALUr
+      uint32_t Res;
+      if (!computeALU(Func, readGPR(Rs1, Addr), readGPR(Rs2, Addr), Res))
+        return false;
+      W.R.push_back(std::make_pair(Rd, Res));
+      return true;
+    }
+    case 0x2: { // ALUm
+      uint32_t A = readGPR(Rs1, Addr), B = readGPR(Rs2, Addr);
+      uint64_t Res;
+      if (Func == 0)
+        Res = (uint64_t)((int64_t)(int32_t)A * (int64_t)(int32_t)B);
+      else if (Func == 1)
+        Res = (uint64_t)A * (uint64_t)B;
+      else
+        return false;
+      DelayedWrite SL = { getPipelineSlot() + MulLatency, true, SReg_SL,
+                          (uint32_t)Res, Addr };
+      DelayedWrite SH = { getPipelineSlot() + MulLatency, true, SReg_SH,
+                          (uint32_t)(Res >> 32), Addr };
+      W.Delayed.push_back(SL);
+      W.Delayed.push_back(SH);
+      return true;
+    }
+    case 0x3:   // ALUc
+    case 0x6: { // ALUci
+      uint32_t B = ((Insn >> 4) & 0x7) == 0x3 ? readGPR(Rs2, Addr) : Rs2;
+      bool Res;
+      if (!compare(Func, readGPR(Rs1, Addr), B, Res))
+        return false;
+      W.P.push_back(std::make_pair(Pd, Res));
+      return true;
+    }
+    case 0x4: { // ALUp
+      unsigned Ps1 = (Insn >> 12) & 0xf, Ps2 = (Insn >> 7) & 0xf;
+      bool A = P[Ps1 & 0x7] ^ (Ps1 >> 3), B = P[Ps2 & 0x7] ^ (Ps2 >> 3);
+      bool Res;
+      switch (Func) {
+      case 0x6: Res = A || B; break;
+      case 0x7: Res = A && B; break;
+      case 0xa: Res = A != B; break;
+      case 0xb: Res = !(A || B); break;
+      default:
+        return false;
+      }
+      W.P.push_back(std::make_pair(Pd, Res));
+      return true;
+    }
+    case 0x5: { // ALUb
+      unsigned Ps = Insn & 0xf;
+      uint32_t Bit = P[Ps & 0x7] ^ (Ps >> 3);
+      uint32_t Res = (readGPR(Rs1, Addr) & ~(1u << Rs2)) | (Bit << Rs2);
+      W.R.push_back(std::make_pair(Rd, Res));
+      return true;
+    }
+    default:
+      // FPU instructions are not supported
+      return false;
+    }
+  }
+  case 0x09: { // SPC
+    switch ((Insn >> 4) & 0x7) {
+    case 0x2: // mts
+      W.S.push_back(std::make_pair(Insn & 0xf, readGPR(Rs1, Addr)));
+      return true;
+    case 0x3: { // mfs
+      unsigned Ss = Insn & 0xf;
+      checkDelayed(true, Ss, Addr);
+      W.R.push_back(std::make_pair(Rd, Ss == SReg_Pred ? getPredicates()
+                                                       : S[Ss]));
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+  case 0x0a: { // LDT
+    unsigned Type = (Insn >> 7) & 0x1f;
+    unsigned Size, Shift;
+    bool Signed;
+    switch (Type >> 2) {
+    case 0: Size = 4; Shift = 2; Signed = false; break;
+    case 1: Size = 2; Shift = 1; Signed = true;  break;
+    case 2: Size = 1; Shift = 0; Signed = true;  break;
+    case 3: Size = 2; Shift = 1; Signed = false; break;
+    case 4: Size = 1; Shift = 0; Signed = false; break;
+    default:
+      return false;
+    }
+    uint32_t EA = readGPR(Rs1, Addr) + ((Insn & 0x7f) << Shift);
+    bool Local = false;
+    switch (Type & 0x3) {
+    case 0: // stack cache
+      EA += S[SReg_ST];
+      break;
+    case 1: // local memory
+      Local = true;
+      break;
+    case 2: // data cache
+      if (!DataCache.empty()) {
+        if (accessDataCache(EA)) {
+          Stats.DataCacheHits++;
+        } else {
+          unsigned Cycles = getTransferCycles(Config.DataCacheBlockSize);
+          Stats.DataCacheMisses++;
+          Stats.DataCacheStalls += Cycles;
+          Stats.Cycles += Cycles;
+        }
+        break;
+      }
+      // Without data cache, the load bypasses the cache.
+      // FALLTHROUGH
+    case 3: { // main memory
+      unsigned Cycles = getTransferCycles(4);
+      Stats.MemoryStalls += Cycles;
+      Stats.Cycles += Cycles;
+      break;
+    }
+    }
+    uint32_t Value = read(Local, EA, Size);
+    if (Signed)
+      Value = Size == 1 ? (uint32_t)(int8_t)Value : (uint32_t)(int16_t)Value;
+    DelayedWrite Load = { getPipelineSlot() + LoadLatency, false, Rd, Value,
+                          Addr };
+    W.Delayed.push_back(Load);
+    return true;
+  }
+  case 0x0b: { // STT
+    unsigned Type = (Insn >> 17) & 0x1f;
+    unsigned Size, Shift;
+    switch (Type >> 2) {
+    case 0: Size = 4; Shift = 2; break;
+    case 1: Size = 2; Shift = 1; break;
+    case 2: Size = 1; Shift = 0; break;
+    default:
+      return false;
+    }
+    uint32_t EA = readGPR(Rs1, Addr) + ((Insn & 0x7f) << Shift);
+    bool Local = false;
+    switch (Type & 0x3) {
+    case 0: // stack cache
+      EA += S[SReg_ST];
+      break;
+    case 1: // local memory
+      Local = true;
+      break;
+    default: {
+      // The data cache is write-through without write allocation, all
+      // stores to main memory stall until the write is done.
+      unsigned Cycles = getTransferCycles(Size);
+      Stats.MemoryStalls += Cycles;
+      Stats.Cycles += Cycles;
+      break;
+    }
+    }
+    write(Local, EA, Size, readGPR(Rs2, Addr));
+    return true;
+  }
+  case 0x0c: { // STC
+    unsigned Op = (Insn >> 20) & 0x3;
+    uint32_t Bytes;
+    switch ((Insn >> 18) & 0x3) {
+    case 0: Bytes = (Insn & 0x3ffff) << 2; break;
+    case 1: Bytes = readGPR(Rs1, Addr) << 2; break;
+    default:
+      return false;
+    }
+
+    uint32_t &SS = S[SReg_SS], &ST = S[SReg_ST];
+    uint32_t Transferred = 0;
+    switch (Op) {
+    case 0: // sres
+      ST -= Bytes;
+      if (SS - ST > Config.StackCacheSize) {
+        Transferred = SS - ST - Config.StackCacheSize;
+        SS -= Transferred;
+        Stats.StackCacheSpilled += Transferred;
+      }
+      break;
+    case 1: // sens
+      if (SS - ST < Bytes) {
+        Transferred = ST + Bytes - SS;
+        SS += Transferred;
+        Stats.StackCacheFilled += Transferred;
+      }
+      break;
+    case 2: // sfree
+      ST += Bytes;
+      if ((int32_t)(ST - SS) > 0)
+        SS = ST;
+      break;
+    case 3: // sspill
+      Transferred = std::min(Bytes, SS - ST);
+      SS -= Transferred;
+      Stats.StackCacheSpilled += Transferred;
+      break;
+    }
+    if (Transferred) {
+      unsigned Cycles = getTransferCycles(Transferred);
+      Stats.StackCacheStalls += Cycles;
+      Stats.Cycles += Cycles;
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+void PatmosSimulator::executeBundle() {
+  uint32_t Addr = PC;
+  uint32_t Insn[2];
+  Insn[0] = read(false, Addr, 4);
+  unsigned Size = 4;
+  if (Insn[0] >> 31) {
+    Insn[1] = read(false, Addr + 4, 4);
+    Size = 8;
+  }
+  if (!ErrMsg.empty())
+    return;
+
+  bool IsLong = Size == 8 && ((Insn[0] >> 22) & 0x1f) == 0x1f;
+  unsigned NumInsns = (Size == 8 && !IsLong) ? 2 : 1;
+
+  // Remember whether this bundle is in the delay slots of a transfer.
+  bool WasPending = Pending;
+
+  commitDelayedWrites(getPipelineSlot());
+
+  Writes W;
+  for (unsigned i = 0; i < NumInsns; i++) {
+    unsigned Pred = (Insn[i] >> 27) & 0xf;
+    Stats.Instructions++;
+    if (!(P[Pred & 0x7] ^ (Pred >> 3))) {
+      Stats.Disabled++;
+      continue;
+    }
+
+    if (!execute(Addr, Insn[i], IsLong ? Insn[1] : 0, IsLong, W)) {
+      fail("unsupported instruction 0x" + Twine::utohexstr(Insn[i]) +
+           " at 0x" + Twine::utohexstr(Addr));
+    }
+    if (!ErrMsg.empty())
+      return;
+  }
+
+  // Commit the register updates of the bundle. Registers with a pending
+  // delayed update must not be overwritten.
+  for (unsigned i = 0, e = W.R.size(); i != e; ++i)
+    checkDelayed(false, W.R[i].first, Addr);
+  for (unsigned i = 0, e = W.S.size(); i != e; ++i)
+    checkDelayed(true, W.S[i].first, Addr);
+  if (!ErrMsg.empty())
+    return;
+
+  for (unsigned i = 0, e = W.R.size(); i != e; ++i)
+    if (W.R[i].first != 0)
+      R[W.R[i].first] = W.R[i].second;
+  for (unsigned i = 0, e = W.S.size(); i != e; ++i) {
+    if (W.S[i].first == SReg_Pred)
+      setPredicates(W.S[i].second);
+    else
+      S[W.S[i].first] = W.S[i].second;
+  }
+  for (unsigned i = 0, e = W.P.size(); i != e; ++i)
+    if (W.P[i].first != 0)
+      P[W.P[i].first] = W.P[i].second;
+  DelayedWrites.insert(DelayedWrites.end(), W.Delayed.begin(),
+                       W.Delayed.end());
+
+  Stats.Cycles++;
+  Stats.Bundles++;
+  PC = Addr + Size;
+
+  if (!Pending)
+    return;
+
+  // Count down the delay slots of a pending transfer, except for the bundle
+  // containing the control flow instruction itself.
+  if (WasPending && DelaySlots > 0) {
+    DelaySlots--;
+  } else if (!WasPending && DelaySlots == 0) {
+    // Non-delayed control flow flushes the pipeline.
+    unsigned Cycles = PendingNonLocal ? NonLocalDelaySlots
+                                      : LocalBranchDelaySlots;
+    Stats.BranchStalls += Cycles;
+    Stats.Cycles += Cycles;
+  }
+  if (DelaySlots > 0)
+    return;
+
+  Pending = false;
+  PC = PendingTarget;
+  if (PendingNonLocal) {
+    if (PendingBase == 0) {
+      // Drain the pipeline, the result may still be loaded.
+      commitDelayedWrites(UINT64_MAX);
+      Halt = true;
+      return;
+    }
+    Base = PendingBase;
+    enterFunction(Base);
+  }
+}
+
+PatmosSimulator::Status PatmosSimulator::run(uint64_t MaxCycles) {
+  while (!Halt && ErrMsg.empty()) {
+    if (MaxCycles && Stats.Cycles >= MaxCycles)
+      return CycleLimit;
+    executeBundle();
+  }
+  return Halt ? Halted : Error;
+}
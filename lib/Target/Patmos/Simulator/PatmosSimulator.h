@@ -0,0 +1,287 @@
+//===-- PatmosSimulator.h - Cycle-level Patmos simulator --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A simple cycle-level simulator of the Patmos instruction set, intended for
+// testing the code generated by llc without the external Patmos tool-chain.
+//
+// The simulator loads relocatable objects as emitted by llc -filetype=obj (and
+// links them statically itself) or linked ELF executables. It executes bundles
+// with the delay slot semantics of the Patmos pipeline and models the timing
+// of the method cache, the stack cache and a set-associative data cache, all
+// connected to a main memory with a fixed latency and burst transfers.
+//
+// The timing model is deliberately simple: every bundle takes one cycle, all
+// stalls of the caches and of non-delayed control flow are added on top.
+// Results of loads and multiplications are written with the latencies of the
+// itineraries in PatmosSchedule.td. Reading or overwriting such a register
+// before the result is available is reported as an error.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef _PATMOS_SIMULATOR_H_
+#define _PATMOS_SIMULATOR_H_
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/DataTypes.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+  class MemoryBuffer;
+  class Twine;
+  class raw_ostream;
+
+  /// Configuration of the simulated processor. The cache defaults match the
+  /// defaults of the Patmos subtarget in llc.
+  struct PatmosSimConfig {
+    /// Size of the main memory in bytes.
+    uint32_t MemorySize;
+    /// Size of the local scratchpad memory in bytes.
+    uint32_t LocalMemorySize;
+    /// Address where the code of relocatable objects is placed.
+    uint32_t TextBase;
+    /// Cycles until the first word of a main memory transfer arrives, each
+    /// further word of a burst takes one more cycle.
+    unsigned MemoryLatency;
+    /// Size of the stack cache in bytes.
+    unsigned StackCacheSize;
+    /// Size of the method cache in bytes.
+    unsigned MethodCacheSize;
+    /// Maximal number of functions in the method cache.
+    unsigned MethodCacheBlocks;
+    /// Size of the data cache in bytes, zero disables the data cache.
+    unsigned DataCacheSize;
+    /// Size of a data cache line in bytes.
+    unsigned DataCacheBlockSize;
+    /// Associativity of the data cache.
+    unsigned DataCacheAssoc;
+
+    PatmosSimConfig()
+      : MemorySize(0x1000000), LocalMemorySize(0x10000), TextBase(0x20000),
+        MemoryLatency(7), StackCacheSize(2048), MethodCacheSize(4096),
+        MethodCacheBlocks(16), DataCacheSize(2048), DataCacheBlockSize(32),
+        DataCacheAssoc(4) {}
+  };
+
+  /// Execution statistics collected by the simulator.
+  struct PatmosSimStats {
+    uint64_t Cycles;
+    uint64_t Bundles;
+    uint64_t Instructions;
+    /// Instructions with a false guard.
+    uint64_t Disabled;
+
+    uint64_t MethodCacheStalls;
+    uint64_t DataCacheStalls;
+    uint64_t StackCacheStalls;
+    uint64_t MemoryStalls;
+    uint64_t BranchStalls;
+
+    uint64_t MethodCacheHits;
+    uint64_t MethodCacheMisses;
+    uint64_t MethodCacheBytes;
+    uint64_t DataCacheHits;
+    uint64_t DataCacheMisses;
+    uint64_t StackCacheSpilled;
+    uint64_t StackCacheFilled;
+
+    PatmosSimStats() { clear(); }
+
+    void clear();
+
+    /// getStallCycles - Get the total number of stall cycles.
+    uint64_t getStallCycles() const {
+      return MethodCacheStalls + DataCacheStalls + StackCacheStalls +
+             MemoryStalls + BranchStalls;
+    }
+
+    void print(raw_ostream &OS) const;
+  };
+
+  /// The simulator. Load one or more objects, link them, and run.
+  class PatmosSimulator {
+  public:
+    /// Reason why the simulation stopped.
+    enum Status {
+      /// The program returned to address zero, see getExitCode.
+      Halted,
+      /// The cycle limit was reached.
+      CycleLimit,
+      /// The program executed an illegal instruction or access, see
+      /// getError.
+      Error
+    };
+
+  private:
+    PatmosSimConfig Config;
+    PatmosSimStats Stats;
+
+    std::vector<uint8_t> Memory;
+    std::vector<uint8_t> LocalMemory;
+
+    /// Objects loaded by addObject, linked by link.
+    std::vector<MemoryBuffer *> Objects;
+    /// Symbols defined from the outside, e.g., on the command line.
+    StringMap<uint32_t> DefinedSymbols;
+    /// Global symbols after linking.
+    StringMap<uint32_t> Symbols;
+
+    /// Architectural state.
+    uint32_t R[32];
+    uint32_t S[16];
+    bool P[8];
+    uint32_t PC;
+    /// Base address of the currently executed function.
+    uint32_t Base;
+
+    /// Pending control flow: the target and, for non-local control flow, the
+    /// new function base take effect after DelaySlots more bundles.
+    bool Pending;
+    bool PendingNonLocal;
+    unsigned DelaySlots;
+    uint32_t PendingTarget;
+    uint32_t PendingBase;
+
+    /// A register update of a load or multiplication, which takes effect in
+    /// pipeline slot Ready (see getPipelineSlot).
+    struct DelayedWrite {
+      uint64_t Ready;
+      bool Special;
+      unsigned Reg;
+      uint32_t Value;
+      /// Address of the bundle producing the value.
+      uint32_t Addr;
+    };
+
+    /// Delayed register updates in the order of their instructions.
+    std::vector<DelayedWrite> DelayedWrites;
+
+    bool Halt;
+    std::string ErrMsg;
+
+    /// Method cache, function bases and sizes in FIFO order.
+    std::deque<std::pair<uint32_t, uint32_t> > MethodCache;
+    uint32_t MethodCacheUsed;
+
+    /// Data cache tags, per set in LRU order (most recent first).
+    std::vector<std::vector<uint32_t> > DataCache;
+
+  public:
+    explicit PatmosSimulator(const PatmosSimConfig &Config);
+    ~PatmosSimulator();
+
+    const PatmosSimConfig &getConfig() const { return Config; }
+
+    const PatmosSimStats &getStats() const { return Stats; }
+
+    /// addObject - Add a relocatable object or an executable to the program.
+    /// The simulator takes ownership of the buffer. Returns false and sets
+    /// ErrMsg if the file is not a Patmos ELF file.
+    bool addObject(MemoryBuffer *Buffer, std::string &ErrMsg);
+
+    /// defineSymbol - Define an absolute symbol, e.g. to pass input to the
+    /// program (--defsym of the linker).
+    void defineSymbol(StringRef Name, uint32_t Value) {
+      DefinedSymbols[Name] = Value;
+    }
+
+    /// link - Place all sections of the objects in memory, resolve the
+    /// symbols and apply the relocations. Sections named .spm are placed
+    /// into the local memory. Returns false and sets ErrMsg on failure.
+    bool link(std::string &ErrMsg);
+
+    /// lookupSymbol - Get the address of a global symbol after linking.
+    bool lookupSymbol(StringRef Name, uint32_t &Value) const;
+
+    /// reset - Reset the processor and start execution at the function at
+    /// Entry. Caches and statistics are cleared, memory is not.
+    void reset(uint32_t Entry);
+
+    /// run - Simulate until the program halts, fails, or until MaxCycles
+    /// cycles have been executed (zero means no limit).
+    Status run(uint64_t MaxCycles = 0);
+
+    /// getExitCode - Get the value returned by the program, i.e., the
+    /// content of r1 when the program halted.
+    uint32_t getExitCode() const { return R[1]; }
+
+    /// getError - Get a description of the error that stopped the program.
+    const std::string &getError() const { return ErrMsg; }
+
+    /// getPC - Get the address of the next bundle to execute.
+    uint32_t getPC() const { return PC; }
+
+  private:
+    /// Register updates of a bundle, applied after all instructions of the
+    /// bundle read their operands.
+    struct Writes;
+
+    bool loadExecutable(MemoryBuffer *Buffer, std::string &ErrMsg);
+    bool linkObjects(std::string &ErrMsg);
+
+    /// fail - Stop the simulation with an error message.
+    void fail(const Twine &Msg);
+
+    bool checkAccess(bool Local, uint32_t Addr, unsigned Size);
+    uint32_t read(bool Local, uint32_t Addr, unsigned Size);
+    void write(bool Local, uint32_t Addr, unsigned Size, uint32_t Value);
+
+    /// getPipelineSlot - Get the pipeline slot of the next bundle, i.e., the
+    /// number of bundles and bubbles of non-delayed control flow. Stalls of
+    /// the caches freeze the pipeline and do not count.
+    uint64_t getPipelineSlot() const {
+      return Stats.Bundles + Stats.BranchStalls;
+    }
+
+    /// checkDelayed - Fail if a delayed update of the register is pending,
+    /// i.e., the register is accessed too early by the bundle at Addr.
+    void checkDelayed(bool Special, unsigned Reg, uint32_t Addr);
+
+    /// readGPR - Read a general purpose register in the bundle at Addr.
+    uint32_t readGPR(unsigned Reg, uint32_t Addr) {
+      checkDelayed(false, Reg, Addr);
+      return R[Reg];
+    }
+
+    /// commitDelayedWrites - Apply all delayed register updates that are due
+    /// in the given pipeline slot.
+    void commitDelayedWrites(uint64_t Slot);
+
+    /// getTransferCycles - Cycles to transfer a number of bytes from or to
+    /// main memory.
+    unsigned getTransferCycles(unsigned Bytes) const;
+
+    /// enterFunction - Make sure the function at Base is in the method cache.
+    void enterFunction(uint32_t NewBase);
+
+    /// accessDataCache - Simulate a cached load from Addr, return true on
+    /// a hit.
+    bool accessDataCache(uint32_t Addr);
+
+    /// getBundleSize - Get the size in bytes of the bundle at Addr.
+    unsigned getBundleSize(uint32_t Addr);
+
+    /// executeBundle - Execute the bundle at PC.
+    void executeBundle();
+
+    /// execute - Execute a single instruction of the bundle at Addr. Returns
+    /// false if the instruction is not known.
+    bool execute(uint32_t Addr, uint32_t Insn, uint32_t LongImm, bool IsLong,
+                 Writes &W);
+
+    void setPredicates(uint32_t Value);
+    uint32_t getPredicates() const;
+  };
+}
+
+#endif // _PATMOS_SIMULATOR_H_
@@ -25,6 +25,11 @@
 // Ideally, they should vanish completely from the final executable, but it
 // seems that this cannot easily be done.
 //
+// Optionally, single-path functions that are only called from blocks that
+// are executed whenever their caller is executed, in roots or in other such
+// functions, are marked as unconditional. They are converted like roots, i.e.,
+// the predicate of the caller is not passed to them.
+//
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "patmos-singlepath"
@@ -51,6 +56,15 @@ using namespace llvm;
 STATISTIC(NumSPTotal,   "Total number of functions marked as single-path");
 STATISTIC(NumSPMaybe,   "Number of 'used' functions marked as single-path");
 STATISTIC(NumSPCleared, "Number of functions cleared again");
+STATISTIC(NumSPUncond,  "Number of single-path functions called "
+                        "unconditionally");
+
+static cl::opt<bool> EnableSPUnconditional(
+  "mpatmos-sp-specialize-callees",
+  cl::init(false),
+  cl::desc("Do not pass the predicate to single-path functions that are "
+           "always called with an enabled predicate."),
+  cl::Hidden);
 
 
 namespace {
@@ -100,6 +114,20 @@ private:
    */
   void removeUncalledSPFunctions(const Module &M);
 
+  /**
+   * Check whether the given block is executed exactly once whenever its
+   * function is executed, i.e., it is not part of a cycle and every path
+   * from the entry to a return passes through it.
+   */
+  bool isUnconditional(const MachineBasicBlock *MBB) const;
+
+  /**
+   * Mark all single-path functions that are only called from unconditional
+   * blocks of roots or of other unconditional functions in
+   * PatmosMachineFunctionInfo.
+   */
+  void markUnconditionalFunctions(const Module &M);
+
 public:
   static char ID; // Pass identification, replacement for typeid
 
@@ -171,6 +199,10 @@ bool PatmosSPMark::runOnMachineModule(const Module &M) {
 
   removeUncalledSPFunctions(M);
 
+  if (EnableSPUnconditional) {
+    markUnconditionalFunctions(M);
+  }
+
   // We either have rewritten calls or removed superfluous functions.
   return true;
 }
@@ -323,6 +355,105 @@ void PatmosSPMark::removeUncalledSPFunctions(const Module &M) {
   }
 }
 
+bool PatmosSPMark::isUnconditional(const MachineBasicBlock *MBB) const {
+  std::set<const MachineBasicBlock*> Visited;
+  std::vector<const MachineBasicBlock*> Stack;
+
+  // search for a cycle through MBB
+  Stack.insert(Stack.end(), MBB->succ_begin(), MBB->succ_end());
+  while (!Stack.empty()) {
+    const MachineBasicBlock *B = Stack.back();
+    Stack.pop_back();
+    if (B == MBB) return false;
+    if (!Visited.insert(B).second) continue;
+    Stack.insert(Stack.end(), B->succ_begin(), B->succ_end());
+  }
+
+  // search for a path from the entry to a return that avoids MBB
+  Visited.clear();
+  Stack.push_back(&MBB->getParent()->front());
+  while (!Stack.empty()) {
+    const MachineBasicBlock *B = Stack.back();
+    Stack.pop_back();
+    if (B == MBB || !Visited.insert(B).second) continue;
+    if (B->succ_empty()) return false;
+    Stack.insert(Stack.end(), B->succ_begin(), B->succ_end());
+  }
+  return true;
+}
+
+
+void PatmosSPMark::markUnconditionalFunctions(const Module &M) {
+  // optimistically mark all single-path functions that are called at all,
+  // the call graph is acyclic
+  for(Module::const_iterator F(M.begin()), FE(M.end()); F != FE; ++F) {
+    MachineFunction *MF = MMI->getMachineFunction(F);
+    if (!MF) continue;
+    for (MachineFunction::iterator MBB = MF->begin(), MBBE = MF->end();
+                                   MBB != MBBE; ++MBB) {
+      for (MachineBasicBlock::instr_iterator MI = MBB->instr_begin(),
+                             ME = MBB->instr_end(); MI != ME; ++MI) {
+        if (!MI->isCall() || MI->isBundle()) continue;
+        MachineFunction *CalleeMF = getCallTargetMF(MI);
+        if (!CalleeMF || PatmosSinglePathInfo::isRoot(*CalleeMF)) continue;
+        PatmosMachineFunctionInfo *PMFI =
+          CalleeMF->getInfo<PatmosMachineFunctionInfo>();
+        if (PMFI->isSinglePath()) {
+          PMFI->setSinglePathUnconditional();
+        }
+      }
+    }
+  }
+
+  // unmark functions called under a condition, until a fixpoint is reached
+  std::map<const MachineBasicBlock*, bool> UncondBlocks;
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for(Module::const_iterator F(M.begin()), FE(M.end()); F != FE; ++F) {
+      MachineFunction *MF = MMI->getMachineFunction(F);
+      if (!MF) continue;
+      PatmosMachineFunctionInfo *PMFI =
+        MF->getInfo<PatmosMachineFunctionInfo>();
+      bool UncondCaller = PMFI->isSinglePath() &&
+        (PatmosSinglePathInfo::isRoot(*MF) ||
+         PMFI->isSinglePathUnconditional());
+
+      for (MachineFunction::iterator MBB = MF->begin(), MBBE = MF->end();
+                                     MBB != MBBE; ++MBB) {
+        for (MachineBasicBlock::instr_iterator MI = MBB->instr_begin(),
+                               ME = MBB->instr_end(); MI != ME; ++MI) {
+          if (!MI->isCall() || MI->isBundle()) continue;
+          MachineFunction *CalleeMF = getCallTargetMF(MI);
+          if (!CalleeMF) continue;
+          PatmosMachineFunctionInfo *CalleePMFI =
+            CalleeMF->getInfo<PatmosMachineFunctionInfo>();
+          if (!CalleePMFI->isSinglePathUnconditional()) continue;
+
+          if (UncondCaller && !UncondBlocks.count(MBB)) {
+            UncondBlocks[MBB] = isUnconditional(MBB);
+          }
+          if (!UncondCaller || !UncondBlocks[MBB]) {
+            DEBUG(dbgs() << "  Conditional call of " << CalleeMF->getName()
+                         << " in " << MF->getName() << "\n");
+            CalleePMFI->setSinglePathUnconditional(false);
+            Changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  for(Module::const_iterator F(M.begin()), FE(M.end()); F != FE; ++F) {
+    MachineFunction *MF = MMI->getMachineFunction(F);
+    if (MF &&
+        MF->getInfo<PatmosMachineFunctionInfo>()->isSinglePathUnconditional()) {
+      DEBUG(dbgs() << "  Unconditional function: " << F->getName() << "\n");
+      NumSPUncond++; // bump STATISTIC
+    }
+  }
+}
+
 void printFunction(MachineFunction &MF) {
   outs() << "Bundle function '" << MF.getFunction()->getName() << "'\n";
   outs() << "Block list:\n";
@@ -0,0 +1,419 @@
+//===-- PatmosSPMerge.cpp - Merge identical single-path functions ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass merges single-path functions that are identical after the
+// single-path conversion (PatmosSPReduce).
+//
+// Every function reachable from a single-path root is cloned to a "..._sp_"
+// variant (PatmosSPClone). Different source functions often result in the
+// same single-path code, e.g., small helpers that only differ in the branches
+// that are removed by the conversion.
+//
+// The machine functions of all cloned single-path functions are hashed
+// structurally. Functions with the same hash are compared instruction by
+// instruction, where basic blocks are compared by their numbers and calls to
+// functions that have already been merged are considered equal. All calls to
+// a duplicate are rewritten to the first identical function in the module and
+// the body of the duplicate is removed, like PatmosSPMark does for unused
+// functions. Merging is repeated until no more duplicates are found, as
+// merging callees can make their callers identical.
+//
+// Single-path roots are never merged, as they are called from outside of the
+// single-path code.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "patmos-singlepath"
+
+#include "Patmos.h"
+#include "PatmosInstrInfo.h"
+#include "PatmosMachineFunctionInfo.h"
+#include "PatmosSinglePathInfo.h"
+#include "PatmosTargetMachine.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFrameInfo.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/CodeGen/MachineModulePass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <vector>
+
+using namespace llvm;
+
+STATISTIC(NumSPMerged,       "Number of single-path functions merged");
+STATISTIC(NumSPMergedInstrs, "Number of instructions removed by merging "
+                             "single-path functions");
+
+static cl::opt<bool> DisableSPMerge(
+  "mpatmos-disable-sp-merge",
+  cl::init(false),
+  cl::desc("Do not merge identical single-path functions."),
+  cl::Hidden);
+
+namespace {
+
+class PatmosSPMerge : public MachineModulePass {
+private:
+  const PatmosTargetMachine &TM;
+  MachineModuleInfo *MMI; // contains map Function -> MachineFunction
+
+  /// Maps merged functions to the function they are replaced by.
+  std::map<const Function*, const Function*> Merged;
+
+  /**
+   * Get the function a global refers to, taking merged functions into
+   * account.
+   */
+  const GlobalValue *getMergeTarget(const GlobalValue *GV) const;
+
+  /**
+   * Check whether the given function may be merged, and compute its
+   * structural hash.
+   * @return false if the function contains operands that are not supported.
+   */
+  bool hashFunction(const MachineFunction &MF, hash_code &Hash) const;
+
+  /**
+   * Check whether two operands are identical, in their respective functions.
+   */
+  bool isIdentical(const MachineOperand &MO1, const MachineOperand &MO2) const;
+
+  /**
+   * Check whether two machine functions are identical.
+   */
+  bool isIdentical(const MachineFunction &MF1,
+                   const MachineFunction &MF2) const;
+
+  /**
+   * Find identical functions and record them in Merged.
+   * @return true if any new functions were merged.
+   */
+  bool findIdenticalFunctions(const Module &M);
+
+  /**
+   * Rewrite all calls to merged functions.
+   */
+  void rewriteCalls(const Module &M);
+
+  /**
+   * Remove the body of a merged function.
+   */
+  void removeBody(MachineFunction &MF);
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+
+  PatmosSPMerge(const PatmosTargetMachine &tm)
+    : MachineModulePass(ID), TM(tm), MMI(0) {}
+
+  /// getPassName - Return the pass' name.
+  virtual const char *getPassName() const {
+    return "Patmos Single-Path Merge (machine code)";
+  }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<MachineModuleInfo>();
+    AU.setPreservesAll();
+    MachineModulePass::getAnalysisUsage(AU);
+  }
+
+  virtual bool runOnMachineModule(const Module &M);
+};
+
+} // end anonymous namespace
+
+char PatmosSPMerge::ID = 0;
+
+ModulePass *llvm::createPatmosSPMergePass(const PatmosTargetMachine &tm) {
+  return new PatmosSPMerge(tm);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+
+bool PatmosSPMerge::runOnMachineModule(const Module &M) {
+  if (DisableSPMerge) return false;
+
+  DEBUG( dbgs() << "[Single-Path] Merge identical single-path functions\n");
+
+  MMI = &getAnalysis<MachineModuleInfo>();
+  Merged.clear();
+
+  bool Changed = false;
+  while (findIdenticalFunctions(M)) {
+    rewriteCalls(M);
+    Changed = true;
+  }
+  return Changed;
+}
+
+
+const GlobalValue *
+PatmosSPMerge::getMergeTarget(const GlobalValue *GV) const {
+  const Function *F = dyn_cast<Function>(GV);
+  if (!F) return GV;
+  // merge targets might have been merged themselves in a later round
+  std::map<const Function*, const Function*>::const_iterator it;
+  while ((it = Merged.find(F)) != Merged.end()) {
+    F = it->second;
+  }
+  return F;
+}
+
+
+bool PatmosSPMerge::hashFunction(const MachineFunction &MF,
+                                 hash_code &Hash) const {
+  const PatmosMachineFunctionInfo *PMFI =
+    MF.getInfo<PatmosMachineFunctionInfo>();
+
+  Hash = hash_combine(MF.size(), MF.getAlignment(),
+                      MF.getFrameInfo()->getStackSize(),
+                      PMFI->getStackCacheReservedBytes(),
+                      PMFI->getStackReservedBytes());
+
+  for (MachineFunction::const_iterator MBB = MF.begin(), MBBE = MF.end();
+                                       MBB != MBBE; ++MBB) {
+    Hash = hash_combine(Hash, MBB->getNumber(), MBB->size(),
+                        MBB->succ_size());
+
+    for (MachineBasicBlock::const_instr_iterator MI = MBB->instr_begin(),
+                           ME = MBB->instr_end(); MI != ME; ++MI) {
+      if (MI->isDebugValue()) continue;
+
+      Hash = hash_combine(Hash, MI->getOpcode(), MI->getNumOperands());
+
+      for (unsigned i = 0, e = MI->getNumOperands(); i != e; i++) {
+        const MachineOperand &MO = MI->getOperand(i);
+        switch (MO.getType()) {
+        case MachineOperand::MO_Register:
+          Hash = hash_combine(Hash, MO.getReg(), MO.isDef());
+          break;
+        case MachineOperand::MO_Immediate:
+          Hash = hash_combine(Hash, MO.getImm());
+          break;
+        case MachineOperand::MO_MachineBasicBlock:
+          Hash = hash_combine(Hash, MO.getMBB()->getNumber());
+          break;
+        case MachineOperand::MO_GlobalAddress:
+          Hash = hash_combine(Hash, getMergeTarget(MO.getGlobal()),
+                              MO.getOffset());
+          break;
+        case MachineOperand::MO_ExternalSymbol:
+          Hash = hash_combine(Hash, StringRef(MO.getSymbolName()),
+                              MO.getOffset());
+          break;
+        case MachineOperand::MO_FPImmediate:
+        case MachineOperand::MO_CImmediate:
+        case MachineOperand::MO_RegisterMask:
+          // uniqued, compared by identity
+          break;
+        default:
+          // Operands referring to function-local data, e.g., constant pool
+          // entries or jump tables.
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+
+bool PatmosSPMerge::isIdentical(const MachineOperand &MO1,
+                                const MachineOperand &MO2) const {
+  if (MO1.getType() != MO2.getType()) return false;
+
+  switch (MO1.getType()) {
+  case MachineOperand::MO_MachineBasicBlock:
+    return MO1.getMBB()->getNumber() == MO2.getMBB()->getNumber();
+  case MachineOperand::MO_GlobalAddress:
+    return getMergeTarget(MO1.getGlobal()) == getMergeTarget(MO2.getGlobal())
+        && MO1.getOffset() == MO2.getOffset()
+        && MO1.getTargetFlags() == MO2.getTargetFlags();
+  default:
+    return MO1.isIdenticalTo(MO2);
+  }
+}
+
+
+bool PatmosSPMerge::isIdentical(const MachineFunction &MF1,
+                                const MachineFunction &MF2) const {
+  const PatmosMachineFunctionInfo *PMFI1 =
+    MF1.getInfo<PatmosMachineFunctionInfo>();
+  const PatmosMachineFunctionInfo *PMFI2 =
+    MF2.getInfo<PatmosMachineFunctionInfo>();
+
+  if (MF1.size() != MF2.size() ||
+      MF1.getAlignment() != MF2.getAlignment() ||
+      MF1.getFrameInfo()->getStackSize() != MF2.getFrameInfo()->getStackSize()||
+      PMFI1->getStackCacheReservedBytes() !=
+                                      PMFI2->getStackCacheReservedBytes() ||
+      PMFI1->getStackReservedBytes() != PMFI2->getStackReservedBytes())
+    return false;
+
+  for (MachineFunction::const_iterator MBB1 = MF1.begin(), MBB2 = MF2.begin(),
+       MBBE = MF1.end(); MBB1 != MBBE; ++MBB1, ++MBB2)
+  {
+    if (MBB1->getNumber() != MBB2->getNumber() ||
+        MBB1->getAlignment() != MBB2->getAlignment() ||
+        MBB1->succ_size() != MBB2->succ_size())
+      return false;
+
+    for (MachineBasicBlock::const_succ_iterator S1 = MBB1->succ_begin(),
+         S2 = MBB2->succ_begin(), SE = MBB1->succ_end(); S1 != SE; ++S1, ++S2)
+    {
+      if ((*S1)->getNumber() != (*S2)->getNumber())
+        return false;
+    }
+
+    MachineBasicBlock::const_instr_iterator MI1 = MBB1->instr_begin(),
+                                            MI2 = MBB2->instr_begin(),
+                                            ME1 = MBB1->instr_end(),
+                                            ME2 = MBB2->instr_end();
+    while (true) {
+      while (MI1 != ME1 && MI1->isDebugValue()) ++MI1;
+      while (MI2 != ME2 && MI2->isDebugValue()) ++MI2;
+      if (MI1 == ME1 || MI2 == ME2) {
+        if (MI1 != ME1 || MI2 != ME2) return false;
+        break;
+      }
+
+      if (MI1->getOpcode() != MI2->getOpcode() ||
+          MI1->getNumOperands() != MI2->getNumOperands() ||
+          MI1->getFlags() != MI2->getFlags())
+        return false;
+
+      for (unsigned i = 0, e = MI1->getNumOperands(); i != e; i++) {
+        if (!isIdentical(MI1->getOperand(i), MI2->getOperand(i)))
+          return false;
+      }
+      ++MI1;
+      ++MI2;
+    }
+  }
+  return true;
+}
+
+
+bool PatmosSPMerge::findIdenticalFunctions(const Module &M) {
+  std::multimap<size_t, const MachineFunction*> Hashes;
+  bool Changed = false;
+
+  for(Module::const_iterator F(M.begin()), FE(M.end()); F != FE; ++F) {
+    // only consider the single-path clones
+    if (!F->hasFnAttribute("sp-reachable") && !F->hasFnAttribute("sp-maybe"))
+      continue;
+    if (Merged.count(F)) continue;
+
+    const MachineFunction *MF = MMI->getMachineFunction(F);
+    if (!MF || !MF->getInfo<PatmosMachineFunctionInfo>()->isSinglePath())
+      continue;
+
+    hash_code Hash;
+    if (!hashFunction(*MF, Hash)) continue;
+
+    // look for an identical function earlier in the module
+    const MachineFunction *Target = NULL;
+    for (std::multimap<size_t, const MachineFunction*>::iterator
+         it = Hashes.lower_bound(Hash), ie = Hashes.upper_bound(Hash);
+         it != ie; ++it)
+    {
+      if (isIdentical(*it->second, *MF)) {
+        Target = it->second;
+        break;
+      }
+    }
+
+    if (Target) {
+      DEBUG(dbgs() << "  Merge function: " << F->getName() << " -> "
+                   << Target->getName() << "\n");
+      Merged[F] = Target->getFunction();
+      Changed = true;
+    } else {
+      Hashes.insert(std::make_pair(Hash, MF));
+    }
+  }
+
+  // remove the bodies only after all functions have been compared
+  for (std::map<const Function*, const Function*>::iterator
+       it = Merged.begin(), ie = Merged.end(); it != ie; ++it)
+  {
+    MachineFunction *MF = MMI->getMachineFunction(it->first);
+    if (MF->getInfo<PatmosMachineFunctionInfo>()->isSinglePath()) {
+      removeBody(*MF);
+    }
+  }
+
+  return Changed;
+}
+
+
+void PatmosSPMerge::rewriteCalls(const Module &M) {
+  for(Module::const_iterator F(M.begin()), FE(M.end()); F != FE; ++F) {
+    MachineFunction *MF = MMI->getMachineFunction(F);
+    if (!MF) continue;
+
+    for (MachineFunction::iterator MBB = MF->begin(), MBBE = MF->end();
+                                   MBB != MBBE; ++MBB) {
+      for (MachineBasicBlock::instr_iterator MI = MBB->instr_begin(),
+                             ME = MBB->instr_end(); MI != ME; ++MI) {
+        if (!MI->isCall() || MI->isBundle()) continue;
+
+        MachineOperand &MO = MI->getOperand(2);
+        if (!MO.isGlobal()) continue;
+
+        const GlobalValue *Target = getMergeTarget(MO.getGlobal());
+        if (Target == MO.getGlobal()) continue;
+
+        DEBUG(dbgs() << "  Rewrite call in " << MF->getName() << ": "
+                     << MO.getGlobal()->getName() << " -> "
+                     << Target->getName() << "\n");
+        // Replace the call target operand, like PatmosSPMark does. The new
+        // operand is inserted before the implicit operands of the call.
+        MI->RemoveOperand(2);
+        MachineInstrBuilder MIB(*MF, MI);
+        MIB.addGlobalAddress(Target);
+      }
+    }
+  }
+}
+
+
+void PatmosSPMerge::removeBody(MachineFunction &MF) {
+  for (MachineFunction::iterator MBB = MF.begin(), MBBE = MF.end();
+                                 MBB != MBBE; ++MBB) {
+    for (MachineBasicBlock::instr_iterator MI = MBB->instr_begin(),
+                           ME = MBB->instr_end(); MI != ME; ++MI) {
+      if (!MI->isBundle() && !MI->isDebugValue())
+        NumSPMergedInstrs++; // bump STATISTIC
+    }
+  }
+
+  // delete all MBBs
+  while (MF.begin() != MF.end()) {
+    MF.begin()->eraseFromParent();
+  }
+  // insert a new single MBB with a single return instruction
+  MachineBasicBlock *EmptyMBB = MF.CreateMachineBasicBlock();
+  MF.push_back(EmptyMBB);
+
+  DebugLoc DL;
+  AddDefaultPred(BuildMI(*EmptyMBB, EmptyMBB->end(), DL,
+      TM.getInstrInfo()->get(Patmos::RET)));
+
+  // the function is not converted anymore
+  MF.getInfo<PatmosMachineFunctionInfo>()->setSinglePath(false);
+  NumSPMerged++; // bump STATISTIC
+}
@@ -36,6 +36,7 @@
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineJumpTableInfo.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
 #include "llvm/CodeGen/MachinePostDominators.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/Support/CommandLine.h"
@@ -60,6 +61,7 @@ STATISTIC( RemovedBranchInstrs, "Number of branch instructions removed");
 STATISTIC( InsertedInstrs,      "Number of instructions inserted");
 STATISTIC( LoopCounters,        "Number of loop counters introduced");
 STATISTIC( ElimLdStCnt,         "Number of eliminated redundant loads/stores");
+STATISTIC( ElimStCnt,           "Number of eliminated redundant stores");
 
 namespace llvm {
   /// LinearizeWalker - Class to linearize the CFG during a walk of the SPScope
@@ -87,29 +89,36 @@ namespace llvm {
 
         // copy/load the header predicate for the subloop
         auto parentLoadLocs = RP.getLoadLocs(HeaderMBB); // In the parent RAInfo, which preds should be loaded
+        auto parentSpillLocs = RP.getSpillLocs(HeaderMBB); // In the parent RAInfo, which registers have to be spilled first
         auto parentPredRegs = Pass.getPredicateRegisters(RP, headerBlock); // In the parent RAInfo, which registers does the block use
         auto predRegs = Pass.getPredicateRegisters(RI, headerBlock); // Which registers does the block actually use
         for(auto pred: headerBlock->getBlockPredicates()){
+          // Find the register the parent uses for the predicate
+          unsigned parentReg = parentPredRegs.count(pred)? parentPredRegs[pred] : (unsigned) Patmos::P0;
+
           if(parentLoadLocs.count(pred)){
-            // The predicate needs to be loaded from a spill slot
+            // The predicate needs to be loaded from a spill slot.
+            // The parent does not insert spill code into the header of the
+            // subloop, as it would be executed in every iteration. Instead,
+            // the spill and load are done once here, in the preheader, such
+            // that the parent finds the predicate in its register after the
+            // loop.
+            if(parentSpillLocs.count(pred)){
+              Pass.insertPredicateSpill(PrehdrMBB, PrehdrMBB->end(),
+                  parentSpillLocs[pred], parentReg);
+            }
             Pass.insertPredicateLoad(PrehdrMBB, PrehdrMBB->end(),
-                parentLoadLocs[pred], predRegs[pred]);
+                parentLoadLocs[pred], parentReg);
+          }
+
+          // if the registers used for the predicate don't match between
+          // parent and this scope, move the value of the predicate
+          // from the parent register to this scope's register
+          if(predRegs[pred] != parentReg){
+            AddDefaultPred(BuildMI(*PrehdrMBB, PrehdrMBB->end(), DL,
+                  Pass.TII->get(Patmos::PMOV), predRegs[pred]))
+              .addReg( parentReg ).addImm(0);
             InsertedInstrs++; // STATISTIC
-          } else {
-            // The predicate does not need to be loaded.
-
-            // Find the register the parent uses for the predicate
-            unsigned parentReg = parentPredRegs.count(pred)? parentPredRegs[pred] : Patmos::P0;
-
-            // if the registers used for the predicate don't match between
-            // parent and this scope, move the value of the predicate
-            // from the parent register to this scope's register
-            if(predRegs[pred] != parentPredRegs[pred]){
-              AddDefaultPred(BuildMI(*PrehdrMBB, PrehdrMBB->end(), DL,
-                    Pass.TII->get(Patmos::PMOV), predRegs[pred]))
-                .addReg( parentReg ).addImm(0);
-              InsertedInstrs++; // STATISTIC
-            }
           }
         }
       }
@@ -154,9 +163,13 @@ namespace llvm {
         // Having redundant loads eliminated enables simpler removal
         // of redundant stores
         DEBUG(dbgs() << "Removing redundant stores:\n");
-        // FIXME the analysis is erroneous.
-        //findRedundantStores();
-        count += remove();
+        findRedundantStores();
+        unsigned int stcount = remove();
+        ElimStCnt += stcount; // STATISTIC
+        count += stcount;
+
+        DEBUG(dbgs() << "Removed " << stcount << " redundant stores in "
+                     << MF.getFunction()->getName() << "\n");
 
         return count;
       }
@@ -213,12 +226,35 @@ namespace llvm {
         }
       }
 
+      /// Returns true if the instruction is not guarded by a predicate.
+      bool isUnpredicated(const MachineInstr *MI) const {
+        int i = MI->findFirstPredOperandIdx();
+        if (i == -1) return true;
+        unsigned reg = MI->getOperand(i).getReg();
+        return (reg == Patmos::NoRegister || reg == Patmos::P0)
+               && MI->getOperand(i+1).getImm() == 0;
+      }
+
+      /// Returns the stack slot created for the single-path transformation
+      /// that is accessed by the given load or store, or -1.
+      /// Any register may be loaded from or stored to such a slot, e.g., R9
+      /// to the call spill slot.
+      int getAccessedFI(const MachineInstr *MI) const {
+        if (!MI->mayLoad() && !MI->mayStore()) return -1;
+        for (unsigned i = 0; i < MI->getNumOperands(); i++) {
+          const MachineOperand &MO = MI->getOperand(i);
+          if (MO.isFI() && MO.getIndex() >= (int)OffsetFIs &&
+              MO.getIndex() < (int)(OffsetFIs + NumFIs)) {
+            return MO.getIndex();
+          }
+        }
+        return -1;
+      }
+
       bool isUncondLoad(const MachineInstr *MI, int &fi) const {
         if ((MI->getOpcode() == Patmos::LBC || MI->getOpcode() == Patmos::LWC)
             && MI->getOperand(0).getReg() == TgtReg
-            && (MI->getOperand(1).getReg() == Patmos::NoRegister ||
-              MI->getOperand(1).getReg() == Patmos::P0)
-            && MI->getOperand(2).getImm() == 0
+            && isUnpredicated(MI)
             && MI->getOperand(3).isFI()) {
           fi = MI->getOperand(3).getIndex();
           return true;
@@ -226,12 +262,11 @@ namespace llvm {
         return false;
       }
 
-      bool isUncondStore(const MachineInstr *MI, int &fi) const {
+      /// Returns true if the instruction stores TgtReg to a stack slot,
+      /// predicated or not.
+      bool isStore(const MachineInstr *MI, int &fi) const {
         if ((MI->getOpcode() == Patmos::SBC || MI->getOpcode() == Patmos::SWC)
             && MI->getOperand(4).getReg() == TgtReg
-            && (MI->getOperand(0).getReg() == Patmos::NoRegister ||
-              MI->getOperand(0).getReg() == Patmos::P0)
-            && MI->getOperand(1).getImm() == 0
             && MI->getOperand(2).isFI()) {
           fi = MI->getOperand(2).getIndex();
           return true;
@@ -239,6 +274,10 @@ namespace llvm {
         return false;
       }
 
+      bool isUncondStore(const MachineInstr *MI, int &fi) const {
+        return isStore(MI, fi) && isUnpredicated(MI);
+      }
+
 
       void findRedundantLoads(void) {
         // forward DF problem
@@ -280,6 +319,24 @@ namespace llvm {
                 // update
                 livefi.reset();
                 livefi.set(normalizeFI(fi));
+                continue;
+              }
+              // after an unconditional store of TgtReg, the slot holds the
+              // value of TgtReg; a predicated one does not change whether
+              // the slot is equal to TgtReg.
+              if (isStore(&*MI, fi)) {
+                if (isUnpredicated(&*MI)) livefi.set(normalizeFI(fi));
+                continue;
+              }
+              // other stores to the slot, e.g., of R9
+              fi = getAccessedFI(&*MI);
+              if (fi != -1 && MI->mayStore()) {
+                livefi.reset(normalizeFI(fi));
+              }
+              // any other definition of TgtReg (including calls clobbering
+              // it) invalidates all slots
+              if (MI->modifiesRegister(TgtReg, TRI)) {
+                livefi.reset();
               }
             }
             // was an update?
@@ -303,16 +360,32 @@ namespace llvm {
         }
       }
 
+      /// Backward DF problems for the removal of stores to the stack slots:
+      /// - FutureLoads (may): slots that might be loaded on some path before
+      ///   they are overwritten by an unconditional store.
+      /// - SubseqStores (must): slots that are overwritten by an unconditional
+      ///   store on all paths before they are loaded.
+      /// The stack slots are local to the function, i.e., nothing is loaded
+      /// after the function returns.
       void findRedundantStores(void) {
-        // backward DF problems
         std::map<MachineInstr *,
                  std::pair<BitVector, BitVector> > collected_stores;
         std::queue<MachineBasicBlock *> worklist;
+        std::set<MachineBasicBlock *> inworklist;
+
+        // initialize the entry sets with the neutral elements of the joins
+        for (MachineFunction::iterator MBB = MF.begin(), MBBe = MF.end();
+            MBB != MBBe; ++MBB) {
+          Blockinfo &BI = this->BlockInfos.at(MBB);
+          BI.FutureLoadsEntry.reset();
+          BI.SubseqStoresEntry.set();
+        }
 
         // fill worklist initially in dfs postorder
         for (po_iterator<MachineBasicBlock *> POI = po_begin(&MF.front()),
             POIe = po_end(&MF.front());  POI != POIe; ++POI) {
           worklist.push(*POI);
+          inworklist.insert(*POI);
         }
 
         // iterate.
@@ -320,6 +393,7 @@ namespace llvm {
           // pop first element
           MachineBasicBlock *MBB = worklist.front();
           worklist.pop();
+          inworklist.erase(MBB);
           Blockinfo &BI = this->BlockInfos.at(MBB);
 
           BitVector subseqstores(NumFIs, true);
@@ -340,21 +414,25 @@ namespace llvm {
           // transfer
           for (MachineBasicBlock::reverse_iterator MI = MBB->rbegin(),
               MIe = MBB->rend(); MI != MIe; ++MI) {
-            int fi;
-            if (isUncondLoad(&*MI, fi)) {
-              int nfi = normalizeFI(fi);
+            int fi = getAccessedFI(&*MI);
+            if (fi == -1) continue;
+            unsigned nfi = normalizeFI(fi);
+            if (MI->mayLoad()) {
               futureloads.set(nfi);
-              if (!subseqstores.test(nfi)) subseqstores.reset();
-              continue;
+              subseqstores.reset(nfi);
             }
-            if (isUncondStore(&*MI, fi)) {
-              // remember store-inst with futureloads/subseq-st at exit
-              collected_stores[&*MI] = std::make_pair(futureloads,
-                                                      subseqstores);
-              // update
-              subseqstores.reset();
-              subseqstores.set(normalizeFI(fi));
-              continue;
+            if (MI->mayStore()) {
+              int sfi;
+              if (isStore(&*MI, sfi)) {
+                // remember store-inst with futureloads/subseq-st at exit
+                collected_stores[&*MI] = std::make_pair(futureloads,
+                                                        subseqstores);
+              }
+              // only unconditional stores overwrite the slot
+              if (isUnpredicated(&*MI)) {
+                futureloads.reset(nfi);
+                subseqstores.set(nfi);
+              }
             }
           }
 
@@ -366,7 +444,9 @@ namespace llvm {
             // add predecessors to worklist
             for (MachineBasicBlock::pred_iterator PI=MBB->pred_begin();
                 PI!=MBB->pred_end(); ++PI) {
-              worklist.push(*PI);
+              if (inworklist.insert(*PI).second) {
+                worklist.push(*PI);
+              }
             }
           }
         }
@@ -379,11 +459,14 @@ namespace llvm {
              I = collected_stores.begin(), E = collected_stores.end();
              I != E; ++I) {
           int fi, nfi;
-          (void) isUncondStore(I->first, fi);
+          (void) isStore(I->first, fi);
           nfi = normalizeFI(fi);
           BitVector futureloads  = I->second.first;
           BitVector subseqstores = I->second.second;
           if (subseqstores.test(nfi) || !futureloads.test(nfi)) {
+            DEBUG(dbgs() << "  store to FI#" << fi << " is redundant, "
+                         << "future loads: "; printFISet(futureloads, dbgs());
+                  dbgs() << "\n");
             Removables.insert(I->first);
           }
         }
@@ -965,10 +1048,16 @@ void PatmosSPReduce::applyPredicates(SPScope *S, MachineFunction &MF) {
           DEBUG_TRACE( dbgs() << "    call: " << *MI );
           assert(!TII->isPredicated(MI) && "call predicated");
           DebugLoc DL = MI->getDebugLoc();
-          // copy actual preg to temporary preg
-          AddDefaultPred(BuildMI(*MBB, MI, DL,
-                TII->get(Patmos::PMOV), PRTmp))
-            .addReg(predReg).addImm(0);
+          // copy actual preg to temporary preg, unless the callee does not
+          // need the predicate
+          if (!isUnconditionalCall(MI)) {
+            AddDefaultPred(BuildMI(*MBB, MI, DL,
+                  TII->get(Patmos::PMOV), PRTmp))
+              .addReg(predReg).addImm(0);
+          } else {
+            assert(predReg == Patmos::P0 &&
+                   "unconditional function called under a predicate");
+          }
 
           // store/restore caller saved R9 (gets dirty during frame setup)
           int fi = PMFI->getSinglePathCallSpillFI();
@@ -1054,6 +1143,17 @@ void PatmosSPReduce::applyPredicates(SPScope *S, MachineFunction &MF) {
   }
 }
 
+bool PatmosSPReduce::isUnconditionalCall(const MachineInstr *MI) const {
+  const MachineOperand &MO = MI->getOperand(2);
+  if (!MO.isGlobal()) return false;
+
+  const Function *Target = dyn_cast<Function>(MO.getGlobal());
+  const MachineFunction *TargetMF = Target ?
+    MI->getParent()->getParent()->getMMI().getMachineFunction(Target) : NULL;
+  return TargetMF &&
+    TargetMF->getInfo<PatmosMachineFunctionInfo>()->isSinglePathUnconditional();
+}
+
 std::map<unsigned, unsigned> PatmosSPReduce::getPredicateRegisters(const RAInfo &R,
                                     const PredicatedBlock *block)
 {
@@ -1090,49 +1190,12 @@ void PatmosSPReduce::insertUseSpillLoad(const RAInfo &R,
   for(auto loadLoc: loadLocs){
     auto pred = loadLoc.first;
     MachineBasicBlock::iterator firstMI = MBB->begin();
-    DebugLoc DL;
     assert(useLocs.count(pred));
     auto use_preg = useLocs[pred];
 
     // insert spill code
     if(spillLocs.count(pred)){
-      auto spill = spillLocs[pred];
-
-      int fi; unsigned bitpos;
-      getStackLocPair(fi, bitpos, spill);
-      // load from stack slot
-      AddDefaultPred(BuildMI(*MBB, firstMI, DL,
-            TII->get(Patmos::LWC), GuardsReg))
-        .addFrameIndex(fi).addImm(0); // address
-      // set/clear bit
-#ifdef USE_BCOPY
-      // (guard) bcopy R, (spill%32), use_preg
-      AddDefaultPred(BuildMI(*MBB, firstMI, DL,
-            TII->get(Patmos::BCOPY), GuardsReg))
-        .addReg(GuardsReg)
-        .addImm(bitpos)
-        .addReg(use_preg).addImm(0); // condition
-      InsertedInstrs++; // STATISTIC
-#else
-      // if (guard) R |= (1 << spill)
-      uint32_t or_bitmask = 1 << bitpos;
-      unsigned or_opcode = (isUInt<12>(or_bitmask))? Patmos::ORi : Patmos::ORl;
-      BuildMI(*MBB, firstMI, DL, TII->get(or_opcode), GuardsReg)
-        .addReg(use_preg).addImm(0) // if guard == true
-        .addReg(GuardsReg)
-        .addImm( or_bitmask );
-      // if (!guard) R &= ~(1 << spill)
-      BuildMI(*MBB, firstMI, DL, TII->get(Patmos::ANDl), GuardsReg)
-        .addReg(use_preg).addImm(1) // if guard == false
-        .addReg(GuardsReg)
-        .addImm( ~or_bitmask );
-      InsertedInstrs += 2; // STATISTIC
-#endif
-      // store back to stack slot
-      AddDefaultPred(BuildMI(*MBB, firstMI, DL, TII->get(Patmos::SWC)))
-        .addFrameIndex(fi).addImm(0) // address
-        .addReg(GuardsReg, RegState::Kill);
-      InsertedInstrs += 2; // STATISTIC (load/store)
+      insertPredicateSpill(MBB, firstMI, spillLocs[pred], use_preg);
     }
 
     insertPredicateLoad(MBB, firstMI, loadLoc.second, use_preg);
@@ -1140,6 +1203,49 @@ void PatmosSPReduce::insertUseSpillLoad(const RAInfo &R,
 }
 
 
+void PatmosSPReduce::insertPredicateSpill(MachineBasicBlock *MBB,
+                                          MachineBasicBlock::iterator MI,
+                                          int loc, unsigned source_preg) {
+  assert(loc != -1);
+  DebugLoc DL;
+  int fi; unsigned bitpos;
+  getStackLocPair(fi, bitpos, loc);
+  // load from stack slot
+  AddDefaultPred(BuildMI(*MBB, MI, DL,
+        TII->get(Patmos::LWC), GuardsReg))
+    .addFrameIndex(fi).addImm(0); // address
+  // set/clear bit
+#ifdef USE_BCOPY
+  // (guard) bcopy R, (spill%32), source_preg
+  AddDefaultPred(BuildMI(*MBB, MI, DL,
+        TII->get(Patmos::BCOPY), GuardsReg))
+    .addReg(GuardsReg)
+    .addImm(bitpos)
+    .addReg(source_preg).addImm(0); // condition
+  InsertedInstrs++; // STATISTIC
+#else
+  // if (guard) R |= (1 << spill)
+  uint32_t or_bitmask = 1 << bitpos;
+  unsigned or_opcode = (isUInt<12>(or_bitmask))? Patmos::ORi : Patmos::ORl;
+  BuildMI(*MBB, MI, DL, TII->get(or_opcode), GuardsReg)
+    .addReg(source_preg).addImm(0) // if guard == true
+    .addReg(GuardsReg)
+    .addImm( or_bitmask );
+  // if (!guard) R &= ~(1 << spill)
+  BuildMI(*MBB, MI, DL, TII->get(Patmos::ANDl), GuardsReg)
+    .addReg(source_preg).addImm(1) // if guard == false
+    .addReg(GuardsReg)
+    .addImm( ~or_bitmask );
+  InsertedInstrs += 2; // STATISTIC
+#endif
+  // store back to stack slot
+  AddDefaultPred(BuildMI(*MBB, MI, DL, TII->get(Patmos::SWC)))
+    .addFrameIndex(fi).addImm(0) // address
+    .addReg(GuardsReg, RegState::Kill);
+  InsertedInstrs += 2; // STATISTIC (load/store)
+}
+
+
 void PatmosSPReduce::insertPredicateLoad(MachineBasicBlock *MBB,
                                          MachineBasicBlock::iterator MI,
                                          int loc, unsigned target_preg) {
@@ -1375,6 +1481,10 @@ void LinearizeWalker::enterSubscope(SPScope *S) {
 
   DebugLoc DL;
 
+  // This has to precede the S0 spill, which must include the predicates
+  // the parent reloads here.
+  insertHeaderPredLoadOrCopy(S, PrehdrMBB, DL);
+
   if (RI.needsScopeSpill()) {
     // load the predicate registers to GuardsReg, and store them to the
     // allocated stack slot for this scope depth.
@@ -1393,8 +1503,6 @@ void LinearizeWalker::enterSubscope(SPScope *S) {
     InsertedInstrs += 3; // STATISTIC
   }
 
-  insertHeaderPredLoadOrCopy(S, PrehdrMBB, DL);
-
 
   // Initialize the loop bound and store it to the stack slot
   if (S->hasLoopBound()) {
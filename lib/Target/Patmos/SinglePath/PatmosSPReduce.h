@@ -139,10 +139,21 @@ namespace llvm {
     /// applyPredicates - Predicate instructions of MBBs in the given SPScope.
     void applyPredicates(SPScope *S, MachineFunction &MF);
 
+    /// isUnconditionalCall - Returns true if the given call instruction
+    /// calls a single-path function that does not take the predicate of
+    /// the caller.
+    bool isUnconditionalCall(const MachineInstr *MI) const;
+
     /// insertUseSpillLoad - Insert Spill/Load code at the beginning of the
     /// given MBB, according to R.
     void insertUseSpillLoad(const RAInfo &R, PredicatedBlock *block);
 
+    /// insertPredicateSpill - Insert code to store a predicate register to
+    /// a spill stack slot.
+    void insertPredicateSpill(MachineBasicBlock *MBB,
+                              MachineBasicBlock::iterator MI,
+                              int loc, unsigned source_preg);
+
     /// insertPredicateLoad - Insert code to load from a spill stack slot to
     /// a predicate register.
     void insertPredicateLoad(MachineBasicBlock *MBB,
@@ -192,9 +192,15 @@ public:
   // The total number of predicate locations used by this instance.
   unsigned NumLocs;
 
-  // The maximum number of location used by any child.
+  // The maximum number of locations used by any child, including the
+  // registers of this instance that are live across it.
   unsigned ChildrenMaxCumLocs;
 
+  /// For each subheader, the number of registers (counted from
+  /// 'FirstUsableReg') that hold predicates which are live across the
+  /// subscope. The registers above are free while the subscope executes.
+  std::map<const MachineBasicBlock*, unsigned> SubheaderLiveRegs;
+
   /// The index of the first register this instance can use.
   /// The registers below the index are used by a parent scope.
   unsigned FirstUsableReg;
@@ -264,7 +270,14 @@ public:
 
   // getCumLocs - Get the maximum number of locations
   // used by this scope and any of its children
-  unsigned getCumLocs(void) const { return NumLocs + ChildrenMaxCumLocs; }
+  unsigned getCumLocs(void) const {
+    return max(NumLocs, ChildrenMaxCumLocs);
+  }
+
+  // getNumStackLocs - Get the number of stack spill slots used by this scope
+  unsigned getNumStackLocs(void) const {
+    return (NumLocs > MaxRegs) ? NumLocs - MaxRegs : 0;
+  }
 
   void createLiveRanges(void) {
 
@@ -362,6 +375,20 @@ public:
                         << DefLocs.at(pred).getLoc() << ", ");
         }
       }
+
+      // (4) for a subheader, record which registers must be preserved
+      //     while the subscope executes: those holding predicates that are
+      //     live across it, including the ones defined on its exit edges.
+      if (Pub.Scope->isSubheader(block)) {
+        unsigned liveRegs = 0;
+        for (auto &pair: curLocs) {
+          if (pair.second.getType() == Register) {
+            liveRegs = max(liveRegs, pair.second.getLoc() + 1);
+          }
+        }
+        SubheaderLiveRegs[MBB] = liveRegs;
+        DEBUG( dbgs() << "live regs " << liveRegs << ", ");
+      }
       DEBUG(dbgs() << "\n");
     } // end of forall MBB
 
@@ -402,17 +429,29 @@ public:
     return idx + FirstUsableStackSlot;
   }
 
+  /// Returns the number of registers of this instance that are live across
+  /// the given child scope.
+  unsigned getLiveRegsAcross(const SPScope *child) const {
+    auto found = SubheaderLiveRegs.find(child->getHeader()->getMBB());
+    assert(found != SubheaderLiveRegs.end());
+    return found->second;
+  }
+
   /// Unifies with parent, such that this RAInfo knows which registers it can use
   /// and where its spill slots are.
-  void unifyWithParent(const RAInfo::Impl &parent, int parentSpillLocCnt, bool topLevel){
+  /// Only the first 'parentLiveRegs' registers of the parent hold predicates
+  /// that are live across this scope and must be preserved.
+  void unifyWithParent(const RAInfo::Impl &parent, unsigned parentLiveRegs,
+                       bool topLevel){
 
-      // We can avoid a spill if the total number of locations
-      // used by the parent, this instance, and any child is less
-      // than/equal to the number of registers available to the function.
-      if ( !topLevel && parent.NumLocs + getCumLocs() <= MaxRegs ) {
+      // We can avoid a spill if the live registers of the parent and the
+      // locations used by this instance and any child fit into the
+      // registers available to the function.
+      if ( !topLevel &&
+           parent.FirstUsableReg + parentLiveRegs + getCumLocs() <= MaxRegs ) {
 
         // Compute the first register not used by an ancestor.
-        FirstUsableReg = parent.FirstUsableReg + parent.NumLocs;
+        FirstUsableReg = parent.FirstUsableReg + parentLiveRegs;
 
         // If the total number of locations the parent, myself, and my children need
         // are less than/equal to the number of available registers
@@ -420,15 +459,18 @@ public:
         NeedsScopeSpill = false;
       }
 
-    if (NumLocs > MaxRegs) {
-      FirstUsableStackSlot = parentSpillLocCnt;
-    }
+    // The spill slots of the parent are live across this scope, but those
+    // of sibling scopes are not, so siblings share their spill slots.
+    FirstUsableStackSlot = parent.FirstUsableStackSlot
+                           + parent.getNumStackLocs();
   }
 
   /// Unifies with child, such that this RAInfo knows how many locations will
-  /// be used by the given child.
-  void unifyWithChild(const RAInfo::Impl &child){
-    ChildrenMaxCumLocs = max(child.getCumLocs(), ChildrenMaxCumLocs);
+  /// be used by the given child, on top of the 'liveRegs' registers of this
+  /// instance that are live across it.
+  void unifyWithChild(const RAInfo::Impl &child, unsigned liveRegs){
+    ChildrenMaxCumLocs = max(liveRegs + child.getCumLocs(),
+                             ChildrenMaxCumLocs);
   }
 
   UseLoc calculateNotHeaderUseLoc(unsigned blockIndex, unsigned usePred,
@@ -586,7 +628,7 @@ public:
       for(auto ul: UseLocs[MBB]){
         auto opLoc = f(ul.second);
         if(opLoc .first){
-          result[ul.first] = unifyRegister(opLoc.second);
+          result[ul.first] = unifyStack(opLoc.second);
         }
       }
     }
@@ -660,11 +702,7 @@ tuple<RAInfo::LocType, unsigned> RAInfo::getDefLoc(unsigned pred) const {
 }
 
 unsigned RAInfo::neededSpillLocs(){
-  if(Priv->NumLocs < Priv->MaxRegs) {
-    return 0;
-  }else{
-    return Priv->NumLocs - Priv->MaxRegs;
-  }
+  return Priv->getNumStackLocs();
 }
 
 void RAInfo::dump() const {
@@ -731,14 +769,16 @@ std::map<const SPScope*, RAInfo> RAInfo::computeRegAlloc(SPScope *rootScope, uns
     for(SPScope::child_iterator CI = scope->child_begin(), CE = scope->child_end();
         CI != CE; ++CI) {
       SPScope *CN = *CI;
-      RI.Priv->unifyWithChild(*(RAInfos.at(CN).Priv));
+      RI.Priv->unifyWithChild(*(RAInfos.at(CN).Priv),
+                              RI.Priv->getLiveRegsAcross(CN));
     }
   } // end of PO traversal for RegAlloc
 
 
   // Visit all scopes in depth-first order to compute offsets:
   // - Offset is inherited during traversal
-  // - SpillOffset is assigned increased depth-first, from left to right
+  // - SpillOffset is stacked on top of the parent's spill slots, siblings
+  //   share them
   unsigned spillLocCnt = 0;
   for (auto iter = df_begin(rootScope), end = df_end(rootScope);
         iter!=end; ++iter) {
@@ -746,10 +786,13 @@ std::map<const SPScope*, RAInfo> RAInfo::computeRegAlloc(SPScope *rootScope, uns
     RAInfo &RI = RAInfos.at(scope);
 
     if (!scope->isTopLevel()) {
-       RI.Priv->unifyWithParent(*(RAInfos.at(scope->getParent()).Priv), spillLocCnt, scope->isTopLevel());
+       const RAInfo::Impl &parent = *(RAInfos.at(scope->getParent()).Priv);
+       RI.Priv->unifyWithParent(parent, parent.getLiveRegsAcross(scope),
+                                scope->isTopLevel());
       if (!RI.needsScopeSpill()) NoSpillScopes++; // STATISTIC
     }
-    spillLocCnt += RI.neededSpillLocs();
+    spillLocCnt = max(spillLocCnt,
+                      RI.Priv->FirstUsableStackSlot + RI.neededSpillLocs());
     DEBUG( RI.dump() );
   } // end df
 
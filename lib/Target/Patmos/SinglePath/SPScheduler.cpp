@@ -7,6 +7,7 @@
 //
 //===----------------------------------------------------------------------===//
 //
+// List scheduler for single-path code, see SPScheduler.h.
 //
 //===----------------------------------------------------------------------===//
 
@@ -18,6 +19,70 @@
 using namespace llvm;
 
 STATISTIC(SPInstructions,     "Number of instruction bundles in single-path code (both single and double)");
+STATISTIC(SPNops,             "Number of NOPs in scheduled single-path code");
+STATISTIC(SPFilledSlots,      "Number of delay slots in single-path code filled with instructions");
+STATISTIC(SPPairedInstrs,     "Number of instructions paired with another instruction by the single-path scheduler");
+
+namespace {
+
+  /// A unit of scheduling, i.e., an instruction or a bundle of instructions of
+  /// the unscheduled code. Bundles are never split.
+  struct SPSchedUnit {
+    /// The instructions of the unit, in bundle order.
+    SmallVector<MachineInstr*, 2> MIs;
+
+    /// The number of issue slots used by the unit.
+    unsigned Width;
+
+    /// Whether this is a control-flow instruction, i.e., it ends its region.
+    bool IsCFL;
+
+    /// The number of delay slot cycles of a control-flow instruction.
+    unsigned DelaySlots;
+
+    /// Memory accesses and instructions that must not be reordered at all.
+    bool IsLoad, IsStore, IsStackControl, IsBarrier;
+
+    /// Whether the unit may be moved into a delay slot.
+    bool DelaySlotOK;
+
+    /// Cycles after the issue of the unit, until all its results can be used
+    /// by the code following the region.
+    unsigned ExitLatency;
+
+    /// Dependencies to earlier units, as pairs of unit index and latency.
+    SmallVector<std::pair<unsigned, unsigned>, 4> Preds;
+
+    /// The number of dependencies of later units that are not yet scheduled.
+    unsigned NumSuccsLeft;
+
+    /// The length of the longest path from the start of the region to the
+    /// unit, in cycles.
+    unsigned Depth;
+
+    /// Lowest cycle (counted from the end of the region) the unit can be
+    /// scheduled to, given the already scheduled units.
+    unsigned Earliest;
+
+    /// The cycle (counted from the end of the region) the unit has been
+    /// scheduled to, or -1.
+    int Cycle;
+
+    SPSchedUnit() : Width(1), IsCFL(false), DelaySlots(0), IsLoad(false),
+      IsStore(false), IsStackControl(false), IsBarrier(false),
+      DelaySlotOK(true), ExitLatency(0), NumSuccsLeft(0), Depth(0),
+      Earliest(0), Cycle(-1) {}
+  };
+
+  /// The definition of a register unit last seen in a region.
+  struct SPRegDef {
+    int Unit;
+    const MachineInstr *MI;
+    unsigned OpIdx;
+
+    SPRegDef() : Unit(-1), MI(NULL), OpIdx(0) {}
+  };
+}
 
 char SPScheduler::ID = 0;
 
@@ -37,17 +102,12 @@ bool SPScheduler::runOnMachineFunction(MachineFunction &mf){
   auto reduceAnalysis = &getAnalysis<PatmosSPReduce>();
   auto rootScope = reduceAnalysis->RootScope;
 
+  // After the reduction, the blocks of all scopes are straight-line code, so
+  // scheduling each block covers all scopes.
   for(auto mbbIter = mf.begin(), mbbEnd = mf.end(); mbbIter != mbbEnd; mbbIter++){
     auto mbb = &(*mbbIter);
     DEBUG(dbgs() << "MBB: [" << mbb << "]: #" << mbb->getNumber() << "\n");
-    for(auto instrIter = mbb->begin(), instrEnd = mbb->end();
-        instrIter != instrEnd; instrIter++)
-    {
-      SPInstructions++;
-	  calculateLatency(instrIter);
-    }
-
-
+    scheduleMBB(*mbb);
   }
 
   DEBUG( dbgs() << "AFTER Single-Path Schedule\n"; mf.dump() );
@@ -58,30 +118,341 @@ bool SPScheduler::runOnMachineFunction(MachineFunction &mf){
   return true;
 }
 
-unsigned SPScheduler::calculateLatency(MachineBasicBlock::iterator instr){
-  auto instrInfo = TM.getInstrInfo();
-
-  auto mbb = instr->getParent();
-  if(instr->isBranch() || instr->isCall() || instr->isReturn()){
-    DEBUG(dbgs() << "Inserting 3xNOP after instruction: "; instr->print(dbgs(), NULL, false));
-
-    // We simply add 3 nops after any branch, call or return, as its
-    // the highest possible delay.
-    // The delay slot filler pass will remove most of these afterwards
-    instr++;
-    instrInfo->insertNoop(*mbb, instr);
-    instrInfo->insertNoop(*mbb, instr);
-    instrInfo->insertNoop(*mbb, instr);
-  } else if (instr->mayLoad() || (instr->getOpcode() == Patmos::MUL) || (instr->getOpcode() == Patmos::MULU)){
-    DEBUG(dbgs() << "Inserting NOP after instruction: "; instr->print(dbgs(), NULL, false));
-    instr++;
-    auto sizebefore = mbb->size();
-    instrInfo->insertNoop(*mbb, instr);
-    assert(mbb->size() == (sizebefore+1));
-    // TODO: make it cleverer, e.g. no reason for a nop
-    // if the next instruction does not use the loaded value.
+bool SPScheduler::isRegionBoundary(const MachineInstr *MI) const {
+  MachineBasicBlock::const_instr_iterator II = MI,
+                                          IE = MI->getParent()->instr_end();
+  do {
+    if (II->isInlineAsm() || II->isLabel() || TII->isPseudo(II)) {
+      return true;
+    }
+  } while (II->isBundledWithSucc() && ++II != IE);
+  return false;
+}
+
+void SPScheduler::scheduleMBB(MachineBasicBlock &MBB) {
+  MachineBasicBlock::iterator I = MBB.begin(), E = MBB.end();
+  while (I != E) {
+    // Collect the region up to the next control-flow instruction or boundary
+    std::vector<MachineInstr*> Region;
+    while (I != E && !isRegionBoundary(I)) {
+      MachineInstr *MI = I++;
+      Region.push_back(MI);
+      if (MI->isCall(MachineInstr::AnyInBundle) ||
+          MI->isReturn(MachineInstr::AnyInBundle) ||
+          MI->isBranch(MachineInstr::AnyInBundle)) {
+        break;
+      }
+    }
+
+    if (!Region.empty()) {
+      scheduleRegion(MBB, Region, I.getInstrIterator());
+    }
+
+    if (I != E && isRegionBoundary(I)) {
+      ++I;
+    }
+  }
+}
+
+/// isDepOperand - Returns whether the given operand of an instruction has to be
+/// considered for dependencies.
+static bool isDepOperand(const MachineInstr *MI, unsigned OpIdx) {
+  const MachineOperand &MO = MI->getOperand(OpIdx);
+  if (!MO.isReg() || !MO.getReg()) {
+    return false;
+  }
+
+  // Instructions in delay slots of calls and returns are executed before the
+  // first instruction at the target, i.e., they may define arguments, return
+  // values and clobbered registers. Only the explicit operands and the return
+  // information registers written (call) or read (return) immediately matter.
+  if ((MI->isCall() || MI->isReturn()) &&
+      OpIdx >= MI->getDesc().getNumOperands()) {
+    unsigned Reg = MO.getReg();
+    return Reg == Patmos::SRB || Reg == Patmos::SRO ||
+           Reg == Patmos::SXB || Reg == Patmos::SXO;
+  }
+  return true;
+}
+
+/// getDefLatency - Returns the number of cycles until the register defined by
+/// the given operand can be used by any following instruction.
+static unsigned getDefLatency(const InstrItineraryData *ItinData,
+                              const MachineInstr *MI, unsigned OpIdx) {
+  // Registers are read in the DR stage (cycle 1) at the earliest, GPRs are
+  // bypassed into EX (cycle 2).
+  int Cycle = ItinData->getOperandCycle(MI->getDesc().getSchedClass(), OpIdx);
+  if (Cycle < 0) {
+    return MI->mayLoad() ? 2 : 1;
   }
+  return std::max(Cycle - 1, 1);
 }
 
+void SPScheduler::scheduleRegion(MachineBasicBlock &MBB,
+                                 const std::vector<MachineInstr*> &Region,
+                                 MachineBasicBlock::instr_iterator InsertPos)
+{
+  const InstrItineraryData *ItinData = &STC.getInstrItineraryData();
+  bool Bundling = STC.enableBundling(TM.getOptLevel());
+
+  std::vector<SPSchedUnit> Units;
+  for (auto MI : Region) {
+    // NOPs are not needed, hazards are resolved below.
+    if (MI->getOpcode() == Patmos::NOP && !MI->isBundled()) {
+      MI->eraseFromParent();
+      continue;
+    }
+
+    Units.push_back(SPSchedUnit());
+    SPSchedUnit &U = Units.back();
+    MachineBasicBlock::instr_iterator II = MI, IE = MBB.instr_end();
+    do {
+      U.MIs.push_back(II);
+    } while (II->isBundledWithSucc() && ++II != IE);
+  }
+  if (Units.empty()) {
+    return;
+  }
+
+  DEBUG(dbgs() << "Scheduling region of " << Units.size() << " units\n");
 
+  // Build the dependence graph. Dependencies always point from earlier to
+  // later units, i.e., the units are in topological order.
+  std::vector<SPRegDef> LastDefs(TRI->getNumRegUnits());
+  std::vector<SmallVector<unsigned, 4> > LastUses(TRI->getNumRegUnits());
+  std::vector<unsigned> MemUnits;
+  int LastBarrier = -1;
 
+  auto addEdge = [&](unsigned From, unsigned To, unsigned Latency) {
+    Units[To].Preds.push_back(std::make_pair(From, Latency));
+    Units[From].NumSuccsLeft++;
+  };
+
+  for (unsigned i = 0, e = Units.size(); i != e; i++) {
+    SPSchedUnit &U = Units[i];
+
+    U.Width = U.MIs.size() > 1 ? 2 : std::max(1u, TII->getIssueWidth(U.MIs[0]));
+    for (auto MI : U.MIs) {
+      if (MI->isCall() || MI->isReturn() || MI->isBranch()) {
+        U.IsCFL = true;
+        if (MI->hasDelaySlot()) {
+          U.DelaySlots = std::max(U.DelaySlots, STC.getDelaySlotCycles(MI));
+        }
+        continue;
+      }
+      U.IsLoad |= MI->mayLoad();
+      U.IsStore |= MI->mayStore();
+      U.IsStackControl |= TII->isStackControl(MI);
+      U.IsBarrier |= MI->hasUnmodeledSideEffects() &&
+                     !TII->isSideEffectFreeSRegAccess(MI);
+      // Long latency multiplies are not moved into delay slots.
+      U.DelaySlotOK &= MI->getOpcode() != Patmos::MUL &&
+                       MI->getOpcode() != Patmos::MULU;
+    }
+    U.DelaySlotOK &= !U.IsCFL && !U.IsStackControl && !U.IsBarrier;
+
+    // Register dependencies, uses before definitions.
+    for (auto MI : U.MIs) {
+      for (unsigned j = 0, je = MI->getNumOperands(); j != je; j++) {
+        const MachineOperand &MO = MI->getOperand(j);
+        if (!isDepOperand(MI, j) || !MO.isUse()) continue;
+
+        for (MCRegUnitIterator RU(MO.getReg(), TRI); RU.isValid(); ++RU) {
+          const SPRegDef &D = LastDefs[*RU];
+          if (D.Unit >= 0 && D.Unit != (int)i) {
+            int Latency = TII->getOperandLatency(ItinData, D.MI, D.OpIdx,
+                                                 MI, j);
+            if (Latency < 0) {
+              Latency = getDefLatency(ItinData, D.MI, D.OpIdx);
+            }
+            addEdge(D.Unit, i, std::max(Latency, 1));
+          }
+          LastUses[*RU].push_back(i);
+        }
+      }
+    }
+    for (auto MI : U.MIs) {
+      for (unsigned j = 0, je = MI->getNumOperands(); j != je; j++) {
+        const MachineOperand &MO = MI->getOperand(j);
+        if (!isDepOperand(MI, j) || !MO.isDef()) continue;
+
+        for (MCRegUnitIterator RU(MO.getReg(), TRI); RU.isValid(); ++RU) {
+          SPRegDef &D = LastDefs[*RU];
+          // Anti-dependencies, the use may be in the same cycle.
+          for (auto Use : LastUses[*RU]) {
+            if (Use != i) {
+              addEdge(Use, i, 0);
+            }
+          }
+          LastUses[*RU].clear();
+          // Output dependencies, the writes must happen in order.
+          if (D.Unit >= 0 && D.Unit != (int)i) {
+            int Latency = (int)getDefLatency(ItinData, D.MI, D.OpIdx) -
+                          (int)getDefLatency(ItinData, MI, j) + 1;
+            addEdge(D.Unit, i, std::max(Latency, 1));
+          }
+          D.Unit = i;
+          D.MI = MI;
+          D.OpIdx = j;
+        }
+      }
+    }
+
+    // Memory and side-effect dependencies. Loads may pass other loads; stack
+    // control is ordered with all memory accesses.
+    if (U.IsBarrier) {
+      for (unsigned j = LastBarrier + 1; j != i; j++) {
+        addEdge(j, i, 1);
+      }
+      LastBarrier = i;
+    } else {
+      if (LastBarrier >= 0) {
+        addEdge(LastBarrier, i, 1);
+      }
+      if (U.IsLoad || U.IsStore || U.IsStackControl) {
+        for (auto j : MemUnits) {
+          const SPSchedUnit &P = Units[j];
+          if (P.IsStore || P.IsStackControl || U.IsStore || U.IsStackControl) {
+            addEdge(j, i, 1);
+          }
+        }
+        MemUnits.push_back(i);
+      }
+    }
+
+    for (auto &Pred : U.Preds) {
+      U.Depth = std::max(U.Depth, Units[Pred.first].Depth + Pred.second);
+    }
+  }
+
+  // Results defined last in the region must be available at its end.
+  for (auto &D : LastDefs) {
+    if (D.Unit >= 0) {
+      SPSchedUnit &U = Units[D.Unit];
+      U.ExitLatency = std::max(U.ExitLatency,
+                               getDefLatency(ItinData, D.MI, D.OpIdx));
+    }
+  }
+
+  // Schedule bottom-up. The control-flow instruction ending the region is
+  // placed such that its delay slots end with the region. Units are ready
+  // once all units depending on them are scheduled.
+  SPSchedUnit *CFL = Units.back().IsCFL ? &Units.back() : NULL;
+  unsigned CFLCycle = CFL ? CFL->DelaySlots : 0;
+  // Calls and returns compute the return address from the size of their
+  // delay slots, only allow single 32 bit instructions there.
+  bool SingleIssueSlots = CFL &&
+      (CFL->MIs[0]->isCall() || CFL->MIs[0]->isReturn());
+
+  for (auto &U : Units) {
+    if (&U != CFL && U.ExitLatency > 1) {
+      U.Earliest = U.ExitLatency - 1;
+    }
+  }
+
+  auto canPair = [&](const SPSchedUnit &A, const SPSchedUnit &B) {
+    return A.Width == 1 && B.Width == 1 &&
+           (TII->canIssueInSlot(A.MIs[0], 1) ||
+            TII->canIssueInSlot(B.MIs[0], 1));
+  };
+
+  auto pickUnit = [&](unsigned Cycle, bool InDelaySlot, int Other) {
+    int Best = -1;
+    for (unsigned i = 0, e = Units.size(); i != e; i++) {
+      const SPSchedUnit &U = Units[i];
+      if (U.Cycle >= 0 || U.NumSuccsLeft || U.Earliest > Cycle || U.IsCFL) {
+        continue;
+      }
+      if (InDelaySlot && (!U.DelaySlotOK || (SingleIssueSlots &&
+              (U.MIs.size() > 1 || TII->getInstrSize(U.MIs[0]) != 4)))) {
+        continue;
+      }
+      if (Other >= 0 && !canPair(Units[Other], U)) {
+        continue;
+      }
+      // Prefer units on long paths from the start of the region, keep the
+      // original order otherwise.
+      if (Best < 0 || U.Depth >= Units[Best].Depth) {
+        Best = i;
+      }
+    }
+    return Best;
+  };
+
+  std::vector<SmallVector<unsigned, 2> > Cycles;
+  auto scheduleUnit = [&](unsigned Idx, unsigned Cycle) {
+    SPSchedUnit &U = Units[Idx];
+    U.Cycle = Cycle;
+    Cycles[Cycle].push_back(Idx);
+    for (auto &Pred : U.Preds) {
+      SPSchedUnit &P = Units[Pred.first];
+      P.NumSuccsLeft--;
+      P.Earliest = std::max(P.Earliest, Cycle + Pred.second);
+    }
+  };
+
+  for (unsigned Left = Units.size(); Left; ) {
+    unsigned Cycle = Cycles.size();
+    Cycles.push_back(SmallVector<unsigned, 2>());
+
+    if (CFL && Cycle == CFLCycle) {
+      scheduleUnit(Units.size() - 1, Cycle);
+      Left--;
+      continue;
+    }
+
+    bool InDelaySlot = CFL && Cycle < CFLCycle;
+    int First = pickUnit(Cycle, InDelaySlot, -1);
+    if (First < 0) {
+      continue;
+    }
+    scheduleUnit(First, Cycle);
+    Left--;
+    if (InDelaySlot) {
+      SPFilledSlots++;
+    }
+
+    if (!Bundling || (InDelaySlot && SingleIssueSlots)) {
+      continue;
+    }
+    int Second = pickUnit(Cycle, InDelaySlot, First);
+    if (Second >= 0) {
+      scheduleUnit(Second, Cycle);
+      // Put the instruction that can be issued in the second slot last.
+      if (!TII->canIssueInSlot(Units[Second].MIs[0], 1)) {
+        std::swap(Cycles[Cycle][0], Cycles[Cycle][1]);
+      }
+      Left--;
+      SPPairedInstrs += 2;
+    }
+  }
+
+  // Re-insert the instructions in scheduled order, filling empty cycles with
+  // NOPs.
+  for (auto &U : Units) {
+    for (auto MI : U.MIs) {
+      MBB.remove_instr(MI);
+    }
+  }
+  for (unsigned Cycle = Cycles.size(); Cycle-- > 0; ) {
+    SPInstructions++;
+    if (Cycles[Cycle].empty()) {
+      DEBUG(dbgs() << "  NOP\n");
+      TII->insertNoop(MBB, InsertPos);
+      SPNops++;
+      continue;
+    }
+
+    bool First = true;
+    for (auto Idx : Cycles[Cycle]) {
+      for (auto MI : Units[Idx].MIs) {
+        DEBUG(dbgs() << (First ? "  " : "  + "); MI->print(dbgs(), &TM));
+        MBB.insert(InsertPos, MI);
+        if (!First) {
+          MI->bundleWithPred();
+        }
+        First = false;
+      }
+    }
+  }
+}
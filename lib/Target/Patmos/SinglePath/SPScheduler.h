@@ -7,6 +7,16 @@
 //
 //===----------------------------------------------------------------------===//
 //
+// List scheduler for single-path code.
+//
+// After the single-path reduction, the blocks of each SPScope are straight-line
+// code. Every block is split into regions that end at a control-flow
+// instruction (or at instructions that cannot be reordered, e.g., inline asm).
+// Each region is list scheduled bottom-up, using the latencies of the
+// itineraries in PatmosSchedule.td. The delay slots of the control-flow
+// instruction ending a region are filled with independent instructions of the
+// region, and instructions are paired into bundles for the dual-issue
+// pipeline. Remaining hazards are filled with NOPs.
 //
 //===----------------------------------------------------------------------===//
 
@@ -28,7 +38,10 @@ public:
   static char ID;
 
   SPScheduler(const PatmosTargetMachine &tm):
-    MachineFunctionPass(ID), TM(tm)
+    MachineFunctionPass(ID), TM(tm),
+    STC(tm.getSubtarget<PatmosSubtarget>()),
+    TII(static_cast<const PatmosInstrInfo*>(tm.getInstrInfo())),
+    TRI(tm.getRegisterInfo())
   {}
 
   // Override MachineFunctionPass::runOnMachineFunction
@@ -48,14 +61,27 @@ public:
 private:
 
   const PatmosTargetMachine &TM;
-
-  /// Calculates the latency that must be observed between these two instructions.
-  /// E.g. if the first instruction loads a value into a register and the
-  /// second instruction uses that value the latency is 1, and there must be at
-  /// least 1 cycle between the two instructions.
-  /// If the instructions are part of bundles, the whole bundle is taken into
-  /// account.
-  unsigned calculateLatency(MachineBasicBlock::iterator);
+  const PatmosSubtarget &STC;
+  const PatmosInstrInfo *TII;
+  const TargetRegisterInfo *TRI;
+
+  /// Schedules all regions of the given block.
+  void scheduleMBB(MachineBasicBlock &MBB);
+
+  /// Schedules a region of a block, given by the (first instructions of the)
+  /// instructions and bundles in it. The scheduled region is inserted before
+  /// InsertPos.
+  /// The last instruction of the region may be a control-flow instruction,
+  /// whose delay slots are filled with other instructions of the region.
+  /// All results of the region are available at the end of the region, i.e.,
+  /// regions can be scheduled independently of each other.
+  void scheduleRegion(MachineBasicBlock &MBB,
+                      const std::vector<MachineInstr*> &Region,
+                      MachineBasicBlock::instr_iterator InsertPos);
+
+  /// Returns whether the given instruction (or bundle) must not be moved by
+  /// the scheduler, i.e., it separates two regions.
+  bool isRegionBoundary(const MachineInstr *MI) const;
 
 };
 
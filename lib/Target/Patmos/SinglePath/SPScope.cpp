@@ -10,6 +10,7 @@
 
 #include "SPScope.h"
 #include "Patmos.h"
+#include "PatmosMachineFunctionInfo.h"
 #include "PatmosUtil.h"
 #include "PatmosSinglePathInfo.h"
 #include "PatmosSPBundling.h"
@@ -879,7 +880,11 @@ void createSPScopeSubtree(MachineLoop *loop, SPScope *parent, MachineFunction &M
 
 SPScope * SPScope::createSPScopeTree(MachineFunction &MF, MachineLoopInfo &LI, const PatmosInstrInfo* instrInfo) {
 
-  SPScope *Root = new SPScope(PatmosSinglePathInfo::isRoot(MF), MF, LI);
+  // Functions that are always called with an enabled predicate are handled
+  // like roots, they do not need the predicate of the caller.
+  bool isRootFunc = PatmosSinglePathInfo::isRoot(MF) ||
+    MF.getInfo<PatmosMachineFunctionInfo>()->isSinglePathUnconditional();
+  SPScope *Root = new SPScope(isRootFunc, MF, LI);
 
   // iterate over top-level loops
   for (MachineLoopInfo::iterator I=LI.begin(), E=LI.end(); I!=E; ++I) {
@@ -0,0 +1,49 @@
+# RUN: llvm-mc -triple=patmos-unknown-unknown-elf -mattr=+fpu -show-encoding %s | FileCheck %s
+#
+# Tests parsing and encoding of the single precision FPU instructions.
+
+# CHECK: fadds $r1 = $r2, $r3 # encoding: [0x02,0x02,0x21,0xf0]
+	fadds $r1 = $r2, $r3
+
+# CHECK: fsubs $r4 = $r5, $r6 # encoding: [0x02,0x08,0x53,0x71]
+	fsubs $r4 = $r5, $r6
+
+# CHECK: fmuls $r7 = $r8, $r9 # encoding: [0x02,0x0e,0x84,0xf2]
+	fmuls $r7 = $r8, $r9
+
+# CHECK: fdivs $r10 = $r11, $r12 # encoding: [0x02,0x14,0xb6,0x73]
+	fdivs $r10 = $r11, $r12
+
+# CHECK: fsqrts $r13 = $r14 # encoding: [0x02,0x1a,0xe0,0x74]
+	fsqrts $r13 = $r14
+
+# CHECK: fitos $r15 = $r16 # encoding: [0x02,0x1f,0x00,0x75]
+	fitos $r15 = $r16
+
+# CHECK: futos $r17 = $r18 # encoding: [0x02,0x23,0x20,0x76]
+	futos $r17 = $r18
+
+# CHECK: fstoi $r19 = $r20 # encoding: [0x02,0x27,0x40,0x77]
+	fstoi $r19 = $r20
+
+# CHECK: fstou $r21 = $r22 # encoding: [0x02,0x2b,0x60,0x78]
+	fstou $r21 = $r22
+
+# CHECK: fcmpeq $p1 = $r1, $r2 # encoding: [0x02,0x02,0x11,0x79]
+	fcmpeq $p1 = $r1, $r2
+
+# CHECK: fcmplt $p2 = $r3, $r4 # encoding: [0x02,0x04,0x32,0x7a]
+	fcmplt $p2 = $r3, $r4
+
+# CHECK: fcmple $p3 = $r5, $r6 # encoding: [0x02,0x06,0x53,0x7b]
+	fcmple $p3 = $r5, $r6
+
+# CHECK: fcmpun $p7 = $r7, $r8 # encoding: [0x02,0x0e,0x74,0x7c]
+	fcmpun $p7 = $r7, $r8
+
+# CHECK: ( $p3) fadds $r1 = $r2, $r3 # encoding: [0x1a,0x02,0x21,0xf0]
+	($p3) fadds $r1 = $r2, $r3
+
+# CHECK: (!$p1) fcmplt $p2 = $r4, $r5 # encoding: [0x4a,0x04,0x42,0xfa]
+	(!$p1) fcmplt $p2 = $r4, $r5
+
@@ -0,0 +1,43 @@
+; RUN: %test_no_runtime_execution
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that ALUi instructions with expressions as immediates are relaxed to their
+; ALUl variant by the assembler only if the value of the expression does not fit into
+; the short immediate.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+define i32 @main() {
+entry:
+  ; The difference fits into the 12 bit immediate, i.e., 'li' is not relaxed.
+  %0 = call i32 asm "
+    li      $0  = .Lshort_end - .Lshort_start
+.Lshort_start:
+    nop
+    nop
+    nop
+.Lshort_end:
+    ", "=r"
+    ()
+  
+  ; The difference does not fit into the 12 bit immediate, i.e., 'li' must be relaxed.
+  %1 = call i32 asm "
+    li      $0  = .Llong_end - .Llong_start
+.Llong_start:
+    .fill   1100, 4, 0x00400000
+.Llong_end:
+    ", "=r"
+    ()
+  
+  ; Check correctness
+  %correct_0 = icmp eq i32 %0, 12
+  %correct_1 = icmp eq i32 %1, 4400
+  %correct = and i1 %correct_0, %correct_1
+  
+  ; Negate result to ensure 0 is returned on success
+  %result_0 = xor i1 %correct, 1 
+  
+  %result = zext i1 %result_0 to i32
+  ret i32 %result
+}
@@ -0,0 +1,80 @@
+; RUN: llc < %s -mattr=+fpu | FileCheck %s
+; RUN: llc < %s | FileCheck %s --check-prefix=SOFT
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that single precision float operations use the FPU instructions when the `fpu` subtarget
+; feature is enabled, and library calls otherwise.
+;
+; Floats are kept in general purpose registers and passed like integers.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-LABEL: arith:
+; CHECK-DAG: fmuls [[M:\$r[0-9]+]] = $r3, $r4
+; CHECK-DAG: fdivs [[D:\$r[0-9]+]] = [[M]], $r5
+; CHECK-DAG: fsubs $r1 = [[D]], $r3
+; SOFT-LABEL: arith:
+; SOFT: call{{(nd)?}} __mulsf3
+; SOFT: call{{(nd)?}} __divsf3
+; SOFT: call{{(nd)?}} __subsf3
+define float @arith(float %a, float %b, float %c) {
+entry:
+  %m = fmul float %a, %b
+  %d = fdiv float %m, %c
+  %s = fsub float %d, %a
+  ret float %s
+}
+
+; CHECK-LABEL: immediate:
+; CHECK-DAG: li [[I:\$r[0-9]+]] = 1069547520
+; CHECK-DAG: fadds $r1 = $r3, [[I]]
+define float @immediate(float %a) {
+entry:
+  %r = fadd float %a, 1.5
+  ret float %r
+}
+
+; CHECK-LABEL: convert:
+; CHECK-DAG: fitos [[F:\$r[0-9]+]] = $r3
+; CHECK-DAG: fstoi $r1 = [[F]]
+; SOFT-LABEL: convert:
+; SOFT: call{{(nd)?}} __floatsisf
+; SOFT: call{{(nd)?}} __fixsfsi
+define i32 @convert(i32 %a) {
+entry:
+  %f = sitofp i32 %a to float
+  %i = fptosi float %f to i32
+  ret i32 %i
+}
+
+; CHECK-LABEL: compare:
+; CHECK: fcmplt [[P:\$p[0-9]+]] = $r4, $r3
+; CHECK: ( [[P]]) mov
+define float @compare(float %a, float %b) {
+entry:
+  %c = fcmp ogt float %a, %b
+  %r = select i1 %c, float %a, float %b
+  ret float %r
+}
+
+; Unordered compares negate the ordered compare
+; CHECK-LABEL: compare_unordered:
+; CHECK: fcmple [[P:\$p[0-9]+]] = $r3, $r4
+; CHECK: pnot {{\$p[0-9]+}} = [[P]]
+define i32 @compare_unordered(float %a, float %b) {
+entry:
+  %c = fcmp ugt float %a, %b
+  %r = zext i1 %c to i32
+  ret i32 %r
+}
+
+; Sign manipulation does not need the FPU
+; CHECK-LABEL: negate:
+; CHECK: xor $r1 = $r3, -2147483648
+; CHECK-NOT: call
+define float @negate(float %a) {
+entry:
+  %r = fsub float -0.0, %a
+  ret float %r
+}
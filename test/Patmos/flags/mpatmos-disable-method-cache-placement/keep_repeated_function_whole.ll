@@ -0,0 +1,116 @@
+; RUN: llc < %s | FileCheck %s
+; RUN: llc < %s -mpatmos-method-cache-size=512 | FileCheck %s --check-prefix=SPLIT
+; RUN: llc < %s -mpatmos-disable-method-cache-placement | FileCheck %s --check-prefix=SPLIT
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that a function that is called repeatedly and whose call footprint fits into the method
+; cache is kept in a single subfunction, even though it is larger than the preferred subfunction
+; size. The function is split when it is not persistent in the method cache, or when the
+; placement is disabled.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK: .fstart f,
+; CHECK-NOT: .fstart .LBB0_
+; CHECK: .fstart main,
+; SPLIT: .fstart f,
+; SPLIT: .fstart .LBB0_
+; SPLIT: .fstart main,
+define i32 @f(i32 %n, i32* %p) {
+entry:
+  %c = icmp slt i32 %n, 0
+  br i1 %c, label %a, label %b
+a:
+  %a0 = load volatile i32* %p
+  %x0 = mul i32 %a0, %n
+  store volatile i32 %x0, i32* %p
+  %a1 = load volatile i32* %p
+  %x1 = mul i32 %a1, %n
+  store volatile i32 %x1, i32* %p
+  %a2 = load volatile i32* %p
+  %x2 = mul i32 %a2, %n
+  store volatile i32 %x2, i32* %p
+  %a3 = load volatile i32* %p
+  %x3 = mul i32 %a3, %n
+  store volatile i32 %x3, i32* %p
+  %a4 = load volatile i32* %p
+  %x4 = mul i32 %a4, %n
+  store volatile i32 %x4, i32* %p
+  %a5 = load volatile i32* %p
+  %x5 = mul i32 %a5, %n
+  store volatile i32 %x5, i32* %p
+  %a6 = load volatile i32* %p
+  %x6 = mul i32 %a6, %n
+  store volatile i32 %x6, i32* %p
+  %a7 = load volatile i32* %p
+  %x7 = mul i32 %a7, %n
+  store volatile i32 %x7, i32* %p
+  %a8 = load volatile i32* %p
+  %x8 = mul i32 %a8, %n
+  store volatile i32 %x8, i32* %p
+  %a9 = load volatile i32* %p
+  %x9 = mul i32 %a9, %n
+  store volatile i32 %x9, i32* %p
+  %a10 = load volatile i32* %p
+  %x10 = mul i32 %a10, %n
+  store volatile i32 %x10, i32* %p
+  %a11 = load volatile i32* %p
+  %x11 = mul i32 %a11, %n
+  store volatile i32 %x11, i32* %p
+  br label %e
+b:
+  %b0 = load volatile i32* %p
+  %y0 = sub i32 %b0, %n
+  store volatile i32 %y0, i32* %p
+  %b1 = load volatile i32* %p
+  %y1 = sub i32 %b1, %n
+  store volatile i32 %y1, i32* %p
+  %b2 = load volatile i32* %p
+  %y2 = sub i32 %b2, %n
+  store volatile i32 %y2, i32* %p
+  %b3 = load volatile i32* %p
+  %y3 = sub i32 %b3, %n
+  store volatile i32 %y3, i32* %p
+  %b4 = load volatile i32* %p
+  %y4 = sub i32 %b4, %n
+  store volatile i32 %y4, i32* %p
+  %b5 = load volatile i32* %p
+  %y5 = sub i32 %b5, %n
+  store volatile i32 %y5, i32* %p
+  %b6 = load volatile i32* %p
+  %y6 = sub i32 %b6, %n
+  store volatile i32 %y6, i32* %p
+  %b7 = load volatile i32* %p
+  %y7 = sub i32 %b7, %n
+  store volatile i32 %y7, i32* %p
+  %b8 = load volatile i32* %p
+  %y8 = sub i32 %b8, %n
+  store volatile i32 %y8, i32* %p
+  %b9 = load volatile i32* %p
+  %y9 = sub i32 %b9, %n
+  store volatile i32 %y9, i32* %p
+  %b10 = load volatile i32* %p
+  %y10 = sub i32 %b10, %n
+  store volatile i32 %y10, i32* %p
+  %b11 = load volatile i32* %p
+  %y11 = sub i32 %b11, %n
+  store volatile i32 %y11, i32* %p
+  br label %e
+e:
+  %r = load volatile i32* %p
+  ret i32 %r
+}
+
+define i32 @main(i32* %p) {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i1, %loop ]
+  %v = call i32 @f(i32 %i, i32* %p)
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, 10
+  br i1 %c, label %loop, label %exit
+exit:
+  ret i32 %v
+}
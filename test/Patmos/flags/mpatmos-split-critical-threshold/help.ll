@@ -0,0 +1,11 @@
+; RUN: CHECK_STDOUT=true; llc -help %XFAIL-filecheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests there is an entry in the help flag for `mpatmos-split-critical-threshold` and
+; `mpatmos-split-cold-threshold`.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK: -mpatmos-split-cold-threshold=<number>    - Blocks with a lower criticality are not added to critical regions, but split into own subfunctions. (default: 0.1)
+; CHECK: -mpatmos-split-critical-threshold=<number> - Minimum criticality of blocks that are kept in the region of critical predecessors up to mpatmos-max-subfunction-size. (default: 0.9)
@@ -0,0 +1,47 @@
+; RUN: llc < %s -mpatmos-preferred-subfunction-size=32 -mimport-pml=%S/split_cold_blocks.pml | FileCheck %s
+; RUN: llc < %s -mpatmos-preferred-subfunction-size=32 | FileCheck %s --check-prefix=NOPML
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the function splitter uses the WCET criticalities from PML: the critical blocks
+; 'entry' and 'hot' are kept in one subfunction even though it exceeds the preferred size, while
+; the cold block gets a subfunction of its own.
+;
+; Without PML, the preferred subfunction size is used to split all blocks.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK: .fstart main
+; CHECK: # %entry
+; CHECK-NOT: .fstart
+; CHECK: # %hot
+; CHECK: .fstart
+; CHECK-NEXT: # %cold
+
+; NOPML: .fstart main
+; NOPML: # %entry
+; NOPML: .fstart
+; NOPML-NEXT: # %hot
+define i32 @main(i32 %n, i32* %p) {
+entry:
+  %c = icmp slt i32 %n, 0
+  br i1 %c, label %cold, label %hot
+
+cold:
+  %a0 = load volatile i32* %p
+  %a1 = sub i32 %a0, %n
+  store volatile i32 %a1, i32* %p
+  %a2 = load volatile i32* %p
+  %a3 = xor i32 %a2, %a1
+  store volatile i32 %a3, i32* %p
+  ret i32 %a3
+
+hot:
+  %b0 = load volatile i32* %p
+  %b1 = mul i32 %b0, %n
+  store volatile i32 %b1, i32* %p
+  %b2 = load volatile i32* %p
+  %b3 = mul i32 %b2, %b1
+  store volatile i32 %b3, i32* %p
+  ret i32 %b3
+}
@@ -0,0 +1,9 @@
+; RUN: CHECK_STDOUT=true; llc -help %XFAIL-filecheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests there is an entry in the help flag for `mpatmos-stack-cache-locals-budget`.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK: -mpatmos-stack-cache-locals-budget=<uint>
@@ -0,0 +1,43 @@
+; RUN: llc < %s | FileCheck %s
+; RUN: llc < %s -mpatmos-stack-cache-locals-budget=0 | FileCheck %s --check-prefix=DISABLED
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that local arrays that are only accessed at constant offsets are placed on the stack
+; cache, while arrays whose address escapes stay on the shadow stack.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+declare void @use(i32*)
+
+; CHECK-LABEL: local:
+; DISABLED-LABEL: local:
+define i32 @local(i32 %x)  {
+entry:
+  %buf = alloca [4 x i32], align 4
+  %p0 = getelementptr inbounds [4 x i32]* %buf, i32 0, i32 0
+  %p2 = getelementptr inbounds [4 x i32]* %buf, i32 0, i32 2
+; CHECK: sws [{{[0-9]+}}] = $r3
+; DISABLED: swc [$r{{[0-9]+}} + {{[0-9]+}}] = $r3
+  store volatile i32 %x, i32* %p0
+  store volatile i32 %x, i32* %p2
+; CHECK: lws $r{{[0-9]+}} = [{{[0-9]+}}]
+; DISABLED: lwc $r{{[0-9]+}} = [$r{{[0-9]+}} + {{[0-9]+}}]
+  %a = load volatile i32* %p0
+  %b = load volatile i32* %p2
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+; CHECK-LABEL: escaping:
+define i32 @escaping(i32 %x)  {
+entry:
+  %buf = alloca [4 x i32], align 4
+  %p0 = getelementptr inbounds [4 x i32]* %buf, i32 0, i32 0
+; CHECK: swc [$r{{[0-9]+}}] = $r3
+  store volatile i32 %x, i32* %p0
+  call void @use(i32* %p0)
+; CHECK: lwc $r{{[0-9]+}} = [$r{{[0-9]+}}]
+  %a = load volatile i32* %p0
+  ret i32 %a
+}
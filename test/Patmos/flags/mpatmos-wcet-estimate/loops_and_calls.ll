@@ -0,0 +1,72 @@
+; RUN: llc < %s -mpatmos-wcet-estimate -o /dev/null 2>&1 | FileCheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the WCET estimate of a function takes the loop bounds and the estimates of its
+; callees into account, and that functions with unbounded loops, or calling such functions,
+; have no estimate.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK: WCET estimate of leaf: [[LEAF:[0-9]+]] cycles
+; CHECK: WCET estimate of loop: {{[0-9]+}} cycles
+; CHECK: (for.body): 10 x {{[0-9]+}} cycles, calls leaf ([[LEAF]] cycles)
+; CHECK: (for.cond): 11 x {{[0-9]+}} cycles
+; CHECK: WCET estimate of unbounded: unknown (loop without bound in BB#{{[0-9]+}})
+; CHECK: WCET estimate of main: unknown (call to unbounded without estimate in BB#0)
+
+@g = global i32 0
+
+define i32 @leaf(i32 %x) {
+entry:
+  %0 = load volatile i32* @g
+  %add = add nsw i32 %x, %0
+  ret i32 %add
+}
+
+define i32 @loop() {
+entry:
+  br label %for.cond
+
+for.cond:
+  %x.0 = phi i32 [ 0, %entry ], [ %call, %for.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i.0, %x.0
+  br i1 %cmp, label %for.body, label %for.end, !llvm.loop !0
+
+for.body:
+  %call = call i32 @leaf(i32 %x.0)
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond
+
+for.end:
+  ret i32 %x.0
+}
+
+define i32 @unbounded(i32 %n) {
+entry:
+  br label %for.cond
+
+for.cond:
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i.0, %n
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  store volatile i32 %i.0, i32* @g
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond
+
+for.end:
+  ret i32 %i.0
+}
+
+define i32 @main(i32 %n) {
+entry:
+  %a = call i32 @loop()
+  %b = call i32 @unbounded(i32 %a)
+  ret i32 %b
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 10}
@@ -0,0 +1,10 @@
+; RUN: CHECK_STDOUT=true; llc -help %XFAIL-filecheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests there is an entry in the help flag for `mserialize-cache` and `mserialize-stream`.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK: -mserialize-cache=<DIR>
+; CHECK: -mserialize-stream
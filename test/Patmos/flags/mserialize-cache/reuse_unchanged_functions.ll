@@ -0,0 +1,30 @@
+; RUN: rm -rf %t.cache
+; RUN: llc %s -mserialize-all -mserialize=%t.first -mserialize-cache=%t.cache -o %t.s
+; RUN: llc %s -mserialize-all -mserialize=%t.second -mserialize-cache=%t.cache -o %t.s
+; RUN: llc %s -mserialize-all -mserialize=%t.stream -mserialize-stream -o %t.s
+; RUN: diff %t.first %t.second
+; RUN: diff %t.first %t.stream
+; RUN: ls %t.cache | count 2
+; RUN: FileCheck %s < %t.second
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the export of every function is stored in the cache directory, and that reusing the
+; cached exports results in the same PML as serializing all functions again.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-DAG: mapsto: {{ *}}callee
+; CHECK-DAG: mapsto: {{ *}}main
+
+define i32 @callee(i32 %x) {
+entry:
+  %r = mul i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @main(i32 %x) {
+entry:
+  %r = call i32 @callee(i32 %x)
+  ret i32 %r
+}
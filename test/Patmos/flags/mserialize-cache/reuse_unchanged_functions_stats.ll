@@ -0,0 +1,25 @@
+; RUN: rm -rf %t.cache
+; RUN: llc %s -mserialize-all -mserialize=%t.first -mserialize-cache=%t.cache -o %t.s
+; RUN: llc %s -mserialize-all -mserialize=%t.second -mserialize-cache=%t.cache -o %t.s -stats 2>&1 | FileCheck %s
+; REQUIRES: asserts
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the second run actually reuses the cached exports of both functions instead of
+; serializing them again (see reuse_unchanged_functions.ll for the resulting PML).
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK: 2 pml-export - Number of functions whose export was reused from the PML cache
+
+define i32 @callee(i32 %x) {
+entry:
+  %r = mul i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @main(i32 %x) {
+entry:
+  %r = call i32 @callee(i32 %x)
+  ret i32 %r
+}
@@ -155,7 +155,7 @@ machine-functions:
             opcode:          CMPLT
             size:            4
           - index:           1
-            opcode:          ADDi
+            opcode:          SUBi
             size:            4
           - index:           2
             opcode:          BRu
@@ -164,7 +164,7 @@ machine-functions:
             branch-delay-slots: 2
             branch-targets:  [ 8 ]
           - index:           3
-            opcode:          SUBi
+            opcode:          ADDi
             size:            4
           - index:           4
             opcode:          SUBi
@@ -272,7 +272,7 @@ machine-functions:
             opcode:          CMPLT
             size:            4
           - index:           4
-            opcode:          ADDi
+            opcode:          SUBi
             size:            4
           - index:           5
             opcode:          BRu
@@ -281,7 +281,7 @@ machine-functions:
             branch-delay-slots: 2
             branch-targets:  [ 8 ]
           - index:           6
-            opcode:          SUBi
+            opcode:          ADDi
             size:            4
           - index:           7
             opcode:          SUBi
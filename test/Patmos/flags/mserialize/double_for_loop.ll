@@ -20,18 +20,19 @@ machine-functions:
         successors:      [ 1, 4 ]
         instructions:    
           - index:           0
-            opcode:          SUBi
+            opcode:          SRESi
             size:            4
+            stack-cache-argument: 8
           - index:           1
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           2
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           3
             opcode:          MFS
             size:            4
@@ -60,10 +61,10 @@ machine-functions:
             opcode:          NOP
             size:            4
           - index:           11
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
       - name:            1
         mapsto:          if.then
         predecessors:    [ 0 ]
@@ -76,10 +77,10 @@ machine-functions:
             branch-delay-slots: 2
             branch-targets:  [ 3 ]
           - index:           1
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          LIl
             size:            8
@@ -90,10 +91,10 @@ machine-functions:
         loops:           [ 3 ]
         instructions:    
           - index:           0
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           1
             opcode:          LWC
             size:            4
@@ -106,10 +107,10 @@ machine-functions:
             opcode:          ADDr
             size:            4
           - index:           4
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           5
             opcode:          NOP
             size:            4
@@ -117,15 +118,15 @@ machine-functions:
             opcode:          ADDr
             size:            4
           - index:           7
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           8
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           9
             opcode:          NOP
             size:            4
@@ -133,10 +134,10 @@ machine-functions:
             opcode:          ADDi
             size:            4
           - index:           11
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
       - name:            3
         mapsto:          for.cond
         predecessors:    [ 1, 2 ]
@@ -144,15 +145,15 @@ machine-functions:
         loops:           [ 3 ]
         instructions:    
           - index:           0
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           1
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          NOP
             size:            4
@@ -181,10 +182,10 @@ machine-functions:
             branch-delay-slots: 3
             branch-targets:  [ 5 ]
           - index:           1
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          LIl
             size:            8
@@ -198,15 +199,15 @@ machine-functions:
         loops:           [ 5 ]
         instructions:    
           - index:           0
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           1
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          SLi
             size:            4
@@ -230,10 +231,10 @@ machine-functions:
         loops:           [ 5 ]
         instructions:    
           - index:           0
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           1
             opcode:          LWC
             size:            4
@@ -246,10 +247,10 @@ machine-functions:
             opcode:          ADDr
             size:            4
           - index:           4
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           5
             opcode:          NOP
             size:            4
@@ -257,15 +258,15 @@ machine-functions:
             opcode:          ADDr
             size:            4
           - index:           7
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           8
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           9
             opcode:          NOP
             size:            4
@@ -279,10 +280,10 @@ machine-functions:
             opcode:          ADDi
             size:            4
           - index:           12
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
       - name:            7
         mapsto:          if.end
         predecessors:    [ 5, 3 ]
@@ -294,16 +295,17 @@ machine-functions:
             branch-type:     return
             branch-delay-slots: 3
           - index:           1
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          MTS
             size:            4
           - index:           3
-            opcode:          ADDi
+            opcode:          SFREEi
             size:            4
+            stack-cache-argument: 8
     subfunctions:    
       - name:            0
         blocks:          [ 0, 1, 2, 3, 4 ]
@@ -20,83 +20,81 @@ machine-functions:
         successors:      [ 1 ]
         instructions:    
           - index:           0
-            opcode:          SUBi
+            opcode:          SRESi
             size:            4
+            stack-cache-argument: 8
           - index:           1
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           2
-            opcode:          LWC
+            opcode:          SWS
             size:            4
-            memmode:         load
-            memtype:         cache
+            memmode:         store
+            memtype:         stack
           - index:           3
-            opcode:          NOP
+            opcode:          LWS
             size:            4
+            memmode:         load
+            memtype:         stack
           - index:           4
-            opcode:          SRi
+            opcode:          SWS
             size:            4
+            memmode:         store
+            memtype:         stack
           - index:           5
-            opcode:          ADDr
+            opcode:          SRi
             size:            4
           - index:           6
-            opcode:          SRAi
+            opcode:          ADDr
             size:            4
           - index:           7
-            opcode:          SWC
+            opcode:          SRAi
             size:            4
-            memmode:         store
-            memtype:         cache
           - index:           8
-            opcode:          LWC
+            opcode:          SWS
             size:            4
-            memmode:         load
-            memtype:         cache
+            memmode:         store
+            memtype:         stack
           - index:           9
+            opcode:          LWS
+            size:            4
+            memmode:         load
+            memtype:         stack
+          - index:           10
             opcode:          LIl
             size:            8
-          - index:           10
-            opcode:          MUL
-            size:            4
           - index:           11
-            opcode:          MFS
+            opcode:          MUL
             size:            4
           - index:           12
             opcode:          MFS
             size:            4
           - index:           13
-            opcode:          SRi
+            opcode:          MFS
             size:            4
           - index:           14
-            opcode:          SRAi
+            opcode:          SRi
             size:            4
           - index:           15
-            opcode:          ADDr
+            opcode:          SRAi
             size:            4
           - index:           16
-            opcode:          SWC
+            opcode:          ADDr
             size:            4
-            memmode:         store
-            memtype:         cache
           - index:           17
-            opcode:          SWC
-            size:            4
-            memmode:         store
-            memtype:         cache
-          - index:           18
             opcode:          BRu
             size:            4
             branch-type:     unconditional
             branch-delay-slots: 2
             branch-targets:  [ 1 ]
-          - index:           19
-            opcode:          SWC
+          - index:           18
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
-          - index:           20
+            memtype:         stack
+          - index:           19
             opcode:          LIl
             size:            8
       - name:            2
@@ -111,10 +109,10 @@ machine-functions:
             memmode:         load
             memtype:         cache
           - index:           1
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          NOP
             size:            4
@@ -122,15 +120,15 @@ machine-functions:
             opcode:          ADDr
             size:            4
           - index:           4
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           5
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           6
             opcode:          NOP
             size:            4
@@ -138,10 +136,10 @@ machine-functions:
             opcode:          ADDi
             size:            4
           - index:           8
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
       - name:            1
         mapsto:          for.cond
         predecessors:    [ 0, 2 ]
@@ -149,15 +147,15 @@ machine-functions:
         loops:           [ 1 ]
         instructions:    
           - index:           0
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           1
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          NOP
             size:            4
@@ -181,10 +179,10 @@ machine-functions:
             branch-delay-slots: 2
             branch-targets:  [ 4 ]
           - index:           1
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          LIl
             size:            8
@@ -200,10 +198,10 @@ machine-functions:
             memmode:         load
             memtype:         cache
           - index:           1
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          NOP
             size:            4
@@ -211,15 +209,15 @@ machine-functions:
             opcode:          ADDr
             size:            4
           - index:           4
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
           - index:           5
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           6
             opcode:          NOP
             size:            4
@@ -227,10 +225,10 @@ machine-functions:
             opcode:          ADDi
             size:            4
           - index:           8
-            opcode:          SWC
+            opcode:          SWS
             size:            4
             memmode:         store
-            memtype:         cache
+            memtype:         stack
       - name:            4
         mapsto:          for.cond2
         predecessors:    [ 3, 5 ]
@@ -238,15 +236,15 @@ machine-functions:
         loops:           [ 4 ]
         instructions:    
           - index:           0
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           1
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          NOP
             size:            4
@@ -269,16 +267,17 @@ machine-functions:
             branch-type:     return
             branch-delay-slots: 3
           - index:           1
-            opcode:          LWC
+            opcode:          LWS
             size:            4
             memmode:         load
-            memtype:         cache
+            memtype:         stack
           - index:           2
             opcode:          MTS
             size:            4
           - index:           3
-            opcode:          ADDi
+            opcode:          SFREEi
             size:            4
+            stack-cache-argument: 8
     subfunctions:    
       - name:            0
         blocks:          [ 0, 2, 1, 3, 5, 4, 6 ]
@@ -0,0 +1,65 @@
+; RUN: llc < %s -O2 -mpatmos-disable-vliw=false -mpatmos-sched-bundle-packing | FileCheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that bundle packing in the post-RA scheduler pairs independent ALU instructions
+; of the unrolled loop body. Memory accesses need the first issue slot, so a store can
+; only be paired with an ALU instruction.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-LABEL: kern:
+; CHECK: {{^\{}}{{.*}}sl [[R1:\$r[0-9]+]] = [[R1]], 3
+; CHECK-NEXT: xor {{.*}} }
+; CHECK-NEXT: {{^\{}}{{.*}}add
+; CHECK-NEXT: sl [[R2:\$r[0-9]+]] = [[R2]], 3 }
+; CHECK: {{^\{}}{{.*}}swc
+; CHECK-NEXT: cmplt {{.*}} }
+; CHECK: retnd
+define void @kern(i32* %a, i32* %b, i32* %c, i32 %n) {
+entry:
+  br label %loop
+loop:
+  %i = phi i32 [0, %entry], [%i4, %loop]
+  %pa0 = getelementptr i32* %a, i32 %i
+  %pb0 = getelementptr i32* %b, i32 %i
+  %pc0 = getelementptr i32* %c, i32 %i
+  %a0 = load i32* %pa0
+  %b0 = load i32* %pb0
+  %i1 = add i32 %i, 1
+  %pa1 = getelementptr i32* %a, i32 %i1
+  %pb1 = getelementptr i32* %b, i32 %i1
+  %pc1 = getelementptr i32* %c, i32 %i1
+  %a1 = load i32* %pa1
+  %b1 = load i32* %pb1
+  %i2 = add i32 %i, 2
+  %pa2 = getelementptr i32* %a, i32 %i2
+  %pb2 = getelementptr i32* %b, i32 %i2
+  %pc2 = getelementptr i32* %c, i32 %i2
+  %a2 = load i32* %pa2
+  %b2 = load i32* %pb2
+  %x0 = xor i32 %a0, %b0
+  %y0 = shl i32 %x0, 3
+  %z0 = add i32 %y0, %a0
+  %w0 = sub i32 %z0, %b0
+  %x1 = xor i32 %a1, %b1
+  %y1 = shl i32 %x1, 3
+  %z1 = add i32 %y1, %a1
+  %w1 = sub i32 %z1, %b1
+  %x2 = xor i32 %a2, %b2
+  %y2 = shl i32 %x2, 3
+  %z2 = add i32 %y2, %a2
+  %w2 = sub i32 %z2, %b2
+  %s0 = or i32 %w0, %w1
+  %s1 = and i32 %s0, %w2
+  %s2 = ashr i32 %s1, 2
+  %s3 = add i32 %s2, %w0
+  store i32 %s3, i32* %pc0
+  store i32 %w1, i32* %pc1
+  store i32 %w2, i32* %pc2
+  %i4 = add i32 %i, 3
+  %c0 = icmp slt i32 %i4, %n
+  br i1 %c0, label %loop, label %exit
+exit:
+  ret void
+}
@@ -0,0 +1,77 @@
+; RUN: llc < %s -mpatmos-enable-bypass-selection | FileCheck %s
+; RUN: llc < %s | FileCheck %s --check-prefix=NOBYPASS
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that loads from an array that does not fit into the data cache bypass the cache,
+; while loads from a small array that is reused in the loop remain cached.
+;
+; The table read by get is reused as well, since get is called in a loop. The frequency of get
+; must account for the loop around its call site.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-LABEL: main:
+; CHECK-DAG: lwm {{\$r[0-9]+}} = [{{\$r[0-9]+}}]
+; CHECK-DAG: lwc {{\$r[0-9]+}} = [{{\$r[0-9]+}}]
+; CHECK: ret
+
+; NOBYPASS-LABEL: main:
+; NOBYPASS-NOT: lwm
+; NOBYPASS: ret
+
+; CHECK-LABEL: get:
+; CHECK-NOT: lwm
+; CHECK: lwc {{\$r[0-9]+}} = [{{\$r[0-9]+}}]
+; CHECK-NOT: lwm
+; CHECK: .size get
+@big = global [1024 x i32] zeroinitializer, align 4
+@small = global [8 x i32] zeroinitializer, align 4
+@table = global [16 x i32] zeroinitializer, align 4
+
+define i32 @main() {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %sum = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %idx = and i32 %i, 7
+  %pb = getelementptr inbounds [1024 x i32]* @big, i32 0, i32 %i
+  %b = load volatile i32* %pb, align 4
+  %ps = getelementptr inbounds [8 x i32]* @small, i32 0, i32 %idx
+  %s = load volatile i32* %ps, align 4
+  %mul = mul i32 %b, %s
+  %add = add i32 %sum, %mul
+  %inc = add i32 %i, 1
+  %cmp = icmp slt i32 %inc, 1024
+  br i1 %cmp, label %for.body, label %for.end, !llvm.loop !0
+
+for.end:
+  br label %call.body
+
+call.body:
+  %j = phi i32 [ 0, %for.end ], [ %inc2, %call.body ]
+  %sum2 = phi i32 [ %add, %for.end ], [ %add2, %call.body ]
+  %t = call i32 @get(i32 %j)
+  %add2 = add i32 %sum2, %t
+  %inc2 = add i32 %j, 1
+  %cmp2 = icmp slt i32 %inc2, 4000
+  br i1 %cmp2, label %call.body, label %call.end, !llvm.loop !2
+
+call.end:
+  ret i32 %add2
+}
+
+define i32 @get(i32 %i) noinline {
+entry:
+  %idx = and i32 %i, 15
+  %p = getelementptr inbounds [16 x i32]* @table, i32 0, i32 %idx
+  %v = load volatile i32* %p, align 4
+  ret i32 %v
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 1023}
+!2 = metadata !{metadata !2, metadata !3}
+!3 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 3999}
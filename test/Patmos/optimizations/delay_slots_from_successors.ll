@@ -0,0 +1,50 @@
+; RUN: llc < %s -O2 -mpatmos-disable-post-ra-patmos | FileCheck %s
+; RUN: llc < %s -O2 -mpatmos-disable-post-ra-patmos -mpatmos-disable-delay-filler-successors | FileCheck %s --check-prefix=LOCAL
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the delay slot filler takes instructions from the successors of a branch
+; when there are not enough instructions in the branch's own block.
+;
+; The loop exit has no other predecessor, so its first instruction can be moved into
+; the delay slot of the loop's back-edge, guarded by the negated branch condition.
+; Without successor fillers, the slot is filled with a NOP instead.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-LABEL: main:
+; CHECK: cmplt [[P:\$p[0-9]]] =
+; CHECK-NEXT: ( [[P]]) br .LBB0_1
+; CHECK-NEXT: add [[ACC:\$r[0-9]+]] = [[ACC]], {{\$r[0-9]+}}
+; CHECK-NEXT: (![[P]]) xor [[ACC]] = [[ACC]], 2
+; CHECK-NOT: nop
+; CHECK: ret
+
+; LOCAL-LABEL: main:
+; LOCAL: ( {{\$p[0-9]}}) br .LBB0_1
+; LOCAL-NEXT: nop
+; LOCAL-NEXT: add
+; LOCAL: xor
+define i32 @main(i32 %n, i32* %p) {
+entry:
+  br label %body
+
+body:
+  %i = phi i32 [0, %entry], [%i1, %body]
+  %acc = phi i32 [0, %entry], [%acc1, %body]
+  %q = getelementptr i32* %p, i32 %i
+  %v = load i32* %q
+  %acc1 = add i32 %acc, %v
+  %i1 = add i32 %i, 1
+  %c = icmp slt i32 %i1, %n
+  br i1 %c, label %body, label %exit
+
+exit:
+  %a1 = xor i32 %acc1, 11
+  %a2 = or i32 %a1, 12
+  %a3 = and i32 %a2, 1234
+  %a4 = sub i32 %a3, %n
+  %a5 = shl i32 %a4, 3
+  %a6 = add i32 %a5, %i1
+  ret i32 %a6
+}
@@ -0,0 +1,56 @@
+; RUN: llc < %s -O2 -mpatmos-disable-vliw=false | FileCheck %s
+; RUN: llc < %s -O2 -mpatmos-disable-vliw=false -debug-only=post-RA-sched 2>&1 | FileCheck %s --check-prefix=DAG
+; REQUIRES: asserts
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the post-RA scheduler keeps the dependency between two instructions with opposite
+; guards on the same predicate register if the predicate is redefined between them.
+;
+; After if-conversion, the load is guarded by !$p1 and the subtraction using its result by $p1,
+; but $p1 is redefined by the second compare in between. Both instructions can thus be
+; enabled, and the subtraction must not be placed in the delay slot of the load.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-LABEL: f:
+; CHECK: (!$p1) lwl [[R:\$r[0-9]+]] =
+; CHECK-NEXT: cmpneq $p1 =
+; CHECK-NEXT: ( $p1) sub {{\$r[0-9]+}} = [[R]],
+
+; DAG: SU([[LD:[0-9]+]]): %R4<def> = LWL pred:%P1, pred:-1
+; DAG: SU({{[0-9]+}}): {{.*}} = SUBr pred:%P1, pred:0, %R4
+; DAG: Predecessors:
+; DAG: val SU([[LD]]): Latency=2 Reg=%R4
+define void @f(i32 addrspace(1)* %p, i32 %a, i32 %b, i32 %c, i32 %d) {
+entry:
+  %c1 = icmp slt i32 %a, %b
+  br i1 %c1, label %join, label %load
+
+load:
+  %pa = getelementptr i32 addrspace(1)* %p, i32 %d
+  %v = load i32 addrspace(1)* %pa
+  br label %join
+
+join:
+  %x = phi i32 [ %v, %load ], [ %a, %entry ]
+  %c2 = icmp eq i32 %c, %d
+  br i1 %c2, label %use, label %other
+
+use:
+  %y = add i32 %b, 3
+  %q = getelementptr i32 addrspace(1)* %p, i32 1
+  store volatile i32 %y, i32 addrspace(1)* %q
+  br label %end
+
+other:
+  %z = sub i32 %x, %c
+  %q1 = getelementptr i32 addrspace(1)* %p, i32 3
+  store volatile i32 %z, i32 addrspace(1)* %q1
+  br label %end
+
+end:
+  %q2 = getelementptr i32 addrspace(1)* %p, i32 2
+  store volatile i32 %b, i32 addrspace(1)* %q2
+  ret void
+}
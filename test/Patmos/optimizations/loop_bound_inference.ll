@@ -0,0 +1,140 @@
+; RUN: llc < %s -O2 | FileCheck %s
+; RUN: llc < %s -O2 -mpatmos-disable-loop-bound-inference | FileCheck %s --check-prefix=NOINF
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that loop bounds are inferred from scalar evolution.
+;
+; The bound of a constant trip count is exact, an annotated bound that is larger than the
+; trip count is tightened. Symbolic trip counts are bounded by the range metadata of the
+; loaded trip count, or by the condition guarding the loop. Loops whose trip count is only
+; bounded by its type get no bound.
+;
+; CHECK-LABEL: const_loop:
+; CHECK: Loop bound: [10, 10]
+; CHECK-LABEL: tighten:
+; CHECK: Loop bound: [8, 8]
+; CHECK-LABEL: range_loop:
+; CHECK: Loop bound: [0, 12]
+; CHECK-LABEL: guard_loop:
+; CHECK: Loop bound: [0, 19]
+; CHECK-LABEL: unbounded:
+; CHECK-NOT: Loop bound
+; CHECK: .size unbounded
+;
+; NOINF-LABEL: const_loop:
+; NOINF-NOT: Loop bound
+; NOINF-LABEL: tighten:
+; NOINF: Loop bound: [0, 100]
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+@g = global i32 0
+@n = global i32 0
+
+define i32 @const_loop() {
+entry:
+  br label %for.cond
+
+for.cond:
+  %x.0 = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i.0, 10
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %0 = load volatile i32* @g
+  %add = add nsw i32 %x.0, %0
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond
+
+for.end:
+  ret i32 %x.0
+}
+
+define i32 @tighten() {
+entry:
+  br label %for.cond
+
+for.cond:
+  %x.0 = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i.0, 8
+  br i1 %cmp, label %for.body, label %for.end, !llvm.loop !0
+
+for.body:
+  %0 = load volatile i32* @g
+  %add = add nsw i32 %x.0, %0
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond
+
+for.end:
+  ret i32 %x.0
+}
+
+define i32 @range_loop() {
+entry:
+  %n = load i32* @n, !range !2
+  br label %for.cond
+
+for.cond:
+  %x.0 = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp ult i32 %i.0, %n
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %0 = load volatile i32* @g
+  %add = add nsw i32 %x.0, %0
+  %inc = add nuw i32 %i.0, 1
+  br label %for.cond
+
+for.end:
+  ret i32 %x.0
+}
+
+define i32 @guard_loop(i32 %n) {
+entry:
+  %c = icmp ult i32 %n, 20
+  br i1 %c, label %for.cond, label %exit
+
+for.cond:
+  %x.0 = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp ult i32 %i.0, %n
+  br i1 %cmp, label %for.body, label %exit
+
+for.body:
+  %0 = load volatile i32* @g
+  %add = add nsw i32 %x.0, %0
+  %inc = add nuw i32 %i.0, 1
+  br label %for.cond
+
+exit:
+  %r = phi i32 [ 0, %entry ], [ %x.0, %for.cond ]
+  ret i32 %r
+}
+
+define i32 @unbounded(i32 %n) {
+entry:
+  br label %for.cond
+
+for.cond:
+  %x.0 = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i.0, %n
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %0 = load volatile i32* @g
+  %add = add nsw i32 %x.0, %0
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond
+
+for.end:
+  ret i32 %x.0
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 100}
+!2 = metadata !{i32 0, i32 13}
@@ -0,0 +1,66 @@
+; RUN: llc < %s -O2 -mpatmos-singlepath=inferred,annotated -mserialize=%t -mserialize-roots=inferred,annotated -o %t.s
+; RUN: FileCheck %s < %t
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the loop bounds of single-path functions inferred from scalar evolution are not
+; exported as user annotations.
+;
+; The bound of the loop in 'inferred' is derived from its constant trip count, the loop in
+; 'annotated' has a symbolic trip count and keeps the bound annotated by the user.
+;
+; CHECK:      rhs: 10
+; CHECK-NEXT: level: machinecode
+; CHECK-NEXT: origin: llvm.bc
+; CHECK:      rhs: 5
+; CHECK-NEXT: level: machinecode
+; CHECK-NEXT: origin: user.bc
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+@g = global i32 0
+@n = global i32 0
+
+define i32 @inferred() {
+entry:
+  br label %for.cond
+
+for.cond:
+  %x.0 = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i.0, 10
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %0 = load volatile i32* @g
+  %add = add nsw i32 %x.0, %0
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond
+
+for.end:
+  ret i32 %x.0
+}
+
+define i32 @annotated() {
+entry:
+  %n = load volatile i32* @n
+  br label %for.cond
+
+for.cond:
+  %x.0 = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i.0, %n
+  br i1 %cmp, label %for.body, label %for.end, !llvm.loop !0
+
+for.body:
+  %0 = load volatile i32* @g
+  %add = add nsw i32 %x.0, %0
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond
+
+for.end:
+  ret i32 %x.0
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 5}
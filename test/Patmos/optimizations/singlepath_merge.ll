@@ -0,0 +1,68 @@
+; RUN: llc < %s -mpatmos-singlepath=main -O2 | FileCheck %s
+; RUN: llc < %s -mpatmos-singlepath=main -O2 -mpatmos-sp-specialize-callees | FileCheck %s --check-prefix=UNCOND
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that single-path clones that are identical after code generation are merged,
+; and that the predicate is not passed to callees that are always called unconditionally.
+;
+; 'foo' and 'bar' only differ in the names of their values, so their single-path
+; clones are identical and both calls target 'foo_sp_'.
+;
+; CHECK-LABEL: main:
+; CHECK: call{{(nd)?}} foo_sp_
+; CHECK: pmov $p7 =
+; CHECK: call{{(nd)?}} foo_sp_
+; CHECK: pmov $p7 =
+; CHECK-LABEL: foo_sp_:
+; CHECK: pmov $p{{[0-9]}} = $p7
+;
+; Both calls are executed on every path through 'main', so with specialization
+; the callee does not read the predicate of the caller.
+;
+; UNCOND-LABEL: main:
+; UNCOND-NOT: pmov $p7 =
+; UNCOND-LABEL: foo_sp_:
+; UNCOND-NOT: $p7
+; UNCOND: .size foo_sp_
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+@g = global i32 0
+
+define i32 @foo(i32 %x) {
+entry:
+  %cmp = icmp slt i32 %x, 5
+  br i1 %cmp, label %if.then, label %if.end
+
+if.then:
+  %v = load volatile i32* @g
+  %add = add nsw i32 %x, %v
+  br label %if.end
+
+if.end:
+  %r = phi i32 [ %add, %if.then ], [ %x, %entry ]
+  ret i32 %r
+}
+
+define i32 @bar(i32 %y) {
+entry:
+  %cmp = icmp slt i32 %y, 5
+  br i1 %cmp, label %if.then, label %if.end
+
+if.then:
+  %v = load volatile i32* @g
+  %add = add nsw i32 %y, %v
+  br label %if.end
+
+if.end:
+  %r = phi i32 [ %add, %if.then ], [ %y, %entry ]
+  ret i32 %r
+}
+
+define i32 @main(i32 %x) {
+entry:
+  %a = call i32 @foo(i32 %x)
+  %b = call i32 @bar(i32 %a)
+  ret i32 %b
+}
@@ -0,0 +1,48 @@
+; RUN: llc < %s -mpatmos-singlepath=main -O2 | FileCheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that single-path code does not keep redundant stores of the loop counter.
+;
+; The loop counter of the only loop is kept in $r26 for the whole function.
+; Its initialization and decrement must therefore not be followed by a store
+; to the counter's stack slot, since the slot is never loaded.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+@_1 = global i32 1
+
+; CHECK-LABEL: main:
+define i32 @main(i32 %iteration_count)  {
+entry:
+  br label %for.cond
+
+; CHECK: li $r26 = 5
+; CHECK-NOT: sw{{[sc]}} [{{.*}}] = $r26
+; CHECK: sub $r26 = $r26, 1
+; CHECK-NOT: sw{{[sc]}} [{{.*}}] = $r26
+; CHECK: br .LBB0_1
+; CHECK-NOT: sw{{[sc]}} [{{.*}}] = $r26
+; CHECK: retnd
+for.cond:                                         ; preds = %for.inc, %entry
+  %x.0 = phi i32 [ 0, %entry ], [ %add1, %for.inc ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.inc ]
+  %cmp = icmp slt i32 %i.0, %iteration_count
+  br i1 %cmp, label %for.body, label %for.end, !llvm.loop !0
+
+for.body:                                         ; preds = %for.cond
+  %0 = load volatile i32* @_1
+  br label %for.inc
+
+for.inc:                                          ; preds = %for.body
+  %add = add nsw i32 %i.0, %0
+  %add1 = add nsw i32 %x.0, %add
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond
+
+for.end:                                          ; preds = %for.cond
+  ret i32 %x.0
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 4}
@@ -0,0 +1,68 @@
+; RUN: llc < %s -mpatmos-singlepath=main -O2 | FileCheck %s
+; RUN: llc < %s -mpatmos-singlepath=main -O2 -mpatmos-disable-vliw=false | FileCheck %s --check-prefix=VLIW
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests the scheduling of single-path code.
+;
+; The delay slots of the call and of the loop's back edge are filled with
+; instructions of the loop body instead of NOPs, and no NOPs are needed to
+; wait for the results of loads or compares. With bundling enabled, independent
+; instructions are paired into bundles.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+@data = global [4 x i32] [i32 1, i32 2, i32 3, i32 4]
+
+define i32 @f(i32 %x) noinline {
+entry:
+  %y = shl i32 %x, 1
+  ret i32 %y
+}
+
+; CHECK-LABEL: main:
+; CHECK:      # Loop bound: [3, 3]
+; CHECK-NOT:  nop
+; CHECK:      call f_sp_
+; CHECK-NEXT: pmov
+; CHECK-NEXT: lwc $r3 = [$r1]
+; CHECK-NEXT: sws
+; CHECK-NOT:  nop
+; CHECK:      br .LBB1_1
+; CHECK-NEXT: cmplt $p1 = $r22, 4
+; CHECK-NEXT: pand $p3 = $p3, $p1
+; CHECK:      # %end
+
+; VLIW-LABEL: main:
+; VLIW:       # Loop bound: [3, 3]
+; VLIW-NOT:   nop
+; VLIW:       call f_sp_
+; VLIW-NOT:   nop
+; VLIW:       { cmplt $p7 = $r0, $r26
+; VLIW-NEXT:  add $r22 = $r22, 1 }
+; VLIW-NEXT:  br .LBB1_1
+; VLIW-NEXT:  cmplt $p1 = $r22, 4
+; VLIW-NEXT:  { pand $p3 = $p3, $p1
+; VLIW-NEXT:  add $r21 = $r21, $r1 }
+; VLIW:       # %end
+define i32 @main(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p = getelementptr [4 x i32]* @data, i32 0, i32 %i
+  %v = load i32* %p
+  %w = call i32 @f(i32 %v)
+  %acc.next = add i32 %acc, %w
+  %i.next = add i32 %i, 1
+  %c = icmp slt i32 %i.next, 4
+  br i1 %c, label %loop, label %end, !llvm.loop !0
+
+end:
+  ret i32 %acc.next
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 4}
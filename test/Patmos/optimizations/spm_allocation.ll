@@ -0,0 +1,68 @@
+; RUN: llc < %s -mpatmos-spm-size=128 | FileCheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that frequently accessed global variables and frame objects are allocated to the
+; scratchpad if they fit, and that their loads and stores are rewritten to local accesses.
+; Objects that are too large or whose address escapes remain in global memory.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-LABEL: kernel:
+; CHECK: shadd2 [[T:\$r[0-9]+]] = {{\$r[0-9]+}}, table
+; CHECK: lwl {{\$r[0-9]+}} = {{\[}}[[T]]]
+; CHECK: shadd2 [[B:\$r[0-9]+]] = {{\$r[0-9]+}}, kernel.buf
+; CHECK: swl {{\[}}[[B]]] =
+; CHECK: lwc
+; CHECK: lwc
+; CHECK: li [[R:\$r[0-9]+]] = kernel.buf
+; CHECK: lwl {{\$r[0-9]+}} = {{\[}}[[R]] + 3]
+; CHECK: ret
+
+; CHECK: .section .spm,
+; CHECK: table:
+; CHECK: .section .spm,
+; CHECK: kernel.buf:
+@table = internal global [16 x i32] zeroinitializer, align 4
+@big = global [1024 x i32] zeroinitializer, align 4
+@ptr = global i32* getelementptr inbounds ([4 x i32]* @escaped, i32 0, i32 0), align 4
+@escaped = internal global [4 x i32] zeroinitializer, align 4
+
+define i32 @kernel(i32 %n) {
+entry:
+  %buf = alloca [8 x i32], align 4
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %sum = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %idx = and i32 %i, 15
+  %pt = getelementptr inbounds [16 x i32]* @table, i32 0, i32 %idx
+  %t = load i32* %pt, align 4
+  %bi = and i32 %i, 7
+  %pbuf = getelementptr inbounds [8 x i32]* %buf, i32 0, i32 %bi
+  store i32 %t, i32* %pbuf, align 4
+  %pb = getelementptr inbounds [1024 x i32]* @big, i32 0, i32 %i
+  %b = load i32* %pb, align 4
+  %e = load i32* getelementptr inbounds ([4 x i32]* @escaped, i32 0, i32 1), align 4
+  %add0 = add i32 %sum, %b
+  %add = add i32 %add0, %e
+  %inc = add i32 %i, 1
+  %cmp = icmp slt i32 %inc, 1024
+  br i1 %cmp, label %for.body, label %for.end, !llvm.loop !0
+
+for.end:
+  %p0 = getelementptr inbounds [8 x i32]* %buf, i32 0, i32 3
+  %r = load i32* %p0, align 4
+  %res = add i32 %add, %r
+  ret i32 %res
+}
+
+define i32 @main() {
+entry:
+  %r = call i32 @kernel(i32 5)
+  ret i32 %r
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 1023}
@@ -0,0 +1,63 @@
+; RUN: llc < %s -mpatmos-spm-size=128 | FileCheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that frame objects of functions that may be recursive through a function pointer are
+; not allocated to the scratchpad.
+;
+; The call graph has no edge from a to b, since a calls b through a function pointer. b calls a
+; again, so a static copy of a.buf in the scratchpad would be overwritten by the nested call.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-LABEL: a:
+; CHECK-NOT: a.buf
+; CHECK: .size a
+; CHECK-NOT: a.buf
+@fp = global i32 (i32)* @b, align 4
+
+define i32 @a(i32 %n) {
+entry:
+  %buf = alloca [8 x i32], align 4
+  br label %for.body
+
+for.body:
+  %i = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %pbuf = getelementptr inbounds [8 x i32]* %buf, i32 0, i32 %i
+  store i32 %n, i32* %pbuf, align 4
+  %inc = add i32 %i, 1
+  %cmp = icmp slt i32 %inc, 8
+  br i1 %cmp, label %for.body, label %for.end, !llvm.loop !0
+
+for.end:
+  %more = icmp sgt i32 %n, 0
+  br i1 %more, label %recurse, label %done
+
+recurse:
+  %f = load i32 (i32)** @fp, align 4
+  %sub = sub i32 %n, 1
+  %c = call i32 %f(i32 %sub)
+  br label %done
+
+done:
+  %r0 = phi i32 [ 0, %for.end ], [ %c, %recurse ]
+  %p = getelementptr inbounds [8 x i32]* %buf, i32 0, i32 3
+  %v = load i32* %p, align 4
+  %r = add i32 %r0, %v
+  ret i32 %r
+}
+
+define i32 @b(i32 %n) {
+entry:
+  %r = call i32 @a(i32 %n)
+  ret i32 %r
+}
+
+define i32 @main() {
+entry:
+  %r = call i32 @a(i32 3)
+  ret i32 %r
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 0, i32 7}
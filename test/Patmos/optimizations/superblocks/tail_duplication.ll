@@ -0,0 +1,56 @@
+; RUN: llc < %s -mimport-pml=%S/tail_duplication.pml | FileCheck %s
+; RUN: llc < %s -mimport-pml=%S/tail_duplication.pml -mpatmos-disable-superblocks | FileCheck %s --check-prefix=NOSB
+; RUN: llc < %s | FileCheck %s --check-prefix=NOSB
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the join block is tail-duplicated into its critical predecessor, so that the
+; critical path 'entry', 'hot', 'join' ends in a superblock without a branch to 'join'.
+; The cold predecessor still branches to the original join block.
+;
+; Without criticalities from PML, or with superblocks disabled, the join block is not
+; duplicated.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+; CHECK-LABEL: # %hot
+; CHECK: xor
+; CHECK-NOT: br
+; CHECK: swc
+; CHECK: ret
+; CHECK: # %cold
+; CHECK: call{{(nd)?}} foo
+; CHECK: # %join
+; CHECK: swc
+; CHECK: ret
+
+; NOSB-LABEL: main:
+; NOSB: ret
+; NOSB-NOT: ret
+declare void @foo()
+
+define i32 @main(i32 %n, i32* %p) {
+entry:
+  %c = icmp slt i32 %n, 0
+  br i1 %c, label %cold, label %hot
+
+cold:
+  call void @foo()
+  %a0 = load volatile i32* %p
+  %a1 = sub i32 %a0, %n
+  br label %join
+
+hot:
+  %b0 = load volatile i32* %p
+  %b1 = mul i32 %b0, %n
+  %b2 = load volatile i32* %p
+  %b3 = xor i32 %b2, %b1
+  br label %join
+
+join:
+  %r = phi i32 [ %a1, %cold ], [ %b3, %hot ]
+  %r0 = load volatile i32* %p
+  %r1 = add i32 %r0, %r
+  store volatile i32 %r1, i32* %p
+  ret i32 %r1
+}
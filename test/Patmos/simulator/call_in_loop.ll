@@ -0,0 +1,52 @@
+; RUN: SIM_ARGS="-stats"; %test_sim_execution 2>&1 | FileCheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests the statistics reported by the simulator for a loop calling a function.
+;
+; All functions fit into the method cache, so only the first call of each
+; function misses, all other calls and returns hit. The local array of the callee
+; is on the shadow stack and shares a data cache line over all iterations. The
+; stack frame of main fits into the stack cache and is never spilled.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+@values = global [4 x i32] [i32 1, i32 2, i32 3, i32 4]
+
+define i32 @sum(i32 %i) noinline {
+entry:
+  %buf = alloca [4 x i32]
+  %slot = getelementptr [4 x i32]* %buf, i32 0, i32 %i
+  %p = getelementptr [4 x i32]* @values, i32 0, i32 %i
+  %v = load volatile i32* %p
+  store volatile i32 %v, i32* %slot
+  %r = load volatile i32* %slot
+  ret i32 %r
+}
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %v = call i32 @sum(i32 %i)
+  %acc.next = add i32 %acc, %v
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, 4
+  br i1 %cmp, label %loop, label %end, !llvm.loop !0
+
+end:
+  ; Returns 0 if the sum is 10
+  %res = sub i32 %acc.next, 10
+  ret i32 %res
+}
+
+!0 = metadata !{metadata !0, metadata !1}
+!1 = metadata !{metadata !"llvm.loop.bound", i32 4, i32 4}
+
+; CHECK: Cycles: {{[0-9]+}}
+; CHECK: Method cache: 7 hits, 3 misses
+; CHECK: Data cache: 6 hits, 2 misses
+; CHECK: Stack cache: 0 bytes spilled, 0 bytes filled
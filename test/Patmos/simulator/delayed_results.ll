@@ -0,0 +1,15 @@
+; RUN: %test_sim_execution
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the results of loads and multiplications can be used after one delay slot.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+define i32 @main() {
+entry:
+  %0 = call i32 asm sideeffect "add $0 = $$r0, 6\0A\09swl [0] = $0\0A\09lwl $0 = [0]\0A\09nop\0A\09mul $0, $0\0A\09nop\0A\09mfs $0 = $$sl", "=r"()
+  ; Returns 0 if the result is 36
+  %res = sub i32 %0, 36
+  ret i32 %res
+}
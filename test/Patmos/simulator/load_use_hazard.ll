@@ -0,0 +1,15 @@
+; RUN: %test_sim_execution %XFAIL-filecheck %s
+; END.
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+;
+; Tests that the simulator reports the use of a loaded value in the delay slot of the load.
+;
+;//////////////////////////////////////////////////////////////////////////////////////////////////
+
+define i32 @main() {
+entry:
+  %0 = call i32 asm sideeffect "lwl $0 = [0]\0A\09add $0 = $0, 1", "=r"()
+  ret i32 %0
+}
+
+; CHECK: patmos-sim: access to {{r[0-9]+}} at 0x{{[0-9a-f]+}} before the result of 0x{{[0-9a-f]+}} is available
@@ -0,0 +1,167 @@
+//===-- patmos-sim.cpp - Cycle-level simulator for Patmos programs --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This program runs Patmos programs in the simulator of the Patmos target.
+// It accepts linked executables as well as relocatable objects produced by
+// llc -filetype=obj, which are linked statically before execution, so that
+// the code generator can be tested without the external Patmos tool-chain.
+//
+// Execution starts at the entry function (_start by default) and ends when
+// the program returns to address zero. The exit code of the simulator is the
+// value returned by the program in r1, or 255 if the simulation fails.
+//
+//===----------------------------------------------------------------------===//
+
+#include "PatmosSimulator.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+using namespace llvm;
+
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::desc("<input files>"), cl::OneOrMore);
+
+static cl::opt<unsigned>
+MaxCycles("max-cycles", cl::init(0),
+          cl::desc("Stop the simulation after the given number of cycles "
+                   "(default: 0, no limit)"));
+
+static cl::list<std::string>
+DefSyms("defsym", cl::value_desc("name=value"),
+        cl::desc("Define an absolute symbol when linking objects"));
+
+static cl::opt<std::string>
+Entry("entry", cl::init("_start"),
+      cl::desc("Function to start the execution at (default: _start)"));
+
+static cl::opt<bool>
+PrintStats("stats", cl::init(false),
+           cl::desc("Print cycle and cache statistics to stderr"));
+
+static cl::opt<unsigned>
+MemorySize("memory-size", cl::init(PatmosSimConfig().MemorySize),
+           cl::desc("Size of the main memory in bytes"));
+
+static cl::opt<unsigned>
+LocalMemorySize("spm-size", cl::init(PatmosSimConfig().LocalMemorySize),
+                cl::desc("Size of the local scratchpad memory in bytes"));
+
+static cl::opt<unsigned>
+MemoryLatency("memory-latency", cl::init(PatmosSimConfig().MemoryLatency),
+              cl::desc("Latency of a main memory transfer in cycles "
+                       "(default: 7)"));
+
+static cl::opt<unsigned>
+StackCacheSize("stack-cache-size", cl::init(PatmosSimConfig().StackCacheSize),
+               cl::desc("Size of the stack cache in bytes (default: 2048)"));
+
+static cl::opt<unsigned>
+MethodCacheSize("method-cache-size",
+                cl::init(PatmosSimConfig().MethodCacheSize),
+                cl::desc("Size of the method cache in bytes "
+                         "(default: 4096)"));
+
+static cl::opt<unsigned>
+MethodCacheBlocks("method-cache-blocks",
+                  cl::init(PatmosSimConfig().MethodCacheBlocks),
+                  cl::desc("Maximal number of functions in the method cache "
+                           "(default: 16)"));
+
+static cl::opt<unsigned>
+DataCacheSize("data-cache-size", cl::init(PatmosSimConfig().DataCacheSize),
+              cl::desc("Size of the data cache in bytes, 0 disables the "
+                       "data cache (default: 2048)"));
+
+static cl::opt<unsigned>
+DataCacheBlockSize("data-cache-block-size",
+                   cl::init(PatmosSimConfig().DataCacheBlockSize),
+                   cl::desc("Size of a data cache line in bytes "
+                            "(default: 32)"));
+
+static cl::opt<unsigned>
+DataCacheAssoc("data-cache-assoc", cl::init(PatmosSimConfig().DataCacheAssoc),
+               cl::desc("Associativity of the data cache (default: 4)"));
+
+static const int SimulationFailed = 255;
+
+static int error(const Twine &Msg) {
+  errs() << "patmos-sim: " << Msg << "\n";
+  return SimulationFailed;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;  // Call llvm_shutdown() on exit.
+
+  cl::ParseCommandLineOptions(argc, argv, "Patmos simulator\n");
+
+  PatmosSimConfig Config;
+  Config.MemorySize = MemorySize;
+  Config.LocalMemorySize = LocalMemorySize;
+  Config.MemoryLatency = MemoryLatency;
+  Config.StackCacheSize = StackCacheSize;
+  Config.MethodCacheSize = MethodCacheSize;
+  Config.MethodCacheBlocks = MethodCacheBlocks;
+  Config.DataCacheSize = DataCacheSize;
+  Config.DataCacheBlockSize = DataCacheBlockSize;
+  Config.DataCacheAssoc = DataCacheAssoc;
+
+  if (Config.DataCacheSize && (!Config.DataCacheBlockSize ||
+                               !Config.DataCacheAssoc))
+    return error("invalid data cache configuration");
+
+  PatmosSimulator Sim(Config);
+  std::string ErrMsg;
+
+  for (unsigned i = 0, e = InputFilenames.size(); i != e; ++i) {
+    OwningPtr<MemoryBuffer> Buffer;
+    if (error_code ec = MemoryBuffer::getFileOrSTDIN(InputFilenames[i],
+                                                     Buffer))
+      return error(InputFilenames[i] + ": " + ec.message());
+    if (!Sim.addObject(Buffer.take(), ErrMsg))
+      return error(ErrMsg);
+  }
+
+  for (unsigned i = 0, e = DefSyms.size(); i != e; ++i) {
+    std::pair<StringRef, StringRef> Def = StringRef(DefSyms[i]).split('=');
+    uint64_t Value;
+    if (Def.first.empty() || Def.second.getAsInteger(0, Value))
+      return error("invalid symbol definition '" + DefSyms[i] + "'");
+    Sim.defineSymbol(Def.first, Value);
+  }
+
+  if (!Sim.link(ErrMsg))
+    return error(ErrMsg);
+
+  uint32_t EntryAddr;
+  if (!Sim.lookupSymbol(Entry, EntryAddr))
+    return error("entry function '" + Entry + "' not found");
+
+  Sim.reset(EntryAddr);
+  PatmosSimulator::Status Status = Sim.run(MaxCycles);
+
+  if (PrintStats)
+    Sim.getStats().print(errs());
+
+  switch (Status) {
+  case PatmosSimulator::Halted:
+    return Sim.getExitCode();
+  case PatmosSimulator::CycleLimit:
+    return error("cycle limit reached at 0x" + Twine::utohexstr(Sim.getPC()));
+  case PatmosSimulator::Error:
+    return error(Sim.getError());
+  }
+  return SimulationFailed;
+}
@@ -0,0 +1,158 @@
+#include "gtest/gtest.h"
+#include "PatmosILPSolver.h"
+#include "llvm/ADT/OwningPtr.h"
+
+using namespace llvm;
+
+namespace {
+
+/// Solve the given LP using the built-in solver.
+PatmosILPSolver::Status solve(const char *LP, double &Result)
+{
+  OwningPtr<PatmosILPSolver> S(createPatmosBuiltinILPSolver());
+  std::string ErrMsg;
+  return S->solve(LP, Result, ErrMsg);
+}
+
+TEST(ILPSolverTest, MaximizeTest){
+  /*
+   * We test a simple maximization problem whose LP relaxation is integral.
+   */
+  double result = 0;
+  ASSERT_EQ(PatmosILPSolver::Optimal, solve(
+    "Maximize\n"
+    " + 3 x + 2 y\n"
+    "Subject To\n"
+    "c1:\t x + y <= 4\n"
+    "c2:\t x + 3 y <= 6\n"
+    "Generals\n"
+    "x\n"
+    "y\n"
+    "End\n", result));
+  EXPECT_EQ(12., result);
+}
+
+TEST(ILPSolverTest, BranchAndBoundTest){
+  /*
+   * We test that the integer optimum is found when the LP relaxation is
+   * fractional (21 at x = 3, y = 1.5).
+   */
+  double result = 0;
+  ASSERT_EQ(PatmosILPSolver::Optimal, solve(
+    "Maximize\n"
+    " obj: 5 x + 4 y\n"
+    "Subject To\n"
+    " 6 x + 4 y <= 24\n"
+    " x + 2 y <= 6\n"
+    "Generals\n"
+    "x\n"
+    "y\n"
+    "End\n", result));
+  EXPECT_EQ(20., result);
+}
+
+TEST(ILPSolverTest, MinimizeTest){
+  /*
+   * We test minimization, greater-or-equal constraints, and comments.
+   */
+  double result = 0;
+  ASSERT_EQ(PatmosILPSolver::Optimal, solve(
+    "Minimize\n"
+    " + x + y \\ some comment\n"
+    "Subject To\n"
+    "c:\t 2 x + 2 y >= 3\n"
+    "Generals\n"
+    "x\n"
+    "y\n"
+    "End\n", result));
+  EXPECT_EQ(2., result);
+}
+
+TEST(ILPSolverTest, BoundsTest){
+  /*
+   * We test the bounds section, including free variables.
+   */
+  double result = 0;
+  ASSERT_EQ(PatmosILPSolver::Optimal, solve(
+    "Maximize\n"
+    " + x + 2 y\n"
+    "Subject To\n"
+    "c:\t x + y <= 10\n"
+    "Bounds\n"
+    " -inf <= y <= 3\n"
+    " x free\n"
+    "Generals\n"
+    "x\n"
+    "y\n"
+    "End\n", result));
+  EXPECT_EQ(13., result);
+}
+
+TEST(ILPSolverTest, BinariesTest){
+  /*
+   * We test a small knapsack problem over binary variables.
+   */
+  double result = 0;
+  ASSERT_EQ(PatmosILPSolver::Optimal, solve(
+    "Maximize\n"
+    " + 5 a + 4 b + 3 c\n"
+    "Subject To\n"
+    " 2 a + 3 b + c <= 5\n"
+    " 4 a + b + 2 c <= 11\n"
+    " 3 a + 4 b + 2 c <= 8\n"
+    "Binaries\n"
+    "a\n"
+    "b\n"
+    "c\n"
+    "End\n", result));
+  EXPECT_EQ(9., result);
+}
+
+TEST(ILPSolverTest, UnboundedTest){
+  /*
+   * We test that unbounded problems are detected, e.g., recursion without
+   * user-supplied bounds.
+   */
+  double result = 0;
+  EXPECT_EQ(PatmosILPSolver::Unbounded, solve(
+    "Maximize\n"
+    " + x\n"
+    "Subject To\n"
+    "c:\t x - y = 0\n"
+    "Generals\n"
+    "x\n"
+    "y\n"
+    "End\n", result));
+}
+
+TEST(ILPSolverTest, InfeasibleTest){
+  /*
+   * We test that infeasible problems are detected.
+   */
+  double result = 0;
+  EXPECT_EQ(PatmosILPSolver::Infeasible, solve(
+    "Maximize\n"
+    " + x\n"
+    "Subject To\n"
+    "c:\t x >= 3\n"
+    "d:\t x <= 2\n"
+    "Generals\n"
+    "x\n"
+    "End\n", result));
+}
+
+TEST(ILPSolverTest, ParseErrorTest){
+  /*
+   * We test that malformed input makes the solver fail (so that callers can
+   * fall back to an external solver).
+   */
+  double result = 0;
+  EXPECT_EQ(PatmosILPSolver::Failed, solve(
+    "Maximize\n"
+    " + x\n"
+    "Subject To\n"
+    "c:\t x + <= 3\n"
+    "End\n", result));
+}
+
+}
@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include "llvm/PML.h"
+#include "llvm/PMLBinary.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace {
+
+const char *PMLText =
+  "---\n"
+  "format:          pml-0.1\n"
+  "triple:          patmos-unknown-unknown-elf\n"
+  "machine-functions:\n"
+  "  - name:            0\n"
+  "    level:           machinecode\n"
+  "    mapsto:          main\n"
+  "    arguments:\n"
+  "      - name:            '%x'\n"
+  "        index:           0\n"
+  "        registers:       [ r3 ]\n"
+  "    hash:            0\n"
+  "    blocks:\n"
+  "      - name:            0\n"
+  "        mapsto:          entry\n"
+  "        predecessors:    [  ]\n"
+  "        successors:      [ 1 ]\n"
+  "        instructions:\n"
+  "          - index:           0\n"
+  "            opcode:          BRu\n"
+  "            size:            4\n"
+  "            branch-type:     unconditional\n"
+  "            branch-delay-slots: 2\n"
+  "            branch-targets:  [ 1 ]\n"
+  "      - name:            1\n"
+  "        mapsto:          exit\n"
+  "        predecessors:    [ 0 ]\n"
+  "        successors:      [  ]\n"
+  "        loops:           [ 1 ]\n"
+  "timing:\n"
+  "  - origin:          platin\n"
+  "    level:           machinecode\n"
+  "    cycles:          42\n"
+  "    profile:\n"
+  "      - reference:       { function: 0, block: 0 }\n"
+  "        wcet-frequency:  1\n"
+  "        criticality:     1.0\n"
+  "...\n"
+  "---\n"
+  "format:          pml-0.1\n"
+  "triple:          patmos-unknown-unknown-elf\n"
+  "flowfacts:\n"
+  "  - scope:\n"
+  "      function:        main\n"
+  "      loop:            for.cond\n"
+  "    lhs:\n"
+  "      - factor:          1\n"
+  "        program-point:\n"
+  "          function:        main\n"
+  "          block:           for.cond\n"
+  "    op:              less-equal\n"
+  "    rhs:             '(1 + (0 smax %n))'\n"
+  "    level:           bitcode\n"
+  "    origin:          llvm.bc\n"
+  "    classification:  loop-global\n"
+  "...\n";
+
+/// Write the documents as YAML text.
+std::string writeYAML(yaml::PMLDocList &Docs) {
+  std::string Text;
+  raw_string_ostream OS(Text);
+  yaml::Output Out(OS);
+  Out << Docs.YDocs;
+  return OS.str();
+}
+
+TEST(PMLBinaryTest, RoundTripTest){
+  /*
+   * We test that converting YAML to the binary encoding and back does not
+   * lose any information.
+   */
+  yaml::PMLDocList TextDocs;
+  yaml::Input In(PMLText);
+  In >> TextDocs.YDocs;
+  ASSERT_FALSE(In.error());
+  ASSERT_EQ(2U, TextDocs.YDocs.size());
+  std::string Expected = writeYAML(TextDocs);
+
+  std::string Binary;
+  {
+    raw_string_ostream OS(Binary);
+    yaml::BinaryOutput Out(OS);
+    Out << TextDocs.YDocs;
+  }
+  EXPECT_TRUE(yaml::isBinaryPML(Binary));
+  EXPECT_GT(Expected.size(), Binary.size());
+
+  yaml::PMLDocList BinaryDocs;
+  yaml::BinaryInput BIn(Binary);
+  BIn >> BinaryDocs.YDocs;
+  ASSERT_FALSE(BIn.error());
+  ASSERT_EQ(2U, BinaryDocs.YDocs.size());
+  EXPECT_EQ(Expected, writeYAML(BinaryDocs));
+}
+
+TEST(PMLBinaryTest, TruncatedTest){
+  /*
+   * We test that a truncated file is reported as an error.
+   */
+  yaml::PMLDocList TextDocs;
+  yaml::Input In(PMLText);
+  In >> TextDocs.YDocs;
+  ASSERT_FALSE(In.error());
+
+  std::string Binary;
+  {
+    raw_string_ostream OS(Binary);
+    yaml::BinaryOutput Out(OS);
+    Out << TextDocs.YDocs;
+  }
+
+  yaml::PMLDocList BinaryDocs;
+  yaml::BinaryInput BIn(StringRef(Binary).drop_back(Binary.size() / 2));
+  BIn >> BinaryDocs.YDocs;
+  EXPECT_TRUE(BIn.error());
+}
+
+}